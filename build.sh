@@ -5,19 +5,38 @@
 BUILD_DIR="build"
 
 # Define all .c files to compile in one place here
+# Entry points are kept separate so the game and tools share everything else
 SOURCES=$(cat <<EOF
+src/algmine.c
+src/algset.c
+src/bigcube.c
 src/core.c
+src/cpu.c
 src/cube.c
+src/dataset.c
+src/difftest.c
+src/extbfs.c
+src/hint.c
 src/input.c
-src/main.c
+src/moves.c
+src/pipeline.c
+src/pocket.c
+src/scramble.c
+src/service.c
 src/solve.c
+src/trace.c
+src/twophase.c
+src/verify.c
 EOF
 )
+GAME_MAIN="src/main.c"
+TOOLS_MAIN="src/tools.c"
 
 LINUX="linux"
 MACOS="macos"
 WINDOWS="windows"
 WEB="web"
+TOOLS="tools"
 
 # FUNCTIONS ###################################################################
 
@@ -27,6 +46,7 @@ help() {
     echo "  $0 $MACOS"
     echo "  $0 $WINDOWS"
     echo "  $0 $WEB"
+    echo "  $0 $TOOLS    (headless benchmarks and offline jobs, linux)"
     exit 1
 }
 
@@ -49,7 +69,7 @@ shift
 
 # Determine if supplied platform is valid and ensure build directory exists
 case $PLATFORM in
-    $LINUX | $MACOS | $WINDOWS | $WEB)
+    $LINUX | $MACOS | $WINDOWS | $WEB | $TOOLS)
         mkdir -p $BUILD_DIR
 
         TARGET_DIR="$BUILD_DIR/$PLATFORM"
@@ -67,7 +87,7 @@ esac
 case $PLATFORM in
     $LINUX)
         # https://github.com/raysan5/raylib/wiki/Working-on-GNU-Linux
-        cc $SOURCES -DPLATFORM_LINUX \
+        cc $SOURCES $GAME_MAIN -DPLATFORM_LINUX \
             -lraylib -lGL -lm -lpthread -ldl -lrt -lX11 \
             -Wall \
             "$@" \
@@ -75,7 +95,7 @@ case $PLATFORM in
         ;;
     $MACOS)
         # https://github.com/raysan5/raylib/wiki/Working-on-macOS
-        eval cc $SOURCES -DPLATFORM_MACOS \
+        eval cc $SOURCES $GAME_MAIN -DPLATFORM_MACOS \
             -framework IOKit -framework Cocoa -framework OpenGL \
             $(pkg-config --libs --cflags raylib) \
             -Wall \
@@ -84,8 +104,8 @@ case $PLATFORM in
         ;;
     $WINDOWS)
         # https://github.com/raysan5/raylib/wiki/Working-on-Windows
-        gcc $SOURCES -DPLATFORM_WINDOWS \
-            -lraylib -lgdi32 -lwinmm \
+        gcc $SOURCES $GAME_MAIN -DPLATFORM_WINDOWS \
+            -lraylib -lgdi32 -lwinmm -lpthread \
             -Wall \
             "$@" \
             -o $TARGET_DIR/game.exe
@@ -98,7 +118,7 @@ case $PLATFORM in
         # https://github.com/raysan5/raylib/wiki/Working-for-Web-(HTML5)
         # Also define WEB so code can run specific web logic
         emcc -o $TARGET_DIR/index.html \
-            $SOURCES \
+            $SOURCES $GAME_MAIN \
             -Os -Wall \
             $HOME/raylib/src/web/libraylib.web.a \
             -I. -I$HOME/raylib/src -L. -L$HOME/raylib/src/web \
@@ -111,6 +131,15 @@ case $PLATFORM in
             -DPLATFORM_WEB \
             "$@"
         ;;
+    $TOOLS)
+        # Optimised as these are used for benchmarking. Still links raylib for
+        # GetRandomValue and the cube colour types but never opens a window
+        cc $SOURCES $TOOLS_MAIN -DPLATFORM_LINUX \
+            -lraylib -lGL -lm -lpthread -ldl -lrt -lX11 \
+            -O2 -Wall \
+            "$@" \
+            -o $TARGET_DIR/tools
+        ;;
 esac
 
 # Exit the script if the last command, compilation, was unsuccessful
@@ -134,4 +163,8 @@ case $PLATFORM in
     $WEB)
         emrun $TARGET_DIR/index.html
         ;;
+    $TOOLS)
+        # Prints available commands
+        $TARGET_DIR/tools
+        ;;
 esac
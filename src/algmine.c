@@ -0,0 +1,696 @@
+// Algorithm sets mined by search instead of typed in, so how good every
+// algorithm is and which cases there are can always be made again from the
+// faces allowed and how turns are counted.
+//
+// Every case is made on the piece level: the front right pair somewhere in
+// the top layer for F2L (24 cases once AUFs are taken out), each way the last
+// layer can be twisted and flipped for OLL (57) and each way it can be
+// permuted for PLL (21). Cases that are the same but for an AUF before, or
+// for PLL after, are only searched once.
+//
+// Each case gets an IDA* search over the allowed face turns, with every AUF
+// before it tried at each length so the AUF is never counted. What counts as
+// done depends on the set: F2L only needs the first two layers back, OLL
+// needs the last layer pieces the right way up wherever they are, and PLL
+// needs everything solved but for an AUF. The lower bound is the largest of
+// five small pattern tables, each the exact distance to done for four pieces
+// on their own (first layer corners, last layer corners, cross, middle and
+// last layer edges) built by BFS for just the faces allowed. Cases are shared
+// out across threads, one at a time as some take far longer than others.
+//
+// The algorithms come out as an algorithm set in the same text the game
+// loads, so the loader checks each one solves its case and covers it once.
+
+
+#include "algmine.h"
+#include "twophase.h"
+
+#include <string.h>
+
+
+#define ALG_MINE_CORNERS TWOPHASE_CORNER_COUNT
+#define ALG_MINE_EDGES TWOPHASE_EDGE_COUNT
+
+// First last layer slot in CUBE_CORNER_COLOUR_TABLE and CUBE_EDGE_COLOUR_TABLE
+#define ALG_MINE_LL_CORNER 4
+#define ALG_MINE_LL_EDGE 8
+
+// The front right pair when held yellow up, green front
+#define ALG_MINE_PAIR_CORNER 3
+#define ALG_MINE_PAIR_EDGE 7
+
+// Each pattern table is four pieces: the slot of each then which way round
+// each is, all as digits of the index
+#define ALG_MINE_TRACKED 4
+#define ALG_MINE_PATTERN_COUNT 5
+#define ALG_MINE_CORNER_PATTERN_LEN (8 * 8 * 8 * 8 * 81)
+#define ALG_MINE_EDGE_PATTERN_LEN (12 * 12 * 12 * 12 * 16)
+#define ALG_MINE_UNVISITED UINT8_MAX
+
+// OLL has the most cases, 57
+#define ALG_MINE_MAX_CASES 64
+
+#define ALG_MINE_MAX_MOVES (CUBE_COLOUR_COUNT * 3)
+#define ALG_MINE_NOT_FOUND UINT8_MAX
+
+// Case states each set goes through, most of them the same case as another
+static const u32 ALG_MINE_CASE_STATES[ALG_SET_COUNT] = {
+    4 * 3 * 4 * 2,  // Pair corner place and twist, edge place and flip
+    27 * 8,         // First three corner twists and edge flips
+    24 * 24,        // Corner and edge permutations, half of them can't happen
+};
+
+
+const char* ALG_METRIC_NAMES[ALG_METRIC_COUNT] = { "htm", "qtm" };
+
+static const u8 ALG_MINE_PATTERN_PIECES[ALG_MINE_PATTERN_COUNT][ALG_MINE_TRACKED] = {
+    { 0, 1, 2, 3 },     // First layer corners
+    { 4, 5, 6, 7 },     // Last layer corners
+    { 0, 1, 2, 3 },     // Cross edges
+    { 4, 5, 6, 7 },     // Middle layer edges
+    { 8, 9, 10, 11 },   // Last layer edges
+};
+static const bool ALG_MINE_PATTERN_EDGES[ALG_MINE_PATTERN_COUNT] = { false, false, true, true, true };
+
+
+typedef enum {
+    ALG_ROLE_IGNORED,   // Anywhere, any way round
+    ALG_ROLE_SOLVED,    // Home, the right way round
+    ALG_ROLE_ORIENTED,  // Anywhere in the last layer, the right way up
+    ALG_ROLE_AUF,       // Home after the same AUF as the rest of the last layer
+} AlgMineRole;
+
+// Where each piece is rather than what each slot has, so the pattern tables
+// find their pieces without looking for them
+typedef struct {
+    u8 corner_slots[ALG_MINE_CORNERS];
+    u8 twists[ALG_MINE_CORNERS];
+    u8 edge_slots[ALG_MINE_EDGES];
+    u8 flips[ALG_MINE_EDGES];
+} AlgMineState;
+
+typedef struct {
+    u8 turn;
+    u8 cost;
+} AlgMineMove;
+
+// What done is for one set and the pattern tables towards it, NULL for
+// tables of pieces the set doesn't care about
+typedef struct {
+    u8 corner_roles[ALG_MINE_CORNERS];
+    u8 edge_roles[ALG_MINE_EDGES];
+    u8* patterns[ALG_MINE_PATTERN_COUNT];
+} AlgMineGoal;
+
+typedef struct {
+    enum8(AlgSetKind) kind;
+    u32 key;
+    AlgMineState start;
+    u8 length;          // In the metric, ALG_MINE_NOT_FOUND if over the limit
+    u8 turn_count;
+    u8 turns[ALG_MAX_LEN];
+    u64 nodes;
+} AlgMineCase;
+
+typedef struct {
+    AlgMineMove moves[ALG_MINE_MAX_MOVES];
+    u32 move_count;
+    u8 max_length;
+    AlgMineGoal goals[ALG_SET_COUNT];
+    AlgMineCase cases[ALG_SET_COUNT * ALG_MINE_MAX_CASES];
+    u32 case_count;
+    u32 next_case;
+} AlgMineJob;
+
+typedef struct {
+    const AlgMineJob* job;
+    const AlgMineGoal* goal;
+    u8 bound;
+    u8 turns[ALG_MAX_LEN];
+    u8 turn_count;
+    u64 nodes;
+} AlgMineSearch;
+
+
+// Found from TwoPhaseCubieTurn on first use. A piece in slot s goes to slot
+// ALG_MINE_CORNER_TO[turn][s] and turns ALG_MINE_TWIST_BY[turn][s] more.
+static bool alg_mine_ready = false;
+static u8 ALG_MINE_CORNER_TO[TURN_TYPE_COUNT][ALG_MINE_CORNERS];
+static u8 ALG_MINE_TWIST_BY[TURN_TYPE_COUNT][ALG_MINE_CORNERS];
+static u8 ALG_MINE_EDGE_TO[TURN_TYPE_COUNT][ALG_MINE_EDGES];
+static u8 ALG_MINE_FLIP_BY[TURN_TYPE_COUNT][ALG_MINE_EDGES];
+
+// Where the piece from each slot is after auf last layer turns (TURN_DOWN)
+static u8 ALG_MINE_AUF_CORNERS[4][ALG_MINE_CORNERS];
+static u8 ALG_MINE_AUF_EDGES[4][ALG_MINE_EDGES];
+
+
+static void AlgMineTablesInit(void) {
+    if (alg_mine_ready) return;
+    TwoPhaseCubiesInit();
+
+    for (int t = 0; t < TURN_TYPE_COUNT; t++) {
+        TwoPhaseCubie cubie;
+        TwoPhaseCubieSolved(&cubie);
+        TwoPhaseCubieTurn(&cubie, t);
+        for (int i = 0; i < ALG_MINE_CORNERS; i++) {
+            ALG_MINE_CORNER_TO[t][cubie.cp[i]] = i;
+            ALG_MINE_TWIST_BY[t][cubie.cp[i]] = cubie.co[i];
+        }
+        for (int i = 0; i < ALG_MINE_EDGES; i++) {
+            ALG_MINE_EDGE_TO[t][cubie.ep[i]] = i;
+            ALG_MINE_FLIP_BY[t][cubie.ep[i]] = cubie.eo[i];
+        }
+    }
+
+    for (int s = 0; s < ALG_MINE_CORNERS; s++) ALG_MINE_AUF_CORNERS[0][s] = s;
+    for (int s = 0; s < ALG_MINE_EDGES; s++) ALG_MINE_AUF_EDGES[0][s] = s;
+    for (int auf = 1; auf < 4; auf++) {
+        for (int s = 0; s < ALG_MINE_CORNERS; s++) {
+            ALG_MINE_AUF_CORNERS[auf][s] = ALG_MINE_CORNER_TO[TURN_DOWN][ALG_MINE_AUF_CORNERS[auf - 1][s]];
+        }
+        for (int s = 0; s < ALG_MINE_EDGES; s++) {
+            ALG_MINE_AUF_EDGES[auf][s] = ALG_MINE_EDGE_TO[TURN_DOWN][ALG_MINE_AUF_EDGES[auf - 1][s]];
+        }
+    }
+
+    alg_mine_ready = true;
+}
+
+static void AlgMineTurn(const AlgMineState* state, u8 turn, AlgMineState* out) {
+    for (int p = 0; p < ALG_MINE_CORNERS; p++) {
+        u8 slot = state->corner_slots[p];
+        out->corner_slots[p] = ALG_MINE_CORNER_TO[turn][slot];
+        out->twists[p] = (state->twists[p] + ALG_MINE_TWIST_BY[turn][slot]) % 3;
+    }
+    for (int p = 0; p < ALG_MINE_EDGES; p++) {
+        u8 slot = state->edge_slots[p];
+        out->edge_slots[p] = ALG_MINE_EDGE_TO[turn][slot];
+        out->flips[p] = state->flips[p] ^ ALG_MINE_FLIP_BY[turn][slot];
+    }
+}
+
+static void AlgMineFromCubie(TwoPhaseCubie* cubie, AlgMineState* state) {
+    for (int i = 0; i < ALG_MINE_CORNERS; i++) {
+        state->corner_slots[cubie->cp[i]] = i;
+        state->twists[cubie->cp[i]] = cubie->co[i];
+    }
+    for (int i = 0; i < ALG_MINE_EDGES; i++) {
+        state->edge_slots[cubie->ep[i]] = i;
+        state->flips[cubie->ep[i]] = cubie->eo[i];
+    }
+}
+
+static bool AlgMinePieceDone(u8 role, bool edge, u8 piece, u8 slot, u8 orientation, u8 auf) {
+    if (role == ALG_ROLE_IGNORED) return true;
+    if (orientation != 0) return false;
+    if (role == ALG_ROLE_SOLVED) return slot == piece;
+    if (role == ALG_ROLE_ORIENTED) return slot >= (edge ? ALG_MINE_LL_EDGE : ALG_MINE_LL_CORNER);
+    return slot == (edge ? ALG_MINE_AUF_EDGES[auf][piece] : ALG_MINE_AUF_CORNERS[auf][piece]);
+}
+
+static bool AlgMineSolved(const AlgMineGoal* goal, const AlgMineState* state) {
+    // The whole last layer has to agree on one AUF, so it's read off the
+    // first corner. Only ALG_ROLE_AUF pieces look at it.
+    u8 auf = 0;
+    while (auf < 3 && ALG_MINE_AUF_CORNERS[auf][ALG_MINE_LL_CORNER] != state->corner_slots[ALG_MINE_LL_CORNER]) auf++;
+
+    for (int p = 0; p < ALG_MINE_CORNERS; p++) {
+        if (!AlgMinePieceDone(goal->corner_roles[p], false, p, state->corner_slots[p], state->twists[p], auf)) {
+            return false;
+        }
+    }
+    for (int p = 0; p < ALG_MINE_EDGES; p++) {
+        if (!AlgMinePieceDone(goal->edge_roles[p], true, p, state->edge_slots[p], state->flips[p], auf)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// PATTERNS ///////////////////////////////////////////////////////////////////
+static u32 AlgMinePatternIndex(const AlgMineState* state, int pattern) {
+    const u8* pieces = ALG_MINE_PATTERN_PIECES[pattern];
+    u32 slots = 0;
+    u32 orientations = 0;
+    if (ALG_MINE_PATTERN_EDGES[pattern]) {
+        for (int k = 0; k < ALG_MINE_TRACKED; k++) {
+            slots = slots * ALG_MINE_EDGES + state->edge_slots[pieces[k]];
+            orientations = orientations * 2 + state->flips[pieces[k]];
+        }
+        return slots * 16 + orientations;
+    }
+    for (int k = 0; k < ALG_MINE_TRACKED; k++) {
+        slots = slots * ALG_MINE_CORNERS + state->corner_slots[pieces[k]];
+        orientations = orientations * 3 + state->twists[pieces[k]];
+    }
+    return slots * 81 + orientations;
+}
+
+// Digits back out, false if two pieces would share a slot
+static bool AlgMinePatternDecode(u32 index, bool edges, u8* slots, u8* orientations) {
+    u32 slot_count = edges ? ALG_MINE_EDGES : ALG_MINE_CORNERS;
+    u32 orientation_count = edges ? 2 : 3;
+    for (int k = ALG_MINE_TRACKED - 1; k >= 0; k--) {
+        orientations[k] = index % orientation_count;
+        index /= orientation_count;
+    }
+    for (int k = ALG_MINE_TRACKED - 1; k >= 0; k--) {
+        slots[k] = index % slot_count;
+        index /= slot_count;
+    }
+    for (int i = 0; i < ALG_MINE_TRACKED; i++) {
+        for (int j = i + 1; j < ALG_MINE_TRACKED; j++) {
+            if (slots[i] == slots[j]) return false;
+        }
+    }
+    return true;
+}
+
+static u32 AlgMinePatternEncode(const u8* slots, const u8* orientations, bool edges) {
+    u32 slot_index = 0;
+    u32 orientation_index = 0;
+    for (int k = 0; k < ALG_MINE_TRACKED; k++) {
+        slot_index = slot_index * (edges ? ALG_MINE_EDGES : ALG_MINE_CORNERS) + slots[k];
+        orientation_index = orientation_index * (edges ? 2 : 3) + orientations[k];
+    }
+    return slot_index * (edges ? 16 : 81) + orientation_index;
+}
+
+// Distance to done for the pattern's four pieces alone, starting from every
+// state where they're done. A half turn costs 2 in QTM, so this goes a
+// distance at a time over the whole table rather than keeping a queue.
+static void AlgMinePatternBuild(AlgMineJob* job, AlgMineGoal* goal, int pattern, u8* distances) {
+    bool edges = ALG_MINE_PATTERN_EDGES[pattern];
+    const u8* pieces = ALG_MINE_PATTERN_PIECES[pattern];
+    const u8* roles = edges ? goal->edge_roles : goal->corner_roles;
+    u32 length = edges ? ALG_MINE_EDGE_PATTERN_LEN : ALG_MINE_CORNER_PATTERN_LEN;
+    MemSet(distances, ALG_MINE_UNVISITED, length);
+
+    u8 slots[ALG_MINE_TRACKED];
+    u8 orientations[ALG_MINE_TRACKED];
+    for (u32 index = 0; index < length; index++) {
+        if (!AlgMinePatternDecode(index, edges, slots, orientations)) continue;
+        for (u8 auf = 0; auf < 4; auf++) {
+            bool done = true;
+            for (int k = 0; k < ALG_MINE_TRACKED; k++) {
+                done = done && AlgMinePieceDone(roles[pieces[k]], edges, pieces[k], slots[k], orientations[k], auf);
+            }
+            if (done) distances[index] = 0;
+        }
+    }
+
+    u32 deepest = 0;
+    for (u32 distance = 0; distance <= deepest; distance++) {
+        for (u32 index = 0; index < length; index++) {
+            if (distances[index] != distance) continue;
+            AlgMinePatternDecode(index, edges, slots, orientations);
+
+            for (u32 m = 0; m < job->move_count; m++) {
+                u8 turn = job->moves[m].turn;
+                u8 next_slots[ALG_MINE_TRACKED];
+                u8 next_orientations[ALG_MINE_TRACKED];
+                for (int k = 0; k < ALG_MINE_TRACKED; k++) {
+                    if (edges) {
+                        next_slots[k] = ALG_MINE_EDGE_TO[turn][slots[k]];
+                        next_orientations[k] = orientations[k] ^ ALG_MINE_FLIP_BY[turn][slots[k]];
+                    } else {
+                        next_slots[k] = ALG_MINE_CORNER_TO[turn][slots[k]];
+                        next_orientations[k] = (orientations[k] + ALG_MINE_TWIST_BY[turn][slots[k]]) % 3;
+                    }
+                }
+
+                u32 next = AlgMinePatternEncode(next_slots, next_orientations, edges);
+                u32 next_distance = distance + job->moves[m].cost;
+                if (next_distance < distances[next]) {
+                    distances[next] = next_distance;
+                    deepest = MaxU32(deepest, next_distance);
+                }
+            }
+        }
+    }
+}
+
+static u8 AlgMineLowerBound(const AlgMineGoal* goal, const AlgMineState* state) {
+    u8 bound = 0;
+    for (int pattern = 0; pattern < ALG_MINE_PATTERN_COUNT; pattern++) {
+        if (goal->patterns[pattern] == NULL) continue;
+        bound = MaxU8(bound, goal->patterns[pattern][AlgMinePatternIndex(state, pattern)]);
+    }
+    return bound;
+}
+
+static void AlgMineGoalInit(Arena* arena, AlgMineJob* job, enum8(AlgSetKind) kind) {
+    static const u8 LAST_LAYER_ROLES[ALG_SET_COUNT] = { ALG_ROLE_IGNORED, ALG_ROLE_ORIENTED, ALG_ROLE_AUF };
+
+    AlgMineGoal* goal = &job->goals[kind];
+    for (int p = 0; p < ALG_MINE_CORNERS; p++) {
+        goal->corner_roles[p] = p < ALG_MINE_LL_CORNER ? ALG_ROLE_SOLVED : LAST_LAYER_ROLES[kind];
+    }
+    for (int p = 0; p < ALG_MINE_EDGES; p++) {
+        goal->edge_roles[p] = p < ALG_MINE_LL_EDGE ? ALG_ROLE_SOLVED : LAST_LAYER_ROLES[kind];
+    }
+
+    for (int pattern = 0; pattern < ALG_MINE_PATTERN_COUNT; pattern++) {
+        bool edges = ALG_MINE_PATTERN_EDGES[pattern];
+        const u8* roles = edges ? goal->edge_roles : goal->corner_roles;
+        bool ignored = true;
+        for (int k = 0; k < ALG_MINE_TRACKED; k++) {
+            if (roles[ALG_MINE_PATTERN_PIECES[pattern][k]] != ALG_ROLE_IGNORED) ignored = false;
+        }
+        if (ignored) {
+            goal->patterns[pattern] = NULL;
+            continue;
+        }
+
+        u32 length = edges ? ALG_MINE_EDGE_PATTERN_LEN : ALG_MINE_CORNER_PATTERN_LEN;
+        goal->patterns[pattern] = ArenaPushArray(arena, length, u8);
+        AlgMinePatternBuild(job, goal, pattern, goal->patterns[pattern]);
+    }
+}
+
+// CASES //////////////////////////////////////////////////////////////////////
+// Lehmer code to a permutation of four, returns its parity
+static u8 AlgMinePermutation(u8 index, u8* perm) {
+    u8 left[4] = { 0, 1, 2, 3 };
+    u8 parity = 0;
+    for (int i = 0; i < 4; i++) {
+        u8 factorial = i == 0 ? 6 : i == 1 ? 2 : 1;
+        u8 pick = (index / factorial) % (4 - i);
+        perm[i] = left[pick];
+        parity ^= pick & 1;
+        for (int j = pick; j < 3 - i; j++) left[j] = left[j + 1];
+    }
+    return parity;
+}
+
+// Case state index of a set (see ALG_MINE_CASE_STATES), false for the PLL
+// ones with the corners and edges disagreeing on parity
+static bool AlgMineCaseCubie(enum8(AlgSetKind) kind, u32 index, TwoPhaseCubie* cubie) {
+    TwoPhaseCubieSolved(cubie);
+
+    if (kind == ALG_SET_F2L) {
+        // Pair pieces swapped with the last layer pieces where they are,
+        // which keep the twist and flip sums right
+        u8 corner_slot = ALG_MINE_LL_CORNER + index / 24;
+        u8 twist = index / 8 % 3;
+        u8 edge_slot = ALG_MINE_LL_EDGE + index / 2 % 4;
+        u8 flip = index % 2;
+        cubie->cp[ALG_MINE_PAIR_CORNER] = corner_slot;
+        cubie->co[ALG_MINE_PAIR_CORNER] = (3 - twist) % 3;
+        cubie->cp[corner_slot] = ALG_MINE_PAIR_CORNER;
+        cubie->co[corner_slot] = twist;
+        cubie->ep[ALG_MINE_PAIR_EDGE] = edge_slot;
+        cubie->eo[ALG_MINE_PAIR_EDGE] = flip;
+        cubie->ep[edge_slot] = ALG_MINE_PAIR_EDGE;
+        cubie->eo[edge_slot] = flip;
+    } else if (kind == ALG_SET_OLL) {
+        u32 twists = index / 8;
+        u8 twist_sum = 0;
+        u8 flip_sum = 0;
+        for (int i = 0; i < 3; i++) {
+            cubie->co[ALG_MINE_LL_CORNER + i] = twists % 3;
+            twist_sum += twists % 3;
+            twists /= 3;
+            cubie->eo[ALG_MINE_LL_EDGE + i] = (index >> i) & 1;
+            flip_sum += (index >> i) & 1;
+        }
+        cubie->co[ALG_MINE_LL_CORNER + 3] = (3 - twist_sum % 3) % 3;
+        cubie->eo[ALG_MINE_LL_EDGE + 3] = flip_sum % 2;
+    } else {
+        u8 corners[4];
+        u8 edges[4];
+        if (AlgMinePermutation(index / 24, corners) != AlgMinePermutation(index % 24, edges)) return false;
+        for (int i = 0; i < 4; i++) {
+            cubie->cp[ALG_MINE_LL_CORNER + i] = ALG_MINE_LL_CORNER + corners[i];
+            cubie->ep[ALG_MINE_LL_EDGE + i] = ALG_MINE_LL_EDGE + edges[i];
+        }
+    }
+
+    assert(TwoPhaseCubieSolvable(cubie));
+    return true;
+}
+
+// The same number for every AUF of a case, the smallest over all of them of
+// what the set cares about: where the pair is for F2L, which way up each
+// last layer piece is for OLL and which piece is where for PLL, with the
+// pieces relabelled by each AUF after as well
+static u32 AlgMineCaseKey(enum8(AlgSetKind) kind, const AlgMineState* state) {
+    u32 best = UINT32_MAX;
+    AlgMineState turned = *state;
+    for (int pre = 0; pre < 4; pre++) {
+        u8 corners_at[ALG_MINE_CORNERS];
+        u8 edges_at[ALG_MINE_EDGES];
+        for (int p = 0; p < ALG_MINE_CORNERS; p++) corners_at[turned.corner_slots[p]] = p;
+        for (int p = 0; p < ALG_MINE_EDGES; p++) edges_at[turned.edge_slots[p]] = p;
+
+        for (int post = 0; post < (kind == ALG_SET_PLL ? 4 : 1); post++) {
+            u32 key = 0;
+            if (kind == ALG_SET_F2L) {
+                key = turned.corner_slots[ALG_MINE_PAIR_CORNER] * 3 + turned.twists[ALG_MINE_PAIR_CORNER];
+                key = (key * ALG_MINE_EDGES + turned.edge_slots[ALG_MINE_PAIR_EDGE]) * 2;
+                key += turned.flips[ALG_MINE_PAIR_EDGE];
+            } else if (kind == ALG_SET_OLL) {
+                for (int i = 0; i < 4; i++) key = key * 3 + turned.twists[corners_at[ALG_MINE_LL_CORNER + i]];
+                for (int i = 0; i < 4; i++) key = key * 2 + turned.flips[edges_at[ALG_MINE_LL_EDGE + i]];
+            } else {
+                for (int i = 0; i < 4; i++) {
+                    u8 piece = ALG_MINE_AUF_CORNERS[post][corners_at[ALG_MINE_LL_CORNER + i]];
+                    key = key * 4 + piece - ALG_MINE_LL_CORNER;
+                }
+                for (int i = 0; i < 4; i++) {
+                    u8 piece = ALG_MINE_AUF_EDGES[post][edges_at[ALG_MINE_LL_EDGE + i]];
+                    key = key * 4 + piece - ALG_MINE_LL_EDGE;
+                }
+            }
+            best = MinU32(best, key);
+        }
+
+        AlgMineState before = turned;
+        AlgMineTurn(&before, TURN_DOWN, &turned);
+    }
+    return best;
+}
+
+// Every case of a set once, leaving out the one that's already done
+static void AlgMineCasesInit(AlgMineJob* job, enum8(AlgSetKind) kind) {
+    u32 first = job->case_count;
+    for (u32 index = 0; index < ALG_MINE_CASE_STATES[kind]; index++) {
+        TwoPhaseCubie cubie;
+        if (!AlgMineCaseCubie(kind, index, &cubie)) continue;
+
+        AlgMineCase* mine_case = &job->cases[job->case_count];
+        MemZero(mine_case, sizeof(AlgMineCase));
+        mine_case->kind = kind;
+        AlgMineFromCubie(&cubie, &mine_case->start);
+        if (AlgMineSolved(&job->goals[kind], &mine_case->start)) continue;
+
+        mine_case->key = AlgMineCaseKey(kind, &mine_case->start);
+        bool seen = false;
+        for (u32 i = first; i < job->case_count; i++) {
+            if (job->cases[i].key == mine_case->key) seen = true;
+        }
+        if (seen) continue;
+
+        assert(job->case_count - first < ALG_MINE_MAX_CASES);
+        job->case_count++;
+    }
+}
+
+// SEARCH /////////////////////////////////////////////////////////////////////
+static bool AlgMineDepthFirst(AlgMineSearch* search, const AlgMineState* state, u8 depth, u8 cost) {
+    search->nodes++;
+    u8 bound = AlgMineLowerBound(search->goal, state);
+    if ((u32) cost + bound > search->bound) return false;
+    if (bound == 0 && depth > 0 && AlgMineSolved(search->goal, state)) {
+        search->turn_count = depth;
+        return true;
+    }
+    if (depth == ALG_MAX_LEN) return false;
+
+    const AlgMineJob* job = search->job;
+    u8 last = depth > 0 ? search->turns[depth - 1] % CUBE_COLOUR_COUNT : CUBE_COLOUR_COUNT;
+    for (u32 m = 0; m < job->move_count; m++) {
+        u8 turn = job->moves[m].turn;
+        u8 face = turn % CUBE_COLOUR_COUNT;
+
+        // Starting with the last layer is just another AUF, those are all
+        // tried anyway. Same face twice is one turn, and opposite faces
+        // commute so only one order of them is searched.
+        if (depth == 0 && face == TURN_DOWN) continue;
+        if (face == last) continue;
+        if (last != CUBE_COLOUR_COUNT && (face + 3) % CUBE_COLOUR_COUNT == last && face < last) continue;
+
+        AlgMineState next;
+        AlgMineTurn(state, turn, &next);
+        search->turns[depth] = turn;
+        if (AlgMineDepthFirst(search, &next, depth + 1, cost + job->moves[m].cost)) return true;
+    }
+    return false;
+}
+
+static void AlgMineCaseSolve(const AlgMineJob* job, AlgMineCase* mine_case) {
+    AlgMineSearch search = {
+        .job = job,
+        .goal = &job->goals[mine_case->kind],
+    };
+
+    AlgMineState starts[4];
+    starts[0] = mine_case->start;
+    for (int pre = 1; pre < 4; pre++) AlgMineTurn(&starts[pre - 1], TURN_DOWN, &starts[pre]);
+
+    mine_case->length = ALG_MINE_NOT_FOUND;
+    for (u32 bound = 1; bound <= job->max_length && mine_case->length == ALG_MINE_NOT_FOUND; bound++) {
+        search.bound = bound;
+        for (int pre = 0; pre < 4; pre++) {
+            if (!AlgMineDepthFirst(&search, &starts[pre], 0, 0)) continue;
+            mine_case->length = bound;
+            mine_case->turn_count = search.turn_count;
+            MemCopy(mine_case->turns, search.turns, search.turn_count);
+            break;
+        }
+    }
+    mine_case->nodes = search.nodes;
+}
+
+static void AlgMineWorker(void* data, u32 thread_index, u32 thread_count) {
+    (void) thread_index;
+    (void) thread_count;
+    AlgMineJob* job = data;
+
+    while (true) {
+        u32 index = __atomic_fetch_add(&job->next_case, 1, __ATOMIC_RELAXED);
+        if (index >= job->case_count) break;
+        AlgMineCaseSolve(job, &job->cases[index]);
+    }
+}
+
+// RUN ////////////////////////////////////////////////////////////////////////
+static bool AlgMineMovesInit(AlgMineJob* job, const char* faces, enum8(AlgMetric) metric) {
+    job->move_count = 0;
+    u16 used = 0;
+    for (const char* c = faces; *c != '\0'; c++) {
+        u8 face = AlgFaceFromChar(*c);
+        if (face == CUBE_COLOUR_COUNT) {
+            printf("'%c' isn't a face, expected some of FRUBLD\n", *c);
+            return false;
+        }
+        if (FlagGet(used, Bit(face))) continue;
+        FlagSet(used, Bit(face));
+
+        job->moves[job->move_count++] = (AlgMineMove) { face, 1 };
+        job->moves[job->move_count++] = (AlgMineMove) { face + TURN_FRONT_PRIME, 1 };
+        job->moves[job->move_count++] = (AlgMineMove) { face + TURN_FRONT_DOUBLE, metric == ALG_METRIC_QTM ? 2 : 1 };
+    }
+    if (job->move_count == 0) {
+        printf("No faces to turn\n");
+        return false;
+    }
+    return true;
+}
+
+bool AlgMineRun(
+    Arena* arena, const char* faces, enum8(AlgMetric) metric, u8 max_length, u32 thread_count, const char* path
+) {
+    assert(metric < ALG_METRIC_COUNT && max_length <= ALG_MAX_LEN);
+    AlgMineTablesInit();
+
+    printf("----- ALGORITHM MINER -----\n");
+
+    AlgMineJob* job = ArenaPushStruct(arena, AlgMineJob);
+    if (!AlgMineMovesInit(job, faces, metric)) return false;
+    job->max_length = max_length;
+
+    double start = TimeSeconds();
+    for (int k = 0; k < ALG_SET_COUNT; k++) {
+        AlgMineGoalInit(arena, job, k);
+        AlgMineCasesInit(job, k);
+    }
+    double tables_seconds = TimeSeconds() - start;
+
+    start = TimeSeconds();
+    ParallelRun(thread_count, AlgMineWorker, job);
+    double search_seconds = TimeSeconds() - start;
+
+    printf("Faces: %s, %s, at most %u\n", faces, ALG_METRIC_NAMES[metric], max_length);
+    printf("Tables: %.2fs, search: %.2fs on %u threads\n", tables_seconds, search_seconds, thread_count);
+    for (int k = 0; k < ALG_SET_COUNT; k++) {
+        u32 cases = 0;
+        u32 found = 0;
+        u32 total = 0;
+        u32 longest = 0;
+        u64 nodes = 0;
+        for (u32 i = 0; i < job->case_count; i++) {
+            AlgMineCase* mine_case = &job->cases[i];
+            if (mine_case->kind != k) continue;
+            cases++;
+            nodes += mine_case->nodes;
+            if (mine_case->length == ALG_MINE_NOT_FOUND) continue;
+            found++;
+            total += mine_case->length;
+            longest = MaxU32(longest, mine_case->length);
+        }
+        printf(
+            "%s: %2u / %2u cases, mean %.2f, longest %2u, %llu nodes\n",
+            ALG_SET_NAMES[k], found, cases, found > 0 ? (double) total / found : 0.0, longest,
+            (unsigned long long) nodes
+        );
+    }
+
+    // Every line has room for the longest algorithm there can be
+    u64 line_size = ALG_NAME_LEN + AlgFormatSize(ALG_MAX_LEN) + 64;
+    u64 text_size = Kilobytes(1) + job->case_count * line_size;
+    char* text = ArenaPushArray(arena, text_size, char);
+    u64 used = snprintf(
+        text, text_size,
+        "# Mined by `tools mine-algs %s %s %u`: a shortest algorithm turning only\n"
+        "# those faces for every case, AUFs not counted. Held yellow up, green front.\n",
+        faces, ALG_METRIC_NAMES[metric], max_length
+    );
+
+    u32 numbers[ALG_SET_COUNT] = { 0 };
+    for (u32 i = 0; i < job->case_count; i++) {
+        AlgMineCase* mine_case = &job->cases[i];
+        u32 number = ++numbers[mine_case->kind];
+        if (i == 0 || job->cases[i - 1].kind != mine_case->kind) used += snprintf(text + used, text_size - used, "\n");
+
+        if (mine_case->length == ALG_MINE_NOT_FOUND) {
+            used += snprintf(
+                text + used, text_size - used, "# %s m%u: none in %u\n",
+                ALG_SET_NAMES[mine_case->kind], number, max_length
+            );
+            continue;
+        }
+
+        char turns[AlgFormatSize(ALG_MAX_LEN)];
+        AlgFormat(mine_case->turns, mine_case->turn_count, turns);
+        used += snprintf(
+            text + used, text_size - used, "%s m%u: %s\n", ALG_SET_NAMES[mine_case->kind], number, turns
+        );
+    }
+    assert(used < text_size);
+
+    const char* source = path != NULL ? path : "mined";
+    AlgSet set;
+    bool valid = AlgSetParse(arena, &set, text, source);
+    AlgSetReport(&set);
+
+    if (path == NULL) {
+        printf("\n%s", text);
+        return valid;
+    }
+
+    FILE* file = fopen(path, "wb");
+    if (file == NULL) {
+        printf("Couldn't open %s\n", path);
+        return false;
+    }
+    bool written = fwrite(text, 1, used, file) == used;
+    written = fclose(file) == 0 && written;
+    if (!written) {
+        printf("Couldn't write %s\n", path);
+        return false;
+    }
+    printf("Wrote %s\n", path);
+    return valid;
+}
@@ -0,0 +1,43 @@
+#ifndef ALGMINE_H
+#define ALGMINE_H
+
+
+#include "core.h"
+#include "algset.h"
+#include "cube.h"
+
+
+// Faces the mined algorithms may turn, written held yellow up, green front
+#define ALG_MINE_DEFAULT_FACES "RUF"
+
+// Longest algorithm searched for in the metric's turns. Cases that need more
+// are left out of the set and fall back to whatever else covers them.
+#define ALG_MINE_DEFAULT_LENGTH 14
+
+// Pattern tables for each set, the cases and the set's text
+#define ALG_MINE_ARENA_SIZE Megabytes(16)
+
+
+// How an algorithm's length is counted: every face turn as one, or half
+// turns as two quarter turns
+typedef enum {
+    ALG_METRIC_HTM,
+    ALG_METRIC_QTM,
+
+    ALG_METRIC_COUNT
+} AlgMetric;
+
+extern const char* ALG_METRIC_NAMES[ALG_METRIC_COUNT];
+
+
+// Finds a shortest algorithm using only faces (say "RUF") for every F2L case
+// with the pair in the top layer, every OLL and every PLL, the cases shared
+// out across thread_count threads. The algorithms come out as an algorithm
+// set, written to path if there is one and printed otherwise, and are loaded
+// back the way the game would load them to check every one.
+bool AlgMineRun(
+    Arena* arena, const char* faces, enum8(AlgMetric) metric, u8 max_length, u32 thread_count, const char* path
+);
+
+
+#endif  /* ALGMINE_H */
@@ -0,0 +1,642 @@
+// Algorithm sets loaded from text so a set can be swapped without touching
+// the lookup tables in solve.c. One algorithm per line:
+//
+//   # comment
+//   oll Sune: R U R' U R U2 R'
+//   pll T: R U R' U' R' F R2 U' R' U' R U R' F'
+//   f2l 1: U R U' R'
+//
+// Algorithms are written the way everyone writes them, holding the cube
+// yellow up and green front. The cube is stored white up so every turn is
+// mapped through a frame that starts as a z2, and slices, wide turns and
+// rotations just move the frame around, leaving only face turns. Anything
+// that ends with the whole cube rotated is rejected as centres never move.
+//
+// Each algorithm is then compiled into a sticker permutation by composing
+// per-turn permutations (found once by probing CubeTurn), so applying one is
+// a single gather no matter how long it is. The case an algorithm solves is
+// found by running it backwards from solved, which means every algorithm
+// solves its case by construction; what gets checked is that it only touches
+// what it is allowed to (the last layer, or one F2L pair), that it actually
+// does something, and that no earlier line already covers the case. Every
+// registered case is also applied the compiled way and checked against the
+// goal for the set, which is the same path the solver takes.
+//
+// F2L algorithms are written for any one slot and get compiled again for the
+// other three by relabelling the side faces.
+
+
+#include "algset.h"
+#include "solve.h"
+
+#include <string.h>
+
+
+DEFINE_TYPED_HASHMAP(u32, u32, AlgCaseMap, HashU64, HashEqual)
+
+
+// At most 384 cases per set, stays under 7/8 full so the maps never grow
+#define ALG_CASE_MAP_START_LEN 512
+
+// Far more than ALG_MAX_COUNT lines of comments and algorithms need
+#define ALG_FILE_MAX_SIZE Megabytes(1)
+
+#define ALG_LAST_LAYER_LEN 20
+#define ALG_LAST_LAYER_SIDE_LEN 12
+
+
+const char* ALG_SET_NAMES[ALG_SET_COUNT] = { "f2l", "oll", "pll" };
+
+// Cases per set. OLL and PLL include the solved state (and its AUFs for PLL)
+// which need no algorithm.
+static const u32 ALG_SET_CASE_TOTAL[ALG_SET_COUNT] = {
+    4 * 4 * 3 * 4 * 2,  // 4 slots, corner 4 places * 3 twists, edge 4 places * 2 flips
+    3 * 3 * 3 * 2 * 2 * 2,  // last corner twist and edge flip are forced
+    4 * 3 * 2 * 4 * 3 * 2 / 2,  // corner and edge permutations share parity
+};
+static const u32 ALG_SET_CASE_FREE[ALG_SET_COUNT] = { 0, 1, 4 };
+
+static const char ALG_FACE_CHARS[] = "FRUBLD";
+static const char ALG_WIDE_CHARS[] = "frubld";
+
+// Which stored face sits in each direction when the cube is held yellow up,
+// green front: a z2 swaps up with down and right with left
+static const u8 ALG_FRAME_START[CUBE_COLOUR_COUNT] = {
+    CUBE_GREEN, CUBE_ORANGE, CUBE_YELLOW, CUBE_BLUE, CUBE_RED, CUBE_WHITE,
+};
+
+// Directions the faces move through for x, y and z. new[cycle[i + 1]] is
+// old[cycle[i]], so for x what was in front ends up on top.
+static const u8 ALG_ROTATION_CYCLES[3][4] = {
+    { TURN_FRONT, TURN_UP, TURN_BACK, TURN_DOWN },
+    { TURN_FRONT, TURN_LEFT, TURN_BACK, TURN_RIGHT },
+    { TURN_UP, TURN_RIGHT, TURN_DOWN, TURN_LEFT },
+};
+
+// Relabels side faces a quarter turn around the up/down axis, moving an F2L
+// algorithm along to the next slot
+static const u8 ALG_SLOT_ROTATE[CUBE_COLOUR_COUNT] = {
+    CUBE_RED, CUBE_BLUE, CUBE_WHITE, CUBE_ORANGE, CUBE_GREEN, CUBE_YELLOW,
+};
+
+// Side colours packed into two bits for PLL keys
+static const u8 ALG_SIDE_CODE[CUBE_COLOUR_COUNT] = { 0, 1, 0, 2, 3, 0 };
+
+
+// Found by probing on first use
+static bool alg_tables_ready = false;
+static u8 ALG_TURN_PERMS[TURN_TYPE_COUNT][ALG_STICKER_COUNT];
+static u8 ALG_LAST_LAYER[ALG_LAST_LAYER_LEN];
+static u8 ALG_LAST_LAYER_SIDE[ALG_LAST_LAYER_SIDE_LEN];
+static bool ALG_IN_LAST_LAYER[ALG_STICKER_COUNT];
+
+
+static void AlgTablesInit(void) {
+    if (alg_tables_ready) return;
+
+    Cube probe;
+    CubeInit(&probe);
+
+    // Mark one sticker on a blank cube, turn, and see where it went
+    for (int t = 0; t < TURN_TYPE_COUNT; t++) {
+        for (int s = 0; s < ALG_STICKER_COUNT; s++) {
+            CubeSetSolid(&probe, CUBE_COLOUR_COUNT);
+            CubeSetTile(&probe, s / 8, CUBE_GREEN, s % 8);
+            CubeTurn(&probe, t);
+            for (int d = 0; d < ALG_STICKER_COUNT; d++) {
+                if (FaceGetTile(probe.faces[d / 8], d % 8) == CUBE_GREEN) {
+                    ALG_TURN_PERMS[t][d] = s;
+                }
+            }
+        }
+    }
+
+    // The last layer is whatever a D turn moves
+    int count = 0;
+    int side_count = 0;
+    for (int s = 0; s < ALG_STICKER_COUNT; s++) {
+        ALG_IN_LAST_LAYER[s] = ALG_TURN_PERMS[TURN_DOWN][s] != s;
+        if (!ALG_IN_LAST_LAYER[s]) continue;
+        ALG_LAST_LAYER[count++] = s;
+        if (s / 8 != CUBE_YELLOW) ALG_LAST_LAYER_SIDE[side_count++] = s;
+    }
+    assert(count == ALG_LAST_LAYER_LEN && side_count == ALG_LAST_LAYER_SIDE_LEN);
+
+    alg_tables_ready = true;
+}
+
+void AlgApply(Cube* cube, const u8* perm) {
+    u8 tiles[ALG_STICKER_COUNT];
+    for (int s = 0; s < ALG_STICKER_COUNT; s++) {
+        tiles[s] = FaceGetTile(cube->faces[s / 8], s % 8);
+    }
+    // Through CubeSetTile so the hash stays up to date
+    for (int s = 0; s < ALG_STICKER_COUNT; s++) {
+        if (perm[s] != s) CubeSetTile(cube, s / 8, tiles[perm[s]], s % 8);
+    }
+}
+
+static void AlgCompose(u8* perm, const u8* turns, u8 length) {
+    for (int s = 0; s < ALG_STICKER_COUNT; s++) perm[s] = s;
+    for (int i = 0; i < length; i++) {
+        u8 next[ALG_STICKER_COUNT];
+        for (int s = 0; s < ALG_STICKER_COUNT; s++) {
+            next[s] = perm[ALG_TURN_PERMS[turns[i]][s]];
+        }
+        MemCopy(perm, next, ALG_STICKER_COUNT);
+    }
+}
+
+static TurnType AlgTurnInverse(TurnType turn) {
+    if (turn < TURN_FRONT_PRIME) return turn + TURN_FRONT_PRIME;
+    if (turn < TURN_FRONT_DOUBLE) return turn - TURN_FRONT_PRIME;
+    return turn;
+}
+
+// Quarter turns clockwise (1 to 3) to a TurnType
+static TurnType AlgTurnMake(u8 face, u8 quarters) {
+    assert(quarters >= 1 && quarters <= 3);
+    if (quarters == 1) return face;
+    if (quarters == 2) return face + TURN_FRONT_DOUBLE;
+    return face + TURN_FRONT_PRIME;
+}
+
+static u8 AlgOpposite(u8 face) {
+    return (face + 3) % 6;
+}
+
+static void AlgRotate(u8* frame, u8 face, u8 quarters) {
+    // Rotating around L, D or B is the other way around R, U or F
+    if (face == TURN_LEFT || face == TURN_DOWN || face == TURN_BACK) {
+        face = AlgOpposite(face);
+        quarters = 4 - quarters;
+    }
+    int axis = face == TURN_RIGHT ? 0 : face == TURN_UP ? 1 : 2;
+    const u8* cycle = ALG_ROTATION_CYCLES[axis];
+
+    for (int q = 0; q < quarters; q++) {
+        u8 last = frame[cycle[3]];
+        for (int i = 3; i > 0; i--) {
+            frame[cycle[i]] = frame[cycle[i - 1]];
+        }
+        frame[cycle[0]] = last;
+    }
+}
+
+static const char* AlgEmit(u8* turns, u8* length, u8 face, u8 quarters) {
+    if (*length >= ALG_MAX_LEN) return "too many turns";
+    turns[(*length)++] = AlgTurnMake(face, quarters);
+    return NULL;
+}
+
+// Returns NULL or what was wrong, and where
+static const char* AlgParseTurns(const char* text, u8* turns, u8* length, int* column) {
+    u8 frame[CUBE_COLOUR_COUNT];
+    memcpy(frame, ALG_FRAME_START, CUBE_COLOUR_COUNT);
+    *length = 0;
+
+    const char* error = NULL;
+    int i = 0;
+    while (text[i] != '\0') {
+        char c = text[i];
+        if (c == ' ' || c == '\t' || c == '(' || c == ')') {
+            i++;
+            continue;
+        }
+        *column = i;
+        i++;
+
+        const char* face_char = strchr(ALG_FACE_CHARS, c);
+        const char* wide_char = strchr(ALG_WIDE_CHARS, c);
+        bool wide = wide_char != NULL;
+        if (face_char != NULL && text[i] == 'w') {
+            wide = true;
+            i++;
+        }
+
+        u8 quarters = 1;
+        if (text[i] == '2') {
+            quarters = 2;
+            i++;
+            if (text[i] == '\'') i++;
+        } else if (text[i] == '\'') {
+            quarters = 3;
+            i++;
+            if (text[i] == '2') {
+                quarters = 2;
+                i++;
+            }
+        }
+        if (text[i] != '\0' && text[i] != ' ' && text[i] != '\t' && text[i] != '(' && text[i] != ')') {
+            return "unknown turn";
+        }
+        u8 back = 4 - quarters;
+
+        if (face_char != NULL && !wide) {
+            error = AlgEmit(turns, length, frame[face_char - ALG_FACE_CHARS], quarters);
+        } else if (wide) {
+            // r = R M' = L x, the opposite face with the whole cube turned
+            u8 face = face_char != NULL ? face_char - ALG_FACE_CHARS : wide_char - ALG_WIDE_CHARS;
+            error = AlgEmit(turns, length, frame[AlgOpposite(face)], quarters);
+            AlgRotate(frame, face, quarters);
+        } else if (c == 'M') {
+            // M = R L' x'
+            error = AlgEmit(turns, length, frame[TURN_RIGHT], quarters);
+            if (error == NULL) error = AlgEmit(turns, length, frame[TURN_LEFT], back);
+            AlgRotate(frame, TURN_LEFT, quarters);
+        } else if (c == 'E') {
+            // E = U D' y'
+            error = AlgEmit(turns, length, frame[TURN_UP], quarters);
+            if (error == NULL) error = AlgEmit(turns, length, frame[TURN_DOWN], back);
+            AlgRotate(frame, TURN_DOWN, quarters);
+        } else if (c == 'S') {
+            // S = F' B z
+            error = AlgEmit(turns, length, frame[TURN_FRONT], back);
+            if (error == NULL) error = AlgEmit(turns, length, frame[TURN_BACK], quarters);
+            AlgRotate(frame, TURN_FRONT, quarters);
+        } else if (c == 'x') {
+            AlgRotate(frame, TURN_RIGHT, quarters);
+        } else if (c == 'y') {
+            AlgRotate(frame, TURN_UP, quarters);
+        } else if (c == 'z') {
+            AlgRotate(frame, TURN_FRONT, quarters);
+        } else {
+            return "unknown turn";
+        }
+        if (error != NULL) return error;
+    }
+
+    // Not about any one turn
+    *column = -1;
+    if (*length == 0) return "no turns";
+    if (memcmp(frame, ALG_FRAME_START, CUBE_COLOUR_COUNT) != 0) {
+        return "ends with the whole cube rotated";
+    }
+    return NULL;
+}
+
+u8 AlgFaceFromChar(char c) {
+    const char* face_char = c != '\0' ? strchr(ALG_FACE_CHARS, c) : NULL;
+    return face_char != NULL ? ALG_FRAME_START[face_char - ALG_FACE_CHARS] : CUBE_COLOUR_COUNT;
+}
+
+u64 AlgFormat(const u8* turns, u8 length, char* out) {
+    u64 written = 0;
+    for (int i = 0; i < length; i++) {
+        u8 face = turns[i] % CUBE_COLOUR_COUNT;
+        u8 direction = 0;
+        while (ALG_FRAME_START[direction] != face) direction++;
+
+        if (i > 0) out[written++] = ' ';
+        out[written++] = ALG_FACE_CHARS[direction];
+        if (turns[i] >= TURN_FRONT_DOUBLE) {
+            out[written++] = '2';
+        } else if (turns[i] >= TURN_FRONT_PRIME) {
+            out[written++] = '\'';
+        }
+    }
+    out[written] = '\0';
+    return written;
+}
+
+static u32 AlgKey(enum8(AlgSetKind) kind, Cube* cube, u8 slot) {
+    u32 key = 0;
+    if (kind == ALG_SET_F2L) {
+        key = (slot << 10) | (F2LCornerSlot(cube, slot) << 5) | F2LEdgeSlot(cube, slot);
+    } else if (kind == ALG_SET_OLL) {
+        for (int i = 0; i < ALG_LAST_LAYER_LEN; i++) {
+            u8 s = ALG_LAST_LAYER[i];
+            if (FaceGetTile(cube->faces[s / 8], s % 8) == CUBE_YELLOW) key |= Bit(i);
+        }
+    } else {
+        for (int i = 0; i < ALG_LAST_LAYER_SIDE_LEN; i++) {
+            u8 s = ALG_LAST_LAYER_SIDE[i];
+            key |= ALG_SIDE_CODE[FaceGetTile(cube->faces[s / 8], s % 8)] << (i * 2);
+        }
+    }
+    return key;
+}
+
+static bool AlgGoal(enum8(AlgSetKind) kind, Cube* cube) {
+    if (kind == ALG_SET_F2L) return IsF2LSolved(cube);
+    if (kind == ALG_SET_OLL) return IsOLLSolved(cube);
+    return IsPLLSolved(cube);
+}
+
+static u32 AlgCasePack(u32 alg, u8 variant, u8 pre, u8 post) {
+    return (alg << 8) | (variant << 4) | (pre << 2) | post;
+}
+
+// Solved, then backwards through the top layer post turns, the algorithm and
+// the top layer pre turns
+static void AlgCaseCube(Cube* cube, const AlgVariant* variant, u8 pre, u8 post) {
+    CubeSetSolved(cube);
+    for (int i = 0; i < post; i++) CubeTurn(cube, TURN_DOWN_PRIME);
+    for (int i = variant->length - 1; i >= 0; i--) {
+        CubeTurn(cube, AlgTurnInverse(variant->turns[i]));
+    }
+    for (int i = 0; i < pre; i++) CubeTurn(cube, TURN_DOWN_PRIME);
+}
+
+// Which slot an F2L case is for, or what is wrong with it
+static const char* AlgCheckF2L(Cube* cube, u8* slot) {
+    if (!IsCrossSolved(cube)) return "breaks the cross";
+
+    int unsolved = 0;
+    for (u8 i = 0; i < 4; i++) {
+        if (F2LPairSolved(cube, i)) continue;
+        *slot = i;
+        unsolved++;
+    }
+    if (unsolved == 0) return "doesn't move any pair";
+    if (unsolved > 1) return "moves more than one pair";
+
+    if (F2LCornerSlot(cube, *slot) / 3 < 4 || F2LEdgeSlot(cube, *slot) / 2 < 4) {
+        return "pair doesn't start in the top layer";
+    }
+    return NULL;
+}
+
+static const char* AlgCheck(Alg* alg, u8* slots) {
+    Cube cube;
+
+    for (int v = 0; v < alg->variant_count; v++) {
+        AlgVariant* variant = &alg->variants[v];
+        AlgCaseCube(&cube, variant, 0, 0);
+
+        if (alg->kind == ALG_SET_F2L) {
+            const char* error = AlgCheckF2L(&cube, &slots[v]);
+            if (error != NULL) return error;
+            continue;
+        }
+
+        slots[v] = 0;
+        for (int s = 0; s < ALG_STICKER_COUNT; s++) {
+            if (!ALG_IN_LAST_LAYER[s] && variant->perm[s] != s) {
+                return "moves pieces outside the last layer";
+            }
+        }
+
+        bool oriented = true;
+        for (int i = 0; i < 8; i++) {
+            if (FaceGetTile(cube.faces[CUBE_YELLOW], i) != CUBE_YELLOW) oriented = false;
+        }
+        if (alg->kind == ALG_SET_OLL && oriented) return "doesn't orient anything, is it a PLL?";
+        if (alg->kind == ALG_SET_PLL && !oriented) return "changes orientation, is it an OLL?";
+
+        if (alg->kind == ALG_SET_PLL) {
+            bool permutes = true;
+            for (int q = 0; q < 4 && permutes; q++) {
+                if (IsPLLSolved(&cube)) permutes = false;
+                CubeTurn(&cube, TURN_DOWN);
+            }
+            if (!permutes) return "doesn't permute anything";
+        }
+    }
+    return NULL;
+}
+
+// Registers every pre (and post) AUF of every variant. Returns the line that
+// already covers the case if nothing new was added.
+static u32 AlgRegister(AlgSet* set, u32 index, const u8* slots) {
+    Alg* alg = &set->algs[index];
+    AlgCaseMap* map = &set->cases[alg->kind];
+    u8 post_count = alg->kind == ALG_SET_PLL ? 4 : 1;
+
+    Cube cube;
+    Cube check;
+
+    u32 added = 0;
+    u32 covered_by = 0;
+    for (int v = 0; v < alg->variant_count; v++) {
+        AlgVariant* variant = &alg->variants[v];
+        for (u8 pre = 0; pre < 4; pre++) {
+            for (u8 post = 0; post < post_count; post++) {
+                AlgCaseCube(&cube, variant, pre, post);
+                u32 key = AlgKey(alg->kind, &cube, slots[v]);
+
+                u32* existing = AlgCaseMap_get(map, key);
+                if (existing != NULL) {
+                    covered_by = set->algs[*existing >> 8].line;
+                    continue;
+                }
+
+                // Take the same path the solver will and make sure it lands
+                // on the goal, and on the same stickers turn by turn would
+                check = cube;
+                for (int i = 0; i < pre; i++) CubeTurn(&check, TURN_DOWN);
+                AlgApply(&check, variant->perm);
+                for (int i = 0; i < post; i++) CubeTurn(&check, TURN_DOWN);
+                assert(AlgGoal(alg->kind, &check) && "Compiled algorithm missed its case!");
+                assert(CubeHash(&check) == CubeHashCompute(&check));
+
+                for (int i = 0; i < pre; i++) CubeTurn(&cube, TURN_DOWN);
+                for (int i = 0; i < variant->length; i++) CubeTurn(&cube, variant->turns[i]);
+                for (int i = 0; i < post; i++) CubeTurn(&cube, TURN_DOWN);
+                assert(MemCmp(cube.faces, check.faces, sizeof(cube.faces)) == 0);
+
+                AlgCaseMap_insert(map, key, AlgCasePack(index, v, pre, post));
+                added++;
+            }
+        }
+    }
+    return added > 0 ? 0 : covered_by;
+}
+
+static void AlgError(AlgSet* set, const char* source, u32 line, const char* message) {
+    printf("%s:%u: %s\n", source, line, message);
+    set->errors++;
+}
+
+bool AlgSetParse(Arena* arena, AlgSet* set, const char* text, const char* source) {
+    AlgTablesInit();
+
+    set->algs = ArenaPushArray(arena, ALG_MAX_COUNT, Alg);
+    set->count = 0;
+    set->errors = 0;
+    for (int k = 0; k < ALG_SET_COUNT; k++) {
+        AlgCaseMap_init(&set->cases[k], arena, ALG_CASE_MAP_START_LEN);
+    }
+
+    char line_text[256];
+    char message[96];
+    u32 line = 0;
+    const char* cursor = text;
+
+    while (*cursor != '\0') {
+        line++;
+        const char* end = strchr(cursor, '\n');
+        u64 length = end != NULL ? (u64) (end - cursor) : strlen(cursor);
+        const char* next = end != NULL ? end + 1 : cursor + length;
+
+        if (length >= sizeof(line_text)) {
+            AlgError(set, source, line, "line too long");
+            cursor = next;
+            continue;
+        }
+        memcpy(line_text, cursor, length);
+        line_text[length] = '\0';
+        cursor = next;
+
+        // Strip comments, carriage returns and trailing space
+        char* hash = strchr(line_text, '#');
+        if (hash != NULL) *hash = '\0';
+        length = strlen(line_text);
+        while (length > 0 && (line_text[length - 1] == ' ' || line_text[length - 1] == '\t' || line_text[length - 1] == '\r')) {
+            line_text[--length] = '\0';
+        }
+        char* start = line_text;
+        while (*start == ' ' || *start == '\t') start++;
+        if (*start == '\0') continue;
+
+        // Set name
+        char* name = start;
+        while (*name != '\0' && *name != ' ' && *name != '\t' && *name != ':') name++;
+        int kind = -1;
+        for (int k = 0; k < ALG_SET_COUNT; k++) {
+            u64 set_length = strlen(ALG_SET_NAMES[k]);
+            if ((u64) (name - start) == set_length && strncmp(start, ALG_SET_NAMES[k], set_length) == 0) kind = k;
+        }
+        if (kind < 0) {
+            AlgError(set, source, line, "expected f2l, oll or pll at the start of the line");
+            continue;
+        }
+
+        // Case name up to the colon
+        char* colon = strchr(name, ':');
+        if (colon == NULL) {
+            AlgError(set, source, line, "expected ':' between the case name and its turns");
+            continue;
+        }
+        *colon = '\0';
+        while (*name == ' ' || *name == '\t') name++;
+        u64 name_length = strlen(name);
+        while (name_length > 0 && (name[name_length - 1] == ' ' || name[name_length - 1] == '\t')) name_length--;
+
+        if (set->count == ALG_MAX_COUNT) {
+            snprintf(message, sizeof(message), "more than %d algorithms", ALG_MAX_COUNT);
+            AlgError(set, source, line, message);
+            break;
+        }
+
+        Alg* alg = &set->algs[set->count];
+        MemZero(alg, sizeof(Alg));
+        alg->kind = kind;
+        alg->line = line;
+        MemCopy(alg->name, name, MinU64(name_length, ALG_NAME_LEN - 1));
+
+        AlgVariant* variant = &alg->variants[0];
+        int column = 0;
+        const char* error = AlgParseTurns(colon + 1, variant->turns, &variant->length, &column);
+        if (error != NULL) {
+            if (column >= 0) {
+                snprintf(message, sizeof(message), "%s (column %d)", error, (int) (colon + 1 - line_text) + column + 1);
+                error = message;
+            }
+            AlgError(set, source, line, error);
+            continue;
+        }
+
+        alg->variant_count = kind == ALG_SET_F2L ? 4 : 1;
+        for (int v = 1; v < alg->variant_count; v++) {
+            AlgVariant* previous = &alg->variants[v - 1];
+            AlgVariant* rotated = &alg->variants[v];
+            rotated->length = previous->length;
+            for (int i = 0; i < previous->length; i++) {
+                u8 turn = previous->turns[i];
+                rotated->turns[i] = (turn / 6) * 6 + ALG_SLOT_ROTATE[turn % 6];
+            }
+        }
+        for (int v = 0; v < alg->variant_count; v++) {
+            AlgCompose(alg->variants[v].perm, alg->variants[v].turns, alg->variants[v].length);
+        }
+
+        u8 slots[4];
+        error = AlgCheck(alg, slots);
+        if (error != NULL) {
+            AlgError(set, source, line, error);
+            continue;
+        }
+
+        u32 covered_by = AlgRegister(set, set->count, slots);
+        if (covered_by != 0) {
+            snprintf(message, sizeof(message), "case already covered by line %u", covered_by);
+            AlgError(set, source, line, message);
+            continue;
+        }
+
+        set->count++;
+    }
+
+    return set->errors == 0;
+}
+
+bool AlgSetLoad(Arena* arena, AlgSet* set, const char* path) {
+    FILE* file = fopen(path, "rb");
+    if (file == NULL) {
+        printf("%s: could not open\n", path);
+        MemZero(set, sizeof(AlgSet));
+        set->errors = 1;
+        return false;
+    }
+
+    // ftell gives -1 for anything it can't measure, a pipe say
+    fseek(file, 0, SEEK_END);
+    long size = ftell(file);
+    fseek(file, 0, SEEK_SET);
+    if (size < 0) {
+        printf("%s: could not read\n", path);
+        fclose(file);
+        MemZero(set, sizeof(AlgSet));
+        set->errors = 1;
+        return false;
+    }
+    if (size > ALG_FILE_MAX_SIZE) {
+        printf("%s: too large, sets are at most %lld bytes\n", path, ALG_FILE_MAX_SIZE);
+        fclose(file);
+        MemZero(set, sizeof(AlgSet));
+        set->errors = 1;
+        return false;
+    }
+
+    // The text is only needed while parsing, so it stays out of the arena
+    // and the arena only ever holds the fixed size set
+    char* text = malloc(size + 1);
+    assert(text != NULL);
+    u64 read = fread(text, 1, size, file);
+    text[read] = '\0';
+    fclose(file);
+
+    bool loaded = AlgSetParse(arena, set, text, path);
+    free(text);
+    return loaded;
+}
+
+bool AlgSetLookup(AlgSet* set, enum8(AlgSetKind) kind, Cube* cube, u8 slot, AlgCase* found) {
+    if (set == NULL || set->algs == NULL) return false;
+
+    u32* packed = AlgCaseMap_get(&set->cases[kind], AlgKey(kind, cube, slot));
+    if (packed == NULL) return false;
+
+    found->alg = &set->algs[*packed >> 8];
+    found->variant = &found->alg->variants[(*packed >> 4) & 0xF];
+    found->pre = (*packed >> 2) & 3;
+    found->post = *packed & 3;
+    return true;
+}
+
+void AlgSetReport(AlgSet* set) {
+    for (int k = 0; k < ALG_SET_COUNT; k++) {
+        u32 algs = 0;
+        for (u32 i = 0; i < set->count; i++) {
+            if (set->algs[i].kind == k) algs++;
+        }
+        u32 cases = AlgCaseMap_length(&set->cases[k]) + ALG_SET_CASE_FREE[k];
+        printf(
+            "%s: %3u algorithms, %3u / %u cases%s\n",
+            ALG_SET_NAMES[k], algs, cases, ALG_SET_CASE_TOTAL[k],
+            k == ALG_SET_F2L && cases < ALG_SET_CASE_TOTAL[k] ? " (rest use the built in table)" : ""
+        );
+    }
+    if (set->errors > 0) printf("%u lines had errors\n", set->errors);
+}
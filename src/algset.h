@@ -0,0 +1,87 @@
+#ifndef ALGSET_H
+#define ALGSET_H
+
+
+#include "core.h"
+#include "cube.h"
+
+
+// Set the game loads at startup, the tools take a path
+#define ALGSET_DEFAULT_PATH "src/data/algsets/cfop.txt"
+
+// Turns once slices, wide turns and rotations are expanded to face turns
+#define ALG_MAX_LEN 40
+#define ALG_MAX_COUNT 256
+#define ALG_NAME_LEN 24
+
+// Every sticker that can move, face * 8 + position
+#define ALG_STICKER_COUNT (CUBE_COLOUR_COUNT * 8)
+
+
+typedef enum {
+    ALG_SET_F2L,
+    ALG_SET_OLL,
+    ALG_SET_PLL,
+
+    ALG_SET_COUNT
+} AlgSetKind;
+
+extern const char* ALG_SET_NAMES[ALG_SET_COUNT];
+
+
+// An algorithm compiled for one slot. perm is the net effect of all of its
+// turns: sticker dst ends up with whatever was on sticker perm[dst].
+typedef struct {
+    u8 turns[ALG_MAX_LEN];
+    u8 length;
+    u8 perm[ALG_STICKER_COUNT];
+} AlgVariant;
+
+// F2L algorithms get one variant per slot, OLL and PLL only need one
+typedef struct {
+    enum8(AlgSetKind) kind;
+    u32 line;
+    char name[ALG_NAME_LEN];
+    u8 variant_count;
+    AlgVariant variants[4];
+} Alg;
+
+// What to do for a recognised case: turn the top layer pre times, the
+// algorithm, then the top layer post times
+typedef struct {
+    const Alg* alg;
+    const AlgVariant* variant;
+    u8 pre;
+    u8 post;
+} AlgCase;
+
+DECLARE_TYPED_HASHMAP(u32, u32, AlgCaseMap)
+
+// Cases are keyed on just the stickers that identify them (which top layer
+// stickers are yellow for OLL, side colours for PLL, where the pair is for
+// F2L) with every pre-AUF registered, so recognition is a single lookup.
+typedef struct {
+    Alg* algs;
+    u32 count;
+    u32 errors;
+    AlgCaseMap cases[ALG_SET_COUNT];
+} AlgSet;
+
+
+bool AlgSetParse(Arena* arena, AlgSet* set, const char* text, const char* source);
+bool AlgSetLoad(Arena* arena, AlgSet* set, const char* path);
+bool AlgSetLookup(AlgSet* set, enum8(AlgSetKind) kind, Cube* cube, u8 slot, AlgCase* found);
+void AlgSetReport(AlgSet* set);
+void AlgApply(Cube* cube, const u8* perm);
+
+// A face letter as written, held yellow up and green front, to the face it
+// turns here. CUBE_COLOUR_COUNT if it isn't one.
+u8 AlgFaceFromChar(char c);
+
+// Face turns back to how they'd be written in a set, into at least
+// AlgFormatSize(length) bytes. Returns the length without the null.
+u64 AlgFormat(const u8* turns, u8 length, char* out);
+#define AlgFormatSize(length) ((u64) (length) * 3 + 1)
+
+
+#endif  /* ALGSET_H */
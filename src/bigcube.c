@@ -0,0 +1,1147 @@
+// Big cubes (4x4 and up) don't fit the 3x3 face encoding so they get their
+// own sticker layout, see bigcube.h. Rather than hand writing rotation tables
+// for every layer of every size like cube.c does for the 3x3, every sticker is
+// given a 3D position and the tables are worked out by rotating those
+// positions. Each layer turn then becomes four lines (rows or columns) that
+// cycle between faces, plus a face rotation for the outer layers. Rows are
+// moved as whole u64s, columns are gathered a tile at a time.
+//
+// ----------------------------------------------------------------------------
+//
+// The solver uses the reduction method:
+//
+// 1. Parity. Both parity problems of even cubes are fixed up front instead of
+//    with long algorithms at the end. Every sequence used in the later stages
+//    is a commutator or conjugate, which can't change the permutation parity
+//    of any piece type. So if the wings (or, on even cubes, the corners) are
+//    in an odd permutation at the start it is fixed with one inner slice (or
+//    outer) quarter turn before anything else is done.
+// 2. Centres are solved one piece at a time.
+// 3. Edges are paired one wing at a time. On odd cubes the wings are matched
+//    to their midge, on even cubes they go straight to their solved spot.
+// 4. The cube is now a 3x3 so it is handed to SolveCube and the 3x3 moves are
+//    replayed as outer turns.
+//
+// For stages 2 and 3 the solver searches short templates in order of length
+// for one that solves the next piece without breaking any piece solved so far:
+//
+//   [a, b]          a b a' b'
+//   [s: [a, b]]     s a b a' b' s'
+//   [a, b c b']     a b c b' a' b c' b'
+//   [s: [a, b c b']]
+//
+// Candidates are checked without turning the cube. Every move has a sticker
+// permutation, so where a sticker ends up after a sequence is found by walking
+// back through the permutations for just the stickers being checked.
+
+
+#include "bigcube.h"
+#include "moves.h"
+#include "trace.h"
+
+
+#define BIG_NO_PARTNER UINT16_MAX
+#define BIG_SOLVE_MAX_MOVES (TURN_TYPE_COUNT * 2)
+#define BIG_TEMPLATE_MAX_LEN 10
+
+static const float BIG_TILE_RENDER_SPACING = 0.15f;
+static const float BIG_FACE_RENDER_SPACING = 0.5f;
+static const float BIG_TILE_RENDER_ROUNDNESS = 0.3f;
+static const int BIG_TILE_RENDER_SEGMENTS = 4;
+static const float BIG_TILE_RENDER_THICKNESS = 0.075f;
+
+static const u64 BITMASK_TILE = 0xFull;
+
+
+typedef struct {
+    int x;
+    int y;
+    int z;
+} BigVector;
+
+// A row or column of a face. Reversed lines are read right to left (rows) or
+// bottom to top (columns).
+typedef struct {
+    u8 face;
+    bool column;
+    u8 index;
+    bool reversed;
+} BigLine;
+
+// Clockwise quarter turn of one layer: lines[i] moves to lines[i + 1], and if
+// the layer is on the outside rotate_face turns rotate_quarters clockwise.
+typedef struct {
+    BigLine lines[4];
+    i8 rotate_face;
+    u8 rotate_quarters;
+} BigLayer;
+
+typedef struct {
+    bool ready;
+    u16 sticker_count;
+    BigLayer layers[CUBE_COLOUR_COUNT][BIG_CUBE_MAX_SIZE];
+    // After a clockwise quarter of the layer the sticker at i came from here
+    u16 layer_src[CUBE_COLOUR_COUNT][BIG_CUBE_MAX_SIZE][BIG_CUBE_MAX_STICKERS];
+} BigGeometry;
+
+// One piece for the solver to place. Each sticker either needs a fixed colour
+// or needs to match whatever colour its partner sticker ends up with.
+typedef struct {
+    u8 count;
+    u16 stickers[2];
+    u16 partners[2];
+    u8 colours[2];
+} BigPiece;
+
+typedef struct {
+    u8 size;
+    u16 sticker_count;
+    u8 move_count;
+    TurnType moves[BIG_SOLVE_MAX_MOVES];
+    u8 inverse[BIG_SOLVE_MAX_MOVES];
+    u8 axis[BIG_SOLVE_MAX_MOVES];
+    u16* src;
+    u8 colours[BIG_CUBE_MAX_STICKERS];
+} BigSolver;
+
+
+// Outward normal of each face, in the same order as CubeColour
+static const BigVector BIG_FACE_NORMALS[CUBE_COLOUR_COUNT] = {
+    {  0,  0,  1 },     // Green (F)
+    {  1,  0,  0 },     // Red (R)
+    {  0,  1,  0 },     // White (U)
+    {  0,  0, -1 },     // Blue (B)
+    { -1,  0,  0 },     // Orange (L)
+    {  0, -1,  0 }      // Yellow (D)
+};
+
+// Row and column of each 3x3 tile index as 0 (first), 1 (middle), 2 (last)
+static const u8 BIG_TILE_ROW_TABLE[8] = { 0, 0, 0, 1, 2, 2, 2, 1 };
+static const u8 BIG_TILE_COL_TABLE[8] = { 0, 1, 2, 2, 2, 1, 0, 0 };
+
+// Where each face is drawn in the net
+static const u8 BIG_FACE_RENDER_TABLE[CUBE_COLOUR_COUNT][2] = {
+    { 1, 1 }, { 2, 1 }, { 1, 0 }, { 3, 1 }, { 0, 1 }, { 1, 2 }
+};
+
+static const char BIG_FACE_CHARS[] = "FRUBLD";
+
+// Centres are solved in this face order, opposite faces first
+static const u8 BIG_CENTRE_FACE_ORDER[CUBE_COLOUR_COUNT] = {
+    CUBE_WHITE, CUBE_YELLOW, CUBE_GREEN, CUBE_BLUE, CUBE_RED, CUBE_ORANGE
+};
+
+
+static BigGeometry BIG_GEOMETRY[BIG_CUBE_MAX_SIZE + 1];
+
+
+// TURN NOTATION //////////////////////////////////////////////////////////////
+
+TurnType BigTurnMake(TurnType base, u8 depth, bool wide) {
+    assert(base < TURN_TYPE_COUNT);
+    if (depth <= 1) return base;
+    assert(depth < BIG_CUBE_MAX_SIZE);
+
+    u8 code = 2 * (depth - 2) + (wide ? 2 : 1);
+    return base + TURN_TYPE_COUNT * code;
+}
+
+TurnType BigTurnBase(TurnType turn) {
+    return turn % TURN_TYPE_COUNT;
+}
+
+u8 BigTurnDepth(TurnType turn) {
+    u8 code = turn / TURN_TYPE_COUNT;
+    if (code == 0) return 1;
+    if (code % 2 == 1) return (code + 3) / 2;
+    return (code + 2) / 2;
+}
+
+bool BigTurnWide(TurnType turn) {
+    u8 code = turn / TURN_TYPE_COUNT;
+    return code != 0 && code % 2 == 0;
+}
+
+TurnType BigTurnInverse(TurnType turn) {
+    TurnType base = BigTurnBase(turn);
+    TurnType layers = turn - base;
+
+    if (base < TURN_FRONT_PRIME) return layers + base + TURN_FRONT_PRIME;
+    if (base < TURN_FRONT_DOUBLE) return layers + base - TURN_FRONT_PRIME;
+    return turn;
+}
+
+// Writes the SiGN style name (R, 2R', Rw2, 3Rw) and returns its length
+int BigTurnFormat(TurnType turn, char* out) {
+    assert(turn < BIG_TURN_COUNT);
+
+    const char* base_name = TURN_TYPE_NAMES[BigTurnBase(turn)];
+    u8 depth = BigTurnDepth(turn);
+    bool wide = BigTurnWide(turn);
+
+    int length = 0;
+    if (depth > 2 || (depth == 2 && !wide)) {
+        out[length++] = '0' + depth;
+    }
+    out[length++] = base_name[0];
+    if (wide) {
+        out[length++] = 'w';
+    }
+    for (const char* suffix = base_name + 1; *suffix; suffix++) {
+        out[length++] = *suffix;
+    }
+    out[length] = '\0';
+
+    return length;
+}
+
+// Parses one turn from the start of text, returns false if there isn't one
+bool BigTurnParse(const char* text, TurnType* turn, int* length) {
+    int i = 0;
+    u8 depth = 0;
+
+    while (text[i] >= '0' && text[i] <= '9') {
+        depth = depth * 10 + (text[i] - '0');
+        i++;
+    }
+
+    int face = -1;
+    for (int f = 0; f < CUBE_COLOUR_COUNT; f++) {
+        if (text[i] == BIG_FACE_CHARS[f]) face = f;
+    }
+    if (face < 0) return false;
+    i++;
+
+    bool wide = false;
+    if (text[i] == 'w') {
+        wide = true;
+        i++;
+    }
+
+    TurnType base = face;
+    if (text[i] == '\'') {
+        base += TURN_FRONT_PRIME;
+        i++;
+    } else if (text[i] == '2') {
+        base += TURN_FRONT_DOUBLE;
+        i++;
+        // R2' is the same as R2
+        if (text[i] == '\'') i++;
+    }
+
+    if (wide && depth == 0) depth = 2;
+    if (depth == 0) depth = 1;
+    if (depth >= BIG_CUBE_MAX_SIZE) return false;
+
+    // 1Rw is just R
+    *turn = BigTurnMake(base, depth, wide && depth > 1);
+    *length = i;
+    return true;
+}
+
+// GEOMETRY ///////////////////////////////////////////////////////////////////
+
+// Positions use doubled coordinates centred on the middle of the cube so every
+// sticker centre is a whole number between -size and size
+static BigVector BigStickerPosition(u8 size, u8 face, u8 row, u8 col) {
+    int u = 2 * col + 1 - size;
+    int v = size - 2 * row - 1;
+    int n = size;
+
+    switch (face) {
+        case CUBE_GREEN:    return (BigVector) {  u,  v,  n };
+        case CUBE_RED:      return (BigVector) {  n,  v, -u };
+        case CUBE_WHITE:    return (BigVector) {  u,  n, -v };
+        case CUBE_BLUE:     return (BigVector) { -u,  v, -n };
+        case CUBE_ORANGE:   return (BigVector) { -n,  v,  u };
+        default:            return (BigVector) {  u, -n,  v };
+    }
+}
+
+static int BigDot(BigVector a, BigVector b) {
+    return a.x * b.x + a.y * b.y + a.z * b.z;
+}
+
+// Clockwise quarter turn looking at the face with outward normal n, which is
+// -90 degrees about n: v' = -(n x v) + n (n . v)
+static BigVector BigRotate(BigVector n, BigVector v) {
+    int d = BigDot(n, v);
+    return (BigVector) {
+        -(n.y * v.z - n.z * v.y) + n.x * d,
+        -(n.z * v.x - n.x * v.z) + n.y * d,
+        -(n.x * v.y - n.y * v.x) + n.z * d
+    };
+}
+
+static u8 BigNormalFace(BigVector normal) {
+    for (u8 face = 0; face < CUBE_COLOUR_COUNT; face++) {
+        BigVector n = BIG_FACE_NORMALS[face];
+        if (n.x == normal.x && n.y == normal.y && n.z == normal.z) return face;
+    }
+    assert(false && "Not a face normal!");
+    return 0;
+}
+
+static u16 BigStickerIndex(u8 size, u8 face, u8 row, u8 col) {
+    return (face * size + row) * size + col;
+}
+
+static u16 BigStickerAt(u8 size, u8 face, BigVector position) {
+    // Undo BigStickerPosition by projecting onto the face's right and down
+    BigVector right = BigStickerPosition(size, face, 0, 1);
+    BigVector origin = BigStickerPosition(size, face, 0, 0);
+    BigVector down = BigStickerPosition(size, face, 1, 0);
+    BigVector r = { right.x - origin.x, right.y - origin.y, right.z - origin.z };
+    BigVector d = { down.x - origin.x, down.y - origin.y, down.z - origin.z };
+    BigVector p = { position.x - origin.x, position.y - origin.y, position.z - origin.z };
+
+    u8 col = BigDot(p, r) / 4;
+    u8 row = BigDot(p, d) / 4;
+    assert(row < size && col < size);
+    return BigStickerIndex(size, face, row, col);
+}
+
+// Which layer (0 is the face itself) a sticker is in when turning face
+static int BigStickerLayer(u8 size, BigVector normal, BigVector position) {
+    int s = BigDot(normal, position);
+    if (s == size) return 0;
+    if (s == -size) return size - 1;
+    return (size - 1 - s) / 2;
+}
+
+static BigLine BigLineFromStickers(u8 size, const u16* stickers) {
+    u8 face = stickers[0] / (size * size);
+    u8 first_row = (stickers[0] / size) % size;
+    u8 second_row = (stickers[1] / size) % size;
+    u8 first_col = stickers[0] % size;
+    u8 second_col = stickers[1] % size;
+
+    BigLine line = { .face = face };
+    if (first_row == second_row) {
+        line.column = false;
+        line.index = first_row;
+        line.reversed = second_col < first_col;
+    } else {
+        line.column = true;
+        line.index = first_col;
+        line.reversed = second_row < first_row;
+    }
+
+    // Sanity check the rest of the line is straight
+    for (u8 i = 0; i < size; i++) {
+        u8 row = line.column ? (line.reversed ? size - 1 - i : i) : line.index;
+        u8 col = line.column ? line.index : (line.reversed ? size - 1 - i : i);
+        assert(stickers[i] == BigStickerIndex(size, face, row, col));
+        (void) row;
+        (void) col;
+    }
+
+    return line;
+}
+
+static void BigGeometryInit(u8 size) {
+    BigGeometry* geometry = &BIG_GEOMETRY[size];
+    if (geometry->ready) return;
+
+    u16 sticker_count = CUBE_COLOUR_COUNT * size * size;
+    geometry->sticker_count = sticker_count;
+
+    BigVector positions[BIG_CUBE_MAX_STICKERS];
+    u8 faces[BIG_CUBE_MAX_STICKERS];
+    for (u8 face = 0; face < CUBE_COLOUR_COUNT; face++) {
+        for (u8 row = 0; row < size; row++) {
+            for (u8 col = 0; col < size; col++) {
+                u16 index = BigStickerIndex(size, face, row, col);
+                positions[index] = BigStickerPosition(size, face, row, col);
+                faces[index] = face;
+            }
+        }
+    }
+
+    for (u8 turn_face = 0; turn_face < CUBE_COLOUR_COUNT; turn_face++) {
+        BigVector n = BIG_FACE_NORMALS[turn_face];
+
+        for (u8 layer = 0; layer < size; layer++) {
+            u16* src = geometry->layer_src[turn_face][layer];
+            u16 dest[BIG_CUBE_MAX_STICKERS];
+
+            for (u16 i = 0; i < sticker_count; i++) {
+                src[i] = i;
+                dest[i] = i;
+            }
+
+            // Rotate every sticker in the layer to find where it goes
+            for (u16 i = 0; i < sticker_count; i++) {
+                if (BigStickerLayer(size, n, positions[i]) != layer) continue;
+
+                BigVector position = BigRotate(n, positions[i]);
+                BigVector normal = BigRotate(n, BIG_FACE_NORMALS[faces[i]]);
+                u16 j = BigStickerAt(size, BigNormalFace(normal), position);
+                src[j] = i;
+                dest[i] = j;
+            }
+
+            // Follow the first side face's stickers around the layer
+            BigLayer* layer_info = &geometry->layers[turn_face][layer];
+            u16 line[BIG_CUBE_MAX_SIZE];
+            int count = 0;
+            for (u16 i = 0; i < sticker_count && count < size; i++) {
+                if (BigDot(n, BIG_FACE_NORMALS[faces[i]]) != 0) continue;
+                if (BigStickerLayer(size, n, positions[i]) != layer) continue;
+                if (count > 0 && faces[i] != faces[line[0]]) continue;
+                line[count++] = i;
+            }
+            assert(count == size);
+
+            for (int j = 0; j < 4; j++) {
+                layer_info->lines[j] = BigLineFromStickers(size, line);
+                for (int k = 0; k < size; k++) {
+                    line[k] = dest[line[k]];
+                }
+            }
+
+            layer_info->rotate_face = -1;
+            if (layer == 0) {
+                layer_info->rotate_face = turn_face;
+                layer_info->rotate_quarters = 1;
+            } else if (layer == size - 1) {
+                // Opposite face, which turns anticlockwise from its own side
+                layer_info->rotate_face = (turn_face + CUBE_COLOUR_COUNT / 2) % CUBE_COLOUR_COUNT;
+                layer_info->rotate_quarters = 3;
+            }
+        }
+    }
+
+    geometry->ready = true;
+}
+
+// TURNS //////////////////////////////////////////////////////////////////////
+
+static u64 BigRowReverse(u64 row, u8 size) {
+    // Byte swap then swap the two tiles in every byte
+    row = __builtin_bswap64(row);
+    row = ((row & 0x0F0F0F0F0F0F0F0Full) << 4) | ((row >> 4) & 0x0F0F0F0F0F0F0F0Full);
+    return row >> (64 - 4 * size);
+}
+
+static u64 BigLineRead(BigCube* cube, const BigLine* line) {
+    u64 value = 0;
+    if (line->column) {
+        u32 shift = line->index * 4;
+        for (u8 row = 0; row < cube->size; row++) {
+            value |= ((cube->rows[line->face][row] >> shift) & BITMASK_TILE) << (row * 4);
+        }
+    } else {
+        value = cube->rows[line->face][line->index];
+    }
+
+    if (line->reversed) value = BigRowReverse(value, cube->size);
+    return value;
+}
+
+static void BigLineWrite(BigCube* cube, const BigLine* line, u64 value) {
+    if (line->reversed) value = BigRowReverse(value, cube->size);
+
+    if (line->column) {
+        u32 shift = line->index * 4;
+        for (u8 row = 0; row < cube->size; row++) {
+            u64* target = &cube->rows[line->face][row];
+            FlagClear(*target, BITMASK_TILE << shift);
+            FlagSet(*target, ((value >> (row * 4)) & BITMASK_TILE) << shift);
+        }
+    } else {
+        cube->rows[line->face][line->index] = value;
+    }
+}
+
+static void BigFaceRotate(BigCube* cube, u8 face, u8 quarter_turns) {
+    for (u8 q = 0; q < quarter_turns % 4; q++) {
+        // Clockwise: new row r is old column r read bottom to top
+        u64 rotated[BIG_CUBE_MAX_SIZE];
+        for (u8 row = 0; row < cube->size; row++) {
+            BigLine column = { face, true, row, true };
+            rotated[row] = BigLineRead(cube, &column);
+        }
+        MemCopy(cube->rows[face], rotated, cube->size * sizeof(u64));
+    }
+}
+
+// Turns a single layer of face clockwise quarter_turns times
+void BigCubeLayerTurn(BigCube* cube, u8 face, u8 layer, u8 quarter_turns) {
+    assert(layer < cube->size);
+    const BigLayer* info = &BIG_GEOMETRY[cube->size].layers[face][layer];
+
+    u64 values[4];
+    for (int i = 0; i < 4; i++) {
+        values[i] = BigLineRead(cube, &info->lines[i]);
+    }
+    for (int i = 0; i < 4; i++) {
+        BigLineWrite(cube, &info->lines[(i + quarter_turns) % 4], values[i]);
+    }
+
+    if (info->rotate_face >= 0) {
+        BigFaceRotate(cube, info->rotate_face, info->rotate_quarters * quarter_turns);
+    }
+}
+
+static u8 BigTurnQuarters(TurnType turn) {
+    TurnType base = BigTurnBase(turn);
+    if (base < TURN_FRONT_PRIME) return 1;
+    if (base < TURN_FRONT_DOUBLE) return 3;
+    return 2;
+}
+
+void BigCubeTurn(BigCube* cube, TurnType turn) {
+    u8 face = BigTurnBase(turn) % CUBE_COLOUR_COUNT;
+    u8 depth = BigTurnDepth(turn);
+    u8 quarters = BigTurnQuarters(turn);
+    assert(depth < cube->size || (depth == 1 && cube->size == 1));
+
+    u8 first = BigTurnWide(turn) ? 0 : depth - 1;
+    for (u8 layer = first; layer < depth; layer++) {
+        BigCubeLayerTurn(cube, face, layer, quarters);
+    }
+}
+
+// CUBE STATE /////////////////////////////////////////////////////////////////
+
+enum8(CubeColour) BigCubeGetTile(BigCube* cube, u8 face, u8 row, u8 col) {
+    assert(row < cube->size && col < cube->size);
+    return (cube->rows[face][row] >> (col * 4)) & BITMASK_TILE;
+}
+
+void BigCubeSetTile(BigCube* cube, u8 face, u8 row, u8 col, enum8(CubeColour) colour) {
+    assert(row < cube->size && col < cube->size);
+    FlagClear(cube->rows[face][row], BITMASK_TILE << (col * 4));
+    FlagSet(cube->rows[face][row], (u64) colour << (col * 4));
+}
+
+void BigCubeSetSolved(BigCube* cube, u8 size) {
+    assert(size >= BIG_CUBE_MIN_SIZE && size <= BIG_CUBE_MAX_SIZE);
+    BigGeometryInit(size);
+
+    MemZero(cube, sizeof(BigCube));
+    cube->size = size;
+    for (u8 face = 0; face < CUBE_COLOUR_COUNT; face++) {
+        for (u8 row = 0; row < size; row++) {
+            for (u8 col = 0; col < size; col++) {
+                BigCubeSetTile(cube, face, row, col, face);
+            }
+        }
+    }
+}
+
+bool BigCubeSolved(BigCube* cube) {
+    for (u8 face = 0; face < CUBE_COLOUR_COUNT; face++) {
+        u8 colour = BigCubeGetTile(cube, face, 0, 0);
+        for (u8 row = 0; row < cube->size; row++) {
+            for (u8 col = 0; col < cube->size; col++) {
+                if (BigCubeGetTile(cube, face, row, col) != colour) return false;
+            }
+        }
+    }
+    return true;
+}
+
+// Maps a row or column of the big cube to the 3x3 row or column it belongs to
+static u8 BigCubeToThree(u8 size, u8 index) {
+    if (index == 0) return 0;
+    if (index == size - 1) return 2;
+    return 1;
+}
+
+// Fills every big cube piece from the matching 3x3 piece, so the result is the
+// 3x3 state with all centres solved and all edges paired
+void BigCubeFromCube(BigCube* big, Cube* cube) {
+    for (u8 face = 0; face < CUBE_COLOUR_COUNT; face++) {
+        for (u8 row = 0; row < big->size; row++) {
+            for (u8 col = 0; col < big->size; col++) {
+                u8 three_row = BigCubeToThree(big->size, row);
+                u8 three_col = BigCubeToThree(big->size, col);
+
+                CubeColour colour = face;
+                for (u8 tile = 0; tile < 8; tile++) {
+                    if (BIG_TILE_ROW_TABLE[tile] == three_row && BIG_TILE_COL_TABLE[tile] == three_col) {
+                        colour = FaceGetTile(cube->faces[face], tile);
+                    }
+                }
+                BigCubeSetTile(big, face, row, col, colour);
+            }
+        }
+    }
+}
+
+// Reads the corners and the middle tile of each edge into a 3x3
+void BigCubeToCube(BigCube* big, Cube* cube) {
+    u8 lookup[3] = { 0, big->size / 2, big->size - 1 };
+
+    for (u8 face = 0; face < CUBE_COLOUR_COUNT; face++) {
+        for (u8 tile = 0; tile < 8; tile++) {
+            u8 row = lookup[BIG_TILE_ROW_TABLE[tile]];
+            u8 col = lookup[BIG_TILE_COL_TABLE[tile]];
+            CubeSetTile(cube, face, BigCubeGetTile(big, face, row, col), tile);
+        }
+    }
+}
+
+void BigCubeScramble(BigCube* cube, int length) {
+    printf("----- SCRAMBLE -----\n");
+
+    u8 last_face = CUBE_COLOUR_COUNT;
+    char name[BIG_TURN_NAME_LEN];
+
+    for (int i = 0; i < length; i++) {
+        u8 face = GetRandomValue(0, CUBE_COLOUR_COUNT - 1);
+        if (face == last_face) {
+            face = (face + 1) % CUBE_COLOUR_COUNT;
+        }
+
+        // Any outer, slice or wide turn that isn't the whole cube
+        u8 depth = GetRandomValue(1, cube->size - 1);
+        bool wide = depth > 1 && GetRandomValue(0, 1);
+        u8 direction = GetRandomValue(0, 2);
+
+        TurnType turn = BigTurnMake(face + direction * CUBE_COLOUR_COUNT, depth, wide);
+        BigCubeTurn(cube, turn);
+        BigTurnFormat(turn, name);
+        printf("%s\n", name);
+
+        last_face = face;
+    }
+}
+
+// SOLVER /////////////////////////////////////////////////////////////////////
+
+// Merges consecutive turns of the same face and layers
+static void BigAppendTurn(MoveStack* moves, TurnType turn) {
+    u32 length = MoveStack_length(moves);
+    TurnType last = TURN_TYPE_COUNT;
+
+    if (length > 0) MoveStack_get(moves, &last, length - 1);
+
+    TurnType layers = turn - BigTurnBase(turn);
+    bool same = length > 0
+        && last - BigTurnBase(last) == layers
+        && BigTurnBase(last) % CUBE_COLOUR_COUNT == BigTurnBase(turn) % CUBE_COLOUR_COUNT;
+
+    if (!same) {
+        bool appended = MoveStack_append(moves, turn);
+        assert(appended && "Big cube move stack full!");
+        (void) appended;
+        return;
+    }
+
+    MoveStack_pop(moves, &last);
+    u8 quarters = (BigTurnQuarters(last) + BigTurnQuarters(turn)) % 4;
+    u8 face = BigTurnBase(turn) % CUBE_COLOUR_COUNT;
+
+    if (quarters == 1) MoveStack_append(moves, layers + face);
+    if (quarters == 2) MoveStack_append(moves, layers + face + TURN_FRONT_DOUBLE);
+    if (quarters == 3) MoveStack_append(moves, layers + face + TURN_FRONT_PRIME);
+}
+
+static void BigPerformTurn(BigCube* cube, MoveStack* moves, TurnType turn) {
+    BigCubeTurn(cube, turn);
+    BigAppendTurn(moves, turn);
+}
+
+static void BigSolverInit(Arena* arena, BigSolver* solver, u8 size) {
+    BigGeometry* geometry = &BIG_GEOMETRY[size];
+
+    solver->size = size;
+    solver->sticker_count = geometry->sticker_count;
+    solver->move_count = 0;
+
+    // Outer turns and the slice next to each face. On odd cubes the middle
+    // slice is never turned so the fixed centres stay where they are.
+    for (u8 depth = 1; depth <= 2; depth++) {
+        for (TurnType base = 0; base < TURN_TYPE_COUNT; base++) {
+            solver->moves[solver->move_count++] = BigTurnMake(base, depth, false);
+        }
+    }
+
+    solver->src = ArenaPushArray(arena, solver->move_count * solver->sticker_count, u16);
+
+    for (u8 m = 0; m < solver->move_count; m++) {
+        TurnType turn = solver->moves[m];
+        u8 face = BigTurnBase(turn) % CUBE_COLOUR_COUNT;
+        u8 layer = BigTurnDepth(turn) - 1;
+
+        solver->axis[m] = face % (CUBE_COLOUR_COUNT / 2);
+
+        for (u8 other = 0; other < solver->move_count; other++) {
+            if (solver->moves[other] == BigTurnInverse(turn)) solver->inverse[m] = other;
+        }
+
+        // Chain the layer permutation once per quarter turn
+        u16* src = &solver->src[m * solver->sticker_count];
+        const u16* layer_src = geometry->layer_src[face][layer];
+        for (u16 i = 0; i < solver->sticker_count; i++) src[i] = i;
+
+        for (u8 q = 0; q < BigTurnQuarters(turn); q++) {
+            u16 previous[BIG_CUBE_MAX_STICKERS];
+            MemCopy(previous, src, solver->sticker_count * sizeof(u16));
+            for (u16 i = 0; i < solver->sticker_count; i++) {
+                src[i] = previous[layer_src[i]];
+            }
+        }
+    }
+}
+
+static void BigSolverLoad(BigSolver* solver, BigCube* cube) {
+    u8 size = solver->size;
+    for (u8 face = 0; face < CUBE_COLOUR_COUNT; face++) {
+        for (u8 row = 0; row < size; row++) {
+            for (u8 col = 0; col < size; col++) {
+                solver->colours[BigStickerIndex(size, face, row, col)] = BigCubeGetTile(cube, face, row, col);
+            }
+        }
+    }
+}
+
+// Colour that ends up on sticker after the sequence
+static u8 BigTraceColour(BigSolver* solver, const u8* sequence, int length, u16 sticker) {
+    for (int i = length - 1; i >= 0; i--) {
+        sticker = solver->src[sequence[i] * solver->sticker_count + sticker];
+    }
+    return solver->colours[sticker];
+}
+
+static bool BigPieceSolvedAfter(
+    BigSolver* solver, const u8* sequence, int length, const BigPiece* piece
+) {
+    for (int i = 0; i < piece->count; i++) {
+        u8 colour = BigTraceColour(solver, sequence, length, piece->stickers[i]);
+        u8 target = piece->colours[i];
+        if (piece->partners[i] != BIG_NO_PARTNER) {
+            target = BigTraceColour(solver, sequence, length, piece->partners[i]);
+        }
+        if (colour != target) return false;
+    }
+    return true;
+}
+
+static bool BigSequenceWorks(
+    BigSolver* solver, const u8* sequence, int length, const BigPiece* pieces, int target
+) {
+    if (!BigPieceSolvedAfter(solver, sequence, length, &pieces[target])) return false;
+
+    for (int i = target - 1; i >= 0; i--) {
+        if (!BigPieceSolvedAfter(solver, sequence, length, &pieces[i])) return false;
+    }
+    return true;
+}
+
+// Writes a template into sequence and returns its length. Setup of UINT8_MAX
+// means no setup move, insert of UINT8_MAX means b is a single move.
+static int BigTemplateBuild(
+    BigSolver* solver, u8* sequence, u8 setup, u8 a, u8 b, u8 insert
+) {
+    int length = 0;
+
+    if (setup != UINT8_MAX) sequence[length++] = setup;
+
+    sequence[length++] = a;
+    if (insert == UINT8_MAX) {
+        sequence[length++] = b;
+        sequence[length++] = solver->inverse[a];
+        sequence[length++] = solver->inverse[b];
+    } else {
+        sequence[length++] = b;
+        sequence[length++] = insert;
+        sequence[length++] = solver->inverse[b];
+        sequence[length++] = solver->inverse[a];
+        sequence[length++] = b;
+        sequence[length++] = solver->inverse[insert];
+        sequence[length++] = solver->inverse[b];
+    }
+
+    if (setup != UINT8_MAX) sequence[length++] = solver->inverse[setup];
+
+    return length;
+}
+
+static int BigFindTemplate(
+    BigSolver* solver, const BigPiece* pieces, int target, u8* sequence
+) {
+    u8 count = solver->move_count;
+
+    // Shortest templates first: no setup or insert, then setup, then insert
+    for (int with_insert = 0; with_insert < 2; with_insert++) {
+        for (int with_setup = 0; with_setup < 2; with_setup++) {
+            for (u8 s = 0; s < (with_setup ? count : 1); s++) {
+                u8 setup = with_setup ? s : UINT8_MAX;
+
+                for (u8 a = 0; a < count; a++) {
+                    for (u8 b = 0; b < count; b++) {
+                        // Turns on the same axis commute so [a, b] does nothing
+                        if (solver->axis[a] == solver->axis[b]) continue;
+
+                        for (u8 c = 0; c < (with_insert ? count : 1); c++) {
+                            u8 insert = with_insert ? c : UINT8_MAX;
+                            if (with_insert && solver->axis[b] == solver->axis[c]) continue;
+
+                            int length = BigTemplateBuild(solver, sequence, setup, a, b, insert);
+                            if (BigSequenceWorks(solver, sequence, length, pieces, target)) {
+                                return length;
+                            }
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    return 0;
+}
+
+static bool BigSolveStage(
+    BigSolver* solver, BigCube* cube, MoveStack* moves,
+    const BigPiece* pieces, int count, const char* name
+) {
+    printf("%s:\n", name);
+    u32 moves_before = MoveStack_length(moves);
+    clock_t start = clock();
+    TraceBegin(name);
+
+    for (int i = 0; i < count; i++) {
+        BigSolverLoad(solver, cube);
+        if (BigPieceSolvedAfter(solver, NULL, 0, &pieces[i])) continue;
+
+        u8 sequence[BIG_TEMPLATE_MAX_LEN];
+        int length = BigFindTemplate(solver, pieces, i, sequence);
+        if (length == 0) {
+            printf("Failed to place piece %d\n\n", i);
+            TraceEnd(name);
+            return false;
+        }
+
+        for (int j = 0; j < length; j++) {
+            BigPerformTurn(cube, moves, solver->moves[sequence[j]]);
+        }
+    }
+
+    TraceEnd(name);
+    printf("Time: %f seconds\n", (double) (clock() - start) / CLOCKS_PER_SEC);
+    printf("Moves: %u\n\n", MoveStack_length(moves) - moves_before);
+    return true;
+}
+
+// Colour every centre should end up. Odd cubes keep their fixed centres.
+static void BigCentreColours(BigCube* cube, u8* colours) {
+    for (u8 face = 0; face < CUBE_COLOUR_COUNT; face++) {
+        colours[face] = face;
+        if (cube->size % 2 == 1) {
+            colours[face] = BigCubeGetTile(cube, face, cube->size / 2, cube->size / 2);
+        }
+    }
+}
+
+// Groups stickers into pieces by the cubie they sit on. Returns sticker count
+// of the cubie and writes the other stickers on it.
+static int BigCubieStickers(u8 size, u16 sticker, u16* others) {
+    u8 face = sticker / (size * size);
+    u8 row = (sticker / size) % size;
+    u8 col = sticker % size;
+    BigVector p = BigStickerPosition(size, face, row, col);
+    BigVector n = BIG_FACE_NORMALS[face];
+    BigVector cubie = { p.x - n.x, p.y - n.y, p.z - n.z };
+
+    int count = 0;
+    for (u8 other_face = 0; other_face < CUBE_COLOUR_COUNT; other_face++) {
+        if (other_face == face) continue;
+        for (u8 r = 0; r < size; r++) {
+            for (u8 c = 0; c < size; c++) {
+                BigVector q = BigStickerPosition(size, other_face, r, c);
+                BigVector m = BIG_FACE_NORMALS[other_face];
+                if (q.x - m.x == cubie.x && q.y - m.y == cubie.y && q.z - m.z == cubie.z) {
+                    others[count++] = BigStickerIndex(size, other_face, r, c);
+                }
+            }
+        }
+    }
+    return count + 1;
+}
+
+static bool BigIsMidge(u8 size, u16 sticker) {
+    if (size % 2 == 0) return false;
+    u8 row = (sticker / size) % size;
+    u8 col = sticker % size;
+    return row == size / 2 || col == size / 2;
+}
+
+static int BigCentrePieces(BigCube* cube, const u8* centre_colours, BigPiece* pieces) {
+    u8 size = cube->size;
+    int count = 0;
+
+    for (int i = 0; i < CUBE_COLOUR_COUNT; i++) {
+        u8 face = BIG_CENTRE_FACE_ORDER[i];
+        for (u8 row = 1; row < size - 1; row++) {
+            for (u8 col = 1; col < size - 1; col++) {
+                if (size % 2 == 1 && row == size / 2 && col == size / 2) continue;
+
+                BigPiece* piece = &pieces[count++];
+                piece->count = 1;
+                piece->stickers[0] = BigStickerIndex(size, face, row, col);
+                piece->partners[0] = BIG_NO_PARTNER;
+                piece->colours[0] = centre_colours[face];
+            }
+        }
+    }
+    return count;
+}
+
+// Midge tile on the same face and edge as a wing tile
+static u16 BigMidgePartner(u8 size, u16 sticker) {
+    u8 face = sticker / (size * size);
+    u8 row = (sticker / size) % size;
+    u8 col = sticker % size;
+    u8 middle = size / 2;
+
+    if (row == 0 || row == size - 1) return BigStickerIndex(size, face, row, middle);
+    return BigStickerIndex(size, face, middle, col);
+}
+
+static int BigWingPieces(BigCube* cube, const u8* centre_colours, BigPiece* pieces) {
+    u8 size = cube->size;
+    u16 sticker_count = CUBE_COLOUR_COUNT * size * size;
+    bool taken[BIG_CUBE_MAX_STICKERS] = { false };
+    int count = 0;
+
+    for (u16 sticker = 0; sticker < sticker_count; sticker++) {
+        u16 others[2];
+        if (taken[sticker]) continue;
+        if (BigCubieStickers(size, sticker, others) != 2) continue;
+        if (BigIsMidge(size, sticker)) continue;
+
+        BigPiece* piece = &pieces[count++];
+        piece->count = 2;
+        piece->stickers[0] = sticker;
+        piece->stickers[1] = others[0];
+        taken[sticker] = true;
+        taken[others[0]] = true;
+
+        for (int i = 0; i < 2; i++) {
+            u16 s = piece->stickers[i];
+            piece->colours[i] = centre_colours[s / (size * size)];
+            piece->partners[i] = size % 2 == 1 ? BigMidgePartner(size, s) : BIG_NO_PARTNER;
+        }
+    }
+    return count;
+}
+
+static int BigPermutationParity(const u8* pieces, int count) {
+    bool seen[BIG_CUBE_MAX_STICKERS] = { false };
+    int cycles = 0;
+
+    for (int i = 0; i < count; i++) {
+        if (seen[i]) continue;
+        cycles++;
+        for (int j = i; !seen[j]; j = pieces[j]) seen[j] = true;
+    }
+    return (count - cycles) % 2;
+}
+
+// Wings can't flip in place so every wing slot has one reference sticker that
+// only ever moves to other reference stickers. A wing is then told apart from
+// its twin on the same edge by which colour is on its reference sticker.
+static int BigWingParity(BigSolver* solver, const BigPiece* wings, int count) {
+    bool reference[BIG_CUBE_MAX_STICKERS] = { false };
+    u16 queue[BIG_CUBE_MAX_STICKERS];
+    int head = 0;
+    int tail = 0;
+
+    queue[tail++] = wings[0].stickers[0];
+    reference[wings[0].stickers[0]] = true;
+    while (head < tail) {
+        u16 sticker = queue[head++];
+        for (u8 m = 0; m < solver->move_count; m++) {
+            const u16* src = &solver->src[m * solver->sticker_count];
+            for (u16 i = 0; i < solver->sticker_count; i++) {
+                if (src[i] != sticker || reference[i]) continue;
+                reference[i] = true;
+                queue[tail++] = i;
+            }
+        }
+    }
+
+    u8 home[BIG_CUBE_MAX_STICKERS][2];
+    u8 current[BIG_CUBE_MAX_STICKERS][2];
+    for (int i = 0; i < count; i++) {
+        int ref = reference[wings[i].stickers[0]] ? 0 : 1;
+        assert(reference[wings[i].stickers[ref]] && !reference[wings[i].stickers[1 - ref]]);
+
+        home[i][0] = wings[i].colours[ref];
+        home[i][1] = wings[i].colours[1 - ref];
+        current[i][0] = solver->colours[wings[i].stickers[ref]];
+        current[i][1] = solver->colours[wings[i].stickers[1 - ref]];
+    }
+
+    u8 permutation[BIG_CUBE_MAX_STICKERS];
+    for (int i = 0; i < count; i++) {
+        permutation[i] = UINT8_MAX;
+        for (int j = 0; j < count; j++) {
+            if (current[i][0] == home[j][0] && current[i][1] == home[j][1]) {
+                permutation[i] = j;
+            }
+        }
+        if (permutation[i] == UINT8_MAX) return -1;
+    }
+
+    return BigPermutationParity(permutation, count);
+}
+
+static int BigCornerParity(BigCube* cube, const u8* centre_colours) {
+    u8 size = cube->size;
+    u8 lookup[3] = { 0, size / 2, size - 1 };
+    u8 permutation[8];
+
+    for (int slot = 0; slot < 8; slot++) {
+        u16 current = 0;
+        for (int k = 0; k < 3; k++) {
+            u8 face = CUBE_CORNER_COLOUR_TABLE[slot * 3 + k];
+            u8 tile = CUBE_CORNER_POSITION_TABLE[slot * 3 + k];
+            u8 row = lookup[BIG_TILE_ROW_TABLE[tile]];
+            u8 col = lookup[BIG_TILE_COL_TABLE[tile]];
+            FlagSet(current, Bit(BigCubeGetTile(cube, face, row, col)));
+        }
+
+        permutation[slot] = UINT8_MAX;
+        for (int piece = 0; piece < 8; piece++) {
+            u16 home = 0;
+            for (int k = 0; k < 3; k++) {
+                FlagSet(home, Bit(centre_colours[CUBE_CORNER_COLOUR_TABLE[piece * 3 + k]]));
+            }
+            if (home == current) permutation[slot] = piece;
+        }
+        if (permutation[slot] == UINT8_MAX) return -1;
+    }
+
+    return BigPermutationParity(permutation, 8);
+}
+
+// The arena is reset by the 3x3 stage so moves must live somewhere else
+bool BigCubeSolve(Arena* arena, BigCube* cube, MoveStack* moves) {
+    u8 size = cube->size;
+    if (size < BIG_SOLVE_MIN_SIZE || size > BIG_SOLVE_MAX_SIZE) {
+        printf("No solver for %dx%d\n", size, size);
+        return false;
+    }
+
+    printf("----- BIG SOLVE -----\n");
+
+    BigSolver* solver = ArenaPushStruct(arena, BigSolver);
+    BigSolverInit(arena, solver, size);
+
+    u8 centre_colours[CUBE_COLOUR_COUNT];
+    BigCentreColours(cube, centre_colours);
+
+    BigPiece* centres = ArenaPushArray(arena, solver->sticker_count, BigPiece);
+    int centre_count = BigCentrePieces(cube, centre_colours, centres);
+
+    BigPiece* wings = ArenaPushArray(arena, solver->sticker_count, BigPiece);
+    int wing_count = BigWingPieces(cube, centre_colours, wings);
+
+    // Wings and centres are always solved together so one list does both
+    BigPiece* pieces = ArenaPushArray(arena, centre_count + wing_count, BigPiece);
+    MemCopy(pieces, centres, centre_count * sizeof(BigPiece));
+    MemCopy(pieces + centre_count, wings, wing_count * sizeof(BigPiece));
+
+    // 1. Parity
+    printf("PARITY:\n");
+    BigSolverLoad(solver, cube);
+    int wing_parity = BigWingParity(solver, wings, wing_count);
+    int corner_parity = size % 2 == 0 ? BigCornerParity(cube, centre_colours) : 0;
+    if (wing_parity < 0 || corner_parity < 0) {
+        printf("Invalid cube\n\n");
+        return false;
+    }
+    if (corner_parity) {
+        BigPerformTurn(cube, moves, TURN_UP);
+    }
+    if (wing_parity) {
+        BigPerformTurn(cube, moves, BigTurnMake(TURN_RIGHT, 2, false));
+    }
+    printf("Corner parity: %d, wing parity: %d\n\n", corner_parity, wing_parity);
+
+    // 2. Centres, 3. Edges
+    if (!BigSolveStage(solver, cube, moves, pieces, centre_count, "CENTRES")) return false;
+    if (!BigSolveStage(solver, cube, moves, pieces, centre_count + wing_count, "EDGES")) return false;
+
+    // 4. Hand the reduced cube to the 3x3 solver. Colours are relabelled in
+    // case the fixed centres of an odd cube were moved by a middle slice.
+    u8 colour_map[CUBE_COLOUR_COUNT];
+    for (u8 face = 0; face < CUBE_COLOUR_COUNT; face++) {
+        colour_map[centre_colours[face]] = face;
+    }
+
+    // On the stack, SolveCube resets the arena
+    Cube three;
+    CubeInit(&three);
+    BigCubeToCube(cube, &three);
+    for (u8 face = 0; face < CUBE_COLOUR_COUNT; face++) {
+        for (u8 tile = 0; tile < 8; tile++) {
+            FaceSetTile(&three.faces[face], colour_map[FaceGetTile(three.faces[face], tile)], tile);
+        }
+    }
+    three.hash = CubeHashCompute(&three);
+
+    ArenaReset(arena);
+
+    if (!CubeValid(arena, &three)) {
+        printf("Reduced cube is not a valid 3x3\n\n");
+        return false;
+    }
+
+    MoveStack* three_moves = SolveCube(arena, &three);
+    for (u32 i = 0; i < MoveStack_length(three_moves); i++) {
+        TurnType turn;
+        MoveStack_get(three_moves, &turn, i);
+        BigPerformTurn(cube, moves, turn);
+    }
+
+    // The full solution on one line, handy for pasting into a simulator
+    MoveBuffer buffer;
+    MoveBufferInit(&buffer, arena, MoveStack_length(moves));
+    MoveBufferFromStack(&buffer, moves);
+    char* text = ArenaPushArray(arena, MoveBufferFormatSize(MoveBufferLength(&buffer)), char);
+    MoveBufferFormat(&buffer, text);
+
+    printf("Total moves: %u\n", MoveStack_length(moves));
+    printf("%s\n\n", text);
+    return true;
+}
+
+// RENDER /////////////////////////////////////////////////////////////////////
+
+void BigCubeRender(BigCube* cube, Rectangle cube_rect) {
+    u8 size = cube->size;
+
+    float face_width = size * (1 + BIG_TILE_RENDER_SPACING) + BIG_FACE_RENDER_SPACING;
+    float tile = MinFloat(cube_rect.width / (4 * face_width), cube_rect.height / (3 * face_width));
+    float offset_x = cube_rect.x + (cube_rect.width - 4 * face_width * tile) / 2;
+    float offset_y = cube_rect.y + (cube_rect.height - 3 * face_width * tile) / 2;
+
+    for (u8 face = 0; face < CUBE_COLOUR_COUNT; face++) {
+        float face_x = offset_x + BIG_FACE_RENDER_TABLE[face][0] * face_width * tile;
+        float face_y = offset_y + BIG_FACE_RENDER_TABLE[face][1] * face_width * tile;
+
+        for (u8 row = 0; row < size; row++) {
+            for (u8 col = 0; col < size; col++) {
+                Rectangle rec = {
+                    face_x + col * tile * (1 + BIG_TILE_RENDER_SPACING),
+                    face_y + row * tile * (1 + BIG_TILE_RENDER_SPACING),
+                    tile, tile
+                };
+                DrawRectangleRounded(
+                    rec, BIG_TILE_RENDER_ROUNDNESS, BIG_TILE_RENDER_SEGMENTS,
+                    CubeFaceColour(BigCubeGetTile(cube, face, row, col))
+                );
+                DrawRectangleRoundedLinesEx(
+                    rec, BIG_TILE_RENDER_ROUNDNESS, BIG_TILE_RENDER_SEGMENTS,
+                    rec.width * BIG_TILE_RENDER_THICKNESS, BLACK
+                );
+            }
+        }
+    }
+}
@@ -0,0 +1,69 @@
+#ifndef BIGCUBE_H
+#define BIGCUBE_H
+
+
+#include "core.h"
+#include "cube.h"
+#include "solve.h"
+#include "raylib.h"
+
+
+#define BIG_CUBE_MIN_SIZE 2
+#define BIG_CUBE_MAX_SIZE 7
+#define BIG_CUBE_MAX_STICKERS (CUBE_COLOUR_COUNT * BIG_CUBE_MAX_SIZE * BIG_CUBE_MAX_SIZE)
+
+// Sizes the reduction solver has been written for
+#define BIG_SOLVE_MIN_SIZE 4
+#define BIG_SOLVE_MAX_SIZE 5
+
+#define BIG_MOVE_STACK_LEN 4096
+
+// Extended turns share TurnType (and so MoveStack) with the 3x3. The normal 18
+// turns are outer layer turns, then every block of 18 after that is another
+// layer code: slice turns (2R, 3R, ...) and wide turns (Rw, 3Rw, ...) going
+// deeper into the cube. Largest value still fits in a byte.
+#define BIG_TURN_LAYER_CODES (1 + 2 * (BIG_CUBE_MAX_SIZE - 2))
+#define BIG_TURN_COUNT (TURN_TYPE_COUNT * BIG_TURN_LAYER_CODES)
+#define BIG_TURN_NAME_LEN 8
+
+
+// Sticker layout is the same net and face order as Cube, but each face is
+// stored as one u64 per row with 4 bits per tile. Column c of a row lives at
+// bits 4c. A u64 holds 16 tiles so the layout works up to 16x16 though only
+// sizes up to BIG_CUBE_MAX_SIZE are allocated.
+//
+//         U
+//       L F R B
+//         D
+//
+// Every face is seen from outside with row 0 at the top of the net, so the
+// bottom row of U touches the top row of F and column 0 of R touches the last
+// column of F.
+typedef struct {
+    u8 size;
+    u64 rows[CUBE_COLOUR_COUNT][BIG_CUBE_MAX_SIZE];
+} BigCube;
+
+
+TurnType BigTurnMake(TurnType base, u8 depth, bool wide);
+TurnType BigTurnBase(TurnType turn);
+u8 BigTurnDepth(TurnType turn);
+bool BigTurnWide(TurnType turn);
+TurnType BigTurnInverse(TurnType turn);
+int BigTurnFormat(TurnType turn, char* out);
+bool BigTurnParse(const char* text, TurnType* turn, int* length);
+
+void BigCubeSetSolved(BigCube* cube, u8 size);
+enum8(CubeColour) BigCubeGetTile(BigCube* cube, u8 face, u8 row, u8 col);
+void BigCubeSetTile(BigCube* cube, u8 face, u8 row, u8 col, enum8(CubeColour) colour);
+void BigCubeLayerTurn(BigCube* cube, u8 face, u8 layer, u8 quarter_turns);
+void BigCubeTurn(BigCube* cube, TurnType turn);
+void BigCubeFromCube(BigCube* big, Cube* cube);
+void BigCubeToCube(BigCube* big, Cube* cube);
+bool BigCubeSolved(BigCube* cube);
+void BigCubeScramble(BigCube* cube, int length);
+bool BigCubeSolve(Arena* arena, BigCube* cube, MoveStack* moves);
+void BigCubeRender(BigCube* cube, Rectangle cube_rect);
+
+
+#endif  /* BIGCUBE_H */
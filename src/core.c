@@ -1,11 +1,58 @@
 #include "core.h"
 
+// Only for GetSystemInfo, kept out of core.h as it clashes with raylib
+#ifdef PLATFORM_WINDOWS
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#endif
+
 
 #define _Max(a, b) (((a) > (b)) ? (a) : (b))
 #define _Min(a, b) (((a) < (b)) ? (a) : (b))
 #define _Mod(x, n) ((((x) % (n)) + (n)) % (n))
 
 
+typedef enum {
+    PARALLEL_GATE_WAIT,
+    PARALLEL_GATE_GO,
+    PARALLEL_GATE_GIVE_UP,
+} ParallelGateState;
+
+// Holds ParallelRunConcurrent's threads until it knows all of them started
+typedef struct {
+#ifndef PLATFORM_WEB
+    pthread_mutex_t lock;
+    pthread_cond_t changed;
+#endif
+    enum8(ParallelGateState) state;
+} ParallelGate;
+
+typedef struct {
+    ParallelFunction func;
+    void* data;
+    u32 thread_index;
+    u32 thread_count;
+    u32 lane;
+    ParallelGate* gate;     // NULL to start straight away
+} ParallelJob;
+
+typedef struct {
+    ThreadFunction func;
+    void* data;
+    u32 lane;
+} ThreadJob;
+
+
+// Index of the share of a ParallelRun this thread is running, 0 outside one
+static _Thread_local u32 current_thread_index = 0;
+
+// Which ThreadStart thread this is, or whose ParallelRun this share is part
+// of. 0 is the main thread and every ThreadStart thread takes the next one
+static _Thread_local u32 current_thread_lane = 0;
+static u32 thread_lane_next = 1;
+
+
 static u64 ArenaAlignedOffset(Arena* arena, u64 align) {
     u64 current = (u64)(arena->base + arena->used);
 
@@ -60,7 +107,7 @@ void ArenaReset(Arena* arena) {
     arena->used = 0;
 }
 
-void* MemCopy(void* dest, void* src, u64 size) {
+void* MemCopyScalar(void* dest, void* src, u64 size) {
     u8* d = (u8*) dest;
     const u8* s = (const u8*) src;
 
@@ -71,7 +118,7 @@ void* MemCopy(void* dest, void* src, u64 size) {
     return dest;
 }
 
-void* MemSet(void* ptr, u8 value, u64 size) {
+void* MemSetScalar(void* ptr, u8 value, u64 size) {
     u8 *dst = (u8*) ptr;
 
     while (size--) {
@@ -81,6 +128,22 @@ void* MemSet(void* ptr, u8 value, u64 size) {
     return ptr;
 }
 
+static MemCopyFunction mem_copy_kernel = MemCopyScalar;
+static MemSetFunction mem_set_kernel = MemSetScalar;
+
+void MemKernelsSet(MemCopyFunction copy, MemSetFunction set) {
+    mem_copy_kernel = copy;
+    mem_set_kernel = set;
+}
+
+void* MemCopy(void* dest, void* src, u64 size) {
+    return mem_copy_kernel(dest, src, size);
+}
+
+void* MemSet(void* ptr, u8 value, u64 size) {
+    return mem_set_kernel(ptr, value, size);
+}
+
 i32 MemCmp(void* a, void* b, u64 count) {
     const u8 *p1 = (const u8*) a;
     const u8 *p2 = (const u8*) b;
@@ -124,3 +187,228 @@ int Index2D(int x, int y, int width, int height) {
     assert(x >= 0 && x < width && y >= 0 && y < height);
     return y * width + x;
 }
+
+double TimeSeconds(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+u32 ThreadCount(void) {
+#if defined(PLATFORM_WEB)
+    return 1;
+#elif defined(PLATFORM_WINDOWS)
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    if (info.dwNumberOfProcessors < 1) return 1;
+    return MinU32(info.dwNumberOfProcessors, MAX_THREADS);
+#else
+    long count = sysconf(_SC_NPROCESSORS_ONLN);
+    if (count < 1) return 1;
+    return MinU32(count, MAX_THREADS);
+#endif
+}
+
+u32 ThreadIndex(void) {
+    return current_thread_index;
+}
+
+u32 ThreadLane(void) {
+    return current_thread_lane;
+}
+
+static void ParallelCall(ParallelFunction func, void* data, u32 thread_index, u32 thread_count) {
+    u32 previous = current_thread_index;
+    current_thread_index = thread_index;
+    func(data, thread_index, thread_count);
+    current_thread_index = previous;
+}
+
+#ifndef PLATFORM_WEB
+static void* ParallelThread(void* arg) {
+    ParallelJob* job = (ParallelJob*) arg;
+    current_thread_lane = job->lane;
+
+    ParallelGate* gate = job->gate;
+    if (gate != NULL) {
+        pthread_mutex_lock(&gate->lock);
+        while (gate->state == PARALLEL_GATE_WAIT) pthread_cond_wait(&gate->changed, &gate->lock);
+        bool go = gate->state == PARALLEL_GATE_GO;
+        pthread_mutex_unlock(&gate->lock);
+        if (!go) return NULL;
+    }
+
+    ParallelCall(job->func, job->data, job->thread_index, job->thread_count);
+    return NULL;
+}
+#endif
+
+void ParallelRun(u32 thread_count, ParallelFunction func, void* data) {
+    thread_count = MaxU32(MinU32(thread_count, MAX_THREADS), 1);
+
+#ifdef PLATFORM_WEB
+    for (u32 i = 0; i < thread_count; i++) {
+        ParallelCall(func, data, i, thread_count);
+    }
+#else
+    pthread_t threads[MAX_THREADS];
+    ParallelJob jobs[MAX_THREADS];
+    bool started[MAX_THREADS];
+
+    for (u32 i = 1; i < thread_count; i++) {
+        jobs[i] = (ParallelJob) { func, data, i, thread_count, current_thread_lane, NULL };
+        started[i] = pthread_create(&threads[i], NULL, ParallelThread, &jobs[i]) == 0;
+
+        // Couldn't get a thread so do its share here instead
+        if (!started[i]) ParallelCall(func, data, i, thread_count);
+    }
+
+    ParallelCall(func, data, 0, thread_count);
+
+    for (u32 i = 1; i < thread_count; i++) {
+        if (started[i]) pthread_join(threads[i], NULL);
+    }
+#endif
+}
+
+bool ParallelRunConcurrent(u32 thread_count, ParallelFunction func, void* data) {
+    if (thread_count > MAX_THREADS) return false;
+    thread_count = MaxU32(thread_count, 1);
+
+#ifdef PLATFORM_WEB
+    if (thread_count > 1) return false;
+    ParallelCall(func, data, 0, 1);
+    return true;
+#else
+    pthread_t threads[MAX_THREADS];
+    ParallelJob jobs[MAX_THREADS];
+    ParallelGate gate = { .state = PARALLEL_GATE_WAIT };
+    pthread_mutex_init(&gate.lock, NULL);
+    pthread_cond_init(&gate.changed, NULL);
+
+    u32 started = 1;
+    for (; started < thread_count; started++) {
+        jobs[started] = (ParallelJob) { func, data, started, thread_count, current_thread_lane, &gate };
+        if (pthread_create(&threads[started], NULL, ParallelThread, &jobs[started]) != 0) break;
+    }
+    bool all = started == thread_count;
+
+    pthread_mutex_lock(&gate.lock);
+    gate.state = all ? PARALLEL_GATE_GO : PARALLEL_GATE_GIVE_UP;
+    pthread_cond_broadcast(&gate.changed);
+    pthread_mutex_unlock(&gate.lock);
+
+    if (all) ParallelCall(func, data, 0, thread_count);
+
+    for (u32 i = 1; i < started; i++) {
+        pthread_join(threads[i], NULL);
+    }
+    pthread_cond_destroy(&gate.changed);
+    pthread_mutex_destroy(&gate.lock);
+    return all;
+#endif
+}
+
+#ifndef PLATFORM_WEB
+static void* ThreadMain(void* arg) {
+    ThreadJob job = *(ThreadJob*) arg;
+    free(arg);
+    current_thread_lane = job.lane;
+    job.func(job.data);
+    return NULL;
+}
+#endif
+
+void ThreadStart(ThreadFunction func, void* data) {
+#ifdef PLATFORM_WEB
+    func(data);
+#else
+    // Has to outlive this call since the caller's stack might not
+    ThreadJob* job = malloc(sizeof(ThreadJob));
+    if (job == NULL) {
+        func(data);
+        return;
+    }
+
+    *job = (ThreadJob) { func, data, __atomic_fetch_add(&thread_lane_next, 1, __ATOMIC_RELAXED) };
+    pthread_t thread;
+    if (pthread_create(&thread, NULL, ThreadMain, job) != 0) {
+        free(job);
+        func(data);
+        return;
+    }
+    pthread_detach(thread);
+#endif
+}
+
+#ifndef PLATFORM_WEB
+static void* WorkerMain(void* arg) {
+    Worker* worker = (Worker*) arg;
+    current_thread_lane = worker->lane;
+
+    pthread_mutex_lock(&worker->lock);
+    while (true) {
+        while (!worker->pending && !worker->stopping) {
+            pthread_cond_wait(&worker->wake, &worker->lock);
+        }
+        if (worker->stopping) break;
+
+        worker->pending = false;
+        pthread_mutex_unlock(&worker->lock);
+        worker->func(worker->data);
+        pthread_mutex_lock(&worker->lock);
+    }
+    pthread_mutex_unlock(&worker->lock);
+    return NULL;
+}
+#endif
+
+void WorkerStart(Worker* worker, ThreadFunction func, void* data) {
+    assert(!worker->started);
+    worker->func = func;
+    worker->data = data;
+    worker->pending = false;
+    worker->stopping = false;
+
+#ifndef PLATFORM_WEB
+    worker->lane = __atomic_fetch_add(&thread_lane_next, 1, __ATOMIC_RELAXED);
+    pthread_mutex_init(&worker->lock, NULL);
+    pthread_cond_init(&worker->wake, NULL);
+    worker->started = pthread_create(&worker->thread, NULL, WorkerMain, worker) == 0;
+
+    // Couldn't get a thread, WorkerWake will do the work itself
+    if (!worker->started) {
+        pthread_cond_destroy(&worker->wake);
+        pthread_mutex_destroy(&worker->lock);
+    }
+#endif
+}
+
+void WorkerWake(Worker* worker) {
+#ifndef PLATFORM_WEB
+    if (worker->started) {
+        pthread_mutex_lock(&worker->lock);
+        worker->pending = true;
+        pthread_cond_signal(&worker->wake);
+        pthread_mutex_unlock(&worker->lock);
+        return;
+    }
+#endif
+    worker->func(worker->data);
+}
+
+void WorkerStop(Worker* worker) {
+#ifndef PLATFORM_WEB
+    if (!worker->started) return;
+
+    pthread_mutex_lock(&worker->lock);
+    worker->stopping = true;
+    pthread_cond_signal(&worker->wake);
+    pthread_mutex_unlock(&worker->lock);
+
+    pthread_join(worker->thread, NULL);
+    pthread_cond_destroy(&worker->wake);
+    pthread_mutex_destroy(&worker->lock);
+    worker->started = false;
+#endif
+}
@@ -11,6 +11,14 @@
 #include <time.h>
 #include <unistd.h>
 
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#ifndef PLATFORM_WEB
+#include <pthread.h>
+#endif
+
 
 typedef int8_t          i8 ;
 typedef int16_t         i16;
@@ -73,6 +81,13 @@ void ArenaReset(Arena* arena);
 
 void* MemCopy(void* dest, void* src, u64 size);
 void* MemSet(void* ptr, u8 value, u64 size);
+
+// MemCopy and MemSet go through these, cpu.c swaps in vector versions
+typedef void* (*MemCopyFunction)(void* dest, void* src, u64 size);
+typedef void* (*MemSetFunction)(void* ptr, u8 value, u64 size);
+void* MemCopyScalar(void* dest, void* src, u64 size);
+void* MemSetScalar(void* ptr, u8 value, u64 size);
+void MemKernelsSet(MemCopyFunction copy, MemSetFunction set);
 i32 MemCmp(void* a, void* b, u64 count);
 #define MemZero(ptr, size) MemSet(ptr, 0, size)
 
@@ -101,6 +116,65 @@ int ModWrap(int x, int n);
 
 int Index2D(int x, int y, int width, int height);
 
+// Wall clock seconds from a monotonic clock. Use over clock() when timing
+// anything multi-threaded as clock() sums CPU time across threads.
+double TimeSeconds(void);
+
+// THREADS ////////////////////////////////////////////////////////////////////
+// Runs func on thread_count threads (the calling thread is one of them) and
+// waits for all of them. Work splitting is left to func, usually by striding
+// on thread_index or grabbing chunks from an atomic counter. Without thread
+// support (web) everything runs on the calling thread one index at a time.
+// ThreadIndex gives the thread_index of the share running on the current
+// thread, 0 outside of ParallelRun. ThreadLane tells apart ParallelRuns
+// going on at the same time: it is 0 on the main thread, each ThreadStart
+// or Worker thread has its own, and every share of a ParallelRun has the lane of the
+// thread that called it.
+#define MAX_THREADS 64
+
+typedef void (*ParallelFunction)(void* data, u32 thread_index, u32 thread_count);
+u32 ThreadCount(void);
+u32 ThreadIndex(void);
+u32 ThreadLane(void);
+void ParallelRun(u32 thread_count, ParallelFunction func, void* data);
+
+// For shares that wait on each other, which would never finish one after the
+// other on the same thread. Only runs func if every one of thread_count
+// threads could be made, and returns false without running any of it if not
+// (always the case on web for more than one thread).
+bool ParallelRunConcurrent(u32 thread_count, ParallelFunction func, void* data);
+
+// Runs func on a new thread and returns straight away. Nothing ever joins it,
+// so func has to let whoever is waiting know when it is done (an atomic flag
+// is plenty). Without thread support (web), or if no thread could be made,
+// func runs on the calling thread before this returns.
+typedef void (*ThreadFunction)(void* data);
+void ThreadStart(ThreadFunction func, void* data);
+
+// A thread that stays around for repeated jobs. It sleeps until WorkerWake,
+// runs func once and goes back to sleep; wakes that come in while func is
+// running add up to one more run. WorkerStop lets a run in progress finish,
+// drops one that was only asked for, and joins the thread. Without thread
+// support (web), or if no thread could be made, WorkerWake runs func on the
+// calling thread before it returns. A zeroed Worker is safe to stop.
+typedef struct {
+    ThreadFunction func;
+    void* data;
+    bool started;
+    bool pending;
+    bool stopping;
+#ifndef PLATFORM_WEB
+    u32 lane;
+    pthread_t thread;
+    pthread_mutex_t lock;
+    pthread_cond_t wake;
+#endif
+} Worker;
+
+void WorkerStart(Worker* worker, ThreadFunction func, void* data);
+void WorkerWake(Worker* worker);
+void WorkerStop(Worker* worker);
+
 // STACK //////////////////////////////////////////////////////////////////////
 #define DECLARE_TYPED_STACK(type, name)                                       \
     typedef struct {                                                          \
@@ -195,5 +269,166 @@ int Index2D(int x, int y, int width, int height);
         queue->tail = 0;                                                      \
     }
 
+// HASHMAP ////////////////////////////////////////////////////////////////////
+// Open addressing hashmap laid out like a Swiss table. Every slot has a control
+// byte that is either HASHMAP_CTRL_EMPTY or the low 7 bits of the key hash.
+// Slots are probed a group of 16 control bytes at a time so with SSE2 a single
+// compare finds every candidate in the group, and only those keys are ever
+// read. Keys are never removed so there are no tombstones.
+//
+// Memory comes from the arena. When the map is 7/8 full the capacity doubles
+// and the old arrays are abandoned in the arena, so size the initial capacity
+// sensibly if the arena is tight.
+#define HASHMAP_GROUP_WIDTH 16
+#define HASHMAP_CTRL_EMPTY 0x80
+#define HashEqual(a, b) ((a) == (b))
+
+static inline u64 HashU64(u64 x) {
+    x ^= x >> 33;
+    x *= 0xFF51AFD7ED558CCDull;
+    x ^= x >> 33;
+    x *= 0xC4CEB9FE1A85EC53ull;
+    x ^= x >> 33;
+    return x;
+}
+
+// Bit i set if control byte i of the group equals value
+static inline u16 HashGroupMatch(const u8* ctrl, u8 value) {
+#ifdef __SSE2__
+    __m128i group = _mm_load_si128((const __m128i*) ctrl);
+    return (u16) _mm_movemask_epi8(_mm_cmpeq_epi8(group, _mm_set1_epi8(value)));
+#else
+    u16 mask = 0;
+    for (int i = 0; i < HASHMAP_GROUP_WIDTH; i++) {
+        if (ctrl[i] == value) mask |= Bit(i);
+    }
+    return mask;
+#endif
+}
+
+// Bit i set if slot i of the group is empty
+static inline u16 HashGroupMatchEmpty(const u8* ctrl) {
+#ifdef __SSE2__
+    __m128i group = _mm_load_si128((const __m128i*) ctrl);
+    return (u16) _mm_movemask_epi8(group);
+#else
+    u16 mask = 0;
+    for (int i = 0; i < HASHMAP_GROUP_WIDTH; i++) {
+        if (ctrl[i] & HASHMAP_CTRL_EMPTY) mask |= Bit(i);
+    }
+    return mask;
+#endif
+}
+
+#define DECLARE_TYPED_HASHMAP(key_type, value_type, name)                     \
+    typedef struct {                                                          \
+        Arena* arena;                                                         \
+        u8* ctrl;                                                             \
+        key_type* keys;                                                       \
+        value_type* values;                                                   \
+        u32 count;                                                            \
+        u32 capacity;                                                         \
+    } name;                                                                   \
+                                                                              \
+    void name##_init(name* map, Arena* arena, u32 capacity);                  \
+    bool name##_insert(name* map, key_type key, value_type value);            \
+    value_type* name##_get(name* map, key_type key);                          \
+    u32 name##_length(name* map);                                             \
+    void name##_clear(name* map);
+
+// Insert returns false (and leaves the value alone) if the key already exists
+#define DEFINE_TYPED_HASHMAP(key_type, value_type, name, hash_func, equal_func) \
+    static void name##_alloc(name* map, u32 capacity) {                       \
+        u32 rounded = HASHMAP_GROUP_WIDTH;                                    \
+        while (rounded < capacity) rounded <<= 1;                             \
+        map->capacity = rounded;                                              \
+        map->count = 0;                                                       \
+        map->ctrl = _ArenaPush(map->arena, rounded, HASHMAP_GROUP_WIDTH, false); \
+        map->keys = _ArenaPush(                                               \
+            map->arena, rounded * sizeof(key_type), alignof(key_type), false  \
+        );                                                                    \
+        map->values = _ArenaPush(                                             \
+            map->arena, rounded * sizeof(value_type), alignof(value_type), false \
+        );                                                                    \
+        MemSet(map->ctrl, HASHMAP_CTRL_EMPTY, rounded);                       \
+    }                                                                         \
+                                                                              \
+    static u32 name##_find_slot(name* map, key_type key, bool* found) {       \
+        u64 hash = hash_func(key);                                            \
+        u8 h2 = hash & 0x7F;                                                  \
+        u32 group_mask = (map->capacity / HASHMAP_GROUP_WIDTH) - 1;           \
+        u32 group = (hash >> 7) & group_mask;                                 \
+                                                                              \
+        for (u32 step = 1;; step++) {                                         \
+            u8* ctrl = map->ctrl + group * HASHMAP_GROUP_WIDTH;               \
+            u16 match = HashGroupMatch(ctrl, h2);                             \
+            while (match) {                                                   \
+                u32 slot = group * HASHMAP_GROUP_WIDTH + __builtin_ctz(match);\
+                if (equal_func(map->keys[slot], key)) {                       \
+                    *found = true;                                            \
+                    return slot;                                              \
+                }                                                             \
+                match &= match - 1;                                           \
+            }                                                                 \
+            u16 empty = HashGroupMatchEmpty(ctrl);                            \
+            if (empty) {                                                      \
+                *found = false;                                               \
+                return group * HASHMAP_GROUP_WIDTH + __builtin_ctz(empty);    \
+            }                                                                 \
+            /* Triangular probing visits every group for power of two */     \
+            group = (group + step) & group_mask;                              \
+        }                                                                     \
+    }                                                                         \
+                                                                              \
+    static void name##_grow(name* map) {                                      \
+        u8* old_ctrl = map->ctrl;                                             \
+        key_type* old_keys = map->keys;                                       \
+        value_type* old_values = map->values;                                 \
+        u32 old_capacity = map->capacity;                                     \
+                                                                              \
+        name##_alloc(map, old_capacity * 2);                                  \
+        for (u32 i = 0; i < old_capacity; i++) {                              \
+            if (old_ctrl[i] & HASHMAP_CTRL_EMPTY) continue;                   \
+            bool found;                                                       \
+            u32 slot = name##_find_slot(map, old_keys[i], &found);            \
+            map->ctrl[slot] = old_ctrl[i];                                    \
+            map->keys[slot] = old_keys[i];                                    \
+            map->values[slot] = old_values[i];                                \
+            map->count++;                                                     \
+        }                                                                     \
+    }                                                                         \
+                                                                              \
+    void name##_init(name* map, Arena* arena, u32 capacity) {                 \
+        map->arena = arena;                                                   \
+        name##_alloc(map, capacity);                                          \
+    }                                                                         \
+                                                                              \
+    bool name##_insert(name* map, key_type key, value_type value) {           \
+        if ((map->count + 1) * 8 > map->capacity * 7) name##_grow(map);       \
+        bool found;                                                           \
+        u32 slot = name##_find_slot(map, key, &found);                        \
+        if (found) return false;                                              \
+        map->ctrl[slot] = hash_func(key) & 0x7F;                              \
+        map->keys[slot] = key;                                                \
+        map->values[slot] = value;                                            \
+        map->count++;                                                         \
+        return true;                                                          \
+    }                                                                         \
+                                                                              \
+    value_type* name##_get(name* map, key_type key) {                         \
+        bool found;                                                           \
+        u32 slot = name##_find_slot(map, key, &found);                        \
+        return found ? &map->values[slot] : NULL;                             \
+    }                                                                         \
+                                                                              \
+    u32 name##_length(name* map) {                                            \
+        return map->count;                                                    \
+    }                                                                         \
+                                                                              \
+    void name##_clear(name* map) {                                            \
+        MemSet(map->ctrl, HASHMAP_CTRL_EMPTY, map->capacity);                 \
+        map->count = 0;                                                       \
+    }
+
 
 #endif  /* CORE_H */
@@ -0,0 +1,449 @@
+// Runtime CPU feature dispatch. The build never turns on SIMD globally (no
+// -march) so the same binary runs anywhere. Instead each kernel is written
+// once as a macro over a vector type and stamped out per level, with the
+// target attribute letting the compiler use that level's instructions inside
+// just that function. CpuInit asks the CPU (cpuid, through
+// __builtin_cpu_supports which also checks the OS saves the wide registers)
+// what it has and points every kernel at the best version.
+//
+//   scalar     plain u32 and byte loops, also used for every kernel's tail
+//   sse4.1     4 lanes of u32. SSE4.1 rather than SSE2 for pmulld
+//   avx2       8 lanes
+//   avx512     16 lanes
+//
+// Kernels:
+//
+// - MemCopy/MemSet copy a vector at a time.
+// - CubeTurnBatch turns many cubes stored face major, one cube per lane. Each
+//   turn is compiled into a small program when the kernels are first set up:
+//   which tiles stay put on every face, a rotate of the turned face and the
+//   12 side tiles that move between faces. The program is found by probing
+//   CubeTurn with single tiles so it can't drift from the reference turns.
+// - CubeColourCheckBatch checks every colour appears on exactly 8 moving
+//   tiles, the cheap first test before a full CubeValid.
+// - TableScan2Bit finds the next word of a 2 bit table (the pocket distances)
+//   holding a given value, so BFS layers skip words with nothing to expand.
+
+
+#include "cpu.h"
+
+#include <string.h>
+
+
+#if defined(__x86_64__) || defined(__i386__)
+#define CPU_X86
+#endif
+
+#define BATCH_SIDE_MOVES 12
+
+#define BENCH_BYTES Megabytes(64)
+#define BENCH_CUBES (1 << 20)
+
+
+typedef struct {
+    u32 keep[CUBE_COLOUR_COUNT];
+    u8 face;
+    u8 rotate;
+    u8 src_face[BATCH_SIDE_MOVES];
+    u8 src_shift[BATCH_SIDE_MOVES];
+    u8 dst_face[BATCH_SIDE_MOVES];
+    u8 dst_shift[BATCH_SIDE_MOVES];
+} BatchTurnProgram;
+
+// Each kernel starts at index start and returns where it stopped, anything
+// left over (less than a vector) is done by the scalar version
+typedef u32 (*BatchTurnKernel)(u32* faces, u32 count, u32 start, TurnType turn);
+typedef u32 (*ColourCheckKernel)(const u32* faces, u32 count, u32 start, u8* ok, u32* passed);
+typedef u32 (*TableScanKernel)(const u32* words, u32 count, u32* start, u8 value);
+
+typedef struct {
+    MemCopyFunction copy;
+    MemSetFunction set;
+    BatchTurnKernel turn;
+    ColourCheckKernel check;
+    TableScanKernel scan;
+} CpuKernels;
+
+
+const char* CPU_LEVEL_NAMES[CPU_LEVEL_COUNT] = {
+    "scalar", "sse4.1", "avx2", "avx512"
+};
+
+
+static BatchTurnProgram BATCH_TURN_PROGRAMS[TURN_TYPE_COUNT];
+static bool batch_programs_initialised = false;
+
+static enum8(CpuLevel) cpu_detected = CPU_LEVEL_SCALAR;
+static enum8(CpuLevel) cpu_level = CPU_LEVEL_SCALAR;
+
+
+// KERNELS ////////////////////////////////////////////////////////////////////
+
+#define DEFINE_MEM_KERNELS(copy_name, set_name, type, element, attributes)    \
+    attributes static void* copy_name(void* dest, void* src, u64 size) {      \
+        u8* d = (u8*) dest;                                                   \
+        const u8* s = (const u8*) src;                                        \
+        u64 i = 0;                                                            \
+        for (; i + sizeof(type) <= size; i += sizeof(type)) {                 \
+            type v;                                                           \
+            __builtin_memcpy(&v, s + i, sizeof(type));                        \
+            __builtin_memcpy(d + i, &v, sizeof(type));                        \
+        }                                                                     \
+        for (; i < size; i++) d[i] = s[i];                                    \
+        return dest;                                                          \
+    }                                                                         \
+                                                                              \
+    attributes static void* set_name(void* ptr, u8 value, u64 size) {         \
+        u8* d = (u8*) ptr;                                                    \
+        type zero;                                                            \
+        __builtin_memset(&zero, 0, sizeof(type));                             \
+        type v = zero + (element) (value * 0x0101010101010101ull);            \
+        u64 i = 0;                                                            \
+        for (; i + sizeof(type) <= size; i += sizeof(type)) {                 \
+            __builtin_memcpy(d + i, &v, sizeof(type));                        \
+        }                                                                     \
+        for (; i < size; i++) d[i] = value;                                   \
+        return ptr;                                                           \
+    }
+
+#define DEFINE_BATCH_TURN(name, type, lanes, attributes)                      \
+    attributes static u32 name(u32* faces, u32 count, u32 start, TurnType turn) { \
+        const BatchTurnProgram* p = &BATCH_TURN_PROGRAMS[turn];               \
+        u32 rotate = p->rotate;                                               \
+        u32 i = start;                                                        \
+        for (; i + (lanes) <= count; i += (lanes)) {                          \
+            type in[CUBE_COLOUR_COUNT];                                       \
+            type out[CUBE_COLOUR_COUNT];                                      \
+            for (int f = 0; f < CUBE_COLOUR_COUNT; f++) {                     \
+                __builtin_memcpy(&in[f], &faces[f * count + i], sizeof(type)); \
+                out[f] = in[f] & p->keep[f];                                  \
+            }                                                                 \
+            type x = in[p->face];                                             \
+            out[p->face] = (x << rotate) | (x >> (32 - rotate));              \
+            for (int m = 0; m < BATCH_SIDE_MOVES; m++) {                      \
+                type tile = (in[p->src_face[m]] >> p->src_shift[m]) & 0xFu;   \
+                out[p->dst_face[m]] |= tile << p->dst_shift[m];               \
+            }                                                                 \
+            for (int f = 0; f < CUBE_COLOUR_COUNT; f++) {                     \
+                __builtin_memcpy(&faces[f * count + i], &out[f], sizeof(type)); \
+            }                                                                 \
+        }                                                                     \
+        return i;                                                             \
+    }
+
+// Per colour: XOR makes matching tiles zero nibbles, OR folding each nibble
+// onto its low bit flags the non-zero ones, flip to count matches. Nibble
+// counts (at most 6) are then summed to bytes and bytes summed by a multiply.
+#define DEFINE_COLOUR_CHECK(name, type, lanes, attributes)                    \
+    attributes static u32 name(const u32* faces, u32 count, u32 start, u8* ok, u32* passed) { \
+        u32 i = start;                                                        \
+        for (; i + (lanes) <= count; i += (lanes)) {                          \
+            type in[CUBE_COLOUR_COUNT];                                       \
+            for (int f = 0; f < CUBE_COLOUR_COUNT; f++) {                     \
+                __builtin_memcpy(&in[f], &faces[f * count + i], sizeof(type)); \
+            }                                                                 \
+            type bad = in[0] ^ in[0];                                         \
+            for (u32 c = 0; c < CUBE_COLOUR_COUNT; c++) {                     \
+                u32 pattern = c * 0x11111111u;                                \
+                type sum = bad ^ bad;                                         \
+                for (int f = 0; f < CUBE_COLOUR_COUNT; f++) {                 \
+                    type x = in[f] ^ pattern;                                 \
+                    type nonzero = (x | (x >> 1) | (x >> 2) | (x >> 3)) & 0x11111111u; \
+                    sum += nonzero ^ 0x11111111u;                             \
+                }                                                             \
+                sum = (sum & 0x0F0F0F0Fu) + ((sum >> 4) & 0x0F0F0F0Fu);       \
+                sum = (sum * 0x01010101u) >> 24;                              \
+                bad |= sum ^ 8u;                                              \
+            }                                                                 \
+            u32 result[lanes];                                                \
+            __builtin_memcpy(result, &bad, sizeof(type));                     \
+            for (u32 l = 0; l < (lanes); l++) {                               \
+                ok[i + l] = result[l] == 0;                                   \
+                *passed += result[l] == 0;                                    \
+            }                                                                 \
+        }                                                                     \
+        return i;                                                             \
+    }
+
+// Same trick as PocketWordHas: XOR makes matching entries 00, then a 01 bit
+// is left for each entry where both bits are clear
+// Other threads can be filling in the table while it's scanned, so a word is
+// read in one piece or not at all. The vector loads here don't promise that
+// in C, they rely on x86 never tearing a 4 byte aligned element of a vector
+// load (each lane is one table word). A stale word is fine for the pocket
+// BFS, entries never change to the value it scans for, so at worst it finds
+// a word that no longer has one and rechecks it. The scalar kernel, which
+// also does every tail, uses relaxed atomic loads.
+#define DEFINE_TABLE_SCAN(name, type, lanes, attributes)                      \
+    attributes static u32 name(const u32* words, u32 count, u32* start, u8 value) { \
+        u32 pattern = value * 0x55555555u;                                    \
+        u32 i = *start;                                                       \
+        for (; i + (lanes) <= count; i += (lanes)) {                          \
+            type w;                                                           \
+            __builtin_memcpy(&w, &words[i], sizeof(type));                    \
+            type x = w ^ pattern;                                             \
+            type hit = ~(x | (x >> 1)) & 0x55555555u;                         \
+            u32 result[lanes];                                                \
+            __builtin_memcpy(result, &hit, sizeof(type));                     \
+            u32 any = 0;                                                      \
+            for (u32 l = 0; l < (lanes); l++) any |= result[l];               \
+            if (!any) continue;                                               \
+            for (u32 l = 0; l < (lanes); l++) {                               \
+                if (result[l]) {                                              \
+                    *start = i + l;                                           \
+                    return i + l;                                             \
+                }                                                             \
+            }                                                                 \
+        }                                                                     \
+        *start = i;                                                           \
+        return count;                                                         \
+    }
+
+
+DEFINE_MEM_KERNELS(MemCopyWord, MemSetWord, u64, u64, )
+DEFINE_BATCH_TURN(BatchTurnScalar, u32, 1, )
+DEFINE_COLOUR_CHECK(ColourCheckScalar, u32, 1, )
+
+static u32 TableScanScalar(const u32* words, u32 count, u32* start, u8 value) {
+    u32 pattern = value * 0x55555555u;
+    for (u32 i = *start; i < count; i++) {
+        u32 x = __atomic_load_n(&words[i], __ATOMIC_RELAXED) ^ pattern;
+        if (~(x | (x >> 1)) & 0x55555555u) {
+            *start = i;
+            return i;
+        }
+    }
+    *start = count;
+    return count;
+}
+
+#ifdef CPU_X86
+typedef u32 CpuVector4 __attribute__((vector_size(16)));
+typedef u32 CpuVector8 __attribute__((vector_size(32)));
+typedef u32 CpuVector16 __attribute__((vector_size(64)));
+
+#define CPU_SSE41 __attribute__((target("sse4.1")))
+#define CPU_AVX2 __attribute__((target("avx2")))
+#define CPU_AVX512 __attribute__((target("avx512f,avx512bw")))
+
+DEFINE_MEM_KERNELS(MemCopySSE41, MemSetSSE41, CpuVector4, u32, CPU_SSE41)
+DEFINE_BATCH_TURN(BatchTurnSSE41, CpuVector4, 4, CPU_SSE41)
+DEFINE_COLOUR_CHECK(ColourCheckSSE41, CpuVector4, 4, CPU_SSE41)
+DEFINE_TABLE_SCAN(TableScanSSE41, CpuVector4, 4, CPU_SSE41)
+
+DEFINE_MEM_KERNELS(MemCopyAVX2, MemSetAVX2, CpuVector8, u32, CPU_AVX2)
+DEFINE_BATCH_TURN(BatchTurnAVX2, CpuVector8, 8, CPU_AVX2)
+DEFINE_COLOUR_CHECK(ColourCheckAVX2, CpuVector8, 8, CPU_AVX2)
+DEFINE_TABLE_SCAN(TableScanAVX2, CpuVector8, 8, CPU_AVX2)
+
+DEFINE_MEM_KERNELS(MemCopyAVX512, MemSetAVX512, CpuVector16, u32, CPU_AVX512)
+DEFINE_BATCH_TURN(BatchTurnAVX512, CpuVector16, 16, CPU_AVX512)
+DEFINE_COLOUR_CHECK(ColourCheckAVX512, CpuVector16, 16, CPU_AVX512)
+DEFINE_TABLE_SCAN(TableScanAVX512, CpuVector16, 16, CPU_AVX512)
+
+static const CpuKernels CPU_KERNEL_TABLE[CPU_LEVEL_COUNT] = {
+    { MemCopyWord, MemSetWord, BatchTurnScalar, ColourCheckScalar, TableScanScalar },
+    { MemCopySSE41, MemSetSSE41, BatchTurnSSE41, ColourCheckSSE41, TableScanSSE41 },
+    { MemCopyAVX2, MemSetAVX2, BatchTurnAVX2, ColourCheckAVX2, TableScanAVX2 },
+    { MemCopyAVX512, MemSetAVX512, BatchTurnAVX512, ColourCheckAVX512, TableScanAVX512 },
+};
+#else
+// No vector kernels off x86, every level is scalar
+static const CpuKernels CPU_KERNEL_TABLE[CPU_LEVEL_COUNT] = {
+    { MemCopyWord, MemSetWord, BatchTurnScalar, ColourCheckScalar, TableScanScalar },
+    { MemCopyWord, MemSetWord, BatchTurnScalar, ColourCheckScalar, TableScanScalar },
+    { MemCopyWord, MemSetWord, BatchTurnScalar, ColourCheckScalar, TableScanScalar },
+    { MemCopyWord, MemSetWord, BatchTurnScalar, ColourCheckScalar, TableScanScalar },
+};
+#endif
+
+// Scalar until CpuInit picks, so nothing is ever called through NULL. Turn
+// and colour check still need CpuInit for their programs.
+static CpuKernels cpu_kernels = {
+    MemCopyWord, MemSetWord, BatchTurnScalar, ColourCheckScalar, TableScanScalar
+};
+
+
+// DISPATCH ///////////////////////////////////////////////////////////////////
+
+static void BatchProgramsInit(void) {
+    for (TurnType turn = 0; turn < TURN_TYPE_COUNT; turn++) {
+        BatchTurnProgram* program = &BATCH_TURN_PROGRAMS[turn];
+        program->face = turn % CUBE_COLOUR_COUNT;
+        program->rotate = turn < TURN_FRONT_PRIME ? 8 : (turn < TURN_FRONT_DOUBLE ? 24 : 16);
+
+        int moves = 0;
+        for (u8 face = 0; face < CUBE_COLOUR_COUNT; face++) {
+            program->keep[face] = face == program->face ? 0 : UINT32_MAX;
+            if (face == program->face) continue;
+
+            for (u8 position = 0; position < 8; position++) {
+                // Follow a single marked tile through the reference turn
+                Cube probe = { 0 };
+                FaceSetTile(&probe.faces[face], 1, position);
+                CubeTurn(&probe, turn);
+
+                u8 dst_face = 0;
+                u8 dst_position = 0;
+                for (u8 f = 0; f < CUBE_COLOUR_COUNT; f++) {
+                    for (u8 p = 0; p < 8; p++) {
+                        if (FaceGetTile(probe.faces[f], p) == 1) {
+                            dst_face = f;
+                            dst_position = p;
+                        }
+                    }
+                }
+                if (dst_face == face && dst_position == position) continue;
+
+                assert(moves < BATCH_SIDE_MOVES);
+                FlagClear(program->keep[face], 0xFu << (position * 4));
+                program->src_face[moves] = face;
+                program->src_shift[moves] = position * 4;
+                program->dst_face[moves] = dst_face;
+                program->dst_shift[moves] = dst_position * 4;
+                moves++;
+            }
+        }
+        assert(moves == BATCH_SIDE_MOVES);
+    }
+    batch_programs_initialised = true;
+}
+
+enum8(CpuLevel) CpuDetect(void) {
+#ifdef CPU_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512bw")) return CPU_LEVEL_AVX512;
+    if (__builtin_cpu_supports("avx2")) return CPU_LEVEL_AVX2;
+    if (__builtin_cpu_supports("sse4.1")) return CPU_LEVEL_SSE41;
+#endif
+    return CPU_LEVEL_SCALAR;
+}
+
+enum8(CpuLevel) CpuLevelGet(void) {
+    return cpu_level;
+}
+
+// Returns the level actually used, which is never above what was detected
+enum8(CpuLevel) CpuLevelSet(enum8(CpuLevel) level) {
+    if (!batch_programs_initialised) BatchProgramsInit();
+
+    cpu_level = MinU8(level, cpu_detected);
+    cpu_kernels = CPU_KERNEL_TABLE[cpu_level];
+    MemKernelsSet(cpu_kernels.copy, cpu_kernels.set);
+    return cpu_level;
+}
+
+void CpuInit(void) {
+    cpu_detected = CpuDetect();
+    enum8(CpuLevel) level = cpu_detected;
+
+    const char* forced = getenv(CPU_LEVEL_ENV);
+    if (forced != NULL) {
+        bool found = false;
+        for (u8 i = 0; i < CPU_LEVEL_COUNT; i++) {
+            if (strcmp(forced, CPU_LEVEL_NAMES[i]) == 0) {
+                level = i;
+                found = true;
+            }
+        }
+        if (!found) {
+            printf("Unknown %s=%s, using %s\n", CPU_LEVEL_ENV, forced, CPU_LEVEL_NAMES[level]);
+        } else if (level > cpu_detected) {
+            printf(
+                "%s=%s isn't supported, using %s\n",
+                CPU_LEVEL_ENV, forced, CPU_LEVEL_NAMES[cpu_detected]
+            );
+        }
+    }
+
+    CpuLevelSet(level);
+
+    // Only worth a line when it isn't what the machine would have picked
+    if (cpu_level != cpu_detected) {
+        printf("CPU: %s (detected %s)\n", CPU_LEVEL_NAMES[cpu_level], CPU_LEVEL_NAMES[cpu_detected]);
+    }
+}
+
+void CubeTurnBatch(u32* faces, u32 count, TurnType turn) {
+    assert(batch_programs_initialised && "CpuInit not called!");
+    u32 i = cpu_kernels.turn(faces, count, 0, turn);
+    BatchTurnScalar(faces, count, i, turn);
+}
+
+// Writes ok[i] for every cube, returns how many passed
+u32 CubeColourCheckBatch(const u32* faces, u32 count, u8* ok) {
+    assert(batch_programs_initialised && "CpuInit not called!");
+    u32 passed = 0;
+    u32 i = cpu_kernels.check(faces, count, 0, ok, &passed);
+    ColourCheckScalar(faces, count, i, ok, &passed);
+    return passed;
+}
+
+u32 TableScan2Bit(const u32* words, u32 count, u8 value) {
+    u32 i = 0;
+    u32 found = cpu_kernels.scan(words, count, &i, value);
+    if (found < count) return found;
+    return TableScanScalar(words, count, &i, value);
+}
+
+// BENCHMARK //////////////////////////////////////////////////////////////////
+
+void CpuBenchmark(Arena* arena) {
+    printf("----- CPU KERNELS -----\n");
+    printf("CPU: %s (detected %s)\n", CPU_LEVEL_NAMES[cpu_level], CPU_LEVEL_NAMES[cpu_detected]);
+
+    u8* source = ArenaPushArray(arena, BENCH_BYTES, u8);
+    u8* dest = ArenaPushArray(arena, BENCH_BYTES, u8);
+    u32* faces = ArenaPushArray(arena, BENCH_CUBES * CUBE_COLOUR_COUNT, u32);
+    u8* ok = ArenaPushArray(arena, BENCH_CUBES, u8);
+
+    enum8(CpuLevel) previous = cpu_level;
+
+    for (u8 level = 0; level <= cpu_detected; level++) {
+        CpuLevelSet(level);
+
+        double start = TimeSeconds();
+        MemSet(source, 0x5A, BENCH_BYTES);
+        double set_time = TimeSeconds() - start;
+
+        start = TimeSeconds();
+        MemCopy(dest, source, BENCH_BYTES);
+        double copy_time = TimeSeconds() - start;
+
+        // Solved cubes, every turn type once
+        for (u32 f = 0; f < CUBE_COLOUR_COUNT; f++) {
+            for (u32 i = 0; i < BENCH_CUBES; i++) {
+                faces[f * BENCH_CUBES + i] = f * 0x11111111u;
+            }
+        }
+        start = TimeSeconds();
+        for (TurnType turn = 0; turn < TURN_TYPE_COUNT; turn++) {
+            CubeTurnBatch(faces, BENCH_CUBES, turn);
+        }
+        double turn_time = TimeSeconds() - start;
+
+        start = TimeSeconds();
+        u32 passed = CubeColourCheckBatch(faces, BENCH_CUBES, ok);
+        double check_time = TimeSeconds() - start;
+        assert(passed == BENCH_CUBES);
+
+        // 0x5A5A... only holds entries 1 and 2 so a scan for 3 reads it all
+        start = TimeSeconds();
+        u32 found = TableScan2Bit((u32*) source, BENCH_BYTES / sizeof(u32), 3);
+        double scan_time = TimeSeconds() - start;
+        assert(found == BENCH_BYTES / sizeof(u32));
+        (void) passed;
+        (void) found;
+
+        double gigabytes = BENCH_BYTES / (double) Gigabytes(1);
+        printf("%s:\n", CPU_LEVEL_NAMES[level]);
+        printf("  MemSet:  %.2f GB/s\n", gigabytes / set_time);
+        printf("  MemCopy: %.2f GB/s\n", gigabytes / copy_time);
+        printf("  Batch turn:   %.1f M cube turns/s\n", BENCH_CUBES * (double) TURN_TYPE_COUNT / turn_time / 1e6);
+        printf("  Colour check: %.1f M cubes/s\n", BENCH_CUBES / check_time / 1e6);
+        printf("  Table scan:   %.2f GB/s\n", gigabytes / scan_time);
+    }
+
+    CpuLevelSet(previous);
+    printf("\n");
+}
@@ -0,0 +1,46 @@
+#ifndef CPU_H
+#define CPU_H
+
+
+#include "core.h"
+#include "cube.h"
+
+
+// Set to scalar, sse4.1, avx2 or avx512 to force a level. Levels above what
+// the CPU has are clamped down with a warning.
+#define CPU_LEVEL_ENV "CUBE_CPU_LEVEL"
+
+// Most cubes a vector kernel works on at once (AVX-512)
+#define CPU_MAX_LANES 16
+
+
+typedef enum {
+    CPU_LEVEL_SCALAR,
+    CPU_LEVEL_SSE41,
+    CPU_LEVEL_AVX2,
+    CPU_LEVEL_AVX512,
+
+    CPU_LEVEL_COUNT
+} CpuLevel;
+
+
+extern const char* CPU_LEVEL_NAMES[CPU_LEVEL_COUNT];
+
+
+void CpuInit(void);
+enum8(CpuLevel) CpuDetect(void);
+enum8(CpuLevel) CpuLevelGet(void);
+enum8(CpuLevel) CpuLevelSet(enum8(CpuLevel) level);
+
+// Batches are stored face major: face f of cube i is faces[f * count + i], so
+// each face of many cubes sits in one vector.
+void CubeTurnBatch(u32* faces, u32 count, TurnType turn);
+u32 CubeColourCheckBatch(const u32* faces, u32 count, u8* ok);
+
+// Index of the first word with a 2 bit entry equal to value, count if none
+u32 TableScan2Bit(const u32* words, u32 count, u8 value);
+
+void CpuBenchmark(Arena* arena);
+
+
+#endif  /* CPU_H */
@@ -22,6 +22,8 @@ static const float CUBE_RENDER_HEIGHT = 11 + (TILE_RENDER_SPACING * 8);
 
 static const int SHUFFLE_LENGTH = 12;
 
+static const u64 HASH_SEED = 0x9E3779B97F4A7C15ull;
+
 
 // Lookup tables
 static const Color CUBE_COLOUR_TABLE[CUBE_COLOUR_COUNT + 1] = {
@@ -110,6 +112,13 @@ const char *TURN_TYPE_NAMES[TURN_TYPE_COUNT+1] = {
     "NONE"
 };
 
+// One random key per face, tile position and colour (including the blank
+// colour CUBE_COLOUR_COUNT used when painting partial cubes). The hash of a
+// cube is the XOR of the key for every tile, so changing one tile only needs
+// its old key and new key XORed into the hash.
+static u64 CUBE_ZOBRIST_TABLE[CUBE_COLOUR_COUNT][8][CUBE_COLOUR_COUNT + 1];
+static bool zobrist_initialised = false;
+
 /*
 static const char CUBE_COLOUR_CHARS[CUBE_COLOUR_COUNT] = "GRWBOY";
 static char *CUBE_COLOUR_NAMES[CUBE_COLOUR_COUNT] = {
@@ -142,8 +151,44 @@ enum8(CubeColour) FaceSetTile(u32* face, enum8(CubeColour) colour, u8 position)
     return old_colour;
 }
 
-void CubeInit(Arena* arena, Cube* cube) {
-    cube->faces = ArenaPushArray(arena, CUBE_FACE_COUNT, u32);
+static u64 SplitMix64(u64* state) {
+    u64 z = (*state += 0x9E3779B97F4A7C15ull);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+    return z ^ (z >> 31);
+}
+
+// Called once from main before any cube exists or any thread starts, the
+// keys are read only after that. Fixed seed so hashes are stable between runs
+void CubeZobristInit(void) {
+    assert(!zobrist_initialised);
+    u64 state = HASH_SEED;
+    for (int face = 0; face < CUBE_COLOUR_COUNT; face++) {
+        for (int position = 0; position < FACE_TILE_COUNT; position++) {
+            for (int colour = 0; colour <= CUBE_COLOUR_COUNT; colour++) {
+                CUBE_ZOBRIST_TABLE[face][position][colour] = SplitMix64(&state);
+            }
+        }
+    }
+    zobrist_initialised = true;
+}
+
+enum8(CubeColour) CubeSetTile(
+    Cube* cube, enum8(CubeColour) face_colour, enum8(CubeColour) colour, u8 position
+) {
+    CubeColour old_colour = FaceSetTile(&cube->faces[face_colour], colour, position);
+
+    const u64* keys = CUBE_ZOBRIST_TABLE[face_colour][position];
+    cube->hash ^= keys[old_colour] ^ keys[colour];
+
+    return old_colour;
+}
+
+void CubeInit(Cube* cube) {
+    assert(zobrist_initialised && "CubeZobristInit not called!");
+
+    MemZero(cube->faces, sizeof(cube->faces));
+    cube->hash = CubeHashCompute(cube);
 }
 
 void CubeSetSolved(Cube* cube) {
@@ -152,6 +197,7 @@ void CubeSetSolved(Cube* cube) {
             FaceSetTile(&cube->faces[colour], colour, position);
         }
     }
+    cube->hash = CubeHashCompute(cube);
 }
 
 void CubeSetSolid(Cube* cube, CubeColour solid) {
@@ -160,14 +206,15 @@ void CubeSetSolid(Cube* cube, CubeColour solid) {
             FaceSetTile(&cube->faces[colour], solid, position);
         }
     }
+    cube->hash = CubeHashCompute(cube);
 }
 
 void CubeHandScramble(Cube* cube) {
-    // NOTE: To generate Rubik's cube shuffles according to official standards
-    // this process would be different. Instead pieces would be randomised
-    // then solver would ensure it was not too simple to get the cube back
-    // to the starting position. Then the scramble sequence is the shortest
-    // solve sequence.
+    // NOTE: Official scrambles are made differently, pieces are randomised
+    // then a solver makes sure it isn't too simple to get the cube back to
+    // the starting position. The scramble is the inverse of the solution.
+    // scramble.c does that for the tools, it needs a 35MB table so the game
+    // sticks with this.
     //
     // This scramble is just 25 random moves, ensuring the same face was not
     // turned two times in a row.
@@ -218,7 +265,7 @@ void CubeFaceTurnClockwise(Cube* cube, enum8(CubeColour) face_colour) {
         for (int i = 1; i <= SIDE_TURN_COUNT; i++) {
             u8 wrapped = i % SIDE_TURN_COUNT;
             side_position = position_lookup[wrapped];
-            temp = FaceSetTile(&cube->faces[face_colour], temp, side_position);
+            temp = CubeSetTile(cube, face_colour, temp, side_position);
         }
     }
 
@@ -235,7 +282,7 @@ void CubeFaceTurnClockwise(Cube* cube, enum8(CubeColour) face_colour) {
             u8 wrapped = i % SIDE_TURN_COUNT;
             side_colour = colour_lookup[wrapped];
             side_position = position_lookup[wrapped];
-            temp = FaceSetTile(&cube->faces[side_colour], temp, side_position);
+            temp = CubeSetTile(cube, side_colour, temp, side_position);
         }
     }
 }
@@ -251,7 +298,7 @@ void CubeFaceTurnAntiClockwise(Cube* cube, enum8(CubeColour) face_colour) {
         for (int i = SIDE_TURN_COUNT; i > -1; i--) {
             u8 wrapped = ModWrap(i, SIDE_TURN_COUNT);
             side_position = position_lookup[wrapped];
-            temp = FaceSetTile(&cube->faces[face_colour], temp, side_position);
+            temp = CubeSetTile(cube, face_colour, temp, side_position);
         }
     }
 
@@ -268,7 +315,7 @@ void CubeFaceTurnAntiClockwise(Cube* cube, enum8(CubeColour) face_colour) {
             u8 wrapped = ModWrap(i, SIDE_TURN_COUNT);
             side_colour = colour_lookup[wrapped];
             side_position = position_lookup[wrapped];
-            temp = FaceSetTile(&cube->faces[side_colour], temp, side_position);
+            temp = CubeSetTile(cube, side_colour, temp, side_position);
         }
     }
 }
@@ -283,8 +330,8 @@ void CubeFaceTurnDouble(Cube* cube, enum8(CubeColour) face_colour) {
             u8 b = position_lookup[i + (SIDE_TURN_COUNT / 2)];
 
             CubeColour temp = FaceGetTile(cube->faces[face_colour], a);
-            temp = FaceSetTile(&cube->faces[face_colour], temp, b);
-            FaceSetTile(&cube->faces[face_colour], temp, a);
+            temp = CubeSetTile(cube, face_colour, temp, b);
+            CubeSetTile(cube, face_colour, temp, a);
         }
     }
 
@@ -301,8 +348,8 @@ void CubeFaceTurnDouble(Cube* cube, enum8(CubeColour) face_colour) {
             u8 b = position_lookup[i + half];
 
             CubeColour temp = FaceGetTile(cube->faces[a_colour], a);
-            temp = FaceSetTile(&cube->faces[b_colour], temp, b);
-            FaceSetTile(&cube->faces[a_colour], temp, a);
+            temp = CubeSetTile(cube, b_colour, temp, b);
+            CubeSetTile(cube, a_colour, temp, a);
         }
     }
 }
@@ -345,7 +392,7 @@ void CubeMousePaint(
         CubeColour face_colour = CUBE_FACE_COLOUR_TABLE[face_position.y][face_position.x];
         u8 tile_index = CUBE_FACE_TILE_INDEX_TABLE[tile_position.y][tile_position.x];
         if (face_colour < CUBE_COLOUR_COUNT && tile_index < FACE_TILE_COUNT) {
-            FaceSetTile(&cube->faces[face_colour], colour, tile_index);
+            CubeSetTile(cube, face_colour, colour, tile_index);
         }
     }
 }
@@ -499,6 +546,45 @@ bool CubeValid(Arena* arena_temp, Cube* cube) {
     return true;
 }
 
+u64 CubeHash(Cube* cube) {
+    return cube->hash;
+}
+
+u64 CubeHashCompute(Cube* cube) {
+    u64 hash = 0;
+    for (u8 face = 0; face < CUBE_COLOUR_COUNT; face++) {
+        for (u8 position = 0; position < FACE_TILE_COUNT; position++) {
+            CubeColour colour = FaceGetTile(cube->faces[face], position);
+            hash ^= CUBE_ZOBRIST_TABLE[face][position][colour];
+        }
+    }
+    return hash;
+}
+
+bool CubeHashVerify(Cube* cube, const u8* turns, u32 count) {
+    // Turns from solved, the incrementally updated hash must always match a
+    // full recompute. Then undo every turn and we should be back at the
+    // solved hash.
+    CubeSetSolved(cube);
+    u64 solved_hash = CubeHash(cube);
+
+    for (u32 i = 0; i < count; i++) {
+        CubeTurn(cube, turns[i]);
+        if (CubeHash(cube) != CubeHashCompute(cube)) return false;
+    }
+
+    for (int i = (int) count - 1; i >= 0; i--) {
+        TurnType turn = turns[i];
+        if (turn < TURN_FRONT_PRIME) {
+            turn += TURN_FRONT_PRIME;
+        } else if (turn < TURN_FRONT_DOUBLE) {
+            turn -= TURN_FRONT_PRIME;
+        }
+        CubeTurn(cube, turn);
+    }
+    return CubeHash(cube) == solved_hash;
+}
+
 static void TileRender(Rectangle rec, enum8(CubeColour) colour, bool valid) {
     DrawRectangleRounded(
         rec, TILE_RENDER_ROUNDNESS, TILE_RENDER_SEGMENTS,
@@ -512,7 +598,8 @@ static void TileRender(Rectangle rec, enum8(CubeColour) colour, bool valid) {
 }
 
 static void FaceRender(
-    Cube* cube, enum8(CubeColour) face_colour, int x, int y, int size, bool valid
+    Cube* cube, enum8(CubeColour) face_colour, int x, int y, int size, bool valid,
+    bool pocket
 ) {
     u32 face = cube->faces[face_colour];
     int spacing = size * (1 + TILE_RENDER_SPACING);
@@ -523,7 +610,10 @@ static void FaceRender(
         for (int x = 0; x < 3; x++) {
             u8 tile_index = CUBE_FACE_TILE_INDEX_TABLE[y][x];
 
-            if (tile_index < FACE_TILE_COUNT) {
+            if (pocket && (tile_index % 2 != 0 || tile_index >= FACE_TILE_COUNT)) {
+                // Only corners exist on a 2x2, blank out edges and centre
+                TileRender(tile_rect, CUBE_COLOUR_COUNT, valid);
+            } else if (tile_index < FACE_TILE_COUNT) {
                 TileRender(tile_rect, FaceGetTile(face, tile_index), valid);
             } else {
                 // Centre tile is fixed colour
@@ -535,7 +625,7 @@ static void FaceRender(
     }
 }
 
-void CubeRender(Cube* cube, Rectangle cube_rect, bool valid) {
+void CubeRender(Cube* cube, Rectangle cube_rect, bool valid, bool pocket) {
     int size = MinFloat(
         cube_rect.width / CUBE_RENDER_WIDTH,
         cube_rect.height / CUBE_RENDER_HEIGHT
@@ -554,7 +644,7 @@ void CubeRender(Cube* cube, Rectangle cube_rect, bool valid) {
         for (int x = 0; x < 4; x++) {
             CubeColour face_colour = CUBE_FACE_COLOUR_TABLE[y][x];
             if (face_colour < CUBE_COLOUR_COUNT) {
-                FaceRender(cube, face_colour, position.x, position.y, size, valid);
+                FaceRender(cube, face_colour, position.x, position.y, size, valid, pocket);
             }
             position.x += size * FACE_RENDER_SPACING;
         }
@@ -562,3 +652,23 @@ void CubeRender(Cube* cube, Rectangle cube_rect, bool valid) {
     }
 }
 
+Rectangle CubeRenderSpareRect(Rectangle cube_rect) {
+    // Same layout as CubeRender, the spare corner is where the third row has
+    // no face under R and B
+    int size = MinFloat(
+        cube_rect.width / CUBE_RENDER_WIDTH,
+        cube_rect.height / CUBE_RENDER_HEIGHT
+    );
+    IntVector2 offset = (IntVector2) {
+        (cube_rect.width - CUBE_RENDER_WIDTH * size) / 2,
+        (cube_rect.height - CUBE_RENDER_HEIGHT * size) / 2
+    };
+    float face_size = size * (3 + TILE_RENDER_SPACING * 2);
+
+    return (Rectangle) {
+        cube_rect.x + offset.x + size * (TILE_RENDER_SPACING + FACE_RENDER_SPACING * 2),
+        cube_rect.y + offset.y + size * (TILE_RENDER_SPACING + FACE_RENDER_SPACING * 2),
+        size * FACE_RENDER_SPACING + face_size,
+        face_size
+    };
+}
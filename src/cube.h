@@ -107,14 +107,25 @@ extern const char *TURN_TYPE_NAMES[TURN_TYPE_COUNT + 1];
 //
 
 
+// Faces are stored inline with the Zobrist hash of the sticker state kept
+// next to them, 32 bytes in all. Every tile write that goes through
+// CubeSetTile (which all turns do) XORs the old sticker key out and the new
+// sticker key in, so the hash never needs to be recomputed from scratch
+// inside a search.
+//
+// It's a plain value, copy one with = to try a turn on the copy. Arrays of
+// them are contiguous and there's no pointer to chase to get at a tile.
 typedef struct {
-    u32* faces;
+    u32 faces[CUBE_COLOUR_COUNT];
+    u64 hash;
 } Cube;
 
 
 enum8(CubeColour) FaceGetTile(u32 face, u8 position);
 enum8(CubeColour) FaceSetTile(u32* face, enum8(CubeColour) colour, u8 position);
-void CubeInit(Arena* arena, Cube* cube);
+enum8(CubeColour) CubeSetTile(Cube* cube, enum8(CubeColour) face_colour, enum8(CubeColour) colour, u8 position);
+void CubeZobristInit(void);
+void CubeInit(Cube* cube);
 void CubeSetSolved(Cube* cube);
 void CubeSetSolid(Cube* cube, CubeColour solid);
 void CubeHandScramble(Cube* cube);
@@ -125,7 +136,12 @@ void CubeFaceTurnDouble(Cube* cube, enum8(CubeColour) face_colour);
 Color CubeFaceColour(enum8(CubeColour) colour);
 void CubeMousePaint(Cube* cube, Vector2 mouse_position, CubeColour colour, Rectangle cube_rect);
 bool CubeValid(Arena* arena_temp, Cube* cube);
-void CubeRender(Cube* cube, Rectangle cube_rect, bool valid);
+u64 CubeHash(Cube* cube);
+u64 CubeHashCompute(Cube* cube);
+bool CubeHashVerify(Cube* cube, const u8* turns, u32 count);
+void CubeRender(Cube* cube, Rectangle cube_rect, bool valid, bool pocket);
+// Empty part of the net below R and B, free for overlays
+Rectangle CubeRenderSpareRect(Rectangle cube_rect);
 
 
 #endif  /* CUBE_H */
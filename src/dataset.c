@@ -0,0 +1,494 @@
+// Sorting and deduplicating logged cube states that don't fit in memory.
+//
+// The states file is read a run at a time. Each run is ranked on every
+// thread, radix sorted, has its duplicates folded together and is written out
+// sorted. Then all the runs are merged in one pass with a heap, adding up the
+// counts of equal ranks on the way. Everything on disk is read and written
+// front to back in big blocks, so past the ranking it goes as fast as the
+// disk does.
+//
+// Ranking is most of the CPU time: 48 symmetries each need their corner
+// coordinate, but only the few that tie for the smallest need the (much
+// slower) edge coordinate.
+
+
+#include "dataset.h"
+#include "trace.h"
+#include "twophase.h"
+
+#include <stdio.h>
+
+
+// Records each ranking worker takes at a time
+#define DATASET_RANK_CHUNK 4096
+
+// States written per fwrite when generating
+#define DATASET_WRITE_BLOCK 65536
+
+// A run is never smaller than this many records, however little memory
+#define DATASET_MIN_RUN 4096
+
+// Smallest buffer each run gets while merging
+#define DATASET_MIN_MERGE_BUFFER 1024
+
+// 8 bit digits, five for the 40 bits of edges and four for the 27 of corners
+#define DATASET_RADIX_BITS 8
+#define DATASET_RADIX_SIZE (1 << DATASET_RADIX_BITS)
+#define DATASET_RADIX_DIGITS 9
+#define DATASET_EDGE_DIGITS 5
+
+#define DATASET_RUN_PATH_SIZE 1024
+
+
+typedef struct {
+    DatasetState* states;
+    DatasetRank* ranks;
+    u64 count;
+    u32 next_chunk;
+    u64 invalid;
+} DatasetRankJob;
+
+typedef struct {
+    DatasetRank* from;
+    DatasetRank* to;
+    u64 count;
+    u8 digit;
+    bool scatter;
+    u64 counts[MAX_THREADS][DATASET_RADIX_SIZE];
+} DatasetRadixJob;
+
+// One run file being merged, buffer holds records [position, filled)
+typedef struct {
+    FILE* file;
+    DatasetRank* buffer;
+    u64 capacity;
+    u64 filled;
+    u64 position;
+    u64 remaining;
+} DatasetRunReader;
+
+
+// RANKS //////////////////////////////////////////////////////////////////////
+static bool DatasetRankLess(DatasetRank* a, DatasetRank* b) {
+    if (a->corners != b->corners) return a->corners < b->corners;
+    return a->edges < b->edges;
+}
+
+static bool DatasetRankEqual(DatasetRank* a, DatasetRank* b) {
+    return a->corners == b->corners && a->edges == b->edges;
+}
+
+bool DatasetCanonicalRank(DatasetState* state, DatasetRank* rank) {
+    Cube cube;
+    MemCopy(cube.faces, state->faces, sizeof(cube.faces));
+    TwoPhaseCubie cubie;
+    if (!TwoPhaseCubieFromCube(&cube, &cubie)) return false;
+
+    TwoPhaseCubie conjugates[TWOPHASE_FULL_SYM_COUNT];
+    u32 corners[TWOPHASE_FULL_SYM_COUNT];
+    u32 best_corners = UINT32_MAX;
+    for (int s = 0; s < TWOPHASE_FULL_SYM_COUNT; s++) {
+        TwoPhaseCubieConjugate(&cubie, s, &conjugates[s]);
+        corners[s] = TwoPhaseCornerCoord(&conjugates[s]);
+        best_corners = MinU32(best_corners, corners[s]);
+    }
+
+    u64 best_edges = UINT64_MAX;
+    for (int s = 0; s < TWOPHASE_FULL_SYM_COUNT; s++) {
+        if (corners[s] != best_corners) continue;
+        best_edges = MinU64(best_edges, TwoPhaseEdgeCoord(&conjugates[s]));
+    }
+
+    rank->corners = best_corners;
+    rank->edges = best_edges;
+    rank->count = 1;
+    return true;
+}
+
+// Invalid states get a count of 0 and are dropped when the run is folded
+static void DatasetRankWorker(void* data, u32 thread_index, u32 thread_count) {
+    DatasetRankJob* job = (DatasetRankJob*) data;
+    u64 invalid = 0;
+
+    for (;;) {
+        u64 start = (u64) __atomic_fetch_add(&job->next_chunk, 1, __ATOMIC_RELAXED) * DATASET_RANK_CHUNK;
+        if (start >= job->count) break;
+        u64 end = MinU64(start + DATASET_RANK_CHUNK, job->count);
+
+        TraceBegin("dataset rank chunk");
+        for (u64 i = start; i < end; i++) {
+            if (!DatasetCanonicalRank(&job->states[i], &job->ranks[i])) {
+                job->ranks[i] = (DatasetRank) { 0 };
+                invalid++;
+            }
+        }
+        TraceEnd("dataset rank chunk");
+    }
+
+    __atomic_fetch_add(&job->invalid, invalid, __ATOMIC_RELAXED);
+}
+
+// RADIX SORT /////////////////////////////////////////////////////////////////
+static u32 DatasetDigit(DatasetRank* rank, u8 digit) {
+    if (digit < DATASET_EDGE_DIGITS) {
+        return (rank->edges >> (digit * DATASET_RADIX_BITS)) & (DATASET_RADIX_SIZE - 1);
+    }
+    return (rank->corners >> ((digit - DATASET_EDGE_DIGITS) * DATASET_RADIX_BITS)) & (DATASET_RADIX_SIZE - 1);
+}
+
+// Each thread owns one contiguous slice of from. First pass counts digits in
+// its slice, second scatters its slice to the offsets worked out in between,
+// which keeps equal digits in their original order.
+static void DatasetRadixWorker(void* data, u32 thread_index, u32 thread_count) {
+    DatasetRadixJob* job = (DatasetRadixJob*) data;
+    u64 start = job->count * thread_index / thread_count;
+    u64 end = job->count * (thread_index + 1) / thread_count;
+    u64* counts = job->counts[thread_index];
+
+    if (!job->scatter) {
+        MemZero(counts, DATASET_RADIX_SIZE * sizeof(u64));
+        for (u64 i = start; i < end; i++) counts[DatasetDigit(&job->from[i], job->digit)]++;
+        return;
+    }
+
+    for (u64 i = start; i < end; i++) {
+        u32 digit = DatasetDigit(&job->from[i], job->digit);
+        job->to[counts[digit]++] = job->from[i];
+    }
+}
+
+void DatasetRadixSort(DatasetRank* ranks, DatasetRank* scratch, u64 count, u32 thread_count) {
+    thread_count = MaxU32(MinU32(thread_count, MAX_THREADS), 1);
+
+    // ~128KB of counts, too much for some stacks, so one sort at a time
+    static DatasetRadixJob job;
+    job.from = ranks;
+    job.to = scratch;
+    job.count = count;
+
+    for (u8 digit = 0; digit < DATASET_RADIX_DIGITS; digit++) {
+        job.digit = digit;
+        job.scatter = false;
+        ParallelRun(thread_count, DatasetRadixWorker, &job);
+
+        // Offsets go digit by digit, thread by thread within a digit. A digit
+        // that's the same everywhere would move nothing so it's skipped.
+        bool all_same = false;
+        u64 offset = 0;
+        for (u32 d = 0; d < DATASET_RADIX_SIZE; d++) {
+            u64 digit_count = 0;
+            for (u32 t = 0; t < thread_count; t++) {
+                u64 c = job.counts[t][d];
+                job.counts[t][d] = offset;
+                offset += c;
+                digit_count += c;
+            }
+            if (digit_count == count) all_same = true;
+        }
+        if (all_same) continue;
+
+        job.scatter = true;
+        ParallelRun(thread_count, DatasetRadixWorker, &job);
+
+        DatasetRank* swap = job.from;
+        job.from = job.to;
+        job.to = swap;
+    }
+
+    if (job.from != ranks) MemCopy(ranks, job.from, count * sizeof(DatasetRank));
+}
+
+// Equal neighbours into one with their counts added, dropping count 0
+static u64 DatasetFold(DatasetRank* ranks, u64 count) {
+    u64 out = 0;
+    for (u64 i = 0; i < count; i++) {
+        if (ranks[i].count == 0) continue;
+        if (out > 0 && DatasetRankEqual(&ranks[out - 1], &ranks[i])) {
+            ranks[out - 1].count += ranks[i].count;
+        } else {
+            ranks[out++] = ranks[i];
+        }
+    }
+    return out;
+}
+
+// FILES //////////////////////////////////////////////////////////////////////
+static bool DatasetReadHeader(FILE* file, const char* path, u32 magic, u64* count) {
+    DatasetHeader header;
+    if (fread(&header, sizeof(header), 1, file) != 1 || header.magic != magic || header.version != DATASET_VERSION) {
+        printf("%s: not a dataset file of the right kind\n", path);
+        return false;
+    }
+    *count = header.count;
+    return true;
+}
+
+static bool DatasetWriteHeader(FILE* file, u32 magic, u64 count) {
+    DatasetHeader header = { magic, DATASET_VERSION, count };
+    return fwrite(&header, sizeof(header), 1, file) == 1;
+}
+
+static void DatasetRunPath(const char* out_path, u32 run, char* path) {
+    snprintf(path, DATASET_RUN_PATH_SIZE, "%s.run%u", out_path, run);
+}
+
+// Draws another state with HashU64, never the Zobrist RNG, so a seed always
+// gives the same file
+static u64 DatasetRandom(u64* state) {
+    *state = HashU64(*state + 0x9E3779B97F4A7C15ull);
+    return *state;
+}
+
+bool DatasetGenerate(Arena* arena, const char* path, u64 count, u64 distinct, u64 seed) {
+    TwoPhaseCubiesInit();
+    assert(distinct > 0);
+
+    FILE* file = fopen(path, "wb");
+    if (file == NULL) {
+        printf("Couldn't open %s for the dataset\n", path);
+        return false;
+    }
+
+    u64 arena_start = arena->used;
+    DatasetState* block = ArenaPushArray(arena, DATASET_WRITE_BLOCK, DatasetState);
+    bool written = DatasetWriteHeader(file, DATASET_STATES_MAGIC, count);
+
+    u64 random = seed;
+    for (u64 start = 0; start < count && written; start += DATASET_WRITE_BLOCK) {
+        u64 block_count = MinU64(DATASET_WRITE_BLOCK, count - start);
+        for (u64 i = 0; i < block_count; i++) {
+            // Each distinct state comes from its own stream so it's the same
+            // whenever it's picked
+            u64 pick = HashU64(seed ^ (DatasetRandom(&random) % distinct));
+            TwoPhaseCubie cubie;
+            TwoPhaseCubieFromCoords(
+                &cubie,
+                DatasetRandom(&pick) % TWOPHASE_CPERM_COUNT, DatasetRandom(&pick) % TWOPHASE_EDGE_PERM_COUNT,
+                DatasetRandom(&pick) % TWOPHASE_TWIST_COUNT, DatasetRandom(&pick) % TWOPHASE_FLIP_COUNT
+            );
+
+            TwoPhaseCubie held;
+            TwoPhaseCubieConjugate(&cubie, DatasetRandom(&random) % TWOPHASE_FULL_SYM_COUNT, &held);
+            Cube cube;
+            TwoPhaseCubieToCube(&held, &cube);
+            MemCopy(block[i].faces, cube.faces, sizeof(block[i].faces));
+        }
+        written = fwrite(block, sizeof(DatasetState), block_count, file) == block_count;
+    }
+
+    fclose(file);
+    arena->used = arena_start;
+
+    if (!written) printf("Couldn't write %s\n", path);
+    return written;
+}
+
+// MERGE //////////////////////////////////////////////////////////////////////
+static bool DatasetReaderFill(DatasetRunReader* reader, DatasetStats* stats) {
+    u64 want = MinU64(reader->capacity, reader->remaining);
+    reader->filled = fread(reader->buffer, sizeof(DatasetRank), want, reader->file);
+    reader->position = 0;
+    reader->remaining -= reader->filled;
+    stats->bytes_read += reader->filled * sizeof(DatasetRank);
+    return reader->filled > 0;
+}
+
+static DatasetRank* DatasetReaderPeek(DatasetRunReader* reader) {
+    return &reader->buffer[reader->position];
+}
+
+// Heap of reader indices ordered by each reader's next rank
+static bool DatasetHeapLess(DatasetRunReader* readers, u32 a, u32 b) {
+    return DatasetRankLess(DatasetReaderPeek(&readers[a]), DatasetReaderPeek(&readers[b]));
+}
+
+static void DatasetHeapDown(DatasetRunReader* readers, u32* heap, u32 size, u32 i) {
+    for (;;) {
+        u32 smallest = i;
+        u32 left = i * 2 + 1;
+        u32 right = left + 1;
+        if (left < size && DatasetHeapLess(readers, heap[left], heap[smallest])) smallest = left;
+        if (right < size && DatasetHeapLess(readers, heap[right], heap[smallest])) smallest = right;
+        if (smallest == i) return;
+
+        u32 swap = heap[i];
+        heap[i] = heap[smallest];
+        heap[smallest] = swap;
+        i = smallest;
+    }
+}
+
+static bool DatasetMerge(
+    Arena* arena, const char* out_path, u32 run_count, u64 memory, DatasetStats* stats
+) {
+    // Half the memory for the runs, the other half for the output
+    u64 buffer_records = MaxU64(memory / 2 / sizeof(DatasetRank) / MaxU32(run_count, 1), DATASET_MIN_MERGE_BUFFER);
+    u64 out_capacity = MaxU64(memory / 2 / sizeof(DatasetRank), DATASET_MIN_MERGE_BUFFER);
+
+    DatasetRunReader* readers = ArenaPushArray(arena, run_count, DatasetRunReader);
+    u32* heap = ArenaPushArray(arena, run_count, u32);
+    DatasetRank* out = (DatasetRank*) _ArenaPush(arena, out_capacity * sizeof(DatasetRank), alignof(DatasetRank), false);
+
+    FILE* file = fopen(out_path, "wb");
+    if (file == NULL) {
+        printf("Couldn't open %s for the ranks\n", out_path);
+        return false;
+    }
+    bool ok = DatasetWriteHeader(file, DATASET_RANKS_MAGIC, 0);
+
+    u32 heap_size = 0;
+    for (u32 r = 0; r < run_count && ok; r++) {
+        char path[DATASET_RUN_PATH_SIZE];
+        DatasetRunPath(out_path, r, path);
+
+        DatasetRunReader* reader = &readers[r];
+        reader->file = fopen(path, "rb");
+        reader->buffer = (DatasetRank*) _ArenaPush(
+            arena, buffer_records * sizeof(DatasetRank), alignof(DatasetRank), false
+        );
+        reader->capacity = buffer_records;
+        ok = reader->file != NULL && DatasetReadHeader(reader->file, path, DATASET_RANKS_MAGIC, &reader->remaining);
+        if (ok && DatasetReaderFill(reader, stats)) heap[heap_size++] = r;
+    }
+    for (u32 i = heap_size; i-- > 0;) DatasetHeapDown(readers, heap, heap_size, i);
+
+    u64 out_count = 0;
+    u64 unique = 0;
+    while (heap_size > 0 && ok) {
+        DatasetRunReader* reader = &readers[heap[0]];
+        DatasetRank* next = DatasetReaderPeek(reader);
+
+        if (out_count > 0 && DatasetRankEqual(&out[out_count - 1], next)) {
+            out[out_count - 1].count += next->count;
+        } else {
+            if (out_count == out_capacity) {
+                // All but the last, which later runs might still add to
+                ok = fwrite(out, sizeof(DatasetRank), out_count - 1, file) == out_count - 1;
+                stats->bytes_written += (out_count - 1) * sizeof(DatasetRank);
+                out[0] = out[out_count - 1];
+                out_count = 1;
+            }
+            out[out_count++] = *next;
+            unique++;
+        }
+
+        reader->position++;
+        if (reader->position == reader->filled && !DatasetReaderFill(reader, stats)) {
+            heap[0] = heap[--heap_size];
+        }
+        DatasetHeapDown(readers, heap, heap_size, 0);
+    }
+
+    ok = ok && fwrite(out, sizeof(DatasetRank), out_count, file) == out_count;
+    stats->bytes_written += out_count * sizeof(DatasetRank);
+    stats->unique = unique;
+
+    for (u32 r = 0; r < run_count; r++) {
+        if (readers[r].file != NULL) fclose(readers[r].file);
+    }
+
+    ok = ok && fseek(file, 0, SEEK_SET) == 0 && DatasetWriteHeader(file, DATASET_RANKS_MAGIC, unique);
+    fclose(file);
+    return ok;
+}
+
+// SORT ///////////////////////////////////////////////////////////////////////
+bool DatasetSortDedupe(
+    Arena* arena, const char* in_path, const char* out_path,
+    u64 memory, u32 thread_count, DatasetStats* stats
+) {
+    TwoPhaseCubiesInit();
+    MemZero(stats, sizeof(DatasetStats));
+
+    FILE* in = fopen(in_path, "rb");
+    if (in == NULL) {
+        printf("%s: could not open\n", in_path);
+        return false;
+    }
+
+    u64 remaining;
+    if (!DatasetReadHeader(in, in_path, DATASET_STATES_MAGIC, &remaining)) {
+        fclose(in);
+        return false;
+    }
+    stats->bytes_read += sizeof(DatasetHeader);
+
+    // Each record in a run needs its state, its rank and radix scratch
+    u64 arena_start = arena->used;
+    u64 per_record = sizeof(DatasetState) + 2 * sizeof(DatasetRank);
+    u64 run_capacity = MaxU64(memory / per_record, DATASET_MIN_RUN);
+    DatasetState* states = (DatasetState*) _ArenaPush(arena, run_capacity * sizeof(DatasetState), alignof(DatasetState), false);
+    DatasetRank* ranks = (DatasetRank*) _ArenaPush(arena, run_capacity * sizeof(DatasetRank), alignof(DatasetRank), false);
+    DatasetRank* scratch = (DatasetRank*) _ArenaPush(arena, run_capacity * sizeof(DatasetRank), alignof(DatasetRank), false);
+
+    bool ok = true;
+    while (remaining > 0 && ok) {
+        u64 want = MinU64(run_capacity, remaining);
+        u64 count = fread(states, sizeof(DatasetState), want, in);
+        if (count != want) {
+            printf("%s: ends early\n", in_path);
+            ok = false;
+            break;
+        }
+        remaining -= count;
+        stats->states += count;
+        stats->bytes_read += count * sizeof(DatasetState);
+
+        double start = TimeSeconds();
+        DatasetRankJob job = {
+            .states = states,
+            .ranks = ranks,
+            .count = count,
+            .next_chunk = 0,
+            .invalid = 0
+        };
+        ParallelRun(thread_count, DatasetRankWorker, &job);
+        stats->invalid += job.invalid;
+        stats->rank_seconds += TimeSeconds() - start;
+
+        start = TimeSeconds();
+        TraceBegin("dataset radix sort");
+        DatasetRadixSort(ranks, scratch, count, thread_count);
+        TraceEnd("dataset radix sort");
+        u64 folded = DatasetFold(ranks, count);
+        stats->sort_seconds += TimeSeconds() - start;
+
+        char path[DATASET_RUN_PATH_SIZE];
+        DatasetRunPath(out_path, stats->runs, path);
+        FILE* run = fopen(path, "wb");
+        if (run == NULL) {
+            printf("Couldn't open %s for a run\n", path);
+            ok = false;
+            break;
+        }
+        ok = DatasetWriteHeader(run, DATASET_RANKS_MAGIC, folded) &&
+            fwrite(ranks, sizeof(DatasetRank), folded, run) == folded;
+        fclose(run);
+        stats->bytes_written += sizeof(DatasetHeader) + folded * sizeof(DatasetRank);
+        stats->runs++;
+
+        printf(
+            "Run %u: %llu states, %llu after folding\n", stats->runs - 1,
+            (unsigned long long) count, (unsigned long long) folded
+        );
+    }
+    fclose(in);
+
+    // The run buffers aren't needed any more, the merge gets the memory
+    arena->used = arena_start;
+
+    double start = TimeSeconds();
+    TraceBegin("dataset merge");
+    ok = ok && DatasetMerge(arena, out_path, stats->runs, memory, stats);
+    TraceEnd("dataset merge");
+    stats->merge_seconds = TimeSeconds() - start;
+    arena->used = arena_start;
+
+    for (u32 r = 0; r < stats->runs; r++) {
+        char path[DATASET_RUN_PATH_SIZE];
+        DatasetRunPath(out_path, r, path);
+        remove(path);
+    }
+
+    return ok;
+}
@@ -0,0 +1,73 @@
+#ifndef DATASET_H
+#define DATASET_H
+
+
+#include "core.h"
+#include "cube.h"
+
+
+// A states file is a DatasetHeader then count DatasetStates. Sorting one
+// gives a ranks file, a DatasetHeader then count DatasetRanks in increasing
+// order with no two the same.
+#define DATASET_STATES_MAGIC 0x54415453u
+#define DATASET_RANKS_MAGIC 0x4B4E4152u
+#define DATASET_VERSION 1
+
+// How much the sort holds in memory at once unless told otherwise
+#define DATASET_DEFAULT_MEMORY_MB 256
+
+
+typedef struct {
+    u32 magic;
+    u32 version;
+    u64 count;
+} DatasetHeader;
+
+// One logged 3x3, the faces exactly as Cube holds them
+typedef struct {
+    u32 faces[CUBE_COLOUR_COUNT];
+} DatasetState;
+
+// Corner and edge coordinates (see TwoPhaseCornerCoord) of whichever of the
+// 48 ways of holding or mirroring the cube gives the smallest, corners first.
+// Every state that's the same up to symmetry has the same rank. 67 bits in
+// all, stored as two numbers with the times it was seen.
+typedef struct {
+    u64 edges;
+    u32 corners;
+    u32 count;
+} DatasetRank;
+
+typedef struct {
+    u64 states;
+    u64 invalid;
+    u64 unique;
+    u32 runs;
+    u64 bytes_read;
+    u64 bytes_written;
+    double rank_seconds;
+    double sort_seconds;
+    double merge_seconds;
+} DatasetStats;
+
+
+// Both need TwoPhaseCubiesInit first. Returns false for faces that aren't a
+// solvable 3x3.
+bool DatasetCanonicalRank(DatasetState* state, DatasetRank* rank);
+
+// Sorts by rank, stable, with scratch the same size as ranks
+void DatasetRadixSort(DatasetRank* ranks, DatasetRank* scratch, u64 count, u32 thread_count);
+
+// count states drawn from distinct random ones, each held a random way
+bool DatasetGenerate(Arena* arena, const char* path, u64 count, u64 distinct, u64 seed);
+
+// Ranks and sorts memory bytes of states at a time, writes each as a run
+// file next to out_path, then merges the runs into out_path adding up the
+// counts of equal ranks. The run files are removed after.
+bool DatasetSortDedupe(
+    Arena* arena, const char* in_path, const char* out_path,
+    u64 memory, u32 thread_count, DatasetStats* stats
+);
+
+
+#endif  /* DATASET_H */
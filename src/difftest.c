@@ -0,0 +1,358 @@
+// Differential testing of every way the repo has of turning a cube. A random
+// turn sequence is fed to the original CubeFaceTurn* functions (the reference)
+// and to every other engine in lockstep, and after every turn each engine's
+// state is checked against the reference. Faster turn code only has to be
+// added to DIFF_ENGINES to be tested against everything else.
+//
+// When a sequence fails it is shrunk before being printed: cut off after the
+// first failing turn, then keep trying to remove chunks of turns (halving the
+// chunk size each pass) while the sequence still fails. What's left is
+// usually only a couple of turns long.
+//
+// Sequences are split across threads in chunks. Each sequence seeds its own
+// random state from its index so a run is the same on any number of threads.
+
+
+#include "difftest.h"
+#include "bigcube.h"
+#include "cpu.h"
+#include "cube.h"
+#include "moves.h"
+#include "pocket.h"
+#include "solve.h"
+
+
+// Sequences handed to a thread at a time
+#define DIFF_CHUNK 1024
+
+// Enough cubes for full vectors and a scalar tail at every CPU level
+#define DIFF_BATCH_COUNT (CPU_MAX_LANES + 3)
+
+
+typedef struct {
+    Cube reference;
+    Cube turn;
+
+    BigCube big;
+    u32 batch[CUBE_COLOUR_COUNT * DIFF_BATCH_COUNT];
+    u32 pocket;
+    u32 cross;
+
+    PocketTable* pocket_table;
+} DiffState;
+
+typedef struct {
+    const char* name;
+    void (*reset)(DiffState* state);
+    void (*turn)(DiffState* state, TurnType turn);
+    bool (*check)(DiffState* state);
+} DiffEngine;
+
+typedef struct {
+    PocketTable* table;
+    u64 sequences;
+    u32 length;
+    u64 next_chunk;
+    u64 turns_checked;
+
+    // First failure found, written once by whichever thread finds it
+    u32 failed;
+    u32 failed_length;
+    enum8(TurnType) failed_turns[DIFF_MAX_LENGTH];
+} DiffJob;
+
+
+static bool DiffFacesEqual(Cube* a, Cube* b) {
+    for (int i = 0; i < CUBE_COLOUR_COUNT; i++) {
+        if (a->faces[i] != b->faces[i]) return false;
+    }
+    return true;
+}
+
+// CubeTurn, the dispatch used by the solver
+static void DiffTurnReset(DiffState* state) {
+    state->turn = state->reference;
+}
+
+static void DiffTurnTurn(DiffState* state, TurnType turn) {
+    CubeTurn(&state->turn, turn);
+}
+
+static bool DiffTurnCheck(DiffState* state) {
+    return DiffFacesEqual(&state->turn, &state->reference)
+        && state->turn.hash == state->reference.hash;
+}
+
+// BigCube at size 3, its own layout and generated turn tables
+static void DiffBigReset(DiffState* state) {
+    BigCubeSetSolved(&state->big, 3);
+    BigCubeFromCube(&state->big, &state->reference);
+}
+
+static void DiffBigTurn(DiffState* state, TurnType turn) {
+    BigCubeTurn(&state->big, turn);
+}
+
+static bool DiffBigCheck(DiffState* state) {
+    Cube cube;
+    CubeInit(&cube);
+    BigCubeToCube(&state->big, &cube);
+    return DiffFacesEqual(&cube, &state->reference);
+}
+
+// CubeTurnBatch at the dispatched CPU level, every lane a copy of the cube
+static void DiffBatchReset(DiffState* state) {
+    for (int f = 0; f < CUBE_COLOUR_COUNT; f++) {
+        for (int i = 0; i < DIFF_BATCH_COUNT; i++) {
+            state->batch[f * DIFF_BATCH_COUNT + i] = state->reference.faces[f];
+        }
+    }
+}
+
+static void DiffBatchTurn(DiffState* state, TurnType turn) {
+    CubeTurnBatch(state->batch, DIFF_BATCH_COUNT, turn);
+}
+
+static bool DiffBatchCheck(DiffState* state) {
+    for (int f = 0; f < CUBE_COLOUR_COUNT; f++) {
+        for (int i = 0; i < DIFF_BATCH_COUNT; i++) {
+            if (state->batch[f * DIFF_BATCH_COUNT + i] != state->reference.faces[f]) return false;
+        }
+    }
+
+    // Any real cube has 8 of every colour
+    u8 ok[DIFF_BATCH_COUNT];
+    return CubeColourCheckBatch(state->batch, DIFF_BATCH_COUNT, ok) == DIFF_BATCH_COUNT;
+}
+
+// Pocket coordinate. Only F, R and U have pocket move tables, any other turn
+// moves the held DBL corner so the coordinate is read from the reference
+// instead, which still tests PocketCoordFromCube on the way.
+static void DiffPocketReset(DiffState* state) {
+    state->pocket = PocketCoordFromCube(&state->reference);
+}
+
+static void DiffPocketTurn(DiffState* state, TurnType turn) {
+    u8 face = turn % CUBE_COLOUR_COUNT;
+    if (face <= CUBE_WHITE) {
+        state->pocket = PocketTurn(state->pocket_table, state->pocket, (turn / 6) * 3 + face);
+    } else {
+        state->pocket = POCKET_COORD_INVALID;
+    }
+}
+
+static bool DiffPocketCheck(DiffState* state) {
+    u32 expected = PocketCoordFromCube(&state->reference);
+    if (state->pocket == POCKET_COORD_INVALID) state->pocket = expected;
+    return state->pocket == expected;
+}
+
+// Cross coordinate used by the cross BFS
+static void DiffCrossReset(DiffState* state) {
+    state->cross = ConvertToCrossCube(&state->reference);
+}
+
+static void DiffCrossTurn(DiffState* state, TurnType turn) {
+    state->cross = TurnCrossCube(state->cross, turn);
+}
+
+static bool DiffCrossCheck(DiffState* state) {
+    return state->cross == ConvertToCrossCube(&state->reference);
+}
+
+// Incremental Zobrist hash on the reference itself
+static void DiffNoReset(DiffState* state) {
+    (void) state;
+}
+
+static void DiffNoTurn(DiffState* state, TurnType turn) {
+    (void) state;
+    (void) turn;
+}
+
+static bool DiffHashCheck(DiffState* state) {
+    return state->reference.hash == CubeHashCompute(&state->reference);
+}
+
+
+static const DiffEngine DIFF_ENGINES[] = {
+    { "CubeTurn", DiffTurnReset, DiffTurnTurn, DiffTurnCheck },
+    { "BigCube 3x3", DiffBigReset, DiffBigTurn, DiffBigCheck },
+    { "batch turn", DiffBatchReset, DiffBatchTurn, DiffBatchCheck },
+    { "pocket coordinate", DiffPocketReset, DiffPocketTurn, DiffPocketCheck },
+    { "cross coordinate", DiffCrossReset, DiffCrossTurn, DiffCrossCheck },
+    { "zobrist hash", DiffNoReset, DiffNoTurn, DiffHashCheck },
+};
+static const int DIFF_ENGINE_COUNT = sizeof(DIFF_ENGINES) / sizeof(DIFF_ENGINES[0]);
+
+
+static void DiffReferenceTurn(Cube* cube, TurnType turn) {
+    u8 face = turn % CUBE_COLOUR_COUNT;
+    if (turn < TURN_FRONT_PRIME) {
+        CubeFaceTurnClockwise(cube, face);
+    } else if (turn < TURN_FRONT_DOUBLE) {
+        CubeFaceTurnAntiClockwise(cube, face);
+    } else {
+        CubeFaceTurnDouble(cube, face);
+    }
+}
+
+static void DiffStateInit(DiffState* state, PocketTable* table) {
+    CubeInit(&state->reference);
+    CubeInit(&state->turn);
+    state->pocket_table = table;
+}
+
+// Replays turns from solved. Returns the index of the first turn after which
+// an engine disagrees (and which engine), or -1 if they all agree.
+static int DiffReplay(DiffState* state, const u8* turns, u32 length, int* engine) {
+    CubeSetSolved(&state->reference);
+    for (int e = 0; e < DIFF_ENGINE_COUNT; e++) {
+        DIFF_ENGINES[e].reset(state);
+    }
+
+    for (u32 i = 0; i < length; i++) {
+        DiffReferenceTurn(&state->reference, turns[i]);
+        for (int e = 0; e < DIFF_ENGINE_COUNT; e++) {
+            DIFF_ENGINES[e].turn(state, turns[i]);
+            if (!DIFF_ENGINES[e].check(state)) {
+                *engine = e;
+                return i;
+            }
+        }
+    }
+    return -1;
+}
+
+// xorshift64*
+static u64 DiffRandom(u64* state) {
+    u64 x = *state;
+    x ^= x >> 12;
+    x ^= x << 25;
+    x ^= x >> 27;
+    *state = x;
+    return x * 0x2545F4914F6CDD1Dull;
+}
+
+static void DiffWorker(void* data, u32 thread_index, u32 thread_count) {
+    (void) thread_index;
+    (void) thread_count;
+    DiffJob* job = (DiffJob*) data;
+
+    DiffState state;
+    DiffStateInit(&state, job->table);
+
+    u8 turns[DIFF_MAX_LENGTH];
+    u64 checked = 0;
+
+    for (;;) {
+        u64 start = __atomic_fetch_add(&job->next_chunk, 1, __ATOMIC_RELAXED) * DIFF_CHUNK;
+        if (start >= job->sequences) break;
+        if (__atomic_load_n(&job->failed, __ATOMIC_RELAXED)) break;
+        u64 end = MinU64(start + DIFF_CHUNK, job->sequences);
+
+        for (u64 s = start; s < end; s++) {
+            u64 random = (s + 1) * 0x9E3779B97F4A7C15ull;
+            for (u32 i = 0; i < job->length; i++) {
+                turns[i] = DiffRandom(&random) % TURN_TYPE_COUNT;
+            }
+
+            int engine;
+            int failed_at = DiffReplay(&state, turns, job->length, &engine);
+            checked += job->length;
+            if (failed_at < 0) continue;
+
+            // Only the first thread to fail gets to record its sequence
+            u32 expected = 0;
+            if (__atomic_compare_exchange_n(&job->failed, &expected, 1, false, __ATOMIC_ACQ_REL, __ATOMIC_RELAXED)) {
+                MemCopy(job->failed_turns, turns, job->length);
+                job->failed_length = job->length;
+            }
+            break;
+        }
+    }
+
+    __atomic_fetch_add(&job->turns_checked, checked, __ATOMIC_RELAXED);
+}
+
+// Removes chunks of turns while the sequence keeps failing, returns new length
+static u32 DiffShrink(DiffState* state, u8* turns, u32 length) {
+    int engine;
+    int failed_at = DiffReplay(state, turns, length, &engine);
+    assert(failed_at >= 0);
+    length = failed_at + 1;
+
+    u8 candidate[DIFF_MAX_LENGTH];
+    for (u32 chunk = length / 2; chunk > 0; chunk /= 2) {
+        u32 start = 0;
+        while (start < length && length > 1) {
+            u32 count = MinU32(chunk, length - start);
+
+            // Copy everything except [start, start + count)
+            u32 candidate_length = 0;
+            for (u32 i = 0; i < length; i++) {
+                if (i < start || i >= start + count) candidate[candidate_length++] = turns[i];
+            }
+
+            failed_at = candidate_length > 0 ? DiffReplay(state, candidate, candidate_length, &engine) : -1;
+            if (failed_at >= 0) {
+                length = failed_at + 1;
+                MemCopy(turns, candidate, length);
+            } else {
+                start += count;
+            }
+        }
+    }
+
+    return length;
+}
+
+bool DiffTestRun(Arena* arena, u64 sequences, u32 length, u32 thread_count) {
+    assert(length > 0 && length <= DIFF_MAX_LENGTH);
+
+    // Shared tables are built up front so workers only ever read them
+    PocketTable* table = ArenaPushStruct(arena, PocketTable);
+    PocketTableInit(arena, table, thread_count);
+    BigCube big;
+    BigCubeSetSolved(&big, 3);
+
+    printf("----- DIFF TEST -----\n");
+    printf("Engines:");
+    for (int e = 0; e < DIFF_ENGINE_COUNT; e++) {
+        printf(" %s%s", DIFF_ENGINES[e].name, e + 1 < DIFF_ENGINE_COUNT ? "," : "\n");
+    }
+
+    DiffJob* job = ArenaPushStruct(arena, DiffJob);
+    job->table = table;
+    job->sequences = sequences;
+    job->length = length;
+
+    double start = TimeSeconds();
+    ParallelRun(thread_count, DiffWorker, job);
+    double elapsed = TimeSeconds() - start;
+
+    printf("Threads: %u\n", thread_count);
+    printf(
+        "Checked: %llu turns in %f seconds (%.0f sequences/minute)\n",
+        (unsigned long long) job->turns_checked, elapsed,
+        job->turns_checked / (double) length / elapsed * 60.0
+    );
+
+    if (!job->failed) {
+        printf("All engines agree\n\n");
+        return true;
+    }
+
+    DiffState state;
+    DiffStateInit(&state, table);
+    u32 shrunk = DiffShrink(&state, job->failed_turns, job->failed_length);
+
+    int engine;
+    DiffReplay(&state, job->failed_turns, shrunk, &engine);
+
+    char text[MoveBufferFormatSize(DIFF_MAX_LENGTH)];
+    MoveFormat(job->failed_turns, shrunk, text);
+    printf("FAILED: %s disagrees with the reference\n", DIFF_ENGINES[engine].name);
+    printf("Shrunk from %u to %u turns: %s\n\n", job->failed_length, shrunk, text);
+    return false;
+}
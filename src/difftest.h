@@ -0,0 +1,15 @@
+#ifndef DIFFTEST_H
+#define DIFFTEST_H
+
+
+#include "core.h"
+
+
+// Longest random sequence a run can ask for
+#define DIFF_MAX_LENGTH 256
+
+
+bool DiffTestRun(Arena* arena, u64 sequences, u32 length, u32 thread_count);
+
+
+#endif  /* DIFFTEST_H */
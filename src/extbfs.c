@@ -0,0 +1,682 @@
+// External memory BFS, for state spaces with more states than there is RAM.
+//
+// Layers live on disk as sorted files of ranks. To make layer d + 1:
+//
+//   1. Read layer d a block at a time, write every neighbour of every state
+//      in the block to a buffer, sort it, drop repeats and spill it as a run.
+//   2. Merge all the runs, and at the same time walk layers d and d - 1 and
+//      drop anything that's in them. Turns can always be undone, so any
+//      neighbour that isn't new is in one of those two.
+//
+// Everything is read and written front to back, and memory only has to hold
+// one block's worth of neighbours. A checkpoint is written after each layer
+// file is complete, so an interrupted run picks up at the layer it was on.
+
+
+#include "extbfs.h"
+#include "trace.h"
+#include "twophase.h"
+
+#include <stdio.h>
+
+
+#define EXTBFS_LAYER_MAGIC 0x5259414Cu
+#define EXTBFS_CHECKPOINT_MAGIC 0x544B4843u
+#define EXTBFS_PDB_MAGIC 0x20424450u
+#define EXTBFS_VERSION 1
+
+// States each expand worker takes at a time
+#define EXTBFS_EXPAND_CHUNK 4096
+
+// Per file buffer while merging, in ranks
+#define EXTBFS_MERGE_BUFFER 65536
+
+// Most runs one layer can spill, and the least each gets to read into while
+// they're merged
+#define EXTBFS_MAX_RUNS 1024
+#define EXTBFS_MIN_RUN_BUFFER 1024
+
+// Radix sort digits
+#define EXTBFS_RADIX_BITS 8
+#define EXTBFS_RADIX_SIZE (1 << EXTBFS_RADIX_BITS)
+
+// Progress is printed each time this much more of a layer is expanded
+#define EXTBFS_PROGRESS_STEP 0.1
+
+
+typedef struct {
+    u32 magic;
+    u32 version;
+    u32 edge_count;
+    u32 depth;
+    u64 count;
+} ExtBfsLayerHeader;
+
+// Where each slot's edge goes and whether it flips, for every turn
+typedef struct {
+    u8 edge_count;
+    u8 slots[TURN_TYPE_COUNT][TWOPHASE_EDGE_COUNT];
+    u8 flips[TURN_TYPE_COUNT][TWOPHASE_EDGE_COUNT];
+} ExtBfsSpace;
+
+typedef struct {
+    ExtBfsSpace* space;
+    const u64* states;
+    u64 count;
+    u64* neighbours;
+    u32 next_chunk;
+} ExtBfsExpandJob;
+
+// A sorted file read front to back, buffer holds [position, filled)
+typedef struct {
+    FILE* file;
+    u64* buffer;
+    u64 capacity;
+    u64 filled;
+    u64 position;
+    u64 remaining;
+    u64* bytes_read;
+} ExtBfsReader;
+
+typedef struct {
+    FILE* file;
+    u64* buffer;
+    u64 capacity;
+    u64 filled;
+    u64 count;
+    u64* bytes_written;
+    bool ok;
+} ExtBfsWriter;
+
+
+// SPACE //////////////////////////////////////////////////////////////////////
+u64 ExtBfsStateCount(u8 edge_count) {
+    u64 count = 1;
+    for (int i = 0; i < edge_count; i++) count *= (TWOPHASE_EDGE_COUNT - i) * 2;
+    return count;
+}
+
+// Read off the two-phase turn cubies, which are themselves read off a Cube
+static void ExtBfsSpaceInit(ExtBfsSpace* space, u8 edge_count) {
+    TwoPhaseCubiesInit();
+    space->edge_count = edge_count;
+
+    for (int t = 0; t < TURN_TYPE_COUNT; t++) {
+        TwoPhaseCubie cubie;
+        TwoPhaseCubieSolved(&cubie);
+        TwoPhaseCubieTurn(&cubie, t);
+
+        // Slot i now has the piece that started in slot ep[i]
+        for (int i = 0; i < TWOPHASE_EDGE_COUNT; i++) {
+            space->slots[t][cubie.ep[i]] = i;
+            space->flips[t][cubie.ep[i]] = cubie.eo[i];
+        }
+    }
+}
+
+// Which slot each tracked edge is in as a partial permutation of the 12
+// slots, then one flip bit per edge
+static u64 ExtBfsRank(u8 edge_count, const u8* slots, const u8* flips) {
+    u64 rank = 0;
+    u32 flip_bits = 0;
+    for (int i = 0; i < edge_count; i++) {
+        u8 smaller = 0;
+        for (int j = 0; j < i; j++) {
+            if (slots[j] < slots[i]) smaller++;
+        }
+        rank = rank * (TWOPHASE_EDGE_COUNT - i) + slots[i] - smaller;
+        flip_bits = flip_bits * 2 + flips[i];
+    }
+    return (rank << edge_count) | flip_bits;
+}
+
+static void ExtBfsUnrank(u8 edge_count, u64 rank, u8* slots, u8* flips) {
+    for (int i = edge_count - 1; i >= 0; i--) {
+        flips[i] = rank & 1;
+        rank >>= 1;
+    }
+
+    u8 digits[EXTBFS_MAX_EDGES];
+    for (int i = edge_count - 1; i >= 0; i--) {
+        digits[i] = rank % (TWOPHASE_EDGE_COUNT - i);
+        rank /= TWOPHASE_EDGE_COUNT - i;
+    }
+
+    // Digit i is the index among the slots not yet taken
+    bool taken[TWOPHASE_EDGE_COUNT] = { false };
+    for (int i = 0; i < edge_count; i++) {
+        u8 free_index = 0;
+        for (u8 slot = 0; slot < TWOPHASE_EDGE_COUNT; slot++) {
+            if (taken[slot]) continue;
+            if (free_index++ == digits[i]) {
+                slots[i] = slot;
+                taken[slot] = true;
+                break;
+            }
+        }
+    }
+}
+
+static void ExtBfsExpandWorker(void* data, u32 thread_index, u32 thread_count) {
+    ExtBfsExpandJob* job = (ExtBfsExpandJob*) data;
+    ExtBfsSpace* space = job->space;
+    u8 edge_count = space->edge_count;
+
+    for (;;) {
+        u64 start = (u64) __atomic_fetch_add(&job->next_chunk, 1, __ATOMIC_RELAXED) * EXTBFS_EXPAND_CHUNK;
+        if (start >= job->count) break;
+        u64 end = MinU64(start + EXTBFS_EXPAND_CHUNK, job->count);
+
+        TraceBegin("extbfs expand chunk");
+        for (u64 i = start; i < end; i++) {
+            u8 slots[EXTBFS_MAX_EDGES];
+            u8 flips[EXTBFS_MAX_EDGES];
+            ExtBfsUnrank(edge_count, job->states[i], slots, flips);
+
+            for (int t = 0; t < TURN_TYPE_COUNT; t++) {
+                u8 turned_slots[EXTBFS_MAX_EDGES];
+                u8 turned_flips[EXTBFS_MAX_EDGES];
+                for (int e = 0; e < edge_count; e++) {
+                    turned_slots[e] = space->slots[t][slots[e]];
+                    turned_flips[e] = flips[e] ^ space->flips[t][slots[e]];
+                }
+                job->neighbours[i * TURN_TYPE_COUNT + t] = ExtBfsRank(edge_count, turned_slots, turned_flips);
+            }
+        }
+        TraceEnd("extbfs expand chunk");
+    }
+}
+
+// LSD radix sort of ranks below Bit(bits), then repeats dropped. Returns how
+// many are left, in values.
+static u64 ExtBfsSortUnique(u64* values, u64* scratch, u64 count, u32 bits) {
+    u64* from = values;
+    u64* to = scratch;
+    for (u32 shift = 0; shift < bits; shift += EXTBFS_RADIX_BITS) {
+        u64 offsets[EXTBFS_RADIX_SIZE] = { 0 };
+        for (u64 i = 0; i < count; i++) offsets[(from[i] >> shift) & (EXTBFS_RADIX_SIZE - 1)]++;
+
+        u64 offset = 0;
+        for (u32 d = 0; d < EXTBFS_RADIX_SIZE; d++) {
+            u64 c = offsets[d];
+            offsets[d] = offset;
+            offset += c;
+        }
+        for (u64 i = 0; i < count; i++) to[offsets[(from[i] >> shift) & (EXTBFS_RADIX_SIZE - 1)]++] = from[i];
+
+        u64* swap = from;
+        from = to;
+        to = swap;
+    }
+
+    u64 unique = 0;
+    for (u64 i = 0; i < count; i++) {
+        if (unique == 0 || values[unique - 1] != from[i]) values[unique++] = from[i];
+    }
+    return unique;
+}
+
+// FILES //////////////////////////////////////////////////////////////////////
+static void ExtBfsLayerPath(const char* dir, u32 depth, char* path) {
+    snprintf(path, EXTBFS_PATH_SIZE, "%s/layer_%02u.bin", dir, depth);
+}
+
+static void ExtBfsLayerTmpPath(const char* dir, u32 depth, char* path) {
+    snprintf(path, EXTBFS_PATH_SIZE, "%s/layer_%02u.tmp", dir, depth);
+}
+
+static void ExtBfsRunPath(const char* dir, u32 run, char* path) {
+    snprintf(path, EXTBFS_PATH_SIZE, "%s/run_%04u.tmp", dir, run);
+}
+
+static bool ExtBfsReaderOpen(
+    ExtBfsReader* reader, Arena* arena, const char* path, u64 capacity, u64* bytes_read
+) {
+    *reader = (ExtBfsReader) { 0 };
+    reader->bytes_read = bytes_read;
+    reader->file = fopen(path, "rb");
+    if (reader->file == NULL) {
+        printf("%s: could not open\n", path);
+        return false;
+    }
+
+    ExtBfsLayerHeader header;
+    if (fread(&header, sizeof(header), 1, reader->file) != 1 || header.magic != EXTBFS_LAYER_MAGIC) {
+        printf("%s: not a layer file\n", path);
+        fclose(reader->file);
+        reader->file = NULL;
+        return false;
+    }
+    *bytes_read += sizeof(header);
+
+    reader->buffer = (u64*) _ArenaPush(arena, capacity * sizeof(u64), alignof(u64), false);
+    reader->capacity = capacity;
+    reader->remaining = header.count;
+    return true;
+}
+
+// False once there's nothing left
+static bool ExtBfsReaderFill(ExtBfsReader* reader) {
+    if (reader->position < reader->filled) return true;
+    u64 want = MinU64(reader->capacity, reader->remaining);
+    reader->filled = want > 0 ? fread(reader->buffer, sizeof(u64), want, reader->file) : 0;
+    reader->position = 0;
+    reader->remaining -= want;
+    *reader->bytes_read += reader->filled * sizeof(u64);
+    return reader->filled > 0;
+}
+
+static void ExtBfsReaderClose(ExtBfsReader* reader) {
+    if (reader->file != NULL) fclose(reader->file);
+    reader->file = NULL;
+}
+
+// Moves past everything below value, true if value itself is there
+static bool ExtBfsReaderContains(ExtBfsReader* reader, u64 value) {
+    if (reader->file == NULL) return false;
+    while (ExtBfsReaderFill(reader)) {
+        u64 next = reader->buffer[reader->position];
+        if (next >= value) return next == value;
+        reader->position++;
+    }
+    return false;
+}
+
+// The header is written with count 0 and fixed up on close
+static bool ExtBfsWriterOpen(
+    ExtBfsWriter* writer, Arena* arena, const char* path, u32 edge_count, u32 depth,
+    u64 capacity, u64* bytes_written
+) {
+    *writer = (ExtBfsWriter) { 0 };
+    writer->bytes_written = bytes_written;
+    writer->file = fopen(path, "wb");
+    if (writer->file == NULL) {
+        printf("Couldn't open %s\n", path);
+        return false;
+    }
+
+    ExtBfsLayerHeader header = { EXTBFS_LAYER_MAGIC, EXTBFS_VERSION, edge_count, depth, 0 };
+    writer->ok = fwrite(&header, sizeof(header), 1, writer->file) == 1;
+    *bytes_written += sizeof(header);
+    writer->buffer = (u64*) _ArenaPush(arena, capacity * sizeof(u64), alignof(u64), false);
+    writer->capacity = capacity;
+    return writer->ok;
+}
+
+static void ExtBfsWriterFlush(ExtBfsWriter* writer) {
+    if (writer->filled == 0) return;
+    writer->ok = writer->ok && fwrite(writer->buffer, sizeof(u64), writer->filled, writer->file) == writer->filled;
+    *writer->bytes_written += writer->filled * sizeof(u64);
+    writer->filled = 0;
+}
+
+static void ExtBfsWriterPush(ExtBfsWriter* writer, u64 value) {
+    if (writer->filled == writer->capacity) ExtBfsWriterFlush(writer);
+    writer->buffer[writer->filled++] = value;
+    writer->count++;
+}
+
+static bool ExtBfsWriterClose(ExtBfsWriter* writer, u32 edge_count, u32 depth) {
+    ExtBfsWriterFlush(writer);
+    ExtBfsLayerHeader header = { EXTBFS_LAYER_MAGIC, EXTBFS_VERSION, edge_count, depth, writer->count };
+    writer->ok = writer->ok && fseek(writer->file, 0, SEEK_SET) == 0 &&
+        fwrite(&header, sizeof(header), 1, writer->file) == 1;
+    writer->ok = fclose(writer->file) == 0 && writer->ok;
+    return writer->ok;
+}
+
+// Spills go through a .tmp first so a file under its real name is always
+// complete
+static bool ExtBfsWriteBuffer(
+    const char* path, u32 edge_count, u32 depth, const u64* values, u64 count, u64* bytes_written
+) {
+    FILE* file = fopen(path, "wb");
+    if (file == NULL) {
+        printf("Couldn't open %s\n", path);
+        return false;
+    }
+    ExtBfsLayerHeader header = { EXTBFS_LAYER_MAGIC, EXTBFS_VERSION, edge_count, depth, count };
+    bool ok = fwrite(&header, sizeof(header), 1, file) == 1 && fwrite(values, sizeof(u64), count, file) == count;
+    ok = fclose(file) == 0 && ok;
+    *bytes_written += sizeof(header) + count * sizeof(u64);
+    return ok;
+}
+
+static bool ExtBfsCommit(const char* tmp_path, const char* path) {
+    remove(path);
+    if (rename(tmp_path, path) == 0) return true;
+    printf("Couldn't rename %s to %s\n", tmp_path, path);
+    return false;
+}
+
+static bool ExtBfsCheckpointSave(const char* dir, ExtBfsCheckpoint* checkpoint) {
+    char path[EXTBFS_PATH_SIZE];
+    char tmp_path[EXTBFS_PATH_SIZE];
+    snprintf(path, EXTBFS_PATH_SIZE, "%s/checkpoint.bin", dir);
+    snprintf(tmp_path, EXTBFS_PATH_SIZE, "%s/checkpoint.tmp", dir);
+
+    FILE* file = fopen(tmp_path, "wb");
+    if (file == NULL) {
+        printf("Couldn't open %s\n", tmp_path);
+        return false;
+    }
+    bool ok = fwrite(checkpoint, sizeof(ExtBfsCheckpoint), 1, file) == 1;
+    ok = fclose(file) == 0 && ok;
+    return ok && ExtBfsCommit(tmp_path, path);
+}
+
+static bool ExtBfsCheckpointLoad(const char* dir, u8 edge_count, ExtBfsCheckpoint* checkpoint) {
+    char path[EXTBFS_PATH_SIZE];
+    snprintf(path, EXTBFS_PATH_SIZE, "%s/checkpoint.bin", dir);
+
+    FILE* file = fopen(path, "rb");
+    if (file == NULL) return false;
+    bool ok = fread(checkpoint, sizeof(ExtBfsCheckpoint), 1, file) == 1;
+    fclose(file);
+
+    if (!ok || checkpoint->magic != EXTBFS_CHECKPOINT_MAGIC || checkpoint->version != EXTBFS_VERSION) {
+        printf("%s: not a checkpoint, starting over\n", path);
+        return false;
+    }
+    if (checkpoint->edge_count != edge_count) {
+        printf("%s: is for %u edges, starting over\n", path, checkpoint->edge_count);
+        return false;
+    }
+    return true;
+}
+
+// LAYERS /////////////////////////////////////////////////////////////////////
+static u32 ExtBfsRankBits(u8 edge_count) {
+    u32 bits = 0;
+    while (((u64) 1 << bits) < ExtBfsStateCount(edge_count)) bits++;
+    return bits;
+}
+
+// Heap of run indices ordered by each run's next rank
+static void ExtBfsHeapDown(ExtBfsReader* runs, u32* heap, u32 size, u32 i) {
+    for (;;) {
+        u32 smallest = i;
+        for (u32 child = i * 2 + 1; child <= i * 2 + 2 && child < size; child++) {
+            ExtBfsReader* a = &runs[heap[child]];
+            ExtBfsReader* b = &runs[heap[smallest]];
+            if (a->buffer[a->position] < b->buffer[b->position]) smallest = child;
+        }
+        if (smallest == i) return;
+
+        u32 swap = heap[i];
+        heap[i] = heap[smallest];
+        heap[smallest] = swap;
+        i = smallest;
+    }
+}
+
+// Layer depth + 1 from layers depth and depth - 1
+static bool ExtBfsNextLayer(
+    Arena* arena, ExtBfsSpace* space, const char* dir, u32 depth,
+    u64 memory, u32 thread_count, ExtBfsLayerStats* stats
+) {
+    u64 arena_start = arena->used;
+    u8 edge_count = space->edge_count;
+    u32 rank_bits = ExtBfsRankBits(edge_count);
+
+    // A block of states plus its neighbours twice over for the sort
+    u64 block_capacity = MaxU64(memory / (sizeof(u64) * (1 + 2 * TURN_TYPE_COUNT)), EXTBFS_EXPAND_CHUNK);
+    u64* block = (u64*) _ArenaPush(arena, block_capacity * sizeof(u64), alignof(u64), false);
+    u64* neighbours = (u64*) _ArenaPush(
+        arena, block_capacity * TURN_TYPE_COUNT * sizeof(u64), alignof(u64), false
+    );
+    u64* scratch = (u64*) _ArenaPush(arena, block_capacity * TURN_TYPE_COUNT * sizeof(u64), alignof(u64), false);
+
+    char path[EXTBFS_PATH_SIZE];
+    ExtBfsLayerPath(dir, depth, path);
+    ExtBfsReader layer;
+    if (!ExtBfsReaderOpen(&layer, arena, path, EXTBFS_MERGE_BUFFER, &stats->bytes_read)) return false;
+
+    // 1. Expand a block at a time into sorted runs
+    u64 total = layer.remaining;
+    u64 done = 0;
+    double next_progress = EXTBFS_PROGRESS_STEP;
+    u32 run_count = 0;
+    bool ok = true;
+    while (ok && layer.remaining > 0) {
+        u64 want = MinU64(block_capacity, layer.remaining);
+        u64 count = fread(block, sizeof(u64), want, layer.file);
+        layer.remaining -= want;
+        stats->bytes_read += count * sizeof(u64);
+        if (count != want || run_count == EXTBFS_MAX_RUNS) {
+            printf("%s: %s\n", path, count != want ? "ends early" : "too many runs, give it more memory");
+            ok = false;
+            break;
+        }
+
+        ExtBfsExpandJob job = {
+            .space = space,
+            .states = block,
+            .count = count,
+            .neighbours = neighbours,
+            .next_chunk = 0
+        };
+        ParallelRun(thread_count, ExtBfsExpandWorker, &job);
+
+        TraceBegin("extbfs sort run");
+        u64 unique = ExtBfsSortUnique(neighbours, scratch, count * TURN_TYPE_COUNT, rank_bits);
+        TraceEnd("extbfs sort run");
+
+        char run_path[EXTBFS_PATH_SIZE];
+        ExtBfsRunPath(dir, run_count++, run_path);
+        ok = ExtBfsWriteBuffer(run_path, edge_count, depth + 1, neighbours, unique, &stats->bytes_written);
+
+        done += count;
+        if (total > 0 && (double) done / total >= next_progress) {
+            printf("  Depth %2u expanding: %3.0f%%\n", depth, 100.0 * done / total);
+            while (next_progress <= (double) done / total) next_progress += EXTBFS_PROGRESS_STEP;
+        }
+    }
+    ExtBfsReaderClose(&layer);
+    arena->used = arena_start;
+
+    // 2. Merge the runs, dropping repeats and anything in the last two layers
+    ExtBfsReader* runs = ArenaPushArray(arena, MaxU32(run_count, 1), ExtBfsReader);
+    u64 run_buffer = MaxU64(memory / 2 / sizeof(u64) / MaxU32(run_count, 1), EXTBFS_MIN_RUN_BUFFER);
+    for (u32 r = 0; r < run_count && ok; r++) {
+        char run_path[EXTBFS_PATH_SIZE];
+        ExtBfsRunPath(dir, r, run_path);
+        ok = ExtBfsReaderOpen(&runs[r], arena, run_path, run_buffer, &stats->bytes_read);
+    }
+
+    ExtBfsReader current = { 0 };
+    ExtBfsReader previous = { 0 };
+    ok = ok && ExtBfsReaderOpen(&current, arena, path, EXTBFS_MERGE_BUFFER, &stats->bytes_read);
+    if (ok && depth > 0) {
+        char previous_path[EXTBFS_PATH_SIZE];
+        ExtBfsLayerPath(dir, depth - 1, previous_path);
+        ok = ExtBfsReaderOpen(&previous, arena, previous_path, EXTBFS_MERGE_BUFFER, &stats->bytes_read);
+    }
+
+    char next_path[EXTBFS_PATH_SIZE];
+    char tmp_path[EXTBFS_PATH_SIZE];
+    ExtBfsLayerPath(dir, depth + 1, next_path);
+    ExtBfsLayerTmpPath(dir, depth + 1, tmp_path);
+    ExtBfsWriter writer = { 0 };
+    ok = ok && ExtBfsWriterOpen(
+        &writer, arena, tmp_path, edge_count, depth + 1, EXTBFS_MERGE_BUFFER, &stats->bytes_written
+    );
+
+    TraceBegin("extbfs merge");
+    u32* heap = ArenaPushArray(arena, MaxU32(run_count, 1), u32);
+    u32 heap_size = 0;
+    for (u32 r = 0; r < run_count && ok; r++) {
+        if (ExtBfsReaderFill(&runs[r])) heap[heap_size++] = r;
+    }
+    for (u32 i = heap_size; i-- > 0;) ExtBfsHeapDown(runs, heap, heap_size, i);
+
+    u64 last = UINT64_MAX;
+    while (ok && heap_size > 0) {
+        ExtBfsReader* run = &runs[heap[0]];
+        u64 value = run->buffer[run->position++];
+        if (!ExtBfsReaderFill(run)) heap[0] = heap[--heap_size];
+        ExtBfsHeapDown(runs, heap, heap_size, 0);
+
+        if (value == last) continue;
+        last = value;
+
+        if (ExtBfsReaderContains(&current, value) || ExtBfsReaderContains(&previous, value)) continue;
+        ExtBfsWriterPush(&writer, value);
+    }
+    TraceEnd("extbfs merge");
+
+    ok = ok && ExtBfsWriterClose(&writer, edge_count, depth + 1);
+    stats->states = writer.count;
+
+    ExtBfsReaderClose(&current);
+    ExtBfsReaderClose(&previous);
+    for (u32 r = 0; r < run_count; r++) {
+        char run_path[EXTBFS_PATH_SIZE];
+        ExtBfsReaderClose(&runs[r]);
+        ExtBfsRunPath(dir, r, run_path);
+        remove(run_path);
+    }
+    arena->used = arena_start;
+
+    return ok && ExtBfsCommit(tmp_path, next_path);
+}
+
+// Every layer is sorted, so merging them all visits the ranks in order and
+// the table can be written straight through, two states to a byte
+static bool ExtBfsWritePdb(Arena* arena, const char* dir, ExtBfsCheckpoint* checkpoint) {
+    u64 arena_start = arena->used;
+    u64 state_count = ExtBfsStateCount(checkpoint->edge_count);
+    u64 bytes_read = 0;
+
+    ExtBfsReader layers[EXTBFS_MAX_DEPTH];
+    bool ok = true;
+    for (u32 d = 0; d <= checkpoint->depth && ok; d++) {
+        char path[EXTBFS_PATH_SIZE];
+        ExtBfsLayerPath(dir, d, path);
+        ok = ExtBfsReaderOpen(&layers[d], arena, path, EXTBFS_MERGE_BUFFER, &bytes_read);
+    }
+
+    char path[EXTBFS_PATH_SIZE];
+    snprintf(path, EXTBFS_PATH_SIZE, "%s/pdb_%u_edges.bin", dir, checkpoint->edge_count);
+    FILE* file = ok ? fopen(path, "wb") : NULL;
+    ok = file != NULL;
+
+    u8* out = ArenaPushArray(arena, EXTBFS_MERGE_BUFFER, u8);
+    u64 out_filled = 0;
+    u64 bytes_written = 0;
+    ExtBfsLayerHeader header = { EXTBFS_PDB_MAGIC, EXTBFS_VERSION, checkpoint->edge_count, checkpoint->depth, state_count };
+    ok = ok && fwrite(&header, sizeof(header), 1, file) == 1;
+
+    for (u64 rank = 0; rank < state_count && ok; rank++) {
+        u8 distance = 0xF;
+        for (u32 d = 0; d <= checkpoint->depth; d++) {
+            if (!ExtBfsReaderFill(&layers[d]) || layers[d].buffer[layers[d].position] != rank) continue;
+            layers[d].position++;
+            distance = d;
+            break;
+        }
+        assert(distance != 0xF && "State missing from every layer!");
+
+        if (rank % 2 == 0) {
+            out[out_filled] = distance;
+        } else {
+            out[out_filled++] |= distance << 4;
+        }
+        if (out_filled == EXTBFS_MERGE_BUFFER) {
+            ok = fwrite(out, 1, out_filled, file) == out_filled;
+            bytes_written += out_filled;
+            out_filled = 0;
+        }
+    }
+    if (state_count % 2 == 1) out_filled++;
+    ok = ok && fwrite(out, 1, out_filled, file) == out_filled;
+    bytes_written += out_filled;
+
+    if (file != NULL) ok = fclose(file) == 0 && ok;
+    for (u32 d = 0; d <= checkpoint->depth; d++) ExtBfsReaderClose(&layers[d]);
+    arena->used = arena_start;
+
+    printf(
+        "PDB: %s, %llu MB read, %llu MB written\n", path,
+        (unsigned long long) ToMegabytes(bytes_read), (unsigned long long) ToMegabytes(bytes_written)
+    );
+    return ok;
+}
+
+bool ExtBfsRun(Arena* arena, u8 edge_count, const char* dir, u64 memory, u32 thread_count, bool pdb) {
+    assert(edge_count >= EXTBFS_MIN_EDGES && edge_count <= EXTBFS_MAX_EDGES);
+
+    printf("----- EXTERNAL BFS -----\n");
+    double start = TimeSeconds();
+    TraceBegin("extbfs");
+
+    ExtBfsSpace space;
+    ExtBfsSpaceInit(&space, edge_count);
+    u64 state_count = ExtBfsStateCount(edge_count);
+    printf("Edges: %u, states: %llu\n", edge_count, (unsigned long long) state_count);
+
+    ExtBfsCheckpoint checkpoint;
+    if (ExtBfsCheckpointLoad(dir, edge_count, &checkpoint)) {
+        printf("Resuming at depth %u with %llu visited\n", checkpoint.depth, (unsigned long long) checkpoint.visited);
+    } else {
+        // Solved is the edges in their own slots, the right way round
+        u8 slots[EXTBFS_MAX_EDGES];
+        u8 flips[EXTBFS_MAX_EDGES] = { 0 };
+        for (int i = 0; i < edge_count; i++) slots[i] = i;
+        u64 solved = ExtBfsRank(edge_count, slots, flips);
+
+        checkpoint = (ExtBfsCheckpoint) { 0 };
+        checkpoint.magic = EXTBFS_CHECKPOINT_MAGIC;
+        checkpoint.version = EXTBFS_VERSION;
+        checkpoint.edge_count = edge_count;
+        checkpoint.visited = 1;
+        checkpoint.layers[0].states = 1;
+
+        char path[EXTBFS_PATH_SIZE];
+        ExtBfsLayerPath(dir, 0, path);
+        if (!ExtBfsWriteBuffer(path, edge_count, 0, &solved, 1, &checkpoint.layers[0].bytes_written)) return false;
+        if (!ExtBfsCheckpointSave(dir, &checkpoint)) return false;
+    }
+
+    bool ok = true;
+    while (!checkpoint.done && ok) {
+        u32 depth = checkpoint.depth;
+        if (depth + 1 >= EXTBFS_MAX_DEPTH) {
+            printf("Deeper than %d layers\n", EXTBFS_MAX_DEPTH);
+            ok = false;
+            break;
+        }
+
+        double layer_start = TimeSeconds();
+        ExtBfsLayerStats* stats = &checkpoint.layers[depth + 1];
+        *stats = (ExtBfsLayerStats) { 0 };
+        ok = ExtBfsNextLayer(arena, &space, dir, depth, memory, thread_count, stats);
+        if (!ok) break;
+
+        double elapsed = TimeSeconds() - layer_start;
+        printf(
+            "Depth %2u: %llu states, %llu MB read, %llu MB written, %f seconds (%.0f MB/s)\n",
+            depth + 1, (unsigned long long) stats->states,
+            (unsigned long long) ToMegabytes(stats->bytes_read), (unsigned long long) ToMegabytes(stats->bytes_written),
+            elapsed, (stats->bytes_read + stats->bytes_written) / elapsed / Megabytes(1)
+        );
+
+        checkpoint.visited += stats->states;
+        if (stats->states == 0) {
+            checkpoint.done = true;
+        } else {
+            checkpoint.depth = depth + 1;
+        }
+        ok = ExtBfsCheckpointSave(dir, &checkpoint);
+    }
+
+    if (ok) {
+        printf("Visited: %llu of %llu\n", (unsigned long long) checkpoint.visited, (unsigned long long) state_count);
+        assert(checkpoint.visited == state_count);
+    }
+    if (ok && pdb) ok = ExtBfsWritePdb(arena, dir, &checkpoint);
+
+    TraceEnd("extbfs");
+    printf("Time: %f seconds\n\n", TimeSeconds() - start);
+    return ok;
+}
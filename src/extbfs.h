@@ -0,0 +1,54 @@
+#ifndef EXTBFS_H
+#define EXTBFS_H
+
+
+#include "core.h"
+#include "cube.h"
+
+
+// Edge pattern databases: where the first edge_count edges of
+// CUBE_EDGE_COLOUR_TABLE are and which way round, everything else ignored.
+// 12! / (12 - n)! * 2^n states, so 510 million for 7 edges and 4.9 billion
+// for 8, too many to BFS in memory at a byte each on small machines.
+#define EXTBFS_MIN_EDGES 1
+#define EXTBFS_MAX_EDGES 8
+
+// Deepest layer there can be a file for
+#define EXTBFS_MAX_DEPTH 32
+
+#define EXTBFS_PATH_SIZE 1024
+
+// Memory for the layer being expanded, its neighbours and sort scratch
+#define EXTBFS_DEFAULT_MEMORY_MB 256
+
+
+typedef struct {
+    u64 states;
+    u64 bytes_read;
+    u64 bytes_written;
+} ExtBfsLayerStats;
+
+// What has been done so far, also what the checkpoint file holds. A layer
+// only counts once its file is complete, so resuming starts by expanding
+// layer depth.
+typedef struct {
+    u32 magic;
+    u32 version;
+    u32 edge_count;
+    u32 depth;
+    u64 visited;
+    bool done;
+    ExtBfsLayerStats layers[EXTBFS_MAX_DEPTH];
+} ExtBfsCheckpoint;
+
+
+u64 ExtBfsStateCount(u8 edge_count);
+
+// BFS of the edge_count edge pattern in dir, which has to exist. Each layer
+// is a sorted file of ranks. Picks up from dir's checkpoint if there is one
+// for the same edge_count. With pdb set the layers are finally merged into
+// one file of a 4 bit distance per state.
+bool ExtBfsRun(Arena* arena, u8 edge_count, const char* dir, u64 memory, u32 thread_count, bool pdb);
+
+
+#endif  /* EXTBFS_H */
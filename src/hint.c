@@ -0,0 +1,374 @@
+// Hints for practising by hand: for each of the 18 turns, does it get the
+// cross, the pair being worked on, or the whole cube any closer?
+//
+// Cross and pair distances are exact, looked up in tables built once by a BFS
+// from solved. The cross table is indexed by the same 20 bit state the cross
+// solver uses (ConvertToCrossCube) so there is one u8 per possible state, 1MB
+// in total. A pair is just one corner and one edge, so its state is where one
+// sticker of each has ended up, 48 * 48 entries per pair.
+//
+// There is no table for the whole cube, so the cube row is a lower bound: the
+// most of the cross distance, every pair distance, and the exact distance of
+// the corners solved as a 2x2 from the pocket table. Any of those has to be
+// done on the way to solved, so none of them can be more than the real
+// distance.
+//
+// Each request evaluates the cube and its 18 children, which takes well under
+// a millisecond once the tables exist, but building the tables takes long
+// enough to drop frames, so all of it happens on a worker thread. The GUI asks
+// again only when the cube hash is different from what it last got back.
+
+
+#include "hint.h"
+#include "solve.h"
+#include "trace.h"
+#include "raylib.h"
+
+
+// Edges from CUBE_EDGE_COLOUR_TABLE that go with the white corners, so pair i
+// is corner i and edge HINT_PAIR_EDGES[i] (same order as the F2L solver)
+static const u8 HINT_PAIR_EDGES[HINT_PAIR_COUNT] = { 6, 5, 4, 7 };
+
+// Reachable cross states, 12 * 11 * 10 * 9 places * 2^4 flips
+#define HINT_CROSS_REACHABLE 190080
+
+#define HINT_UNREACHED UINT8_MAX
+
+// Header line then one line per turn direction
+#define HINT_RENDER_ROWS 4
+#define HINT_RENDER_TEXT_SCALE 0.45f
+#define HINT_RENDER_MARK_SCALE 0.22f
+
+#define HINT_BENCHMARK_SCRAMBLE_LEN 25
+
+
+// Where the sticker coloured like the first colour of a piece is. Pieces are
+// found by colour set so this works whatever way round the piece is.
+static u8 HintFindSticker(
+    Cube* cube, const enum8(CubeColour)* colours, const u8* positions,
+    u8 piece_size, u8 slot_count, u8 piece
+) {
+    const enum8(CubeColour)* target = colours + piece * piece_size;
+
+    for (int slot = 0; slot < slot_count; slot++) {
+        u8 found = HINT_STICKER_COUNT;
+        bool matches = true;
+
+        for (int k = 0; k < piece_size && matches; k++) {
+            CubeColour face = colours[slot * piece_size + k];
+            u8 position = positions[slot * piece_size + k];
+            CubeColour colour = FaceGetTile(cube->faces[face], position);
+
+            matches = false;
+            for (int j = 0; j < piece_size; j++) {
+                if (colour == target[j]) matches = true;
+            }
+            if (colour == target[0]) found = face * 8 + position;
+        }
+
+        if (matches && found < HINT_STICKER_COUNT) return found;
+    }
+    // Only on an invalid cube
+    return 0;
+}
+
+static u16 HintPairState(Cube* cube, u8 pair) {
+    u8 corner = HintFindSticker(
+        cube, CUBE_CORNER_COLOUR_TABLE, CUBE_CORNER_POSITION_TABLE, 3, 8, pair
+    );
+    u8 edge = HintFindSticker(
+        cube, CUBE_EDGE_COLOUR_TABLE, CUBE_EDGE_POSITION_TABLE, 2, 12, HINT_PAIR_EDGES[pair]
+    );
+    return corner * HINT_STICKER_COUNT + edge;
+}
+
+static void HintCrossTable(HintEngine* engine, Cube* solved) {
+    u8* distances = ArenaPushArray(&engine->arena, HINT_CROSS_STATE_COUNT, u8);
+    MemSet(distances, HINT_UNREACHED, HINT_CROSS_STATE_COUNT);
+
+    u32* items = ArenaPushArray(&engine->arena, HINT_CROSS_REACHABLE + 1, u32);
+    QueueU32 queue;
+    QueueU32_init(&queue, items, HINT_CROSS_REACHABLE + 1);
+
+    u32 start = ConvertToCrossCube(solved);
+    distances[start] = 0;
+    QueueU32_append(&queue, start);
+
+    u32 reached = 1;
+    u32 state;
+    while (QueueU32_pop(&queue, &state)) {
+        for (int t = 0; t < TURN_TYPE_COUNT; t++) {
+            u32 next = TurnCrossCube(state, t);
+            if (distances[next] != HINT_UNREACHED) continue;
+            distances[next] = distances[state] + 1;
+            QueueU32_append(&queue, next);
+            reached++;
+        }
+    }
+    assert(reached == HINT_CROSS_REACHABLE);
+
+    engine->cross_distances = distances;
+}
+
+static void HintPairTable(HintEngine* engine, Cube* solved, u8 pair, QueueU32* queue) {
+    u8* distances = ArenaPushArray(&engine->arena, HINT_PAIR_STATE_COUNT, u8);
+    MemSet(distances, HINT_UNREACHED, HINT_PAIR_STATE_COUNT);
+
+    u32 start = HintPairState(solved, pair);
+    distances[start] = 0;
+    QueueU32_clear(queue);
+    QueueU32_append(queue, start);
+
+    u32 reached = 1;
+    u32 state;
+    while (QueueU32_pop(queue, &state)) {
+        u8 corner = state / HINT_STICKER_COUNT;
+        u8 edge = state % HINT_STICKER_COUNT;
+        for (int t = 0; t < TURN_TYPE_COUNT; t++) {
+            u32 next = engine->sticker_moves[t][corner] * HINT_STICKER_COUNT
+                + engine->sticker_moves[t][edge];
+            if (distances[next] != HINT_UNREACHED) continue;
+            distances[next] = distances[state] + 1;
+            QueueU32_append(queue, next);
+            reached++;
+        }
+    }
+    // Corner anywhere 3 ways round, edge anywhere 2 ways round
+    assert(reached == 8 * 3 * 12 * 2);
+
+    engine->pair_distances[pair] = distances;
+}
+
+void HintInit(HintEngine* engine) {
+    MemZero(engine, sizeof(HintEngine));
+    ArenaInit(&engine->arena, HINT_ARENA_SIZE);  // [ ~2.8 / 3 ] megabytes used
+}
+
+void HintFree(HintEngine* engine) {
+    // Waits for a request that is still being worked on
+    WorkerStop(&engine->worker);
+    ArenaFree(&engine->arena);
+}
+
+void HintTablesBuild(HintEngine* engine) {
+    if (__atomic_load_n(&engine->tables_ready, __ATOMIC_ACQUIRE)) return;
+
+    printf("----- HINT TABLES -----\n");
+    double start = TimeSeconds();
+    TraceBegin("hint tables");
+
+    Cube solved;
+    CubeInit(&solved);
+    CubeSetSolved(&solved);
+
+    // Mark one sticker on a blank cube, turn, and see where it went
+    Cube probe;
+    for (int t = 0; t < TURN_TYPE_COUNT; t++) {
+        for (int s = 0; s < HINT_STICKER_COUNT; s++) {
+            CubeSetSolid(&probe, CUBE_COLOUR_COUNT);
+            CubeSetTile(&probe, s / 8, CUBE_GREEN, s % 8);
+            CubeTurn(&probe, t);
+            for (int d = 0; d < HINT_STICKER_COUNT; d++) {
+                if (FaceGetTile(probe.faces[d / 8], d % 8) == CUBE_GREEN) {
+                    engine->sticker_moves[t][s] = d;
+                }
+            }
+        }
+    }
+
+    HintCrossTable(engine, &solved);
+
+    u32* items = ArenaPushArray(&engine->arena, HINT_PAIR_STATE_COUNT, u32);
+    QueueU32 queue;
+    QueueU32_init(&queue, items, HINT_PAIR_STATE_COUNT);
+    for (int pair = 0; pair < HINT_PAIR_COUNT; pair++) {
+        HintPairTable(engine, &solved, pair, &queue);
+    }
+
+    PocketTableInit(&engine->arena, &engine->pocket, ThreadCount());
+
+    TraceEnd("hint tables");
+    printf("Memory: %llu kilobytes\n", (unsigned long long) ToKilobytes(engine->arena.used));
+    printf("Time: %f seconds\n\n", TimeSeconds() - start);
+
+    __atomic_store_n(&engine->tables_ready, true, __ATOMIC_RELEASE);
+}
+
+static void HintDistances(HintEngine* engine, Cube* cube, u8 pair, u8* distances) {
+    u8 cross = engine->cross_distances[ConvertToCrossCube(cube)];
+    u8 bound = cross;
+
+    u32 coord = PocketCoordFromCube(cube);
+    if (coord != POCKET_COORD_INVALID) {
+        enum8(TurnType) moves[POCKET_MAX_MOVES];
+        bound = MaxU8(bound, PocketSolveCoord(&engine->pocket, coord, moves));
+    }
+
+    distances[HINT_PAIR] = 0;
+    for (int i = 0; i < HINT_PAIR_COUNT; i++) {
+        u8 distance = engine->pair_distances[i][HintPairState(cube, i)];
+        if (i == pair) distances[HINT_PAIR] = distance;
+        bound = MaxU8(bound, distance);
+    }
+
+    distances[HINT_CROSS] = cross;
+    distances[HINT_CUBE] = bound;
+}
+
+void HintEvaluate(HintEngine* engine, Cube* cube, HintResult* result) {
+    assert(__atomic_load_n(&engine->tables_ready, __ATOMIC_ACQUIRE));
+    TraceBegin("hint");
+
+    // The pair being worked on is whichever unsolved one is closest. It stays
+    // the same for the children so they are all compared on the same thing.
+    result->hash = cube->hash;
+    result->pair = HINT_NO_PAIR;
+    u8 closest = HINT_UNREACHED;
+    for (int i = 0; i < HINT_PAIR_COUNT; i++) {
+        u8 distance = engine->pair_distances[i][HintPairState(cube, i)];
+        if (distance > 0 && distance < closest) {
+            closest = distance;
+            result->pair = i;
+        }
+    }
+
+    HintDistances(engine, cube, result->pair, result->distances);
+
+    for (int t = 0; t < TURN_TYPE_COUNT; t++) {
+        Cube child = *cube;
+        CubeTurn(&child, t);
+        HintDistances(engine, &child, result->pair, result->turn_distances[t]);
+    }
+
+    TraceEnd("hint");
+}
+
+static void HintWorker(void* data) {
+    HintEngine* engine = (HintEngine*) data;
+
+    HintTablesBuild(engine);
+
+    HintEvaluate(engine, &engine->request, &engine->result);
+
+    __atomic_store_n(&engine->busy, 0, __ATOMIC_RELEASE);
+}
+
+void HintUpdate(HintEngine* engine, Cube* cube) {
+    // Still working, result and request belong to the worker until it's done
+    if (__atomic_load_n(&engine->busy, __ATOMIC_ACQUIRE)) return;
+
+    if (engine->requested) {
+        engine->shown = engine->result;
+        engine->shown_ready = true;
+        engine->requested = false;
+    }
+
+    if (engine->shown_ready && engine->shown.hash == cube->hash) return;
+
+    // Only ever started once, if there was no thread to be had every request
+    // is worked on here instead
+    if (engine->worker.func == NULL) {
+        WorkerStart(&engine->worker, HintWorker, engine);
+    }
+
+    engine->request = *cube;
+    engine->requested = true;
+    __atomic_store_n(&engine->busy, 1, __ATOMIC_RELEASE);
+    WorkerWake(&engine->worker);
+}
+
+static Color HintColour(u8 before, u8 after) {
+    if (after < before) return GREEN;
+    if (after > before) return RED;
+    return LIGHTGRAY;
+}
+
+void HintRender(HintEngine* engine, Cube* cube, Rectangle cube_rect) {
+    Rectangle rect = CubeRenderSpareRect(cube_rect);
+    float row_height = rect.height / HINT_RENDER_ROWS;
+    float column_width = rect.width / CUBE_COLOUR_COUNT;
+    int font_size = row_height * HINT_RENDER_TEXT_SCALE;
+    char text[64];
+
+    // Nothing for a cube that has changed since, it would only be misleading
+    HintResult* result = &engine->shown;
+    if (!engine->shown_ready || result->hash != cube->hash) {
+        bool ready = __atomic_load_n(&engine->tables_ready, __ATOMIC_ACQUIRE);
+        DrawText(ready ? "..." : "building hints...", rect.x, rect.y, font_size, DARKGRAY);
+        return;
+    }
+
+    if (result->pair == HINT_NO_PAIR) {
+        snprintf(text, sizeof(text), "cross %d  pair -  cube %d+",
+            result->distances[HINT_CROSS], result->distances[HINT_CUBE]);
+    } else {
+        snprintf(text, sizeof(text), "cross %d  pair %d  cube %d+",
+            result->distances[HINT_CROSS], result->distances[HINT_PAIR], result->distances[HINT_CUBE]);
+    }
+    DrawText(text, rect.x, rect.y, font_size, BLACK);
+
+    // One cell per turn, F R U B L D across and clockwise, prime, double
+    // down. Under each name is a mark for cross, pair and cube in that order.
+    float mark_size = row_height * HINT_RENDER_MARK_SCALE;
+    for (int t = 0; t < TURN_TYPE_COUNT; t++) {
+        float x = rect.x + (t % CUBE_COLOUR_COUNT) * column_width;
+        float y = rect.y + (1 + t / CUBE_COLOUR_COUNT) * row_height;
+
+        DrawText(TURN_TYPE_NAMES[t], x, y, font_size, BLACK);
+
+        for (int kind = 0; kind < HINT_KIND_COUNT; kind++) {
+            if (kind == HINT_PAIR && result->pair == HINT_NO_PAIR) continue;
+
+            Rectangle mark = (Rectangle) {
+                x + kind * mark_size * 1.25f, y + font_size * 1.1f, mark_size, mark_size
+            };
+            DrawRectangleRec(mark, HintColour(result->distances[kind], result->turn_distances[t][kind]));
+        }
+    }
+}
+
+void HintBenchmark(u32 count) {
+    HintEngine* engine = malloc(sizeof(HintEngine));
+    HintInit(engine);
+    HintTablesBuild(engine);
+
+    Cube cube;
+    CubeInit(&cube);
+
+    printf("----- HINT BENCHMARK -----\n");
+
+    double total = 0.0;
+    double slowest = 0.0;
+    for (u32 i = 0; i < count; i++) {
+        // Quietly, CubeHandScramble prints every turn
+        CubeSetSolved(&cube);
+        for (int t = 0; t < HINT_BENCHMARK_SCRAMBLE_LEN; t++) {
+            CubeTurn(&cube, GetRandomValue(0, TURN_TYPE_COUNT - 1));
+        }
+
+        HintResult result;
+        double start = TimeSeconds();
+        HintEvaluate(engine, &cube, &result);
+        double elapsed = TimeSeconds() - start;
+        total += elapsed;
+        slowest = MaxFloat(slowest, elapsed);
+
+        // Exact distances can only change by one per turn, and the bound
+        // can never be below the exact ones
+        for (int t = 0; t < TURN_TYPE_COUNT; t++) {
+            for (int kind = HINT_CROSS; kind <= HINT_PAIR; kind++) {
+                int delta = result.turn_distances[t][kind] - result.distances[kind];
+                assert(delta >= -1 && delta <= 1);
+            }
+            assert(result.turn_distances[t][HINT_CUBE] >= result.turn_distances[t][HINT_CROSS]);
+        }
+    }
+
+    double frame = 1.0 / 60.0;
+    printf("Cubes: %u, each with 18 children\n", count);
+    printf("Average: %f ms (%.2f%% of a 60fps frame)\n", total * 1000.0 / count, total / count / frame * 100.0);
+    printf("Slowest: %f ms\n\n", slowest * 1000.0);
+
+    HintFree(engine);
+    free(engine);
+}
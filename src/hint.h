@@ -0,0 +1,76 @@
+#ifndef HINT_H
+#define HINT_H
+
+
+#include "core.h"
+#include "cube.h"
+#include "pocket.h"
+
+
+// Every state ConvertToCrossCube can produce, 4 edges of 5 bits
+#define HINT_CROSS_STATE_COUNT (1 << 20)
+
+// A pair is tracked by where one sticker of its corner and one sticker of its
+// edge are, face * 8 + position each
+#define HINT_STICKER_COUNT (CUBE_COLOUR_COUNT * 8)
+#define HINT_PAIR_STATE_COUNT (HINT_STICKER_COUNT * HINT_STICKER_COUNT)
+#define HINT_PAIR_COUNT 4
+
+// Cross table, pair tables, pocket table and the BFS queue
+#define HINT_ARENA_SIZE Megabytes(3)
+
+// Pair value when every F2L pair is already in
+#define HINT_NO_PAIR HINT_PAIR_COUNT
+
+
+typedef enum {
+    HINT_CROSS,
+    HINT_PAIR,
+    HINT_CUBE,
+
+    HINT_KIND_COUNT
+} HintKind;
+
+// Distances for one cube and for each cube one turn away. Cross and pair are
+// exact, cube is a lower bound (the best of the cross, the corners as a 2x2
+// and every pair on its own).
+typedef struct {
+    u64 hash;
+    u8 pair;
+    u8 distances[HINT_KIND_COUNT];
+    u8 turn_distances[TURN_TYPE_COUNT][HINT_KIND_COUNT];
+} HintResult;
+
+// Tables are built by the worker the first time hints are asked for. While
+// busy is set the worker owns request and result; once it clears
+// the GUI copies result into shown, which is what gets drawn. The worker
+// thread is started on the first request and stays until HintFree.
+typedef struct {
+    Arena arena;
+    bool tables_ready;  // written by the worker, atomic loads anywhere else
+    u8* cross_distances;
+    u8* pair_distances[HINT_PAIR_COUNT];
+    u8 sticker_moves[TURN_TYPE_COUNT][HINT_STICKER_COUNT];
+    PocketTable pocket;
+
+    Worker worker;
+    u32 busy;
+    bool requested;
+    Cube request;
+    HintResult result;
+
+    bool shown_ready;
+    HintResult shown;
+} HintEngine;
+
+
+void HintInit(HintEngine* engine);
+void HintFree(HintEngine* engine);
+void HintTablesBuild(HintEngine* engine);
+void HintEvaluate(HintEngine* engine, Cube* cube, HintResult* result);
+void HintUpdate(HintEngine* engine, Cube* cube);
+void HintRender(HintEngine* engine, Cube* cube, Rectangle cube_rect);
+void HintBenchmark(u32 count);
+
+
+#endif  /* HINT_H */
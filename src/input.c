@@ -11,12 +11,17 @@ static const KeyboardKey input_keymap_table[INPUT_ACTION_COUNT] = {
 
     KEY_LEFT_SHIFT,
     KEY_LEFT_CONTROL,
+    KEY_LEFT_ALT,
 
     KEY_S,
     KEY_W,
     KEY_SPACE,
 
-    KEY_T
+    KEY_T,
+    KEY_P,
+    KEY_N,
+    KEY_X,
+    KEY_H
 };
 
 
@@ -16,12 +16,17 @@ typedef enum {
 
     INPUT_PRIME,
     INPUT_DOUBLE,
+    INPUT_WIDE,
 
     INPUT_SHUFFLE,
     INPUT_RESET,
     INPUT_SOLVE,
 
     INPUT_TEST,
+    INPUT_POCKET,
+    INPUT_SIZE,
+    INPUT_TRACE,
+    INPUT_HINT,
 
     INPUT_ACTION_COUNT
 } InputAction;
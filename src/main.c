@@ -1,7 +1,13 @@
+#include "algset.h"
+#include "bigcube.h"
 #include "core.h"
+#include "cpu.h"
 #include "cube.h"
+#include "hint.h"
 #include "input.h"
+#include "pocket.h"
 #include "solve.h"
+#include "trace.h"
 #include "raylib.h"
 
 
@@ -18,27 +24,65 @@ int main(void) {
 
     SetTargetFPS(WINDOW_FPS);
     SetRandomSeed(0);
+    CpuInit();
+    CubeZobristInit();
 
     Image icon = LoadImage("src/data/textures/icon.png");
     SetWindowIcon(icon);
 
-    Arena arena;
-    ArenaInit(&arena, Kilobytes(1));  // [ 24 / 1024 ] bytes used
-
     Arena arena_temp;
     ArenaInit(&arena_temp, Kilobytes(1));  // [ 256 / 1024 ] bytes used
 
     Arena arena_solve;
     ArenaInit(&arena_solve, Megabytes(5));  // [ ~4.3 / 5 ] megabytes used
 
+    // Only filled the first time 2x2 mode is turned on
+    Arena arena_pocket;
+    ArenaInit(&arena_pocket, Megabytes(2));  // [ ~1.0 / 2 ] megabytes used
+    PocketTable pocket_table;
+    bool pocket_ready = false;
+
+    // Moves for 4x4 and 5x5 solves. Separate since BigCubeSolve resets
+    // arena_solve when it hands over to the 3x3 solver
+    Arena arena_big;
+    ArenaInit(&arena_big, Kilobytes(17));  // [ 16 / 17 ] kilobytes used
+    TurnType* big_items = ArenaPushArray(&arena_big, BIG_MOVE_STACK_LEN, TurnType);
+    MoveStack big_moves;
+    MoveStack_init(&big_moves, big_items, BIG_MOVE_STACK_LEN);
+
+    // OLL and PLL come from here, and any F2L cases it overrides. Errors are
+    // printed with line numbers and the lines that did load are still used
+    Arena arena_algs;
+    ArenaInit(&arena_algs, Kilobytes(128));  // [ ~112 / 128 ] kilobytes used
+    AlgSet algs;
+    AlgSetLoad(&arena_algs, &algs, ALGSET_DEFAULT_PATH);
+    SolveUseAlgSet(&algs);
+
     // Only one cube for now
     Cube cube;
-    CubeInit(&arena, &cube);
+    CubeInit(&cube);
+
+    // So SPACE after a couple of turns undoes them instead of solving again
+    SolveCache solve_cache;
+    SolveCacheInit(&solve_cache);
+
+    // Tables are built on a worker thread the first time H is pressed, after
+    // that the same thread sleeps until the cube changes
+    HintEngine hints;
+    HintInit(&hints);
+    bool hinting = false;
+
+    // Used instead of cube when size is above 3
+    BigCube big;
+    u8 size = 3;
 
     CubeColour active_colour = CUBE_GREEN;
     bool testing = false;
+    bool pocket = false;
 
-    F2LTestLookup(&arena_solve, &cube);
+    // Cheap enough to leave on, a thread's ring is only allocated when it first
+    // records something. X writes out the most recent events
+    TraceInit();
 
     CubeSetSolved(&cube);
 
@@ -60,6 +104,7 @@ int main(void) {
             assert(CubeValid(&arena_temp, &cube));
             ArenaReset(&arena_temp);
             SolveCube(&arena_solve, &cube);
+            assert(CubeHash(&cube) == CubeHashCompute(&cube));
         } else {
             Vector2 mouse_position = GetMousePosition();
 
@@ -73,49 +118,138 @@ int main(void) {
                 testing = true;
             }
 
-            if (IsMouseButtonDown(MOUSE_BUTTON_LEFT)) {
+            if (InputPressed(INPUT_TRACE)) {
+                TraceWrite("trace.json");
+            }
+
+            if (InputPressed(INPUT_HINT)) {
+                hinting = !hinting;
+            }
+
+            bool revalidate = false;
+
+            if (size == 3 && InputPressed(INPUT_POCKET)) {
+                pocket = !pocket;
+                revalidate = true;
+
+                if (pocket && !pocket_ready) {
+                    PocketTableInit(&arena_pocket, &pocket_table, ThreadCount());
+                    pocket_ready = true;
+                }
+            }
+
+            if (InputPressed(INPUT_SIZE)) {
+                size = size == BIG_SOLVE_MAX_SIZE ? 3 : size + 1;
+                if (size > 3) {
+                    BigCubeSetSolved(&big, size);
+                    pocket = false;
+                }
+                revalidate = true;
+            }
+
+            // Painting is only for the 3x3 and 2x2
+            if (size == 3 && IsMouseButtonDown(MOUSE_BUTTON_LEFT)) {
                 CubeMousePaint(&cube, mouse_position, active_colour, cube_rect);
+                SolveCacheForget(&solve_cache);
+                revalidate = true;
+            }
 
-                valid = CubeValid(&arena_temp, &cube);
-                ArenaReset(&arena_temp);
+            if (revalidate) {
+                // A 2x2 only needs valid corners
+                if (size > 3) {
+                    valid = true;
+                } else if (pocket) {
+                    valid = PocketCoordFromCube(&cube) != POCKET_COORD_INVALID;
+                } else {
+                    valid = CubeValid(&arena_temp, &cube);
+                    ArenaReset(&arena_temp);
+                }
             }
 
             if (InputPressed(INPUT_RESET)) {
                 CubeSetSolved(&cube);
+                SolveCacheForget(&solve_cache);
+                if (size > 3) BigCubeSetSolved(&big, size);
                 valid = true;
             }
 
-            if (valid) {
+            if (size > 3) {
+                for (u8 i = 0; i < CUBE_COLOUR_COUNT; i++) {
+                    if (InputPressed(i)) {
+                        TurnType turn = i;
+                        if (InputDown(INPUT_PRIME)) {
+                            turn += TURN_FRONT_PRIME;
+                        } else if (InputDown(INPUT_DOUBLE)) {
+                            turn += TURN_FRONT_DOUBLE;
+                        }
+                        BigCubeTurn(&big, BigTurnMake(turn, InputDown(INPUT_WIDE) ? 2 : 1, true));
+                    }
+                }
+
+                if (InputPressed(INPUT_SHUFFLE)) {
+                    BigCubeScramble(&big, size * 10);
+                }
+
+                if (InputPressed(INPUT_SOLVE)) {
+                    MoveStack_clear(&big_moves);
+                    BigCubeSolve(&arena_solve, &big, &big_moves);
+                }
+            } else if (valid) {
                 for (u8 i = 0; i < CUBE_COLOUR_COUNT; i++) {
                     if (InputPressed(i)) {
                         if (InputDown(INPUT_PRIME)) {
                             CubeFaceTurnAntiClockwise(&cube, i);
+                            SolveCacheTurn(&solve_cache, i + TURN_FRONT_PRIME);
                         } else if (InputDown(INPUT_DOUBLE)) {
                             CubeFaceTurnDouble(&cube, i);
+                            SolveCacheTurn(&solve_cache, i + TURN_FRONT_DOUBLE);
                         } else {
                             CubeFaceTurnClockwise(&cube, i);
+                            SolveCacheTurn(&solve_cache, i);
                         }
                     }
                 }
 
                 if (InputPressed(INPUT_SHUFFLE)) {
                     CubeHandScramble(&cube);
+                    SolveCacheForget(&solve_cache);
                 }
             }
 
-            if (valid && InputPressed(INPUT_SOLVE)) {
-                SolveCube(&arena_solve, &cube);
+            if (size == 3 && valid && InputPressed(INPUT_SOLVE)) {
+                if (pocket) {
+                    ArenaReset(&arena_solve);
+                    TurnType* items = ArenaPushArray(&arena_solve, POCKET_MAX_MOVES, TurnType);
+                    MoveStack moves;
+                    MoveStack_init(&moves, items, POCKET_MAX_MOVES);
+                    PocketSolveCube(&pocket_table, &moves, &cube);
+                    SolveCacheForget(&solve_cache);
+                } else {
+                    SolveCubeCached(&arena_solve, &solve_cache, &cube);
+                }
             }
         }
 
+        // Only for a real 3x3, and not while it's changing every frame
+        bool show_hints = hinting && !testing && size == 3 && !pocket && valid;
+        if (show_hints) {
+            HintUpdate(&hints, &cube);
+        }
+
         // RENDER
         BeginDrawing();
             ClearBackground(GRAY);
-            CubeRender(&cube, cube_rect, valid);
+            if (size > 3) {
+                BigCubeRender(&big, cube_rect);
+            } else {
+                CubeRender(&cube, cube_rect, valid, pocket);
+                if (show_hints) HintRender(&hints, &cube, cube_rect);
+            }
             DrawRectangleLinesEx(cube_rect, 2.0f, CubeFaceColour(active_colour));
         EndDrawing();
     }
 
+    HintFree(&hints);
     CloseWindow();
 }
 
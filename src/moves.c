@@ -0,0 +1,138 @@
+// Compact storage for solutions. A MoveStack spends 4 bytes on every turn and
+// has a fixed capacity, fine for one solve at a time but not for keeping
+// millions of solutions around. MoveBuffer stores a byte per turn and grows.
+//
+// Formatting is done with a table of every turn name padded to 8 bytes, so
+// each turn is one 8 byte copy and a length add with no branching on the
+// turn. Output is space separated.
+
+
+#include "moves.h"
+#include "bigcube.h"
+
+
+typedef struct {
+    char name[MOVE_NAME_STRIDE];
+    u8 length;
+} MoveName;
+
+
+static MoveName MOVE_NAME_TABLE[BIG_TURN_COUNT];
+static bool move_names_initialised = false;
+
+
+static void MoveNamesInit(void) {
+    for (TurnType turn = 0; turn < BIG_TURN_COUNT; turn++) {
+        MoveName* entry = &MOVE_NAME_TABLE[turn];
+        MemZero(entry->name, MOVE_NAME_STRIDE);
+
+        // Name then a space
+        entry->length = BigTurnFormat(turn, entry->name);
+        entry->name[entry->length++] = ' ';
+        assert(entry->length <= MOVE_NAME_STRIDE);
+    }
+    move_names_initialised = true;
+}
+
+void MoveBufferInit(MoveBuffer* buffer, Arena* arena, u32 capacity) {
+    assert(capacity > 0);
+
+    buffer->arena = arena;
+    buffer->turns = ArenaPushArray(arena, capacity, u8);
+    buffer->length = 0;
+    buffer->capacity = capacity;
+}
+
+void MoveBufferClear(MoveBuffer* buffer) {
+    buffer->length = 0;
+}
+
+static void MoveBufferGrow(MoveBuffer* buffer, u32 needed) {
+    u32 capacity = buffer->capacity;
+    while (capacity < needed) capacity *= 2;
+
+    Arena* arena = buffer->arena;
+    u8* end = buffer->turns + buffer->capacity;
+
+    if (end == arena->base + arena->used && arena->used + (capacity - buffer->capacity) <= arena->size) {
+        // Nothing pushed since so just take more of the arena
+        arena->used += capacity - buffer->capacity;
+    } else {
+        u8* turns = ArenaPushArray(arena, capacity, u8);
+        MemCopy(turns, buffer->turns, buffer->length);
+        buffer->turns = turns;
+    }
+
+    buffer->capacity = capacity;
+}
+
+void MoveBufferPush(MoveBuffer* buffer, TurnType turn) {
+    assert(turn < BIG_TURN_COUNT);
+
+    if (buffer->length == buffer->capacity) {
+        MoveBufferGrow(buffer, buffer->length + 1);
+    }
+    buffer->turns[buffer->length++] = turn;
+}
+
+void MoveBufferPushArray(MoveBuffer* buffer, const u8* turns, u32 count) {
+    if (buffer->length + count > buffer->capacity) {
+        MoveBufferGrow(buffer, buffer->length + count);
+    }
+    for (u32 i = 0; i < count; i++) {
+        buffer->turns[buffer->length++] = turns[i];
+    }
+}
+
+TurnType MoveBufferGet(MoveBuffer* buffer, u32 index) {
+    assert(index < buffer->length);
+    return buffer->turns[index];
+}
+
+u32 MoveBufferLength(MoveBuffer* buffer) {
+    return buffer->length;
+}
+
+// Appends every turn in the stack
+void MoveBufferFromStack(MoveBuffer* buffer, MoveStack* moves) {
+    u32 length = MoveStack_length(moves);
+    if (buffer->length + length > buffer->capacity) {
+        MoveBufferGrow(buffer, buffer->length + length);
+    }
+    for (u32 i = 0; i < length; i++) {
+        buffer->turns[buffer->length++] = moves->items[i];
+    }
+}
+
+// Appends every turn to the stack, false (and nothing appended) if they don't fit
+bool MoveBufferToStack(MoveBuffer* buffer, MoveStack* moves) {
+    if (MoveStack_length(moves) + buffer->length > moves->capacity) return false;
+
+    for (u32 i = 0; i < buffer->length; i++) {
+        MoveStack_append(moves, buffer->turns[i]);
+    }
+    return true;
+}
+
+// Writes the turns space separated and null terminated. out needs
+// MoveBufferFormatSize(count) bytes. Returns the length without the null.
+u64 MoveFormat(const u8* turns, u32 count, char* out) {
+    if (!move_names_initialised) MoveNamesInit();
+
+    u64 length = 0;
+    for (u32 i = 0; i < count; i++) {
+        const MoveName* entry = &MOVE_NAME_TABLE[turns[i]];
+        __builtin_memcpy(out + length, entry->name, MOVE_NAME_STRIDE);
+        length += entry->length;
+    }
+
+    // Drop the trailing space
+    if (length > 0) length--;
+    out[length] = '\0';
+
+    return length;
+}
+
+u64 MoveBufferFormat(MoveBuffer* buffer, char* out) {
+    return MoveFormat(buffer->turns, buffer->length, out);
+}
@@ -0,0 +1,44 @@
+#ifndef MOVES_H
+#define MOVES_H
+
+
+#include "core.h"
+#include "cube.h"
+#include "solve.h"
+
+
+// Longest turn name plus the space after it. Names are stored padded to this
+// so formatting can copy a fixed 8 bytes per turn.
+#define MOVE_NAME_STRIDE 8
+
+// Turns formatted at most, needs MOVE_NAME_STRIDE bytes each in the worst case
+#define MoveBufferFormatSize(count) ((u64) (count) * MOVE_NAME_STRIDE + 1)
+
+
+// One byte per turn with an explicit length, so a quarter the size of a
+// MoveStack and with no fixed limit. Holds any TurnType including big cube
+// turns, which is why it isn't packed tighter than a byte. When full it grows
+// in its arena, in place if it was the last thing pushed.
+typedef struct {
+    Arena* arena;
+    u8* turns;
+    u32 length;
+    u32 capacity;
+} MoveBuffer;
+
+
+void MoveBufferInit(MoveBuffer* buffer, Arena* arena, u32 capacity);
+void MoveBufferClear(MoveBuffer* buffer);
+void MoveBufferPush(MoveBuffer* buffer, TurnType turn);
+void MoveBufferPushArray(MoveBuffer* buffer, const u8* turns, u32 count);
+TurnType MoveBufferGet(MoveBuffer* buffer, u32 index);
+u32 MoveBufferLength(MoveBuffer* buffer);
+
+void MoveBufferFromStack(MoveBuffer* buffer, MoveStack* moves);
+bool MoveBufferToStack(MoveBuffer* buffer, MoveStack* moves);
+
+u64 MoveFormat(const u8* turns, u32 count, char* out);
+u64 MoveBufferFormat(MoveBuffer* buffer, char* out);
+
+
+#endif  /* MOVES_H */
@@ -0,0 +1,303 @@
+// Batch 3x3 solving two ways, to see which treats the cache better.
+//
+// The pool is the usual ParallelRun: every thread grabs a chunk of cubes and
+// takes each one through all four stages, so every core cycles through the
+// cross BFS memory, the F2L tables and the algorithm set maps once per cube.
+//
+// The pipeline gives each group of stages a thread of its own: cross, F2L,
+// then OLL and PLL together as the last layer. A cube and its half filled
+// MoveStack live in a slot, and the slot's index goes down the line through
+// a single producer single consumer ring between each pair of stages. So
+// each thread only ever touches its own stage's memory and the slots passing
+// through. The rings are two counters and an array, the producer only writes
+// head and the consumer only writes tail, each on its own cache line.
+//
+// Three threads is all the pipeline can use, and it's only as quick as its
+// slowest stage, so the stage times are printed to show how even it is.
+
+
+#include "pipeline.h"
+
+#include <sched.h>
+
+
+// Cubes a pool thread takes at a time
+#define PIPELINE_POOL_CHUNK 8
+
+// Turns in each benchmark scramble, as CubeHandScramble does
+#define PIPELINE_SCRAMBLE_LENGTH 25
+
+// Tries before a thread waiting on a ring gives up its core. On a machine
+// with fewer cores than stages the other end can't run until it does.
+#define PIPELINE_SPIN_LIMIT 256
+
+#define PIPELINE_CACHE_LINE 64
+
+
+typedef struct {
+    alignas(PIPELINE_CACHE_LINE) u32 head;
+    alignas(PIPELINE_CACHE_LINE) u32 tail;
+    alignas(PIPELINE_CACHE_LINE) u32 items[PIPELINE_RING_LEN];
+} PipelineRing;
+
+typedef struct {
+    PipelineSlot* slots;
+    u32 count;
+    u32 next_chunk;
+    PipelineRing rings[PIPELINE_STAGE_COUNT - 1];
+    PipelineStats* stats;
+} PipelineJob;
+
+
+static const char* PIPELINE_STAGE_NAMES[PIPELINE_STAGE_COUNT] = {
+    "cross", "f2l", "last layer"
+};
+
+
+static void PipelineWait(u32* spins) {
+    if (++(*spins) < PIPELINE_SPIN_LIMIT) {
+#ifdef __SSE2__
+        _mm_pause();
+#endif
+    } else {
+        sched_yield();
+    }
+}
+
+static void PipelineRingPush(PipelineRing* ring, u32 item) {
+    u32 head = ring->head;
+    u32 spins = 0;
+    while (head - __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE) == PIPELINE_RING_LEN) {
+        PipelineWait(&spins);
+    }
+
+    ring->items[head % PIPELINE_RING_LEN] = item;
+    __atomic_store_n(&ring->head, head + 1, __ATOMIC_RELEASE);
+}
+
+static u32 PipelineRingPop(PipelineRing* ring) {
+    u32 tail = ring->tail;
+    u32 spins = 0;
+    while (__atomic_load_n(&ring->head, __ATOMIC_ACQUIRE) == tail) {
+        PipelineWait(&spins);
+    }
+
+    u32 item = ring->items[tail % PIPELINE_RING_LEN];
+    __atomic_store_n(&ring->tail, tail + 1, __ATOMIC_RELEASE);
+    return item;
+}
+
+static void PipelineSolveSlot(PipelineStage stage, Arena* arena, PipelineSlot* slot) {
+    switch (stage) {
+        case PIPELINE_STAGE_CROSS:
+            ArenaReset(arena);
+            SolveStageRun(SOLVE_STAGE_CROSS, arena, &slot->moves, &slot->cube);
+            break;
+        case PIPELINE_STAGE_F2L:
+            SolveStageRun(SOLVE_STAGE_F2L, arena, &slot->moves, &slot->cube);
+            break;
+        case PIPELINE_STAGE_LAST_LAYER:
+            SolveStageRun(SOLVE_STAGE_OLL, arena, &slot->moves, &slot->cube);
+            SolveStageRun(SOLVE_STAGE_PLL, arena, &slot->moves, &slot->cube);
+            break;
+        default:
+            assert(false && "Unknown pipeline stage!");
+    }
+}
+
+static void PipelinePoolWorker(void* data, u32 thread_index, u32 thread_count) {
+    PipelineJob* job = (PipelineJob*) data;
+
+    // Made here so its pages are first touched by the thread using them
+    Arena arena;
+    ArenaInit(&arena, PIPELINE_ARENA_SIZE);
+
+    for (;;) {
+        u32 start = __atomic_fetch_add(&job->next_chunk, 1, __ATOMIC_RELAXED) * PIPELINE_POOL_CHUNK;
+        if (start >= job->count) break;
+        u32 end = MinU32(start + PIPELINE_POOL_CHUNK, job->count);
+
+        TraceBegin("pool chunk");
+        for (u32 i = start; i < end; i++) {
+            for (int stage = 0; stage < PIPELINE_STAGE_COUNT; stage++) {
+                PipelineSolveSlot(stage, &arena, &job->slots[i]);
+            }
+        }
+        TraceEnd("pool chunk");
+    }
+
+    ArenaFree(&arena);
+}
+
+static void PipelineStageWorker(void* data, u32 thread_index, u32 thread_count) {
+    PipelineJob* job = (PipelineJob*) data;
+    PipelineStage stage = thread_index;
+    PipelineRing* in = stage > 0 ? &job->rings[stage - 1] : NULL;
+    PipelineRing* out = stage + 1 < PIPELINE_STAGE_COUNT ? &job->rings[stage] : NULL;
+
+    Arena arena;
+    ArenaInit(&arena, stage == PIPELINE_STAGE_CROSS ? PIPELINE_ARENA_SIZE : Kilobytes(4));
+
+    double busy = 0.0;
+    double waiting = 0.0;
+    for (u32 i = 0; i < job->count; i++) {
+        double start = TimeSeconds();
+        u32 index = in != NULL ? PipelineRingPop(in) : i;
+        double popped = TimeSeconds();
+
+        TraceBegin(PIPELINE_STAGE_NAMES[stage]);
+        PipelineSolveSlot(stage, &arena, &job->slots[index]);
+        TraceEnd(PIPELINE_STAGE_NAMES[stage]);
+        double solved = TimeSeconds();
+
+        if (out != NULL) PipelineRingPush(out, index);
+
+        busy += solved - popped;
+        waiting += (popped - start) + (TimeSeconds() - solved);
+    }
+
+    job->stats->stage_busy[stage] = busy;
+    job->stats->stage_waiting[stage] = waiting;
+    ArenaFree(&arena);
+}
+
+// Concurrent for shares that wait on each other, false if they couldn't all
+// be given a thread and nothing was run
+static bool PipelineRunTimed(
+    PipelineJob* job, u32 thread_count, ParallelFunction func, bool concurrent, PipelineStats* stats
+) {
+    TraceCacheCounters counters;
+    stats->cache_counted = TraceCacheStart(&counters);
+    double start = TimeSeconds();
+
+    bool ran = true;
+    if (concurrent) {
+        ran = ParallelRunConcurrent(thread_count, func, job);
+    } else {
+        ParallelRun(thread_count, func, job);
+    }
+
+    stats->seconds = TimeSeconds() - start;
+    TraceCacheStop(&counters, &stats->cache);
+
+    stats->moves = 0;
+    for (u32 i = 0; i < job->count; i++) {
+        stats->moves += MoveStack_length(&job->slots[i].moves);
+    }
+    return ran;
+}
+
+void PipelineSolvePool(PipelineSlot* slots, u32 count, u32 thread_count, PipelineStats* stats) {
+    *stats = (PipelineStats) { .count = count, .thread_count = thread_count };
+    PipelineJob job = { .slots = slots, .count = count, .next_chunk = 0, .stats = stats };
+
+    TraceBegin("pipeline pool");
+    PipelineRunTimed(&job, thread_count, PipelinePoolWorker, false, stats);
+    TraceEnd("pipeline pool");
+}
+
+void PipelineSolveStaged(PipelineSlot* slots, u32 count, PipelineStats* stats) {
+#ifdef PLATFORM_WEB
+    // Stages wait on each other so they can't take turns on one thread
+    PipelineSolvePool(slots, count, 1, stats);
+#else
+    *stats = (PipelineStats) { .count = count, .thread_count = PIPELINE_STAGE_COUNT };
+    PipelineJob job = { .slots = slots, .count = count, .next_chunk = 0, .stats = stats };
+
+    TraceBegin("pipeline staged");
+    bool ran = PipelineRunTimed(&job, PIPELINE_STAGE_COUNT, PipelineStageWorker, true, stats);
+    TraceEnd("pipeline staged");
+
+    // A stage run on the same thread as the one before it would wait forever
+    if (!ran) {
+        printf("Couldn't start a thread for every stage, solving pooled instead\n");
+        PipelineSolvePool(slots, count, PIPELINE_STAGE_COUNT, stats);
+    }
+#endif
+}
+
+static u64 PipelineRandom(u64* state) {
+    u64 x = *state;
+    x ^= x >> 12;
+    x ^= x << 25;
+    x ^= x >> 27;
+    *state = x;
+    return x * 0x2545F4914F6CDD1Dull;
+}
+
+// Same shape of scramble as CubeHandScramble, but seeded and quiet
+static void PipelineScramble(u64* random, Cube* cube) {
+    CubeSetSolved(cube);
+    u8 last_face = PipelineRandom(random) % CUBE_COLOUR_COUNT;
+    for (int i = 0; i < PIPELINE_SCRAMBLE_LENGTH; i++) {
+        u8 face = PipelineRandom(random) % (CUBE_COLOUR_COUNT - 1);
+        if (face >= last_face) face++;
+        u8 direction = PipelineRandom(random) % 3;
+        CubeTurn(cube, direction * TURN_FRONT_PRIME + face);
+        last_face = face;
+    }
+}
+
+static void PipelineReport(const char* name, PipelineStats* stats) {
+    printf(
+        "%-9s %2u threads: %f seconds, %.0f solves/second, %.1f moves/solve\n", name, stats->thread_count,
+        stats->seconds, stats->count / stats->seconds, (double) stats->moves / stats->count
+    );
+    if (!stats->cache_counted) {
+        printf("          LLC: no hardware counters here\n");
+        return;
+    }
+    printf(
+        "          LLC: %llu references, %llu misses (%.1f%%), %.0f misses/solve\n",
+        (unsigned long long) stats->cache.references, (unsigned long long) stats->cache.misses,
+        stats->cache.references > 0 ? 100.0 * stats->cache.misses / stats->cache.references : 0.0,
+        (double) stats->cache.misses / stats->count
+    );
+}
+
+void PipelineBenchmark(Arena* arena, u32 count, u32 thread_count, u64 seed) {
+    printf("----- PIPELINE BENCHMARK -----\n");
+
+    PipelineSlot* pooled = ArenaPushArray(arena, count, PipelineSlot);
+    PipelineSlot* staged = ArenaPushArray(arena, count, PipelineSlot);
+    u64 random = HashU64(seed) | 1;
+    Cube cube;
+    CubeInit(&cube);
+    for (u32 i = 0; i < count; i++) {
+        PipelineScramble(&random, &cube);
+        pooled[i].cube = cube;
+        staged[i].cube = cube;
+        MoveStack_init(&pooled[i].moves, pooled[i].items, MOVE_STACK_LEN);
+        MoveStack_init(&staged[i].moves, staged[i].items, MOVE_STACK_LEN);
+    }
+
+    PipelineStats pool_stats;
+    PipelineStats staged_stats;
+    PipelineSolvePool(pooled, count, thread_count, &pool_stats);
+    PipelineSolveStaged(staged, count, &staged_stats);
+
+    // Same solver either way so the answers have to match move for move
+    u32 mismatched = 0;
+    u32 unsolved = 0;
+    for (u32 i = 0; i < count; i++) {
+        u32 length = MoveStack_length(&pooled[i].moves);
+        if (length != MoveStack_length(&staged[i].moves)
+            || MemCmp(pooled[i].items, staged[i].items, length * sizeof(TurnType)) != 0) {
+            mismatched++;
+        }
+        if (!IsPLLSolved(&staged[i].cube)) unsolved++;
+    }
+
+    printf("Cubes: %u, seed %llu\n", count, (unsigned long long) seed);
+    PipelineReport("Pool", &pool_stats);
+    PipelineReport("Pipeline", &staged_stats);
+    for (int s = 0; s < PIPELINE_STAGE_COUNT; s++) {
+        double busy = staged_stats.stage_busy[s];
+        double total = busy + staged_stats.stage_waiting[s];
+        printf(
+            "  %-10s busy %f seconds (%.0f%%), %.1f us/cube\n", PIPELINE_STAGE_NAMES[s], busy,
+            total > 0.0 ? 100.0 * busy / total : 0.0, busy * 1e6 / count
+        );
+    }
+    printf("Solutions that differ: %u, left unsolved: %u\n\n", mismatched, unsolved);
+}
@@ -0,0 +1,64 @@
+#ifndef PIPELINE_H
+#define PIPELINE_H
+
+
+#include "core.h"
+#include "algset.h"
+#include "cube.h"
+#include "solve.h"
+#include "trace.h"
+
+
+// Cubes that can be waiting between two stages, a power of two
+#define PIPELINE_RING_LEN 64
+
+// Threads the pipeline runs on, one per stage group
+typedef enum {
+    PIPELINE_STAGE_CROSS,
+    PIPELINE_STAGE_F2L,
+    PIPELINE_STAGE_LAST_LAYER,
+
+    PIPELINE_STAGE_COUNT
+} PipelineStage;
+
+// Scratch each solving thread needs, the cross BFS is most of it
+#define PIPELINE_ARENA_SIZE Megabytes(5)
+
+// The benchmark's cubes, solved once each way
+#define PipelineArenaSize(count) (Kilobytes(64) + (u64) (count) * 2 * sizeof(PipelineSlot))
+
+
+// A cube on its way through the solver and the moves found for it so far
+typedef struct {
+    Cube cube;
+    MoveStack moves;
+    TurnType items[MOVE_STACK_LEN];
+} PipelineSlot;
+
+typedef struct {
+    u32 count;
+    u32 thread_count;
+    double seconds;
+    TraceCacheCounts cache;
+    bool cache_counted;
+    u64 moves;
+
+    // Pipeline only, time each stage thread spent solving vs waiting
+    double stage_busy[PIPELINE_STAGE_COUNT];
+    double stage_waiting[PIPELINE_STAGE_COUNT];
+} PipelineStats;
+
+
+// Both solve slots[0, count) in place with the stages of SolveCube. The pool
+// takes each cube through every stage on whichever of thread_count threads
+// grabbed it. The pipeline has a thread per stage group passing cubes along
+// through rings. The algorithm set comes from SolveUseAlgSet.
+void PipelineSolvePool(PipelineSlot* slots, u32 count, u32 thread_count, PipelineStats* stats);
+void PipelineSolveStaged(PipelineSlot* slots, u32 count, PipelineStats* stats);
+
+// Solves count random cubes both ways, compares the answers and prints
+// throughput and last level cache misses for each
+void PipelineBenchmark(Arena* arena, u32 count, u32 thread_count, u64 seed);
+
+
+#endif  /* PIPELINE_H */
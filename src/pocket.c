@@ -0,0 +1,641 @@
+// The 2x2 (pocket cube) is just the corners of the 3x3, so this reuses the
+// corner lookup tables from cube.c to read the pieces off a normal Cube and
+// ignores edges and centres.
+//
+// With no centres the whole cube can be rotated freely, so one corner (DBL) is
+// held still and only F, R and U are turned. That leaves 7! * 3^6 =
+// 3,674,160 states, small enough to store the distance to solved for every
+// single one. Each distance is stored mod 3 in 2 bits (3 means unvisited) so
+// the whole table is under 1MB. Mod 3 is enough because a neighbour of a state
+// at depth d is at depth d-1, d or d+1, and those are all different mod 3.
+// Solving is then a greedy descent: keep taking any turn that lands on a state
+// with value (current - 1) mod 3 until solved, at most 11 steps.
+//
+// The table is generated by a layered BFS split across threads. Early layers
+// expand forwards from the frontier. Once the frontier is bigger than what is
+// left unvisited it is faster to scan the unvisited states and check if any
+// neighbour is in the frontier.
+
+
+#include "pocket.h"
+#include "cpu.h"
+#include "moves.h"
+#include "trace.h"
+
+
+#define POCKET_FIXED_SLOT 4
+#define POCKET_MOVING_SLOTS 7
+#define POCKET_WORD_STATES 16
+#define POCKET_WORD_COUNT (POCKET_STATE_COUNT / POCKET_WORD_STATES)
+
+// Words of the distance table handed to a thread at a time during BFS
+#define POCKET_BFS_CHUNK 1024
+
+// States handed to a thread at a time during batch solves
+#define POCKET_BATCH_CHUNK 4096
+
+// Coordinates are under 2^22, sorted 11 bits at a time
+#define POCKET_SORT_DIGIT_BITS 11
+#define POCKET_SORT_PASSES 2
+#define POCKET_SORT_DIGITS (1 << POCKET_SORT_DIGIT_BITS)
+
+#define POCKET_UNVISITED 3
+
+
+static const int CORNER_COUNT = 8;
+
+// Slots (and pieces) that are allowed to move, in coordinate order
+static const u8 POCKET_SLOTS[POCKET_MOVING_SLOTS] = { 0, 1, 2, 3, 5, 6, 7 };
+static const u8 POCKET_PIECE_RANK[8] = { 0, 1, 2, 3, UINT8_MAX, 4, 5, 6 };
+
+const enum8(TurnType) POCKET_TURNS[POCKET_TURN_COUNT] = {
+    TURN_FRONT, TURN_RIGHT, TURN_UP,
+    TURN_FRONT_PRIME, TURN_RIGHT_PRIME, TURN_UP_PRIME,
+    TURN_FRONT_DOUBLE, TURN_RIGHT_DOUBLE, TURN_UP_DOUBLE
+};
+
+
+typedef struct {
+    PocketTable* table;
+    u8 depth;
+    bool backward;
+    u32 next_chunk;
+    u32 found;
+} PocketLayerJob;
+
+typedef struct {
+    PocketTable* table;
+    const u32* coords;
+    u32 count;
+    u8* lengths;
+    enum8(TurnType)* moves;
+    u32 next_chunk;
+} PocketBatchJob;
+
+
+// Finds the piece and twist in every corner slot, passing every tile colour
+// through colour_map first. Twist is how far the piece's white/yellow tile is
+// rotated from the slot's first tile, same as F2LCornerSlot in solve.c.
+static bool PocketReadCorners(
+    Cube* cube, const u8* colour_map, u8* pieces, u8* twists
+) {
+    for (int slot = 0; slot < CORNER_COUNT; slot++) {
+        u8 colours[3];
+        for (int k = 0; k < 3; k++) {
+            CubeColour face = CUBE_CORNER_COLOUR_TABLE[slot * 3 + k];
+            u8 position = CUBE_CORNER_POSITION_TABLE[slot * 3 + k];
+            colours[k] = colour_map[FaceGetTile(cube->faces[face], position)];
+        }
+
+        bool found = false;
+        for (int piece = 0; piece < CORNER_COUNT && !found; piece++) {
+            const enum8(CubeColour)* target = &CUBE_CORNER_COLOUR_TABLE[piece * 3];
+            for (int twist = 0; twist < 3; twist++) {
+                if (
+                    colours[0] == target[twist] &&
+                    colours[1] == target[(twist + 1) % 3] &&
+                    colours[2] == target[(twist + 2) % 3]
+                ) {
+                    pieces[slot] = piece;
+                    twists[slot] = twist;
+                    found = true;
+                    break;
+                }
+            }
+        }
+
+        if (!found) return false;
+    }
+
+    return true;
+}
+
+static u16 PocketPermEncode(const u8* pieces) {
+    // Lehmer code of the seven moving slots
+    u16 coord = 0;
+    for (int i = 0; i < POCKET_MOVING_SLOTS; i++) {
+        u8 rank = POCKET_PIECE_RANK[pieces[POCKET_SLOTS[i]]];
+        u8 smaller = 0;
+        for (int j = i + 1; j < POCKET_MOVING_SLOTS; j++) {
+            if (POCKET_PIECE_RANK[pieces[POCKET_SLOTS[j]]] < rank) smaller++;
+        }
+        coord = coord * (POCKET_MOVING_SLOTS - i) + smaller;
+    }
+    return coord;
+}
+
+static void PocketPermDecode(u16 coord, u8* pieces) {
+    u8 digits[POCKET_MOVING_SLOTS];
+    for (int i = POCKET_MOVING_SLOTS - 1; i >= 0; i--) {
+        digits[i] = coord % (POCKET_MOVING_SLOTS - i);
+        coord /= (POCKET_MOVING_SLOTS - i);
+    }
+
+    // Digit i is how many of the remaining pieces are smaller
+    u8 remaining[POCKET_MOVING_SLOTS];
+    MemCopy(remaining, (void*) POCKET_SLOTS, POCKET_MOVING_SLOTS);
+    int remaining_count = POCKET_MOVING_SLOTS;
+
+    for (int i = 0; i < POCKET_MOVING_SLOTS; i++) {
+        pieces[POCKET_SLOTS[i]] = remaining[digits[i]];
+        for (int j = digits[i]; j < remaining_count - 1; j++) {
+            remaining[j] = remaining[j + 1];
+        }
+        remaining_count--;
+    }
+    pieces[POCKET_FIXED_SLOT] = POCKET_FIXED_SLOT;
+}
+
+static u16 PocketTwistEncode(const u8* twists) {
+    // Last moving slot is implied as total twist is always 0 mod 3
+    u16 coord = 0;
+    for (int i = POCKET_MOVING_SLOTS - 2; i >= 0; i--) {
+        coord = coord * 3 + twists[POCKET_SLOTS[i]];
+    }
+    return coord;
+}
+
+static void PocketTwistDecode(u16 coord, u8* twists) {
+    u8 total = 0;
+    for (int i = 0; i < POCKET_MOVING_SLOTS - 1; i++) {
+        twists[POCKET_SLOTS[i]] = coord % 3;
+        total += coord % 3;
+        coord /= 3;
+    }
+    twists[POCKET_SLOTS[POCKET_MOVING_SLOTS - 1]] = (3 - total % 3) % 3;
+    twists[POCKET_FIXED_SLOT] = 0;
+}
+
+// Applies a turn that moved the piece in slot src[i] to slot i and added
+// delta[i] to its twist
+static void PocketApplyEffect(
+    const u8* src, const u8* delta, u8* pieces, u8* twists
+) {
+    u8 old_pieces[8];
+    u8 old_twists[8];
+    MemCopy(old_pieces, pieces, CORNER_COUNT);
+    MemCopy(old_twists, twists, CORNER_COUNT);
+
+    for (int slot = 0; slot < CORNER_COUNT; slot++) {
+        pieces[slot] = old_pieces[src[slot]];
+        twists[slot] = (old_twists[src[slot]] + delta[slot]) % 3;
+    }
+}
+
+static void PocketBuildMoveTables(PocketTable* table) {
+    u8 identity[CUBE_COLOUR_COUNT + 1];
+    for (int i = 0; i <= CUBE_COLOUR_COUNT; i++) identity[i] = i;
+
+    // Read what each turn does to the corners straight off a turned cube so
+    // this always agrees with CubeTurn
+    u8 src[POCKET_TURN_COUNT][8];
+    u8 delta[POCKET_TURN_COUNT][8];
+    Cube cube;
+    CubeInit(&cube);
+    for (int m = 0; m < POCKET_TURN_COUNT; m++) {
+        CubeSetSolved(&cube);
+        CubeTurn(&cube, POCKET_TURNS[m]);
+        bool read = PocketReadCorners(&cube, identity, src[m], delta[m]);
+        assert(read && src[m][POCKET_FIXED_SLOT] == POCKET_FIXED_SLOT);
+        (void) read;
+    }
+
+    u8 pieces[8];
+    u8 twists[8];
+    for (int perm = 0; perm < POCKET_PERM_COUNT; perm++) {
+        for (int m = 0; m < POCKET_TURN_COUNT; m++) {
+            PocketPermDecode(perm, pieces);
+            MemZero(twists, CORNER_COUNT);
+            PocketApplyEffect(src[m], delta[m], pieces, twists);
+            table->perm_moves[perm * POCKET_TURN_COUNT + m] = PocketPermEncode(pieces);
+        }
+    }
+    for (int twist = 0; twist < POCKET_TWIST_COUNT; twist++) {
+        for (int m = 0; m < POCKET_TURN_COUNT; m++) {
+            PocketPermDecode(0, pieces);
+            PocketTwistDecode(twist, twists);
+            PocketApplyEffect(src[m], delta[m], pieces, twists);
+            table->twist_moves[twist * POCKET_TURN_COUNT + m] = PocketTwistEncode(twists);
+        }
+    }
+}
+
+static u8 PocketGetDistance(const u32* distances, u32 state) {
+    u32 word = __atomic_load_n(&distances[state / POCKET_WORD_STATES], __ATOMIC_RELAXED);
+    return (word >> ((state % POCKET_WORD_STATES) * 2)) & 3;
+}
+
+// Entries only ever go from unvisited (3) to a value so clearing bits with an
+// atomic AND is safe with many threads writing. Returns true if this call was
+// the one that visited the state.
+static bool PocketSetDistance(u32* distances, u32 state, u8 value) {
+    u32 shift = (state % POCKET_WORD_STATES) * 2;
+    u32 mask = ~((u32) (POCKET_UNVISITED ^ value) << shift);
+    u32 old = __atomic_fetch_and(&distances[state / POCKET_WORD_STATES], mask, __ATOMIC_RELAXED);
+    return ((old >> shift) & 3) == POCKET_UNVISITED;
+}
+
+// True if any of the sixteen 2 bit entries in word equal value
+static bool PocketWordHas(u32 word, u8 value) {
+    u32 x = word ^ (value * 0x55555555u);
+    return ((x | (x >> 1)) & 0x55555555u) != 0x55555555u;
+}
+
+static void PocketLayerWorker(void* data, u32 thread_index, u32 thread_count) {
+    PocketLayerJob* job = (PocketLayerJob*) data;
+    PocketTable* table = job->table;
+    u32* distances = table->distances;
+
+    u8 current = job->depth % 3;
+    u8 next = (job->depth + 1) % 3;
+    u8 scan = job->backward ? POCKET_UNVISITED : current;
+    u32 found = 0;
+
+    TraceBegin(job->backward ? "pocket layer backward" : "pocket layer forward");
+
+    for (;;) {
+        u32 chunk = __atomic_fetch_add(&job->next_chunk, 1, __ATOMIC_RELAXED);
+        u32 start = chunk * POCKET_BFS_CHUNK;
+        if (start >= POCKET_WORD_COUNT) break;
+        u32 end = MinU32(start + POCKET_BFS_CHUNK, POCKET_WORD_COUNT);
+
+        // Vector scan to the next word with anything to do. Words can change
+        // under the scan but only from unvisited to next, never to the value
+        // being scanned for, and the word is reloaded before it is used.
+        for (u32 w = start; w < end; w++) {
+            w += TableScan2Bit(&distances[w], end - w, scan);
+            if (w >= end) break;
+
+            u32 word = __atomic_load_n(&distances[w], __ATOMIC_RELAXED);
+            if (!PocketWordHas(word, scan)) continue;
+
+            for (u32 i = 0; i < POCKET_WORD_STATES; i++) {
+                if (((word >> (i * 2)) & 3) != scan) continue;
+                u32 state = w * POCKET_WORD_STATES + i;
+
+                if (job->backward) {
+                    // Unvisited state, is any neighbour in the frontier?
+                    for (u8 m = 0; m < POCKET_TURN_COUNT; m++) {
+                        u32 neighbour = PocketTurn(table, state, m);
+                        if (PocketGetDistance(distances, neighbour) == current) {
+                            if (PocketSetDistance(distances, state, next)) found++;
+                            break;
+                        }
+                    }
+                } else {
+                    // Frontier state (or an older one at depth - 3k whose
+                    // neighbours are all visited already)
+                    for (u8 m = 0; m < POCKET_TURN_COUNT; m++) {
+                        u32 neighbour = PocketTurn(table, state, m);
+                        if (PocketGetDistance(distances, neighbour) != POCKET_UNVISITED) continue;
+                        if (PocketSetDistance(distances, neighbour, next)) found++;
+                    }
+                }
+            }
+        }
+    }
+
+    __atomic_fetch_add(&job->found, found, __ATOMIC_RELAXED);
+
+    TraceEnd(job->backward ? "pocket layer backward" : "pocket layer forward");
+}
+
+void PocketTableInit(Arena* arena, PocketTable* table, u32 thread_count) {
+    printf("----- POCKET TABLE -----\n");
+    double start = TimeSeconds();
+    TraceBegin("pocket table");
+
+    table->perm_moves = ArenaPushArray(arena, POCKET_PERM_COUNT * POCKET_TURN_COUNT, u16);
+    table->twist_moves = ArenaPushArray(arena, POCKET_TWIST_COUNT * POCKET_TURN_COUNT, u16);
+    table->distances = (u32*) _ArenaPush(
+        arena, POCKET_WORD_COUNT * sizeof(u32), alignof(u32), false
+    );
+    MemSet(table->distances, 0xFF, POCKET_WORD_COUNT * sizeof(u32));
+
+    PocketBuildMoveTables(table);
+
+    // Solved is coordinate 0
+    PocketSetDistance(table->distances, 0, 0);
+    u32 visited = 1;
+    u32 layer = 1;
+
+    for (u8 depth = 0; layer > 0; depth++) {
+        printf("Depth %2d: %u\n", depth, layer);
+
+        PocketLayerJob job = {
+            .table = table,
+            .depth = depth,
+            .backward = layer > POCKET_STATE_COUNT - visited,
+            .next_chunk = 0,
+            .found = 0
+        };
+        ParallelRun(thread_count, PocketLayerWorker, &job);
+        TraceFaults();
+
+        layer = job.found;
+        visited += layer;
+    }
+    assert(visited == POCKET_STATE_COUNT);
+
+    TraceEnd("pocket table");
+
+    printf("Time: %f seconds\n\n", TimeSeconds() - start);
+}
+
+u8 PocketDistanceMod3(PocketTable* table, u32 coord) {
+    return PocketGetDistance(table->distances, coord);
+}
+
+u32 PocketCoordFromCube(Cube* cube) {
+    // Relabel colours so the piece sitting in DBL becomes the DBL piece. This
+    // is the same as rotating the whole cube, which is free on a 2x2.
+    u8 colour_map[CUBE_COLOUR_COUNT + 1];
+    for (int i = 0; i <= CUBE_COLOUR_COUNT; i++) colour_map[i] = CUBE_COLOUR_COUNT;
+
+    for (int k = 0; k < 3; k++) {
+        CubeColour face = CUBE_CORNER_COLOUR_TABLE[POCKET_FIXED_SLOT * 3 + k];
+        u8 position = CUBE_CORNER_POSITION_TABLE[POCKET_FIXED_SLOT * 3 + k];
+        CubeColour colour = FaceGetTile(cube->faces[face], position);
+        if (colour >= CUBE_COLOUR_COUNT) return POCKET_COORD_INVALID;
+
+        CubeColour opposite = (colour + CUBE_COLOUR_COUNT / 2) % CUBE_COLOUR_COUNT;
+        CubeColour target = CUBE_CORNER_COLOUR_TABLE[POCKET_FIXED_SLOT * 3 + k];
+        CubeColour target_opposite = (target + CUBE_COLOUR_COUNT / 2) % CUBE_COLOUR_COUNT;
+
+        // Same or opposite colours twice on one corner
+        if (colour_map[colour] != CUBE_COLOUR_COUNT) return POCKET_COORD_INVALID;
+        if (colour_map[opposite] != CUBE_COLOUR_COUNT) return POCKET_COORD_INVALID;
+
+        colour_map[colour] = target;
+        colour_map[opposite] = target_opposite;
+    }
+
+    u8 pieces[8];
+    u8 twists[8];
+    if (!PocketReadCorners(cube, colour_map, pieces, twists)) {
+        return POCKET_COORD_INVALID;
+    }
+
+    u8 seen = 0;
+    u8 total_twist = 0;
+    for (int slot = 0; slot < CORNER_COUNT; slot++) {
+        FlagSet(seen, Bit(pieces[slot]));
+        total_twist += twists[slot];
+    }
+    if (seen != 0xFF || total_twist % 3 != 0) return POCKET_COORD_INVALID;
+
+    return PocketPermEncode(pieces) * POCKET_TWIST_COUNT + PocketTwistEncode(twists);
+}
+
+u32 PocketTurn(PocketTable* table, u32 coord, u8 pocket_turn) {
+    u32 perm = coord / POCKET_TWIST_COUNT;
+    u32 twist = coord % POCKET_TWIST_COUNT;
+    return table->perm_moves[perm * POCKET_TURN_COUNT + pocket_turn] * POCKET_TWIST_COUNT
+        + table->twist_moves[twist * POCKET_TURN_COUNT + pocket_turn];
+}
+
+u8 PocketSolveCoord(PocketTable* table, u32 coord, enum8(TurnType)* moves) {
+    assert(coord < POCKET_STATE_COUNT);
+
+    u8 length = 0;
+    while (coord != 0) {
+        u8 target = (PocketGetDistance(table->distances, coord) + 2) % 3;
+
+        u8 m = 0;
+        for (; m < POCKET_TURN_COUNT; m++) {
+            u32 next = PocketTurn(table, coord, m);
+            if (PocketGetDistance(table->distances, next) == target) {
+                coord = next;
+                break;
+            }
+        }
+        assert(m < POCKET_TURN_COUNT && length < POCKET_MAX_MOVES);
+
+        moves[length++] = POCKET_TURNS[m];
+    }
+
+    return length;
+}
+
+bool PocketSolveCube(PocketTable* table, MoveStack* moves, Cube* cube) {
+    printf("----- POCKET SOLVE -----\n");
+
+    u32 coord = PocketCoordFromCube(cube);
+    if (coord == POCKET_COORD_INVALID) {
+        printf("Invalid 2x2 corners\n\n");
+        return false;
+    }
+
+    enum8(TurnType) solution[POCKET_MAX_MOVES];
+    u8 length = PocketSolveCoord(table, coord, solution);
+
+    printf("Moves: %d\n", length);
+    for (int i = 0; i < length; i++) {
+        CubeTurn(cube, solution[i]);
+        MoveStack_append(moves, solution[i]);
+        printf("%s\n", TURN_TYPE_NAMES[solution[i]]);
+    }
+    printf("\n");
+
+    return true;
+}
+
+static void PocketBatchWorker(void* data, u32 thread_index, u32 thread_count) {
+    PocketBatchJob* job = (PocketBatchJob*) data;
+
+    for (;;) {
+        u32 start = __atomic_fetch_add(&job->next_chunk, 1, __ATOMIC_RELAXED) * POCKET_BATCH_CHUNK;
+        if (start >= job->count) break;
+        u32 end = MinU32(start + POCKET_BATCH_CHUNK, job->count);
+
+        TraceBegin("pocket batch chunk");
+        for (u32 i = start; i < end; i++) {
+            job->lengths[i] = PocketSolveCoord(
+                job->table, job->coords[i], &job->moves[i * POCKET_MAX_MOVES]
+            );
+        }
+        TraceEnd("pocket batch chunk");
+    }
+}
+
+// Solution i is written to moves[i * POCKET_MAX_MOVES] with length lengths[i]
+void PocketSolveBatch(
+    PocketTable* table, const u32* coords, u32 count,
+    u8* lengths, enum8(TurnType)* moves, u32 thread_count
+) {
+    PocketBatchJob job = {
+        .table = table,
+        .coords = coords,
+        .count = count,
+        .lengths = lengths,
+        .moves = moves,
+        .next_chunk = 0
+    };
+    ParallelRun(thread_count, PocketBatchWorker, &job);
+}
+
+// LSD radix sort of coordinate << 32 | index, so equal coordinates keep the
+// order they came in
+static u64* PocketSortKeys(Arena* arena, const u32* coords, u32 count) {
+    u64* keys = (u64*) _ArenaPush(arena, (u64) count * sizeof(u64), alignof(u64), false);
+    u64 arena_start = arena->used;
+    u64* scratch = (u64*) _ArenaPush(arena, (u64) count * sizeof(u64), alignof(u64), false);
+
+    for (u32 i = 0; i < count; i++) {
+        assert(coords[i] < POCKET_STATE_COUNT);
+        keys[i] = (u64) coords[i] << 32 | i;
+    }
+
+    // An even number of passes so it ends back in keys
+    u64* from = keys;
+    u64* to = scratch;
+    for (int pass = 0; pass < POCKET_SORT_PASSES; pass++) {
+        u32 shift = 32 + pass * POCKET_SORT_DIGIT_BITS;
+        u32 starts[POCKET_SORT_DIGITS] = { 0 };
+        for (u32 i = 0; i < count; i++) {
+            starts[(from[i] >> shift) & (POCKET_SORT_DIGITS - 1)]++;
+        }
+
+        u32 total = 0;
+        for (u32 d = 0; d < POCKET_SORT_DIGITS; d++) {
+            u32 bucket = starts[d];
+            starts[d] = total;
+            total += bucket;
+        }
+
+        for (u32 i = 0; i < count; i++) {
+            to[starts[(from[i] >> shift) & (POCKET_SORT_DIGITS - 1)]++] = from[i];
+        }
+        u64* swap = from;
+        from = to;
+        to = swap;
+    }
+    assert(from == keys);
+
+    arena->used = arena_start;
+    return keys;
+}
+
+void PocketSolveBatchSorted(
+    Arena* arena, PocketTable* table, const u32* coords, u32 count,
+    u8* lengths, enum8(TurnType)* moves, u32 thread_count
+) {
+    u64 arena_start = arena->used;
+
+    TraceBegin("pocket batch sort");
+    u64* keys = PocketSortKeys(arena, coords, count);
+    u32* sorted = (u32*) _ArenaPush(arena, (u64) count * sizeof(u32), alignof(u32), false);
+    for (u32 k = 0; k < count; k++) sorted[k] = keys[k] >> 32;
+    TraceEnd("pocket batch sort");
+
+    // Solved into their sorted places, writing straight to the input order
+    // would scatter every solution and cost more than the table saves
+    u8* sorted_lengths = (u8*) _ArenaPush(arena, count, 1, false);
+    enum8(TurnType)* sorted_moves = (u8*) _ArenaPush(arena, (u64) count * POCKET_MAX_MOVES, 1, false);
+    PocketSolveBatch(table, sorted, count, sorted_lengths, sorted_moves, thread_count);
+
+    TraceBegin("pocket batch restore");
+    for (u32 k = 0; k < count; k++) {
+        u32 i = (u32) keys[k];
+        lengths[i] = sorted_lengths[k];
+        MemCopy(&moves[(u64) i * POCKET_MAX_MOVES], &sorted_moves[(u64) k * POCKET_MAX_MOVES], sorted_lengths[k]);
+    }
+    TraceEnd("pocket batch restore");
+
+    arena->used = arena_start;
+}
+
+static void PocketPrintCounts(const char* name, TraceCacheCounts* counts, u32 count) {
+    printf(
+        "%s: %.2f LLC misses/solve (%.1f%% of references), %.2f dTLB misses/solve\n", name,
+        (double) counts->misses / count,
+        counts->references > 0 ? 100.0 * counts->misses / counts->references : 0.0,
+        (double) counts->tlb_misses / count
+    );
+}
+
+void PocketBenchmark(Arena* arena, u32 count, u32 thread_count) {
+    PocketTable table;
+    PocketTableInit(arena, &table, thread_count);
+
+    printf("----- POCKET BENCHMARK -----\n");
+
+    u32* coords = ArenaPushArray(arena, count, u32);
+    u8* lengths = ArenaPushArray(arena, count, u8);
+    enum8(TurnType)* moves = ArenaPushArray(arena, (u64) count * POCKET_MAX_MOVES, u8);
+
+    // Two draws as GetRandomValue may only have 15 bits of randomness
+    for (u32 i = 0; i < count; i++) {
+        coords[i] = GetRandomValue(0, POCKET_PERM_COUNT - 1) * POCKET_TWIST_COUNT
+            + GetRandomValue(0, POCKET_TWIST_COUNT - 1);
+    }
+
+    TraceCacheCounters counters;
+    TraceCacheCounts given_counts;
+    bool counted = TraceCacheStart(&counters);
+    double start = TimeSeconds();
+    PocketSolveBatch(&table, coords, count, lengths, moves, thread_count);
+    double elapsed = TimeSeconds() - start;
+    TraceCacheStop(&counters, &given_counts);
+
+    // Same again sorted by coordinate, the sort and putting the solutions
+    // back count towards the time
+    u8* sorted_lengths = ArenaPushArray(arena, count, u8);
+    enum8(TurnType)* sorted_moves = ArenaPushArray(arena, (u64) count * POCKET_MAX_MOVES, u8);
+
+    TraceCacheCounts sorted_counts;
+    TraceCacheStart(&counters);
+    double sorted_start = TimeSeconds();
+    PocketSolveBatchSorted(arena, &table, coords, count, sorted_lengths, sorted_moves, thread_count);
+    double sorted_elapsed = TimeSeconds() - sorted_start;
+    TraceCacheStop(&counters, &sorted_counts);
+
+    bool same = MemCmp(lengths, sorted_lengths, count) == 0
+        && MemCmp(moves, sorted_moves, (u64) count * POCKET_MAX_MOVES) == 0;
+
+    // Check every solution actually solves its state
+    u32 length_counts[POCKET_MAX_MOVES + 1] = { 0 };
+    for (u32 i = 0; i < count; i++) {
+        u32 coord = coords[i];
+        for (int j = 0; j < lengths[i]; j++) {
+            TurnType turn = moves[i * POCKET_MAX_MOVES + j];
+            u8 m = (turn / 6) * 3 + (turn % 6);
+            coord = PocketTurn(&table, coord, m);
+        }
+        assert(coord == 0 && "Pocket solution failed!");
+        length_counts[lengths[i]]++;
+    }
+
+    // Pack the solutions end to end and format them all as text
+    MoveBuffer buffer;
+    MoveBufferInit(&buffer, arena, count);
+    for (u32 i = 0; i < count; i++) {
+        MoveBufferPushArray(&buffer, &moves[i * POCKET_MAX_MOVES], lengths[i]);
+    }
+
+    char* text = ArenaPushArray(arena, MoveBufferFormatSize(MoveBufferLength(&buffer)), char);
+    double format_start = TimeSeconds();
+    u64 text_length = MoveBufferFormat(&buffer, text);
+    double format_elapsed = TimeSeconds() - format_start;
+
+    printf("Threads: %u\n", thread_count);
+    printf("Solved: %u in %f seconds (%.0f solves/second)\n", count, elapsed, count / elapsed);
+    printf(
+        "Sorted: %u in %f seconds (%.0f solves/second), %s solutions\n",
+        count, sorted_elapsed, count / sorted_elapsed, same ? "same" : "DIFFERENT"
+    );
+    if (counted) {
+        PocketPrintCounts("Given order", &given_counts, count);
+        PocketPrintCounts("Sorted", &sorted_counts, count);
+    } else {
+        printf("No hardware counters here for cache and TLB misses\n");
+    }
+    printf(
+        "Packed: %u turns in %llu KB, formatted to %llu KB in %f seconds\n",
+        MoveBufferLength(&buffer), (unsigned long long) ToKilobytes(buffer.capacity),
+        (unsigned long long) ToKilobytes(text_length), format_elapsed
+    );
+    for (int i = 0; i <= POCKET_MAX_MOVES; i++) {
+        printf("Length %2d: %u\n", i, length_counts[i]);
+    }
+}
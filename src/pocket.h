@@ -0,0 +1,55 @@
+#ifndef POCKET_H
+#define POCKET_H
+
+
+#include "core.h"
+#include "cube.h"
+#include "solve.h"
+
+
+// 7! corner permutations * 3^6 corner twists with the DBL corner held still
+#define POCKET_STATE_COUNT 3674160
+#define POCKET_PERM_COUNT 5040
+#define POCKET_TWIST_COUNT 729
+
+// God's number for the 2x2 in the half turn metric
+#define POCKET_MAX_MOVES 11
+
+// F, R, U in all three directions. These never move the DBL corner
+#define POCKET_TURN_COUNT 9
+
+#define POCKET_COORD_INVALID UINT32_MAX
+
+
+typedef struct {
+    u32* distances;     // 2 bits per state: depth mod 3, 3 is unvisited
+    u16* perm_moves;    // [POCKET_PERM_COUNT][POCKET_TURN_COUNT]
+    u16* twist_moves;   // [POCKET_TWIST_COUNT][POCKET_TURN_COUNT]
+} PocketTable;
+
+
+extern const enum8(TurnType) POCKET_TURNS[POCKET_TURN_COUNT];
+
+
+void PocketTableInit(Arena* arena, PocketTable* table, u32 thread_count);
+u8 PocketDistanceMod3(PocketTable* table, u32 coord);
+u32 PocketCoordFromCube(Cube* cube);
+u32 PocketTurn(PocketTable* table, u32 coord, u8 pocket_turn);
+u8 PocketSolveCoord(PocketTable* table, u32 coord, enum8(TurnType)* moves);
+bool PocketSolveCube(PocketTable* table, MoveStack* moves, Cube* cube);
+void PocketSolveBatch(
+    PocketTable* table, const u32* coords, u32 count,
+    u8* lengths, enum8(TurnType)* moves, u32 thread_count
+);
+// Same answers as PocketSolveBatch, but the batch is radix sorted by
+// coordinate first (which is also distance table order) and solved in that
+// order, so cubes solved one after the other start from the same part of
+// the table. Solutions are put back in the order given at the end.
+void PocketSolveBatchSorted(
+    Arena* arena, PocketTable* table, const u32* coords, u32 count,
+    u8* lengths, enum8(TurnType)* moves, u32 thread_count
+);
+void PocketBenchmark(Arena* arena, u32 count, u32 thread_count);
+
+
+#endif  /* POCKET_H */
@@ -0,0 +1,187 @@
+// Random state scrambles on top of the two-phase solver.
+//
+// Every scramble gets its own random number stream started from the batch
+// seed and its index, so a batch comes out the same on one thread or many
+// and any single scramble can be made again on its own. The stream is
+// xorshift64*, 64 bits a draw, which makes the modulo bias in picking
+// coordinates far too small to ever show up.
+
+
+#include "scramble.h"
+#include "trace.h"
+
+
+// Scrambles each worker takes at a time. They're a few milliseconds each so
+// small chunks keep the threads finishing together.
+#define SCRAMBLE_BATCH_CHUNK 8
+
+
+typedef struct {
+    TwoPhaseTables* tables;
+    u64 seed;
+    u32 count;
+    u8* lengths;
+    enum8(TurnType)* moves;
+    u32 next_chunk;
+    u32 rejected;
+} ScrambleBatchJob;
+
+
+static u64 ScrambleRandom(u64* state) {
+    u64 x = *state;
+    x ^= x >> 12;
+    x ^= x << 25;
+    x ^= x >> 27;
+    *state = x;
+    return x * 0x2545F4914F6CDD1Dull;
+}
+
+static void ScrambleRandomCubie(u64* state, TwoPhaseCubie* cubie) {
+    u16 cperm = ScrambleRandom(state) % TWOPHASE_CPERM_COUNT;
+    u32 edge_perm = ScrambleRandom(state) % TWOPHASE_EDGE_PERM_COUNT;
+    u16 twist = ScrambleRandom(state) % TWOPHASE_TWIST_COUNT;
+    u16 flip = ScrambleRandom(state) % TWOPHASE_FLIP_COUNT;
+    TwoPhaseCubieFromCoords(cubie, cperm, edge_perm, twist, flip);
+}
+
+// The phase 1 distance is a lower bound that rules out nearly every state
+// straight away. Anything left gets an actual search that short, which
+// two-phase always finds if it's there at these lengths.
+static bool ScrambleTooClose(TwoPhaseTables* tables, TwoPhaseCubie* cubie) {
+    if (TwoPhaseLowerBound(tables, cubie) >= SCRAMBLE_MIN_DISTANCE) return false;
+
+    enum8(TurnType) moves[SCRAMBLE_MIN_DISTANCE];
+    return TwoPhaseSolve(tables, cubie, SCRAMBLE_MIN_DISTANCE - 1, moves) != TWOPHASE_NO_SOLUTION;
+}
+
+u8 ScrambleGenerate(TwoPhaseTables* tables, u64 seed, u64 index, enum8(TurnType)* moves, u32* rejected) {
+    // Never 0, xorshift would stay there
+    u64 state = HashU64(seed ^ HashU64(index)) | 1;
+
+    TwoPhaseCubie cubie;
+    ScrambleRandomCubie(&state, &cubie);
+    while (ScrambleTooClose(tables, &cubie)) {
+        (*rejected)++;
+        ScrambleRandomCubie(&state, &cubie);
+    }
+
+    enum8(TurnType) solution[SCRAMBLE_MAX_LENGTH];
+    u8 length = TwoPhaseSolve(tables, &cubie, SCRAMBLE_MAX_LENGTH, solution);
+    assert(length != TWOPHASE_NO_SOLUTION && "Every state is 20 or less!");
+
+    // The solution backwards with every turn the other way
+    for (int i = 0; i < length; i++) {
+        TurnType turn = solution[length - 1 - i];
+        if (turn < TURN_FRONT_PRIME) {
+            turn += TURN_FRONT_PRIME;
+        } else if (turn < TURN_FRONT_DOUBLE) {
+            turn -= TURN_FRONT_PRIME;
+        }
+        moves[i] = turn;
+    }
+
+#ifndef NDEBUG
+    TwoPhaseCubie scrambled;
+    TwoPhaseCubieSolved(&scrambled);
+    for (int i = 0; i < length; i++) TwoPhaseCubieTurn(&scrambled, moves[i]);
+    assert(MemCmp(&scrambled, &cubie, sizeof(TwoPhaseCubie)) == 0 && "Scramble doesn't reach its state!");
+#endif
+
+    return length;
+}
+
+static void ScrambleBatchWorker(void* data, u32 thread_index, u32 thread_count) {
+    ScrambleBatchJob* job = (ScrambleBatchJob*) data;
+    u32 rejected = 0;
+
+    for (;;) {
+        u32 start = __atomic_fetch_add(&job->next_chunk, 1, __ATOMIC_RELAXED) * SCRAMBLE_BATCH_CHUNK;
+        if (start >= job->count) break;
+        u32 end = MinU32(start + SCRAMBLE_BATCH_CHUNK, job->count);
+
+        TraceBegin("scramble batch chunk");
+        for (u32 i = start; i < end; i++) {
+            job->lengths[i] = ScrambleGenerate(
+                job->tables, job->seed, i, &job->moves[(u64) i * SCRAMBLE_MAX_LENGTH], &rejected
+            );
+        }
+        TraceEnd("scramble batch chunk");
+    }
+
+    __atomic_fetch_add(&job->rejected, rejected, __ATOMIC_RELAXED);
+}
+
+u32 ScrambleBatch(
+    TwoPhaseTables* tables, u64 seed, u32 count,
+    u8* lengths, enum8(TurnType)* moves, u32 thread_count
+) {
+    ScrambleBatchJob job = {
+        .tables = tables,
+        .seed = seed,
+        .count = count,
+        .lengths = lengths,
+        .moves = moves,
+        .next_chunk = 0,
+        .rejected = 0
+    };
+    ParallelRun(thread_count, ScrambleBatchWorker, &job);
+    return job.rejected;
+}
+
+void ScrambleRun(Arena* arena, u32 count, u64 seed, u32 thread_count, const char* path) {
+    TwoPhaseTables tables;
+    TwoPhaseTablesInit(arena, &tables, TWOPHASE_CACHE_PATH, thread_count);
+
+    printf("----- SCRAMBLES -----\n");
+
+    u8* lengths = ArenaPushArray(arena, count, u8);
+    enum8(TurnType)* moves = ArenaPushArray(arena, (u64) count * SCRAMBLE_MAX_LENGTH, u8);
+
+    double start = TimeSeconds();
+    u32 rejected = ScrambleBatch(&tables, seed, count, lengths, moves, thread_count);
+    double elapsed = TimeSeconds() - start;
+
+    u32 length_counts[SCRAMBLE_MAX_LENGTH + 1] = { 0 };
+    u64 total_turns = 0;
+    for (u32 i = 0; i < count; i++) {
+        length_counts[lengths[i]]++;
+        total_turns += lengths[i];
+    }
+
+    printf("Threads: %u\n", thread_count);
+    printf("Seed: %llu\n", (unsigned long long) seed);
+    printf("Scrambles: %u in %f seconds (%.0f scrambles/second)\n", count, elapsed, count / elapsed);
+    printf("Rejected: %u too close to solved\n", rejected);
+    printf("Average: %.2f turns\n", count > 0 ? (double) total_turns / count : 0.0);
+    for (int i = 0; i <= SCRAMBLE_MAX_LENGTH; i++) {
+        if (length_counts[i] > 0) printf("Length %2d: %u\n", i, length_counts[i]);
+    }
+
+    if (path == NULL) {
+        // A few to look at
+        char line[MoveBufferFormatSize(SCRAMBLE_MAX_LENGTH)];
+        for (u32 i = 0; i < MinU32(count, 5); i++) {
+            MoveFormat(&moves[(u64) i * SCRAMBLE_MAX_LENGTH], lengths[i], line);
+            printf("%u: %s\n", i, line);
+        }
+        printf("\n");
+        return;
+    }
+
+    // Formatted end to end then written in one go
+    char* text = ArenaPushArray(arena, (u64) count * MoveBufferFormatSize(SCRAMBLE_MAX_LENGTH), char);
+    u64 text_length = 0;
+    for (u32 i = 0; i < count; i++) {
+        text_length += MoveFormat(&moves[(u64) i * SCRAMBLE_MAX_LENGTH], lengths[i], text + text_length);
+        text[text_length++] = '\n';
+    }
+
+    FILE* file = fopen(path, "w");
+    if (file == NULL) {
+        printf("Couldn't open %s for the scrambles\n\n", path);
+        return;
+    }
+    fwrite(text, 1, text_length, file);
+    fclose(file);
+    printf("Written: %s\n\n", path);
+}
@@ -0,0 +1,39 @@
+#ifndef SCRAMBLE_H
+#define SCRAMBLE_H
+
+
+#include "core.h"
+#include "cube.h"
+#include "moves.h"
+#include "twophase.h"
+
+
+// Random state scrambles the way competitions make them: pick a state
+// uniformly from every reachable one, throw it away if it's too close to
+// solved, and give the inverse of a short solution as the scramble.
+#define SCRAMBLE_MAX_LENGTH 20
+
+// Regulation 4b3: a scramble must need at least 2 moves to solve
+#define SCRAMBLE_MIN_DISTANCE 2
+
+// Tables plus each scramble and its formatted line
+#define ScrambleArenaSize(count) (TWOPHASE_ARENA_SIZE + Megabytes(1) + \
+    (u64) (count) * (1 + SCRAMBLE_MAX_LENGTH + MoveBufferFormatSize(SCRAMBLE_MAX_LENGTH)))
+
+
+// Scramble i of a batch only depends on the seed and i, never on which
+// thread made it or how many there were. Writes SCRAMBLE_MAX_LENGTH turns to
+// moves[i * SCRAMBLE_MAX_LENGTH] with the length in lengths[i], and returns
+// how many drawn states were too close to solved.
+u32 ScrambleBatch(
+    TwoPhaseTables* tables, u64 seed, u32 count,
+    u8* lengths, enum8(TurnType)* moves, u32 thread_count
+);
+u8 ScrambleGenerate(TwoPhaseTables* tables, u64 seed, u64 index, enum8(TurnType)* moves, u32* rejected);
+
+// Builds the tables, makes count scrambles and prints how fast. With a path
+// the scrambles are written there one per line.
+void ScrambleRun(Arena* arena, u32 count, u64 seed, u32 thread_count, const char* path);
+
+
+#endif  /* SCRAMBLE_H */
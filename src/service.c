@@ -0,0 +1,1006 @@
+// A solve service for callers on the same machine, and two ways to talk to
+// it.
+//
+// The socket way is what anything would do first: a unix socket, a line of
+// text per cube (its six faces in hex) and a line back with the solution.
+// Every batch costs a write and at least one read on each side plus the
+// formatting and parsing, and a 2x2 solve, a dozen lookups in a table that
+// fits in cache, is quicker than any of that.
+//
+// The shared memory way puts rings in a memfd mapped by both processes,
+// submissions of raw cubes and completions of solutions a byte per turn. The
+// client writes requests straight into the submission ring and the server
+// writes replies straight into the completion ring, so nothing is copied or
+// formatted. Each ring is single producer single consumer like the
+// pipeline's. A consumer that runs dry spins a little and then sleeps on a
+// futex, its bell, saying so first, and the producer only makes the wake up
+// syscall when it has been told someone is asleep. So while both sides keep
+// busy there are no syscalls at all.
+//
+// Requests come in two classes with a pair of rings each. Bulk work like a
+// dataset job can keep dozens of 3x3 solves queued, and behind a single FIFO
+// an interactive solve from the GUI waits for all of them. Under the
+// deadline policy the server takes every interactive request off its ring as
+// soon as it's there and does them earliest deadline first. A bulk two-phase
+// solve asks every so often during its search whether one has come in, and
+// if so gives up and stays at the front of its queue to be started again
+// afterwards. Before solving anything with a deadline the server checks a
+// running 95th percentile time for that solver. If it won't make it the request
+// falls back to a faster solver, and if nothing will it's turned down
+// straight away rather than answered late.
+//
+// The server is a forked child, which inherits the tables and the memfd's
+// mapping. Anything else on the machine would get the memfd passed over a
+// unix socket with SCM_RIGHTS, which the benchmarks have no need for.
+
+
+#include "service.h"
+#include "solve.h"
+
+#include <string.h>
+
+#ifdef __linux__
+#include <linux/futex.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <sys/wait.h>
+#endif
+
+
+// Turns in each random 2x2 state's scramble
+#define SERVICE_SCRAMBLE_LENGTH 20
+
+// Tries before a consumer that finds its ring empty goes to sleep, if there
+// is more than one core. With one the other side can't run until it does.
+#define SERVICE_SPIN_LIMIT 256
+
+#define SERVICE_CACHE_LINE 64
+
+// Six faces as 8 hex digits, a space or newline after each
+#define SERVICE_REQUEST_LINE_LEN (CUBE_COLOUR_COUNT * 9)
+#define SERVICE_REPLY_LINE_LEN MoveBufferFormatSize(POCKET_MAX_MOVES)
+
+// Bulk requests the mixed benchmark's bulk client keeps queued
+#define SERVICE_BULK_DEPTH 64
+
+// How far a solver's running estimate moves for each new solve time. It's a
+// high quantile because a few two-phase solves take twenty times as long as
+// the rest, and admitting against the median let all of those through to
+// miss. Going up STEP * QUANTILE for a solve slower than the estimate and down
+// STEP * (1 - QUANTILE) for a faster one settles where QUANTILE of solves are
+// faster. The step is big so the estimate climbs from the first guess within
+// a few dozen solves.
+#define SERVICE_ESTIMATE_STEP 0.2
+#define SERVICE_ESTIMATE_QUANTILE 0.95
+
+// Latency histogram buckets, each up to that many milliseconds, then one
+// more for anything longer
+#define SERVICE_HISTOGRAM_LEN 11
+static const double SERVICE_HISTOGRAM_BOUNDS_MS[SERVICE_HISTOGRAM_LEN - 1] = {
+    0.5, 1, 2, 5, 10, 20, 50, 100, 200, 500
+};
+
+// First guesses at how long each solver takes, until there are real times
+static const double SERVICE_SOLVER_ESTIMATES[SERVICE_SOLVER_COUNT] = { 5e-6, 10e-3, 1e-3 };
+
+// What each solver falls back to when it would be too slow, COUNT for nothing
+static const enum8(ServiceSolver) SERVICE_SOLVER_FALLBACK[SERVICE_SOLVER_COUNT] = {
+    SERVICE_SOLVER_COUNT, SERVICE_SOLVER_TWOPHASE_FAST, SERVICE_SOLVER_COUNT
+};
+
+static const char* SERVICE_CLASS_NAMES[SERVICE_CLASS_COUNT] = { "interactive", "bulk" };
+static const char* SERVICE_POLICY_NAMES[SERVICE_POLICY_COUNT] = { "FIFO", "Deadline" };
+
+
+typedef struct {
+    alignas(SERVICE_CACHE_LINE) u32 head;
+    alignas(SERVICE_CACHE_LINE) u32 tail;
+} ServiceRing;
+
+// What a consumer sleeps on. Producers ring it after publishing, and
+// sleeping is set by the consumer before it goes to sleep on rings. The
+// server also has one for room on a full reply ring, rung by clients when
+// they take replies off.
+typedef struct {
+    alignas(SERVICE_CACHE_LINE) u32 rings;
+    alignas(SERVICE_CACHE_LINE) u32 sleeping;
+} ServiceBell;
+
+typedef struct {
+    u64 waits;
+    u64 wakes;
+    u64 preempted;
+    u64 degraded;
+    u64 rejected;
+} ServiceServerCounts;
+
+// What's in the memfd. The server's counts are kept here too so the client
+// can print them.
+typedef struct {
+    enum8(ServicePolicy) policy;
+    ServiceBell server_bell;
+    ServiceBell room_bell;
+    ServiceBell client_bells[SERVICE_CLASS_COUNT];
+    ServiceRing submit[SERVICE_CLASS_COUNT];
+    ServiceRing complete[SERVICE_CLASS_COUNT];
+    alignas(SERVICE_CACHE_LINE) ServiceServerCounts server;
+    alignas(SERVICE_CACHE_LINE) ServiceRequest requests[SERVICE_CLASS_COUNT][SERVICE_RING_LEN];
+    alignas(SERVICE_CACHE_LINE) ServiceReply replies[SERVICE_CLASS_COUNT][SERVICE_RING_LEN];
+} ServiceShared;
+
+// The server process's own state. Either table can be NULL, and requests
+// for its solver are answered SERVICE_STATUS_INVALID.
+typedef struct {
+    PocketTable* pocket;
+    TwoPhaseTables* twophase;
+    ServiceShared* shared;
+    ServiceServerCounts counts;
+    u32 reply_heads[SERVICE_CLASS_COUNT];
+    double estimates[SERVICE_SOLVER_COUNT];
+    bool closing;
+
+    // Interactive requests taken off their ring and not done yet
+    ServiceRequest pending[SERVICE_RING_LEN];
+    u32 pending_count;
+} ServiceServer;
+
+typedef struct {
+    double seconds;
+    u64 syscalls;
+    u64 server_syscalls;
+    bool server_counted;
+    u32 mismatched;
+} ServiceStats;
+
+typedef struct {
+    u64 histogram[SERVICE_HISTOGRAM_LEN];
+    u32 count;
+    u32 degraded;
+    u32 rejected;
+    u32 late;
+    u32 unsolved;
+    double total_latency;
+    double worst_latency;
+    u64 syscalls;
+} ServiceClassStats;
+
+typedef struct {
+    ServiceShared* shared;
+    u32 interactive_count;
+    double deadline;
+    u32 interactive_done;
+    double seconds;
+    ServiceClassStats stats[SERVICE_CLASS_COUNT];
+    ServiceServerCounts server;
+} ServiceMixedJob;
+
+
+static u32 service_spin_limit = SERVICE_SPIN_LIMIT;
+
+
+#ifdef __linux__
+// SOLVING ////////////////////////////////////////////////////////////////////
+static void ServiceServerInit(ServiceServer* server, PocketTable* pocket, TwoPhaseTables* twophase) {
+    *server = (ServiceServer) { .pocket = pocket, .twophase = twophase };
+    for (int s = 0; s < SERVICE_SOLVER_COUNT; s++) server->estimates[s] = SERVICE_SOLVER_ESTIMATES[s];
+}
+
+// Solves request with solver, not necessarily the one it asked for. False if
+// stop said to give up part way, with nothing written to reply.
+static bool ServiceSolve(
+    ServiceServer* server, ServiceRequest* request, ServiceSolver solver, ServiceReply* reply,
+    TwoPhaseStopFunction stop
+) {
+    Cube cube = { 0 };
+    MemCopy(cube.faces, request->faces, sizeof(cube.faces));
+
+    *reply = (ServiceReply) { .id = request->id, .status = SERVICE_STATUS_SOLVED, .solver = solver };
+    double start = TimeSeconds();
+    switch (solver) {
+        case SERVICE_SOLVER_POCKET: {
+            u32 coord = server->pocket != NULL ? PocketCoordFromCube(&cube) : POCKET_COORD_INVALID;
+            if (coord == POCKET_COORD_INVALID) {
+                reply->status = SERVICE_STATUS_INVALID;
+                return true;
+            }
+            reply->length = PocketSolveCoord(server->pocket, coord, reply->moves);
+        } break;
+
+        case SERVICE_SOLVER_TWOPHASE:
+        case SERVICE_SOLVER_TWOPHASE_FAST: {
+            TwoPhaseCubie cubie;
+            if (server->twophase == NULL || !TwoPhaseCubieFromCube(&cube, &cubie)
+                || !TwoPhaseCubieSolvable(&cubie)) {
+                reply->status = SERVICE_STATUS_INVALID;
+                return true;
+            }
+            u8 max_length = solver == SERVICE_SOLVER_TWOPHASE ? SERVICE_TWOPHASE_LENGTH : TWOPHASE_MAX_LENGTH;
+            u8 length = TwoPhaseSolveUntil(server->twophase, &cubie, max_length, reply->moves, stop, server->shared);
+            if (length == TWOPHASE_STOPPED) return false;
+            if (length == TWOPHASE_NO_SOLUTION) {
+                reply->status = SERVICE_STATUS_INVALID;
+                return true;
+            }
+            reply->length = length;
+        } break;
+
+        default:
+            assert(false && "Unknown service solver!");
+    }
+
+    double elapsed = TimeSeconds() - start;
+    double step = elapsed > server->estimates[solver]
+        ? SERVICE_ESTIMATE_STEP * SERVICE_ESTIMATE_QUANTILE
+        : -SERVICE_ESTIMATE_STEP * (1.0 - SERVICE_ESTIMATE_QUANTILE);
+    server->estimates[solver] *= 1.0 + step;
+    return true;
+}
+
+// Which solver can still make request's deadline, going by the running
+// estimates, or SERVICE_SOLVER_COUNT if none can
+static ServiceSolver ServiceAdmit(ServiceServer* server, ServiceRequest* request, double now) {
+    ServiceSolver solver = request->solver;
+    while (solver != SERVICE_SOLVER_COUNT && request->deadline > 0.0
+        && now + server->estimates[solver] > request->deadline) {
+        solver = SERVICE_SOLVER_FALLBACK[solver];
+    }
+    return solver;
+}
+
+// SHARED MEMORY //////////////////////////////////////////////////////////////
+// Not the private futex ops, the two sides are different processes
+static void ServiceFutexWait(u32* address, u32 value) {
+    syscall(SYS_futex, address, FUTEX_WAIT, value, NULL, NULL, 0);
+}
+
+static void ServiceFutexWake(u32* address) {
+    syscall(SYS_futex, address, FUTEX_WAKE, 1, NULL, NULL, 0);
+}
+
+// Waits for the bell to ring after it read seen. Saying we're asleep and
+// looking at the bell again before the futex call is what stops a wake up
+// going missing: either the producer sees sleeping and wakes us, or we see
+// it rang, and the futex won't sleep if it has rung since.
+static void ServiceBellWait(ServiceBell* bell, u32 seen, u64* waits) {
+    for (u32 spins = 0; spins < service_spin_limit; spins++) {
+        if (__atomic_load_n(&bell->rings, __ATOMIC_ACQUIRE) != seen) return;
+#ifdef __SSE2__
+        _mm_pause();
+#endif
+    }
+
+    __atomic_store_n(&bell->sleeping, 1, __ATOMIC_SEQ_CST);
+    if (__atomic_load_n(&bell->rings, __ATOMIC_SEQ_CST) == seen) {
+        ServiceFutexWait(&bell->rings, seen);
+        (*waits)++;
+    }
+    __atomic_store_n(&bell->sleeping, 0, __ATOMIC_RELAXED);
+}
+
+static void ServiceBellRing(ServiceBell* bell, u64* wakes) {
+    __atomic_fetch_add(&bell->rings, 1, __ATOMIC_SEQ_CST);
+    if (__atomic_load_n(&bell->sleeping, __ATOMIC_SEQ_CST)) {
+        ServiceFutexWake(&bell->rings);
+        (*wakes)++;
+    }
+}
+
+static void ServicePublish(ServiceRing* ring, u32 head, ServiceBell* bell, u64* wakes) {
+    __atomic_store_n(&ring->head, head, __ATOMIC_RELEASE);
+    ServiceBellRing(bell, wakes);
+}
+
+// Waits until the ring has something past tail and returns its head. The
+// bell is read first so anything published after the ring was looked at
+// counts as a ring.
+static u32 ServiceRingWait(ServiceRing* ring, u32 tail, ServiceBell* bell, u64* waits) {
+    for (;;) {
+        u32 seen = __atomic_load_n(&bell->rings, __ATOMIC_SEQ_CST);
+        u32 head = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+        if (head != tail) return head;
+        ServiceBellWait(bell, seen, waits);
+    }
+}
+
+static bool ServiceRingEmpty(ServiceRing* ring) {
+    return __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE) == ring->tail;
+}
+
+static void ServiceReplyPublish(ServiceServer* server, ServiceClass class) {
+    ServiceShared* shared = server->shared;
+    ServicePublish(
+        &shared->complete[class], server->reply_heads[class], &shared->client_bells[class], &server->counts.wakes
+    );
+}
+
+// Waits for the client to take replies off class's ring until there is a
+// free slot. Anything written but not published is published first, or the
+// client would never see the replies it needs to take.
+static void ServiceReplyRoomWait(ServiceServer* server, ServiceClass class) {
+    ServiceShared* shared = server->shared;
+    ServiceRing* ring = &shared->complete[class];
+    if (server->reply_heads[class] - __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE) < SERVICE_RING_LEN) return;
+
+    ServiceReplyPublish(server, class);
+    for (;;) {
+        u32 seen = __atomic_load_n(&shared->room_bell.rings, __ATOMIC_SEQ_CST);
+        u32 tail = __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE);
+        if (server->reply_heads[class] - tail < SERVICE_RING_LEN) return;
+        ServiceBellWait(&shared->room_bell, seen, &server->counts.waits);
+    }
+}
+
+// The client is done with every reply of class before tail. Ringing for room
+// costs no syscall unless the server is asleep waiting for it.
+static void ServiceReplyRelease(ServiceShared* shared, ServiceClass class, u32 tail, u64* wakes) {
+    __atomic_store_n(&shared->complete[class].tail, tail, __ATOMIC_RELEASE);
+    ServiceBellRing(&shared->room_bell, wakes);
+}
+
+// A bulk solve's stop function
+static bool ServiceInteractiveWaiting(void* data) {
+    ServiceShared* shared = (ServiceShared*) data;
+    return !ServiceRingEmpty(&shared->submit[SERVICE_CLASS_INTERACTIVE]);
+}
+
+// Admits, solves and writes the answer to request to the next reply slot of
+// its class, without publishing it. False if a preemptible solve stopped for
+// an interactive request, and nothing was written.
+static bool ServiceHandle(ServiceServer* server, ServiceClass class, ServiceRequest* request, bool preemptible) {
+    ServiceSolver solver = request->solver;
+    if (server->shared->policy == SERVICE_POLICY_DEADLINE) solver = ServiceAdmit(server, request, TimeSeconds());
+
+    ServiceReply reply;
+    if (solver == SERVICE_SOLVER_COUNT) {
+        reply = (ServiceReply) { .id = request->id, .status = SERVICE_STATUS_REJECTED, .solver = request->solver };
+        server->counts.rejected++;
+
+        // A solver that's turning everything down gets no new times, so a
+        // run of slow solves would shut it out for good. Its estimate comes
+        // down as if it had made the time, so it's tried again every twenty
+        // or so rejections.
+        for (ServiceSolver s = request->solver; s != SERVICE_SOLVER_COUNT; s = SERVICE_SOLVER_FALLBACK[s]) {
+            server->estimates[s] *= 1.0 - SERVICE_ESTIMATE_STEP * (1.0 - SERVICE_ESTIMATE_QUANTILE);
+        }
+    } else {
+        if (!ServiceSolve(server, request, solver, &reply, preemptible ? ServiceInteractiveWaiting : NULL)) {
+            server->counts.preempted++;
+            return false;
+        }
+        if (solver != request->solver && reply.status == SERVICE_STATUS_SOLVED) {
+            reply.status = SERVICE_STATUS_DEGRADED;
+            server->counts.degraded++;
+        }
+    }
+
+    ServiceReplyRoomWait(server, class);
+    u32 head = server->reply_heads[class]++;
+    server->shared->replies[class][head % SERVICE_RING_LEN] = reply;
+    return true;
+}
+
+// Every request waiting, oldest first whatever its class. Bulk replies are
+// only published at the end so a batch costs one wake up at most.
+static bool ServiceServeFifo(ServiceServer* server) {
+    ServiceShared* shared = server->shared;
+    bool worked = false;
+    bool bulk_answered = false;
+
+    for (;;) {
+        ServiceClass oldest = SERVICE_CLASS_COUNT;
+        ServiceRequest* request = NULL;
+        for (int c = 0; c < SERVICE_CLASS_COUNT; c++) {
+            ServiceRing* ring = &shared->submit[c];
+            if (ServiceRingEmpty(ring)) continue;
+            ServiceRequest* next = &shared->requests[c][ring->tail % SERVICE_RING_LEN];
+            if (request == NULL || next->submitted < request->submitted) {
+                oldest = c;
+                request = next;
+            }
+        }
+        if (request == NULL) break;
+        worked = true;
+
+        if (request->id == SERVICE_REQUEST_CLOSE) {
+            server->closing = true;
+        } else {
+            ServiceHandle(server, oldest, request, false);
+            if (oldest == SERVICE_CLASS_INTERACTIVE) {
+                ServiceReplyPublish(server, oldest);
+            } else {
+                bulk_answered = true;
+            }
+        }
+        ServiceRing* ring = &shared->submit[oldest];
+        __atomic_store_n(&ring->tail, ring->tail + 1, __ATOMIC_RELEASE);
+        if (server->closing) break;
+    }
+
+    if (bulk_answered) ServiceReplyPublish(server, SERVICE_CLASS_BULK);
+    return worked;
+}
+
+// A deadline of 0 is none, so it goes last
+static bool ServiceDeadlineBefore(ServiceRequest* a, ServiceRequest* b) {
+    if (a->deadline == 0.0) return false;
+    return b->deadline == 0.0 || a->deadline < b->deadline;
+}
+
+static void ServicePullInteractive(ServiceServer* server) {
+    ServiceShared* shared = server->shared;
+    ServiceRing* ring = &shared->submit[SERVICE_CLASS_INTERACTIVE];
+    u32 head = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+    u32 tail = ring->tail;
+
+    // Whatever doesn't fit in pending stays on the ring until some is done
+    u32 room = SERVICE_RING_LEN - server->pending_count;
+    for (; tail != head && room > 0; tail++, room--) {
+        server->pending[server->pending_count++] = shared->requests[SERVICE_CLASS_INTERACTIVE][tail % SERVICE_RING_LEN];
+    }
+    __atomic_store_n(&ring->tail, tail, __ATOMIC_RELEASE);
+}
+
+// Interactive requests earliest deadline first until there are none, then
+// one bulk request, which is left where it is if an interactive one turns up
+// while it's being solved
+static bool ServiceServeDeadline(ServiceServer* server) {
+    ServiceShared* shared = server->shared;
+    bool worked = false;
+
+    for (;;) {
+        ServicePullInteractive(server);
+        if (server->pending_count == 0) break;
+
+        u32 earliest = 0;
+        for (u32 i = 1; i < server->pending_count; i++) {
+            if (ServiceDeadlineBefore(&server->pending[i], &server->pending[earliest])) earliest = i;
+        }
+        ServiceRequest request = server->pending[earliest];
+        server->pending[earliest] = server->pending[--server->pending_count];
+
+        ServiceHandle(server, SERVICE_CLASS_INTERACTIVE, &request, false);
+        ServiceReplyPublish(server, SERVICE_CLASS_INTERACTIVE);
+        worked = true;
+    }
+
+    ServiceRing* ring = &shared->submit[SERVICE_CLASS_BULK];
+    if (ServiceRingEmpty(ring)) return worked;
+
+    ServiceRequest* request = &shared->requests[SERVICE_CLASS_BULK][ring->tail % SERVICE_RING_LEN];
+    if (request->id == SERVICE_REQUEST_CLOSE) {
+        server->closing = true;
+    } else if (ServiceHandle(server, SERVICE_CLASS_BULK, request, true)) {
+        ServiceReplyPublish(server, SERVICE_CLASS_BULK);
+    } else {
+        return true;
+    }
+    __atomic_store_n(&ring->tail, ring->tail + 1, __ATOMIC_RELEASE);
+    return true;
+}
+
+static void ServiceServe(ServiceServer* server) {
+    ServiceShared* shared = server->shared;
+    while (!server->closing) {
+        u32 seen = __atomic_load_n(&shared->server_bell.rings, __ATOMIC_SEQ_CST);
+        bool worked = shared->policy == SERVICE_POLICY_FIFO
+            ? ServiceServeFifo(server)
+            : ServiceServeDeadline(server);
+        if (!worked) ServiceBellWait(&shared->server_bell, seen, &server->counts.waits);
+    }
+    shared->server = server->counts;
+}
+
+static ServiceShared* ServiceSharedCreate(ServicePolicy policy) {
+    int fd = (int) syscall(SYS_memfd_create, "cube service", 0);
+    if (fd < 0 || ftruncate(fd, sizeof(ServiceShared)) != 0) {
+        printf("Couldn't make the shared memory for the service\n");
+        if (fd >= 0) close(fd);
+        return NULL;
+    }
+    ServiceShared* shared = mmap(NULL, sizeof(ServiceShared), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (shared == MAP_FAILED) {
+        printf("Couldn't map the shared memory for the service\n");
+        return NULL;
+    }
+
+    // A new memfd reads as zeros, so the rings start empty
+    shared->policy = policy;
+    return shared;
+}
+
+static pid_t ServiceShmStart(ServiceShared* shared, PocketTable* pocket, TwoPhaseTables* twophase) {
+    pid_t server = fork();
+    if (server == 0) {
+        ServiceServer state;
+        ServiceServerInit(&state, pocket, twophase);
+        state.shared = shared;
+        ServiceServe(&state);
+        _exit(0);
+    }
+    if (server < 0) printf("Couldn't start the service\n");
+    return server;
+}
+
+// Once everything sent has been answered, so there's room on the ring
+static void ServiceShmStop(ServiceShared* shared, pid_t server, u64* wakes) {
+    ServiceRing* ring = &shared->submit[SERVICE_CLASS_BULK];
+    u32 head = ring->head;
+    shared->requests[SERVICE_CLASS_BULK][head % SERVICE_RING_LEN] = (ServiceRequest) { .id = SERVICE_REQUEST_CLOSE };
+    ServicePublish(ring, head + 1, &shared->server_bell, wakes);
+    waitpid(server, NULL, 0);
+}
+
+static bool ServiceShmRun(
+    PocketTable* table, ServiceRequest* requests, u32 count, u32 batch,
+    u8* lengths, enum8(TurnType)* moves, ServiceStats* stats
+) {
+    ServiceShared* shared = ServiceSharedCreate(SERVICE_POLICY_FIFO);
+    if (shared == NULL) return false;
+    pid_t server = ServiceShmStart(shared, table, NULL);
+    if (server < 0) {
+        munmap(shared, sizeof(ServiceShared));
+        return false;
+    }
+
+    ServiceRing* submit = &shared->submit[SERVICE_CLASS_BULK];
+    ServiceRing* complete = &shared->complete[SERVICE_CLASS_BULK];
+    ServiceBell* bell = &shared->client_bells[SERVICE_CLASS_BULK];
+    u64 waits = 0;
+    u64 wakes = 0;
+    u32 submit_head = 0;
+    u32 reply_tail = 0;
+    double start = TimeSeconds();
+    for (u32 first = 0; first < count; first += batch) {
+        u32 end = MinU32(first + batch, count);
+        for (u32 i = first; i < end; i++) {
+            shared->requests[SERVICE_CLASS_BULK][submit_head++ % SERVICE_RING_LEN] = requests[i];
+        }
+        ServicePublish(submit, submit_head, &shared->server_bell, &wakes);
+
+        for (u32 i = first; i < end;) {
+            u32 reply_head = ServiceRingWait(complete, reply_tail, bell, &waits);
+            for (; reply_tail != reply_head; reply_tail++, i++) {
+                ServiceReply* reply = &shared->replies[SERVICE_CLASS_BULK][reply_tail % SERVICE_RING_LEN];
+                assert(reply->id == i);
+                if (reply->length != lengths[i]
+                    || MemCmp(reply->moves, &moves[(u64) i * POCKET_MAX_MOVES], reply->length) != 0) {
+                    stats->mismatched++;
+                }
+            }
+            ServiceReplyRelease(shared, SERVICE_CLASS_BULK, reply_tail, &wakes);
+        }
+    }
+    stats->seconds = TimeSeconds() - start;
+
+    ServiceShmStop(shared, server, &wakes);
+    stats->syscalls = waits + wakes;
+    stats->server_syscalls = shared->server.waits + shared->server.wakes;
+    stats->server_counted = true;
+    munmap(shared, sizeof(ServiceShared));
+    return true;
+}
+
+// SOCKET /////////////////////////////////////////////////////////////////////
+static bool ServiceWriteAll(int fd, const char* data, u64 size, u64* syscalls) {
+    while (size > 0) {
+        ssize_t written = write(fd, data, size);
+        (*syscalls)++;
+        if (written <= 0) return false;
+        data += written;
+        size -= written;
+    }
+    return true;
+}
+
+static u64 ServiceFormatRequest(ServiceRequest* request, char* out) {
+    u64 length = 0;
+    for (int f = 0; f < CUBE_COLOUR_COUNT; f++) {
+        length += sprintf(out + length, "%08x%c", request->faces[f], f + 1 < CUBE_COLOUR_COUNT ? ' ' : '\n');
+    }
+    return length;
+}
+
+static bool ServiceParseRequest(const char* line, ServiceRequest* request) {
+    for (int f = 0; f < CUBE_COLOUR_COUNT; f++) {
+        char* end;
+        request->faces[f] = (u32) strtoul(line, &end, 16);
+        if (end == line) return false;
+        line = end;
+    }
+    return true;
+}
+
+// Reads whatever has come in, answers every whole line and keeps the rest
+// for next time. The socket only ever does 2x2 solves.
+static void ServiceSocketServe(ServiceServer* server, int fd, char* in, char* out) {
+    u64 have = 0;
+    u64 syscalls = 0;
+    for (;;) {
+        ssize_t got = read(fd, in + have, SERVICE_RING_LEN * SERVICE_REQUEST_LINE_LEN - have);
+        if (got <= 0) return;
+        have += got;
+
+        u64 used = 0;
+        u64 out_length = 0;
+        for (;;) {
+            char* newline = memchr(in + used, '\n', have - used);
+            if (newline == NULL) break;
+            *newline = '\0';
+
+            ServiceRequest request = { 0 };
+            ServiceReply reply = { 0 };
+            if (ServiceParseRequest(in + used, &request)) {
+                ServiceSolve(server, &request, SERVICE_SOLVER_POCKET, &reply, NULL);
+            }
+            out_length += MoveFormat(reply.moves, reply.length, out + out_length);
+            out[out_length++] = '\n';
+            used = newline + 1 - in;
+        }
+
+        if (!ServiceWriteAll(fd, out, out_length, &syscalls)) return;
+        memmove(in, in + used, have - used);
+        have -= used;
+    }
+}
+
+static bool ServiceSocketRun(
+    Arena* arena, PocketTable* table, ServiceRequest* requests, u32 count, u32 batch,
+    const char* expected, ServiceStats* stats
+) {
+    u64 arena_start = arena->used;
+    char* in = ArenaPushArray(arena, SERVICE_RING_LEN * SERVICE_REQUEST_LINE_LEN, char);
+    char* out = ArenaPushArray(arena, SERVICE_RING_LEN * SERVICE_REPLY_LINE_LEN, char);
+
+    int fds[2];
+    if (socketpair(AF_UNIX, SOCK_STREAM, 0, fds) != 0) {
+        printf("Couldn't make a socket for the service\n");
+        arena->used = arena_start;
+        return false;
+    }
+
+    pid_t server = fork();
+    if (server == 0) {
+        close(fds[0]);
+        ServiceServer state;
+        ServiceServerInit(&state, table, NULL);
+        ServiceSocketServe(&state, fds[1], in, out);
+        _exit(0);
+    }
+    close(fds[1]);
+    if (server < 0) {
+        printf("Couldn't start the service\n");
+        close(fds[0]);
+        arena->used = arena_start;
+        return false;
+    }
+
+    // Client's buffers are the other way round, lines out and replies in
+    bool ok = true;
+    u64 syscalls = 0;
+    double start = TimeSeconds();
+    for (u32 first = 0; first < count && ok; first += batch) {
+        u32 end = MinU32(first + batch, count);
+        u64 length = 0;
+        for (u32 i = first; i < end; i++) length += ServiceFormatRequest(&requests[i], in + length);
+        ok = ServiceWriteAll(fds[0], in, length, &syscalls);
+
+        u64 have = 0;
+        u64 checked = 0;
+        for (u32 i = first; i < end && ok;) {
+            ssize_t got = read(fds[0], out + have, SERVICE_RING_LEN * SERVICE_REPLY_LINE_LEN - have);
+            syscalls++;
+            if (got <= 0) {
+                ok = false;
+                break;
+            }
+            have += got;
+
+            for (;;) {
+                char* newline = memchr(out + checked, '\n', have - checked);
+                if (newline == NULL) break;
+                *newline = '\0';
+                if (strcmp(out + checked, &expected[(u64) i * SERVICE_REPLY_LINE_LEN]) != 0) stats->mismatched++;
+                checked = newline + 1 - out;
+                i++;
+            }
+        }
+    }
+    stats->seconds = TimeSeconds() - start;
+    stats->syscalls = syscalls;
+
+    close(fds[0]);
+    waitpid(server, NULL, 0);
+    arena->used = arena_start;
+
+    if (!ok) printf("The service hung up\n");
+    return ok;
+}
+
+// MIXED LOAD /////////////////////////////////////////////////////////////////
+static void ServiceRandomCube(u64* random, Cube* cube) {
+    u64 a = *random = HashU64(*random);
+    u64 b = *random = HashU64(*random);
+    TwoPhaseCubie cubie;
+    TwoPhaseCubieFromCoords(
+        &cubie, a % TWOPHASE_CPERM_COUNT, (a >> 16) % TWOPHASE_EDGE_PERM_COUNT,
+        b % TWOPHASE_TWIST_COUNT, (b >> 16) % TWOPHASE_FLIP_COUNT
+    );
+    TwoPhaseCubieToCube(&cubie, cube);
+}
+
+static void ServiceSleepUntil(double when) {
+    double delay = when - TimeSeconds();
+    if (delay <= 0.0) return;
+    struct timespec wait = { (time_t) delay, (long) ((delay - (time_t) delay) * 1e9) };
+    nanosleep(&wait, NULL);
+}
+
+// Counts the reply and checks its moves really do solve cube
+static void ServiceRecord(
+    ServiceClassStats* stats, ServiceRequest* request, ServiceReply* reply, Cube* cube, double now
+) {
+    double latency = now - request->submitted;
+    stats->count++;
+    stats->total_latency += latency;
+    if (latency > stats->worst_latency) stats->worst_latency = latency;
+
+    int bucket = 0;
+    while (bucket < SERVICE_HISTOGRAM_LEN - 1 && latency * 1e3 > SERVICE_HISTOGRAM_BOUNDS_MS[bucket]) bucket++;
+    stats->histogram[bucket]++;
+
+    if (reply->status == SERVICE_STATUS_REJECTED) {
+        stats->rejected++;
+        return;
+    }
+    if (reply->status == SERVICE_STATUS_DEGRADED) stats->degraded++;
+    if (request->deadline > 0.0 && now > request->deadline) stats->late++;
+
+    Cube check = *cube;
+    for (int i = 0; i < reply->length; i++) CubeTurn(&check, reply->moves[i]);
+    if (reply->status == SERVICE_STATUS_INVALID || !IsPLLSolved(&check)) stats->unsolved++;
+}
+
+// One at a time, SERVICE_INTERACTIVE_PERIOD_MS apart, like someone clicking
+static void ServiceInteractiveClient(ServiceMixedJob* job) {
+    ServiceShared* shared = job->shared;
+    ServiceRing* submit = &shared->submit[SERVICE_CLASS_INTERACTIVE];
+    ServiceRing* complete = &shared->complete[SERVICE_CLASS_INTERACTIVE];
+    ServiceBell* bell = &shared->client_bells[SERVICE_CLASS_INTERACTIVE];
+    ServiceClassStats* stats = &job->stats[SERVICE_CLASS_INTERACTIVE];
+    u64 random = 0x9E3779B97F4A7C15ull;
+    u64 waits = 0;
+    u64 wakes = 0;
+
+    double next = TimeSeconds();
+    for (u32 i = 0; i < job->interactive_count; i++) {
+        ServiceSleepUntil(next);
+        next += SERVICE_INTERACTIVE_PERIOD_MS / 1e3;
+
+        Cube cube;
+        ServiceRandomCube(&random, &cube);
+        ServiceRequest request = { .id = i, .solver = SERVICE_SOLVER_TWOPHASE };
+        MemCopy(request.faces, cube.faces, sizeof(request.faces));
+        request.submitted = TimeSeconds();
+        request.deadline = request.submitted + job->deadline;
+
+        u32 head = submit->head;
+        shared->requests[SERVICE_CLASS_INTERACTIVE][head % SERVICE_RING_LEN] = request;
+        ServicePublish(submit, head + 1, &shared->server_bell, &wakes);
+
+        u32 tail = complete->tail;
+        ServiceRingWait(complete, tail, bell, &waits);
+        ServiceReply* reply = &shared->replies[SERVICE_CLASS_INTERACTIVE][tail % SERVICE_RING_LEN];
+        ServiceRecord(stats, &request, reply, &cube, TimeSeconds());
+        ServiceReplyRelease(shared, SERVICE_CLASS_INTERACTIVE, tail + 1, &wakes);
+    }
+
+    stats->syscalls = waits + wakes;
+    __atomic_store_n(&job->interactive_done, 1, __ATOMIC_RELEASE);
+}
+
+// Keeps SERVICE_BULK_DEPTH solves queued until the interactive client is
+// done, then waits for the last of them
+static void ServiceBulkClient(ServiceMixedJob* job) {
+    ServiceShared* shared = job->shared;
+    ServiceRing* submit = &shared->submit[SERVICE_CLASS_BULK];
+    ServiceRing* complete = &shared->complete[SERVICE_CLASS_BULK];
+    ServiceBell* bell = &shared->client_bells[SERVICE_CLASS_BULK];
+    ServiceClassStats* stats = &job->stats[SERVICE_CLASS_BULK];
+    u64 random = 0xD1B54A32D192ED03ull;
+    u64 waits = 0;
+    u64 wakes = 0;
+
+    // Ids go up by one and no more than the depth are out at once, so the
+    // id picks a slot to keep each cube in
+    Cube cubes[SERVICE_BULK_DEPTH];
+    ServiceRequest sent[SERVICE_BULK_DEPTH];
+    u32 submitted = 0;
+    u32 answered = 0;
+    for (;;) {
+        bool done = __atomic_load_n(&job->interactive_done, __ATOMIC_ACQUIRE);
+        if (!done && submitted - answered < SERVICE_BULK_DEPTH) {
+            u32 head = submit->head;
+            for (; submitted - answered < SERVICE_BULK_DEPTH; submitted++) {
+                u32 slot = submitted % SERVICE_BULK_DEPTH;
+                ServiceRandomCube(&random, &cubes[slot]);
+                ServiceRequest* request = &sent[slot];
+                *request = (ServiceRequest) { .id = submitted, .solver = SERVICE_SOLVER_TWOPHASE };
+                MemCopy(request->faces, cubes[slot].faces, sizeof(request->faces));
+                request->submitted = TimeSeconds();
+                shared->requests[SERVICE_CLASS_BULK][head++ % SERVICE_RING_LEN] = *request;
+            }
+            ServicePublish(submit, head, &shared->server_bell, &wakes);
+        }
+        if (answered == submitted) break;
+
+        u32 tail = complete->tail;
+        u32 reply_head = ServiceRingWait(complete, tail, bell, &waits);
+        double now = TimeSeconds();
+        for (; tail != reply_head; tail++, answered++) {
+            ServiceReply* reply = &shared->replies[SERVICE_CLASS_BULK][tail % SERVICE_RING_LEN];
+            u32 slot = reply->id % SERVICE_BULK_DEPTH;
+            ServiceRecord(stats, &sent[slot], reply, &cubes[slot], now);
+        }
+        ServiceReplyRelease(shared, SERVICE_CLASS_BULK, tail, &wakes);
+    }
+
+    stats->syscalls = waits + wakes;
+}
+
+static void ServiceMixedWorker(void* data, u32 thread_index, u32 thread_count) {
+    ServiceMixedJob* job = (ServiceMixedJob*) data;
+    if (thread_index == 0) {
+        ServiceInteractiveClient(job);
+    } else {
+        ServiceBulkClient(job);
+    }
+}
+
+static bool ServiceMixedRun(TwoPhaseTables* twophase, ServicePolicy policy, ServiceMixedJob* job) {
+    ServiceShared* shared = ServiceSharedCreate(policy);
+    if (shared == NULL) return false;
+    pid_t server = ServiceShmStart(shared, NULL, twophase);
+    if (server < 0) {
+        munmap(shared, sizeof(ServiceShared));
+        return false;
+    }
+
+    job->shared = shared;
+    double start = TimeSeconds();
+    ParallelRun(SERVICE_CLASS_COUNT, ServiceMixedWorker, job);
+    job->seconds = TimeSeconds() - start;
+
+    u64 wakes = 0;
+    ServiceShmStop(shared, server, &wakes);
+    job->server = shared->server;
+    munmap(shared, sizeof(ServiceShared));
+    return true;
+}
+
+static void ServiceMixedReport(ServicePolicy policy, ServiceMixedJob* job) {
+    printf(
+        "%s: %f seconds, %llu bulk solves stopped part way, %llu degraded, %llu rejected\n",
+        SERVICE_POLICY_NAMES[policy], job->seconds, (unsigned long long) job->server.preempted,
+        (unsigned long long) job->server.degraded, (unsigned long long) job->server.rejected
+    );
+    for (int c = 0; c < SERVICE_CLASS_COUNT; c++) {
+        ServiceClassStats* stats = &job->stats[c];
+        printf(
+            "  %-11s %5u answered, mean %.2f ms, worst %.2f ms, %u late, %u degraded, %u rejected, "
+            "%u unsolved, %.2f syscalls/request\n",
+            SERVICE_CLASS_NAMES[c], stats->count,
+            stats->count > 0 ? stats->total_latency * 1e3 / stats->count : 0.0, stats->worst_latency * 1e3,
+            stats->late, stats->degraded, stats->rejected, stats->unsolved,
+            stats->count > 0 ? (double) stats->syscalls / stats->count : 0.0
+        );
+    }
+
+    printf("  %-11s", "ms up to");
+    for (int b = 0; b < SERVICE_HISTOGRAM_LEN - 1; b++) printf(" %5g", SERVICE_HISTOGRAM_BOUNDS_MS[b]);
+    printf("  more\n");
+    for (int c = 0; c < SERVICE_CLASS_COUNT; c++) {
+        printf("  %-11s", SERVICE_CLASS_NAMES[c]);
+        for (int b = 0; b < SERVICE_HISTOGRAM_LEN; b++) {
+            printf(" %5llu", (unsigned long long) job->stats[c].histogram[b]);
+        }
+        printf("\n");
+    }
+}
+#endif
+
+// BENCHMARK //////////////////////////////////////////////////////////////////
+static void ServiceReport(const char* name, u32 count, u32 batch, ServiceStats* stats) {
+    u32 batches = (count + batch - 1) / batch;
+    printf(
+        "%-7s %f seconds, %.0f solves/second, %.2f us/solve, %u differ\n", name, stats->seconds,
+        count / stats->seconds, stats->seconds * 1e6 / count, stats->mismatched
+    );
+    printf("        client %.2f syscalls/batch", (double) stats->syscalls / batches);
+    if (stats->server_counted) printf(", server %.2f", (double) stats->server_syscalls / batches);
+    printf("\n");
+}
+
+void ServiceBenchmark(Arena* arena, u32 count, u32 batch) {
+    assert(batch > 0 && batch <= SERVICE_RING_LEN);
+
+    PocketTable table;
+    PocketTableInit(arena, &table, ThreadCount());
+
+    // Before the forks so the server gets it too
+    service_spin_limit = ThreadCount() > 1 ? SERVICE_SPIN_LIMIT : 0;
+
+    printf("----- SERVICE BENCHMARK -----\n");
+
+#ifdef __linux__
+    // Random 2x2 states the way the other 2x2 tools make them, and the
+    // answers solving them here gives to check the service against
+    ServiceRequest* requests = ArenaPushArray(arena, count, ServiceRequest);
+    u32* coords = ArenaPushArray(arena, count, u32);
+    Cube cube;
+    CubeInit(&cube);
+    u64 random = 0x9E3779B97F4A7C15ull;
+    for (u32 i = 0; i < count; i++) {
+        CubeSetSolved(&cube);
+        for (int t = 0; t < SERVICE_SCRAMBLE_LENGTH; t++) {
+            random = HashU64(random);
+            CubeTurn(&cube, POCKET_TURNS[random % POCKET_TURN_COUNT]);
+        }
+        requests[i] = (ServiceRequest) { .id = i, .solver = SERVICE_SOLVER_POCKET };
+        MemCopy(requests[i].faces, cube.faces, sizeof(cube.faces));
+        coords[i] = PocketCoordFromCube(&cube);
+    }
+
+    u8* lengths = ArenaPushArray(arena, count, u8);
+    enum8(TurnType)* moves = ArenaPushArray(arena, (u64) count * POCKET_MAX_MOVES, u8);
+    PocketSolveBatch(&table, coords, count, lengths, moves, ThreadCount());
+
+    char* expected = ArenaPushArray(arena, (u64) count * SERVICE_REPLY_LINE_LEN, char);
+    for (u32 i = 0; i < count; i++) {
+        MoveFormat(&moves[(u64) i * POCKET_MAX_MOVES], lengths[i], &expected[(u64) i * SERVICE_REPLY_LINE_LEN]);
+    }
+
+    printf("Cubes: %u in batches of %u\n", count, batch);
+
+    ServiceStats socket_stats = { 0 };
+    if (ServiceSocketRun(arena, &table, requests, count, batch, expected, &socket_stats)) {
+        ServiceReport("Socket", count, batch, &socket_stats);
+    }
+
+    ServiceStats shm_stats = { 0 };
+    if (ServiceShmRun(&table, requests, count, batch, lengths, moves, &shm_stats)) {
+        ServiceReport("Shm", count, batch, &shm_stats);
+    }
+
+    if (socket_stats.seconds > 0.0 && shm_stats.seconds > 0.0) {
+        printf("Shared memory is %.2fx the socket\n", socket_stats.seconds / shm_stats.seconds);
+    }
+    printf("\n");
+#else
+    printf("The service needs Linux\n\n");
+#endif
+}
+
+void ServiceMixedBenchmark(Arena* arena, u32 interactive_count, u32 deadline_ms) {
+    TwoPhaseTables tables;
+    TwoPhaseTablesInit(arena, &tables, TWOPHASE_CACHE_PATH, ThreadCount());
+
+    service_spin_limit = ThreadCount() > 1 ? SERVICE_SPIN_LIMIT : 0;
+
+    printf("----- MIXED SERVICE BENCHMARK -----\n");
+
+#ifdef __linux__
+    printf(
+        "%u interactive solves %d ms apart with %u ms each, %d bulk solves kept queued\n",
+        interactive_count, SERVICE_INTERACTIVE_PERIOD_MS, deadline_ms, SERVICE_BULK_DEPTH
+    );
+    for (int policy = 0; policy < SERVICE_POLICY_COUNT; policy++) {
+        ServiceMixedJob job = { .interactive_count = interactive_count, .deadline = deadline_ms / 1e3 };
+        if (ServiceMixedRun(&tables, policy, &job)) ServiceMixedReport(policy, &job);
+    }
+    printf("\n");
+#else
+    printf("The service needs Linux\n\n");
+#endif
+}
@@ -0,0 +1,108 @@
+#ifndef SERVICE_H
+#define SERVICE_H
+
+
+#include "core.h"
+#include "cube.h"
+#include "moves.h"
+#include "pocket.h"
+#include "twophase.h"
+
+
+// Requests (and so replies) of one class that can be waiting at once, a
+// power of two. Also the biggest batch a client can send.
+#define SERVICE_RING_LEN 1024
+
+#define SERVICE_DEFAULT_COUNT 200000
+#define SERVICE_DEFAULT_BATCH 64
+
+// Longest solution any solver gives
+#define SERVICE_MAX_MOVES TWOPHASE_MAX_LENGTH
+
+// What SERVICE_SOLVER_TWOPHASE holds out for
+#define SERVICE_TWOPHASE_LENGTH 20
+
+// Request id that tells the server to stop
+#define SERVICE_REQUEST_CLOSE UINT32_MAX
+
+// Mixed benchmark defaults: interactive solves a GUI might ask for, the
+// time each has, and how far apart they come
+#define SERVICE_DEFAULT_INTERACTIVE_COUNT 200
+#define SERVICE_DEFAULT_DEADLINE_MS 20
+#define SERVICE_INTERACTIVE_PERIOD_MS 10
+
+
+// Each class has its own rings. Interactive requests come with a deadline
+// and, under SERVICE_POLICY_DEADLINE, go ahead of any bulk work.
+typedef enum {
+    SERVICE_CLASS_INTERACTIVE,
+    SERVICE_CLASS_BULK,
+
+    SERVICE_CLASS_COUNT
+} ServiceClass;
+
+typedef enum {
+    SERVICE_SOLVER_POCKET,          // Optimal 2x2
+    SERVICE_SOLVER_TWOPHASE,        // 3x3 in at most SERVICE_TWOPHASE_LENGTH
+    SERVICE_SOLVER_TWOPHASE_FAST,   // 3x3, the first two-phase solution found
+
+    SERVICE_SOLVER_COUNT
+} ServiceSolver;
+
+typedef enum {
+    SERVICE_STATUS_SOLVED,
+    SERVICE_STATUS_DEGRADED,    // Solved by a faster solver to make the deadline
+    SERVICE_STATUS_REJECTED,    // Couldn't be done in time by any solver
+    SERVICE_STATUS_INVALID,     // Not a cube the solver can solve
+} ServiceStatus;
+
+// How the server picks what to do next. FIFO is one queue in order of
+// arrival whatever the class. Deadline does interactive requests first,
+// earliest deadline first, stops bulk solves part way when one comes in and
+// turns down or degrades the ones it can't finish in time.
+typedef enum {
+    SERVICE_POLICY_FIFO,
+    SERVICE_POLICY_DEADLINE,
+
+    SERVICE_POLICY_COUNT
+} ServicePolicy;
+
+
+// A cube to solve as its raw faces, nothing to format or parse. Times are
+// TimeSeconds, which both processes share, and a deadline of 0 is none.
+typedef struct {
+    u32 id;
+    u32 faces[CUBE_COLOUR_COUNT];
+    enum8(ServiceSolver) solver;
+    double submitted;
+    double deadline;
+} ServiceRequest;
+
+typedef struct {
+    u32 id;
+    enum8(ServiceStatus) status;
+    enum8(ServiceSolver) solver;
+    u8 length;
+    enum8(TurnType) moves[SERVICE_MAX_MOVES];
+} ServiceReply;
+
+
+// Solves count random 2x2 states through a server process, batch at a time,
+// first over a unix socket with a line of text per cube and then through
+// shared memory rings. Prints throughput and syscalls for each and checks the
+// solutions against solving them here.
+void ServiceBenchmark(Arena* arena, u32 count, u32 batch);
+
+// The scratch ServiceBenchmark needs, besides the 2x2 table
+#define ServiceArenaSize(count) (Megabytes(4) + (u64) (count) * (sizeof(ServiceRequest) + \
+    sizeof(u32) + 1 + POCKET_MAX_MOVES + MoveBufferFormatSize(POCKET_MAX_MOVES)))
+
+// A bulk client keeping the server busy with 3x3 solves while an interactive
+// client sends interactive_count more, each with deadline_ms to be answered
+// in. Run under each policy, with a latency histogram for each class.
+void ServiceMixedBenchmark(Arena* arena, u32 interactive_count, u32 deadline_ms);
+
+#define SERVICE_MIXED_ARENA_SIZE (TWOPHASE_ARENA_SIZE + Megabytes(4))
+
+
+#endif  /* SERVICE_H */
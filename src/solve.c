@@ -89,12 +89,14 @@
 
 
 #include "solve.h"
+#include "trace.h"
 
 
 DEFINE_TYPED_STACK(TurnType, MoveStack)
 DEFINE_TYPED_QUEUE(u32, QueueU32)
 
-#define MOVE_STACK_LEN 300
+DECLARE_TYPED_HASHMAP(u32, u32, CrossMap)
+DEFINE_TYPED_HASHMAP(u32, u32, CrossMap, HashU64, HashEqual)
 
 
 // (12*2)*(11*2)*(10*2)*(9*2) = 190,080. Due to edge parity rules that state
@@ -106,9 +108,17 @@ DEFINE_TYPED_QUEUE(u32, QueueU32)
 // but only 95,040 spots can be filled so hashmap is ~1/10 filled...
 #define CROSS_HASHMAP_LEN 1048576
 
-#define F2L_TOP_LAYER_LEN 24
+// Starting size of the hashmap used by the benchmark BFS, grows as needed
+#define CROSS_MAP_START_LEN 1024
+
+#define CROSS_BENCHMARK_SCRAMBLE_LEN 25
+
 #define F2L_ALGO_LEN 12
 
+// Longest stretch of a re-solve that gets searched for something shorter.
+// Search depth is one less, 18 * 15^3 nodes at most so still instant.
+#define RESOLVE_WINDOW_LEN 5
+
 
 static const u8 CROSS_TURN_TABLE[6][4] = {
     { 2, 4, 8, 7 },     // F
@@ -190,6 +200,16 @@ static const TurnType F2L_TOP_LAYER_LOOKUP[F2L_TOP_LAYER_LEN][F2L_ALGO_LEN] = {
 typedef void (*SolveFunction)(Arena* arena, MoveStack* moves, Cube* cube);
 
 
+// Loaded algorithms, checked before the built in tables when set
+static AlgSet* solve_algs = NULL;
+
+// Set while a stage runs for SolveStageRun, batch solves happen on worker
+// threads and a few thousand solves worth of stage output helps nobody
+static _Thread_local bool solve_quiet = false;
+
+#define SolveLog(...) do { if (!solve_quiet) printf(__VA_ARGS__); } while (0)
+
+
 // To check for double face turn that can be collapsed into one
 static void TidyMoveStack(MoveStack* moves) {
     u32 length = MoveStack_length(moves);
@@ -266,10 +286,39 @@ static void PerformTurn(MoveStack* moves, Cube* cube, TurnType turn_type) {
         CubeFaceTurnDouble(cube, face);
     }
 
-    MoveStack_append(moves, turn_type);
+    // Running out of room would silently drop turns from the solution
+    bool appended = MoveStack_append(moves, turn_type);
+    assert(appended && "Move stack full!");
+    (void) appended;
+
     TidyMoveStack(moves);
 }
 
+// Applies a compiled algorithm in one go, the turns are only recorded.
+// Returns false without touching the cube if the move stack can't fit it,
+// sets can hold algorithms longer than some callers' stacks.
+static bool PerformAlg(MoveStack* moves, Cube* cube, AlgCase* found) {
+    u32 needed = found->pre + found->variant->length + found->post;
+    if (MoveStack_length(moves) + needed > moves->capacity) { return false; }
+
+    for (int i = 0; i < found->pre; i++) {
+        PerformTurn(moves, cube, TURN_DOWN);
+    }
+
+    AlgApply(cube, found->variant->perm);
+    for (int i = 0; i < found->variant->length; i++) {
+        bool appended = MoveStack_append(moves, found->variant->turns[i]);
+        assert(appended && "Move stack full!");
+        (void) appended;
+        TidyMoveStack(moves);
+    }
+
+    for (int i = 0; i < found->post; i++) {
+        PerformTurn(moves, cube, TURN_DOWN);
+    }
+    return true;
+}
+
 static void PrintMoves(MoveStack* moves, int start, int end) {
     printf("Moves: %d\n", end - start);
     for (int i = start; i < end; i++) {
@@ -295,13 +344,15 @@ static void PrintHash(u32 hash) {
 */
 
 static void SolveStep(
-    SolveFunction func, Arena* arena, MoveStack* moves, Cube* cube
+    SolveFunction func, const char* name, Arena* arena, MoveStack* moves, Cube* cube
 ) {
     int moves_before = MoveStack_length(moves);
 
+    TraceBegin(name);
     clock_t start = clock();
     func(arena, moves, cube);
     clock_t end = clock();
+    TraceEnd(name);
 
     double elapsed = (double) (end - start) / CLOCKS_PER_SEC;
     printf("Time: %f seconds\n", elapsed);
@@ -310,7 +361,7 @@ static void SolveStep(
     PrintMoves(moves, moves_before, moves_after);
 }
 
-static bool IsCrossSolved(Cube* cube) {
+bool IsCrossSolved(Cube* cube) {
     for (int i = 0; i < 8; i++) {
         CubeColour colour = CUBE_EDGE_COLOUR_TABLE[i];
         u8 position = CUBE_EDGE_POSITION_TABLE[i];
@@ -319,7 +370,7 @@ static bool IsCrossSolved(Cube* cube) {
     return true;
 }
 
-static bool IsF2LSolved(Cube* cube) {
+bool IsF2LSolved(Cube* cube) {
     for (int i = 0; i < 16; i++) {
         CubeColour colour = CUBE_EDGE_COLOUR_TABLE[i];
         u8 position = CUBE_EDGE_POSITION_TABLE[i];
@@ -333,7 +384,7 @@ static bool IsF2LSolved(Cube* cube) {
     return true;
 }
 
-static bool IsOLLSolved(Cube* cube) {
+bool IsOLLSolved(Cube* cube) {
     if (!IsF2LSolved(cube)) {
         return false;
     }
@@ -343,7 +394,7 @@ static bool IsOLLSolved(Cube* cube) {
     return true;
 }
 
-static bool IsPLLSolved(Cube* cube) {
+bool IsPLLSolved(Cube* cube) {
     for (int i = 0; i < 24; i++) {
         CubeColour colour = CUBE_EDGE_COLOUR_TABLE[i];
         u8 position = CUBE_EDGE_POSITION_TABLE[i];
@@ -357,7 +408,7 @@ static bool IsPLLSolved(Cube* cube) {
     return true;
 }
 
-static u32 ConvertToCrossCube(Cube* cube) {
+u32 ConvertToCrossCube(Cube* cube) {
     // This function searches the cube for the four white edges so that their
     // position and orientation can be stored in a simplified state.
     //
@@ -400,7 +451,7 @@ static u32 ConvertToCrossCube(Cube* cube) {
     return state;
 }
 
-static u32 TurnCrossCube(u32 state, TurnType turn_type) {
+u32 TurnCrossCube(u32 state, TurnType turn_type) {
     // Extract sections from state for easy modification
     u8 edge_position[4];
     u8 edge_orientation[4];
@@ -499,8 +550,104 @@ static u32 CrossBFS(
     return UINT32_MAX;
 }
 
+// Same search as CrossBFS but visited states live in a hashmap instead of the
+// dense array indexed by cross hash. Only used to compare the two approaches.
+static u32 CrossBFSHashed(
+    CrossMap* visited, QueueU32* queue, u32 starting_state, u32 target_hash
+) {
+    QueueU32_append(queue, starting_state);
+    CrossMap_insert(visited, starting_state, starting_state | (TURN_TYPE_COUNT << 20));
+
+    if (starting_state == target_hash) {
+        return target_hash;
+    }
+
+    u32 current_state = starting_state;
+
+    while (QueueU32_length(queue) > 0) {
+        QueueU32_pop(queue, &current_state);
+        for (int turn_type = 0; turn_type < TURN_TYPE_COUNT; turn_type++) {
+            u32 new_state = TurnCrossCube(current_state, turn_type);
+
+            // Insert fails if already visited
+            if (!CrossMap_insert(visited, new_state, current_state | (turn_type << 20))) continue;
+
+            QueueU32_append(queue, new_state);
+
+            if (new_state == target_hash) {
+                return target_hash;
+            }
+        }
+    }
+
+    return UINT32_MAX;
+}
+
+void CrossBenchmark(Arena* arena, Cube* cube, int iterations) {
+    printf("----- CROSS BENCHMARK -----\n");
+
+    Cube solved_cube;
+    CubeInit(&solved_cube);
+    CubeSetSolved(&solved_cube);
+    u32 target = ConvertToCrossCube(&solved_cube);
+
+    double dense_time = 0.0;
+    double hashed_time = 0.0;
+    u64 dense_memory = 0;
+    u64 hashed_memory = 0;
+    u64 states = 0;
+
+    for (int i = 0; i < iterations; i++) {
+        CubeSetSolved(cube);
+        for (int j = 0; j < CROSS_BENCHMARK_SCRAMBLE_LEN; j++) {
+            CubeTurn(cube, GetRandomValue(0, TURN_TYPE_COUNT - 1));
+        }
+        u32 start = ConvertToCrossCube(cube);
+
+        // Dense visited array, as used by SolveCross
+        u64 arena_start = arena->used;
+        clock_t begin = clock();
+
+        u32* visited = ArenaPushArray(arena, CROSS_HASHMAP_LEN, u32);
+        u32* items = ArenaPushArray(arena, CROSS_EDGE_LEN, u32);
+        QueueU32 queue;
+        QueueU32_init(&queue, items, CROSS_EDGE_LEN);
+        u32 found = CrossBFS(visited, &queue, start, target);
+
+        dense_time += (double) (clock() - begin) / CLOCKS_PER_SEC;
+        dense_memory += arena->used - arena_start;
+        arena->used = arena_start;
+
+        // Hashmap visited set
+        begin = clock();
+
+        CrossMap map;
+        CrossMap_init(&map, arena, CROSS_MAP_START_LEN);
+        items = ArenaPushArray(arena, CROSS_EDGE_LEN, u32);
+        QueueU32_init(&queue, items, CROSS_EDGE_LEN);
+        u32 found_hashed = CrossBFSHashed(&map, &queue, start, target);
+
+        hashed_time += (double) (clock() - begin) / CLOCKS_PER_SEC;
+        assert(found == target && found_hashed == target);
+        (void) found;
+        (void) found_hashed;
+        hashed_memory += arena->used - arena_start;
+        states += CrossMap_length(&map);
+        arena->used = arena_start;
+    }
+
+    printf("Iterations: %d\n", iterations);
+    printf("Average states visited: %llu\n", (unsigned long long) (states / iterations));
+    printf("Dense array:  %f ms/solve, %llu KB/solve\n",
+        dense_time * 1000.0 / iterations,
+        (unsigned long long) ToKilobytes(dense_memory / iterations));
+    printf("Hashmap:      %f ms/solve, %llu KB/solve\n",
+        hashed_time * 1000.0 / iterations,
+        (unsigned long long) ToKilobytes(hashed_memory / iterations));
+}
+
 static void SolveCross(Arena* arena, MoveStack* moves, Cube* cube) {
-    printf("CROSS:\n");
+    SolveLog("CROSS:\n");
 
     // We need to encode the position of the four edges into an integer to use
     // in the lookup table. Each of the 190,080 configurations needs a spot in
@@ -516,7 +663,7 @@ static void SolveCross(Arena* arena, MoveStack* moves, Cube* cube) {
 
     // Compute hash for cube with cross solved
     Cube solved_cube;
-    CubeInit(arena, &solved_cube);
+    CubeInit(&solved_cube);
     CubeSetSolved(&solved_cube);
     u32 target = ConvertToCrossCube(&solved_cube);
 
@@ -530,8 +677,11 @@ static void SolveCross(Arena* arena, MoveStack* moves, Cube* cube) {
 
     u32 start = ConvertToCrossCube(cube);
 
-    // Run BFS
+    // Run BFS. The visited array is mostly cold pages so log the faults too
+    TraceBegin("cross bfs");
     assert(CrossBFS(visited, &queue, start, target) == target);
+    TraceEnd("cross bfs");
+    TraceFaults();
 
     // Reconstruct path. Start at end and traverse backwards. Max length 8
     TurnType path[8];
@@ -557,7 +707,7 @@ static void SolveCross(Arena* arena, MoveStack* moves, Cube* cube) {
 // Returns position and orientation in single number
 // return divided by three round down to get pos
 // return - pos = orientation
-static u8 F2LCornerSlot(Cube* cube, u8 pair_index) {
+u8 F2LCornerSlot(Cube* cube, u8 pair_index) {
     assert(pair_index < 4);
 
     int index = pair_index * 3;
@@ -592,7 +742,7 @@ static u8 F2LCornerSlot(Cube* cube, u8 pair_index) {
 // Returns position and orientation in single number
 // return divided by two round down to get pos
 // return - pos = orientation
-static u8 F2LEdgeSlot(Cube* cube, u8 pair_index) {
+u8 F2LEdgeSlot(Cube* cube, u8 pair_index) {
     assert(pair_index < 4);
 
     int index = pair_index * 2;
@@ -701,7 +851,7 @@ static void SetCorner(Cube* cube, u8 from, u8 to, u8 orientation) {
         CubeColour face = CUBE_CORNER_COLOUR_TABLE[from + i];
         u8 position = CUBE_CORNER_POSITION_TABLE[from + i];
         CubeColour colour = CUBE_CORNER_COLOUR_TABLE[to + ((i + orientation) % 3)];
-        FaceSetTile(&cube->faces[face], colour, position);
+        CubeSetTile(cube, face, colour, position);
     }
 }
 
@@ -711,73 +861,84 @@ static void SetEdge(Cube* cube, u8 from, u8 to, u8 orientation) {
         CubeColour face = F2L_EDGE_COLOUR_TABLE[from + i];
         u8 position = F2L_EDGE_POSITION_TABLE[from + i];
         CubeColour colour = F2L_EDGE_COLOUR_TABLE[to + ((i + orientation) % 2)];
-        FaceSetTile(&cube->faces[face], colour, position);
+        CubeSetTile(cube, face, colour, position);
     }
 }
 
-void F2LTestLookup(Arena* arena, Cube* cube) {
-    ArenaReset(arena);
-    TurnType* items = ArenaPushArray(arena, MOVE_STACK_LEN, TurnType);
+// Lehmer code to a permutation of four, returns its parity
+static u8 PermutationFromIndex(u8* perm, u8 index) {
+    u8 left[4] = { 0, 1, 2, 3 };
+    u8 parity = 0;
+    for (int i = 0; i < 4; i++) {
+        u8 base = 4 - i;
+        u8 factorial = i == 0 ? 6 : i == 1 ? 2 : 1;
+        u8 pick = (index / factorial) % base;
+        perm[i] = left[pick];
+        parity ^= pick & 1;
+        for (int j = pick; j < 3 - i; j++) left[j] = left[j + 1];
+    }
+    return parity;
+}
 
-    MoveStack* moves = ArenaPushStruct(arena, MoveStack);
-    MoveStack_init(moves, items, MOVE_STACK_LEN);
+bool F2LVerifyCase(MoveStack* moves, Cube* cube, u8 lookup_index, u8 slot, u8 auf) {
+    assert(lookup_index < F2L_TOP_LAYER_LEN && slot < 4 && auf < 4);
+    u8 c = slot;
 
-    for (int lookup_index = 0; lookup_index < F2L_TOP_LAYER_LEN; lookup_index++) {
-        // Test for all colours
-        for (int c = 0; c < 4; c++) {
-            // Blank out cube
-            CubeSetSolid(cube, CUBE_COLOUR_COUNT);
-
-            // Paint on solved cross and other solved pairs
-            for (int i = 0; i < 8; i++) {
-                CubeColour colour = CUBE_EDGE_COLOUR_TABLE[i];
-                u8 position = CUBE_EDGE_POSITION_TABLE[i];
-                FaceSetTile(&cube->faces[colour], colour, position);
-                if (i < 4 && i != c) {
-                    SetEdge(cube, i*2, i*2, 0);
-                    SetCorner(cube, i*3, i*3, 0);
-                }
-            }
+    // Blank out cube
+    CubeSetSolid(cube, CUBE_COLOUR_COUNT);
 
-            // Paint on lookup index start position
-            u8 corner_ori = (u8)(lookup_index / 8);
-            u8 corner_to = c * 3;
-            u8 corner_from = corner_to + 12;
-            assert(corner_to < 12);
-            assert(corner_from >= 12 && corner_from < 24);
-            SetCorner(cube, corner_from, corner_to, corner_ori);
-
-            u8 edge_ori = (u8)(lookup_index / 4) % 2;
-            u8 edge_offset = ModWrap(lookup_index % 4 + c, 4);
-            u8 edge_to = c * 2;
-            u8 edge_from = (edge_offset * 2) % 8 + 8;
-            assert(edge_to < 8);
-            assert(edge_from >= 8 && edge_from < 16);
-            SetEdge(cube, edge_from, edge_to, edge_ori);
-
-            // Get start position
-            u8 edge = F2LEdgeSlot(cube, c);
-            u8 edge_position = edge / 2;
-            u8 edge_orientation = edge - (edge_position * 2);
+    // Paint on solved cross and other solved pairs
+    for (int i = 0; i < 8; i++) {
+        CubeColour colour = CUBE_EDGE_COLOUR_TABLE[i];
+        u8 position = CUBE_EDGE_POSITION_TABLE[i];
+        CubeSetTile(cube, colour, colour, position);
+        if (i < 4 && i != c) {
+            SetEdge(cube, i*2, i*2, 0);
+            SetCorner(cube, i*3, i*3, 0);
+        }
+    }
 
-            u8 corner = F2LCornerSlot(cube, c);
-            u8 corner_position = corner / 3;
-            u8 corner_orientation = corner - (corner_position * 3);
+    // Paint on lookup index start position
+    u8 corner_ori = (u8)(lookup_index / 8);
+    u8 corner_to = c * 3;
+    u8 corner_from = corner_to + 12;
+    assert(corner_to < 12);
+    assert(corner_from >= 12 && corner_from < 24);
+    SetCorner(cube, corner_from, corner_to, corner_ori);
+
+    u8 edge_ori = (u8)(lookup_index / 4) % 2;
+    u8 edge_offset = ModWrap(lookup_index % 4 + c, 4);
+    u8 edge_to = c * 2;
+    u8 edge_from = (edge_offset * 2) % 8 + 8;
+    assert(edge_to < 8);
+    assert(edge_from >= 8 && edge_from < 16);
+    SetEdge(cube, edge_from, edge_to, edge_ori);
+
+    // Spin the top layer so the pair doesn't always start over its slot, the
+    // solver has to find its way back
+    for (int i = 0; i < auf; i++) {
+        CubeTurn(cube, TURN_DOWN);
+    }
 
-            // Try solve for specific pair
-            SolveF2LPairTopLayer(moves, cube, c, edge_position, edge_orientation, corner_position, corner_orientation);
+    // Get start position
+    u8 edge = F2LEdgeSlot(cube, c);
+    u8 edge_position = edge / 2;
+    u8 edge_orientation = edge - (edge_position * 2);
 
-            // Ensure solved without messing other pairs
-            assert(IsF2LSolved(cube) && "F2L algorithm failed!");
+    u8 corner = F2LCornerSlot(cube, c);
+    u8 corner_position = corner / 3;
+    u8 corner_orientation = corner - (corner_position * 3);
 
-            // So we don't overrun
-            MoveStack_clear(moves);
-        }
-    }
+    // Try solve for specific pair
+    MoveStack_clear(moves);
+    SolveF2LPairTopLayer(moves, cube, c, edge_position, edge_orientation, corner_position, corner_orientation);
+
+    // Ensure solved without messing other pairs
+    return IsF2LSolved(cube);
 }
 
 static void SolveF2L(Arena* arena, MoveStack* moves, Cube* cube) {
-    printf("F2L:\n");
+    SolveLog("F2L:\n");
 
     // Check for already solved pairs so we don't mess them up
     // Only loop 4 - solved times to ensure lookup table is correct
@@ -810,7 +971,10 @@ static void SolveF2L(Arena* arena, MoveStack* moves, Cube* cube) {
             u8 corner_orientation = corner - (corner_position * 3);
 
             if (edge_position >= 4 && corner_position >= 4) {
-                SolveF2LPairTopLayer(moves, cube, i, edge_position, edge_orientation, corner_position, corner_orientation);
+                AlgCase found;
+                if (!AlgSetLookup(solve_algs, ALG_SET_F2L, cube, i, &found) || !PerformAlg(moves, cube, &found)) {
+                    SolveF2LPairTopLayer(moves, cube, i, edge_position, edge_orientation, corner_position, corner_orientation);
+                }
 
                 new_pair_solved = true;
                 just_retrieved = false;
@@ -904,24 +1068,135 @@ static void SolveF2L(Arena* arena, MoveStack* moves, Cube* cube) {
     assert(IsF2LSolved(cube));
 }
 
+// Last layer from an algorithm set. found->alg is left NULL when there was
+// nothing to do, returns false if the set has no algorithm for the case or
+// the moves don't fit.
+static bool OLLFromSet(MoveStack* moves, Cube* cube, AlgSet* set, AlgCase* found) {
+    found->alg = NULL;
+    if (IsOLLSolved(cube)) { return true; }
+
+    if (!AlgSetLookup(set, ALG_SET_OLL, cube, 0, found)) { return false; }
+    return PerformAlg(moves, cube, found);
+}
+
+static bool PLLFromSet(MoveStack* moves, Cube* cube, AlgSet* set, AlgCase* found) {
+    found->alg = NULL;
+    if (IsPLLSolved(cube)) { return true; }
+
+    // Might only need the top layer lining up
+    Cube turned = *cube;
+    for (int i = 1; i < 4; i++) {
+        CubeFaceTurnClockwise(&turned, CUBE_YELLOW);
+        if (IsPLLSolved(&turned)) {
+            for (int j = 0; j < i; j++) {
+                PerformTurn(moves, cube, TURN_DOWN);
+            }
+            return true;
+        }
+    }
+
+    if (!AlgSetLookup(set, ALG_SET_PLL, cube, 0, found)) { return false; }
+    return PerformAlg(moves, cube, found);
+}
+
 static void SolveOLL(Arena* arena, MoveStack* moves, Cube* cube) {
-    printf("OLL:\n");
-    printf("NOT IMPLEMENTED YET\n");
-    return;
+    SolveLog("OLL:\n");
+
+    // No built in table, so this needs an algorithm set
+    AlgCase found;
+    if (!OLLFromSet(moves, cube, solve_algs, &found)) {
+        SolveLog("NO ALGORITHM FOR THIS CASE\n");
+        return;
+    }
+    if (found.alg != NULL) { SolveLog("Case: %s\n", found.alg->name); }
 
     // Sanity check
     assert(IsOLLSolved(cube));
 }
 
 static void SolvePLL(Arena* arena, MoveStack* moves, Cube* cube) {
-    printf("PLL:\n");
-    printf("NOT IMPLEMENTED YET\n");
-    return;
+    SolveLog("PLL:\n");
+    if (!IsOLLSolved(cube)) {
+        SolveLog("SKIPPED, OLL NOT SOLVED\n");
+        return;
+    }
+
+    AlgCase found;
+    if (!PLLFromSet(moves, cube, solve_algs, &found)) {
+        SolveLog("NO ALGORITHM FOR THIS CASE\n");
+        return;
+    }
+    if (found.alg != NULL) { SolveLog("Case: %s\n", found.alg->name); }
 
     // Sanity check
     assert(IsPLLSolved(cube));
 }
 
+// Paints every legal top layer orientation onto an otherwise solved cube,
+// index < OLL_CASE_LEN. Corner twists have to add up to a multiple of three
+// and edge flips to an even number, so the last of each is forced.
+bool OLLVerifyCase(MoveStack* moves, Cube* cube, AlgSet* set, u16 index) {
+    assert(index < OLL_CASE_LEN);
+    CubeSetSolved(cube);
+
+    u8 twists = index / 8;
+    u8 twist_sum = 0;
+    u8 flip_sum = 0;
+    for (int i = 0; i < 4; i++) {
+        u8 twist = (3 - twist_sum % 3) % 3;
+        u8 flip = flip_sum % 2;
+        if (i < 3) {
+            twist = twists % 3;
+            twists /= 3;
+            flip = (index >> i) & 1;
+        }
+        twist_sum += twist;
+        flip_sum += flip;
+        SetCorner(cube, (4 + i) * 3, (4 + i) * 3, twist);
+        SetEdge(cube, 8 + i * 2, 8 + i * 2, flip);
+    }
+
+    MoveStack_clear(moves);
+    AlgCase found;
+    return OLLFromSet(moves, cube, set, &found) && IsOLLSolved(cube);
+}
+
+// Every corner and edge permutation of the top layer, index < PLL_CASE_LEN.
+// Half of them have mismatched parity and can't happen, those pass.
+bool PLLVerifyCase(MoveStack* moves, Cube* cube, AlgSet* set, u16 index) {
+    assert(index < PLL_CASE_LEN);
+    u8 corners[4];
+    u8 edges[4];
+    u8 corner_parity = PermutationFromIndex(corners, index / 24);
+    u8 edge_parity = PermutationFromIndex(edges, index % 24);
+    if (corner_parity != edge_parity) { return true; }
+
+    CubeSetSolved(cube);
+    for (int i = 0; i < 4; i++) {
+        SetCorner(cube, (4 + i) * 3, (4 + corners[i]) * 3, 0);
+        SetEdge(cube, 8 + i * 2, 8 + edges[i] * 2, 0);
+    }
+
+    MoveStack_clear(moves);
+    AlgCase found;
+    return PLLFromSet(moves, cube, set, &found) && IsPLLSolved(cube);
+}
+
+void SolveUseAlgSet(AlgSet* set) {
+    solve_algs = set;
+}
+
+void SolveStageRun(SolveStage stage, Arena* arena, MoveStack* moves, Cube* cube) {
+    static const SolveFunction SOLVE_STAGE_FUNCTIONS[SOLVE_STAGE_COUNT] = {
+        SolveCross, SolveF2L, SolveOLL, SolvePLL
+    };
+    assert(stage < SOLVE_STAGE_COUNT);
+
+    solve_quiet = true;
+    SOLVE_STAGE_FUNCTIONS[stage](arena, moves, cube);
+    solve_quiet = false;
+}
+
 MoveStack* SolveCube(Arena* arena, Cube* cube) {
     ArenaReset(arena);
     TurnType* items = ArenaPushArray(arena, MOVE_STACK_LEN, TurnType);
@@ -931,10 +1206,226 @@ MoveStack* SolveCube(Arena* arena, Cube* cube) {
 
     printf("----- SOLVE -----\n");
 
-    SolveStep(SolveCross, arena, moves, cube);
-    SolveStep(SolveF2L, arena, moves, cube);
-    SolveStep(SolveOLL, arena, moves, cube);
-    SolveStep(SolvePLL, arena, moves, cube);
+    TraceBegin("solve");
+    SolveStep(SolveCross, "cross", arena, moves, cube);
+    SolveStep(SolveF2L, "f2l", arena, moves, cube);
+    SolveStep(SolveOLL, "oll", arena, moves, cube);
+    SolveStep(SolvePLL, "pll", arena, moves, cube);
+    TraceEnd("solve");
+
+    return moves;
+}
+
+// SOLVE CACHE ////////////////////////////////////////////////////////////////
+// Remembers the hash of every state along the last solution and every turn
+// the user has made since. When asked to solve again we undo the newest user
+// turns one at a time until the cube lands back on that path, then the new
+// solution is those undos followed by the rest of the old solution. A
+// peephole pass cancels and merges turns around the join and a short search
+// tries to shorten each window that crosses it.
+
+void SolveCacheInit(SolveCache* cache) {
+    cache->valid = false;
+    cache->last_incremental = false;
+    cache->path_length = 0;
+    cache->full_length = 0;
+    cache->journal_length = 0;
+}
+
+void SolveCacheTurn(SolveCache* cache, TurnType turn) {
+    // Only the newest turns are worth keeping
+    if (cache->journal_length == SOLVE_CACHE_JOURNAL_LEN) {
+        for (int i = 1; i < SOLVE_CACHE_JOURNAL_LEN; i++) {
+            cache->journal[i - 1] = cache->journal[i];
+        }
+        cache->journal_length--;
+    }
+    cache->journal[cache->journal_length++] = turn;
+}
+
+void SolveCacheForget(SolveCache* cache) {
+    // The path is still fine, we just can't say how the cube got off it
+    cache->journal_length = 0;
+}
+
+static TurnType TurnInverse(TurnType turn) {
+    if (turn < TURN_FRONT_PRIME) return turn + TURN_FRONT_PRIME;
+    if (turn < TURN_FRONT_DOUBLE) return turn - TURN_FRONT_PRIME;
+    return turn;
+}
+
+static u8 TurnQuarters(TurnType turn) {
+    return turn < TURN_FRONT_PRIME ? 1 : turn < TURN_FRONT_DOUBLE ? 3 : 2;
+}
+
+static void SolveCacheStore(SolveCache* cache, Cube* start, const TurnType* turns, u32 length, bool full) {
+    Cube walk = *start;
+
+    cache->path_hashes[0] = walk.hash;
+    for (u32 i = 0; i < length; i++) {
+        CubeTurn(&walk, turns[i]);
+        cache->path[i] = turns[i];
+        cache->path_hashes[i + 1] = walk.hash;
+    }
+    cache->path_length = length;
+    if (full) cache->full_length = length;
+    cache->journal_length = 0;
+
+    // A solve that stopped early (no algorithm set) isn't worth rejoining
+    cache->valid = IsPLLSolved(&walk);
+}
+
+// Cancels and merges turns on the same face, looking through turns on the
+// opposite face as they commute. Returns the new length.
+static u32 PeepholeTurns(TurnType* turns, u32 length) {
+    u32 out = 0;
+    for (u32 i = 0; i < length; i++) {
+        u8 face = turns[i] % 6;
+        int j = (int) out - 1;
+        while (j >= 0 && turns[j] % 6 == (face + 3) % 6) j--;
+
+        if (j >= 0 && turns[j] % 6 == face) {
+            u8 quarters = (TurnQuarters(turns[j]) + TurnQuarters(turns[i])) % 4;
+            if (quarters == 0) {
+                for (u32 k = j; k + 1 < out; k++) turns[k] = turns[k + 1];
+                out--;
+            } else {
+                turns[j] = quarters == 1 ? face : quarters == 2 ? face + TURN_FRONT_DOUBLE : face + TURN_FRONT_PRIME;
+            }
+            continue;
+        }
+        turns[out++] = turns[i];
+    }
+    return out;
+}
+
+static bool WindowSearch(Cube* cube, u64 target, TurnType* path, u32 depth, u32 max_depth, int last_face) {
+    if (depth == max_depth) return cube->hash == target;
+
+    for (int t = 0; t < TURN_TYPE_COUNT; t++) {
+        int face = t % 6;
+        // Same face twice is never shorter, opposite faces only one way round
+        if (face == last_face) continue;
+        if (last_face >= 0 && face == (last_face + 3) % 6 && face < last_face) continue;
+
+        CubeTurn(cube, t);
+        path[depth] = t;
+        bool found = WindowSearch(cube, target, path, depth + 1, max_depth, face);
+        CubeTurn(cube, TurnInverse(t));
+        if (found) return true;
+    }
+    return false;
+}
+
+// Replaces turns[start, start + window) with anything shorter that has the
+// same effect. cube is the state before turns[start]. Returns the new length.
+static u32 WindowShorten(Cube* cube, TurnType* turns, u32 length, u32 start, u32 window) {
+    Cube search = *cube;
+
+    for (u32 i = 0; i < window; i++) CubeTurn(&search, turns[start + i]);
+    u64 target = search.hash;
+    for (int i = window - 1; i >= 0; i--) CubeTurn(&search, TurnInverse(turns[start + i]));
+
+    TurnType path[RESOLVE_WINDOW_LEN];
+    for (u32 depth = 0; depth < window; depth++) {
+        if (!WindowSearch(&search, target, path, 0, depth, -1)) continue;
+
+        for (u32 i = 0; i < depth; i++) turns[start + i] = path[i];
+        u32 removed = window - depth;
+        for (u32 i = start + depth; i + removed < length; i++) turns[i] = turns[i + removed];
+        return length - removed;
+    }
+    return length;
+}
+
+// Null when the cube isn't a few known turns off the last path, or when
+// getting back to it would take more turns than a fresh solve did
+static MoveStack* SolveIncremental(Arena* arena, SolveCache* cache, Cube* cube) {
+    Cube back = *cube;
+
+    int best_undo = -1;
+    u32 best_index = 0;
+    u32 best_cost = UINT32_MAX;
+    for (u32 undo = 0; undo <= cache->journal_length; undo++) {
+        if (undo > 0) CubeTurn(&back, TurnInverse(cache->journal[cache->journal_length - undo]));
+
+        // Latest match leaves the least of the old solution to do
+        for (int i = cache->path_length; i >= 0; i--) {
+            if (cache->path_hashes[i] != back.hash) continue;
+            u32 cost = undo + cache->path_length - i;
+            if (cost < best_cost) {
+                best_cost = cost;
+                best_undo = undo;
+                best_index = i;
+            }
+            break;
+        }
+    }
+    if (best_undo < 0 || best_cost > cache->full_length) return NULL;
+
+    ArenaReset(arena);
+    TurnType* turns = ArenaPushArray(arena, MOVE_STACK_LEN, TurnType);
+    u32 length = 0;
+    for (int i = 0; i < best_undo; i++) {
+        turns[length++] = TurnInverse(cache->journal[cache->journal_length - 1 - i]);
+    }
+    for (u32 i = best_index; i < cache->path_length; i++) {
+        turns[length++] = cache->path[i];
+    }
+
+    length = PeepholeTurns(turns, length);
+    u32 join = MinU32(best_undo, length);
+
+    // Try to shorten every window crossing the join. The peephole can reach
+    // back past start so the cube is walked up to it again each time.
+    if (best_undo > 0) {
+        u32 first = join >= RESOLVE_WINDOW_LEN ? join - RESOLVE_WINDOW_LEN + 1 : 0;
+        for (u32 start = first; start <= join && start < length; start++) {
+            back = *cube;
+            for (u32 i = 0; i < start; i++) CubeTurn(&back, turns[i]);
+
+            u32 window = MinU32(RESOLVE_WINDOW_LEN, length - start);
+            length = PeepholeTurns(turns, WindowShorten(&back, turns, length, start, window));
+        }
+    }
+
+    MoveStack* moves = ArenaPushStruct(arena, MoveStack);
+    MoveStack_init(moves, turns, MOVE_STACK_LEN);
+    moves->head = length;
+
+    // Hashes can collide, make sure it really solves before turning the cube
+    back = *cube;
+    for (u32 i = 0; i < length; i++) CubeTurn(&back, turns[i]);
+    if (!IsPLLSolved(&back)) return NULL;
+
+    *cube = back;
+    printf("Rejoined last solution at %u / %u after undoing %d turns\n", best_index, cache->path_length, best_undo);
+    return moves;
+}
+
+MoveStack* SolveCubeCached(Arena* arena, SolveCache* cache, Cube* cube) {
+    Cube start = *cube;
+
+    if (cache->valid) {
+        printf("----- RESOLVE -----\n");
+        TraceBegin("resolve");
+        double begin = TimeSeconds();
+        MoveStack* moves = SolveIncremental(arena, cache, cube);
+        double elapsed = TimeSeconds() - begin;
+        TraceEnd("resolve");
+
+        cache->last_incremental = moves != NULL;
+        if (moves != NULL) {
+            printf("Time: %f seconds\n", elapsed);
+            PrintMoves(moves, 0, MoveStack_length(moves));
+            SolveCacheStore(cache, &start, moves->items, MoveStack_length(moves), false);
+            return moves;
+        }
+        printf("Not close to the last solution, solving from scratch\n\n");
+    }
 
+    cache->last_incremental = false;
+    MoveStack* moves = SolveCube(arena, cube);
+    SolveCacheStore(cache, &start, moves->items, MoveStack_length(moves), true);
     return moves;
 }
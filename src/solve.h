@@ -3,15 +3,78 @@
 
 
 #include "core.h"
+#include "algset.h"
 #include "cube.h"
 
 
+// Longest solution the 3x3 solver will produce
+#define MOVE_STACK_LEN 300
+
+// User turns remembered since the last solve, how far back a re-solve looks
+#define SOLVE_CACHE_JOURNAL_LEN 8
+
+// F2L cases with the pair in the top layer, see F2L_TOP_LAYER_LOOKUP
+#define F2L_TOP_LAYER_LEN 24
+
+// Top layer states painted by OLLVerifyCase and PLLVerifyCase
+#define OLL_CASE_LEN (27 * 8)
+#define PLL_CASE_LEN (24 * 24)
+
+
 DECLARE_TYPED_STACK(TurnType, MoveStack)
 DECLARE_TYPED_QUEUE(u32, QueueU32)
 
 
+// The steps SolveCube goes through, in order
+typedef enum {
+    SOLVE_STAGE_CROSS,
+    SOLVE_STAGE_F2L,
+    SOLVE_STAGE_OLL,
+    SOLVE_STAGE_PLL,
+
+    SOLVE_STAGE_COUNT
+} SolveStage;
+
+
+// The last solution with the hash of every state along it, and the turns
+// made since, so solving again after a few turns doesn't start from nothing
+typedef struct {
+    bool valid;
+    bool last_incremental;
+    u32 path_length;
+    u32 full_length;
+    TurnType path[MOVE_STACK_LEN];
+    u64 path_hashes[MOVE_STACK_LEN + 1];
+
+    u32 journal_length;
+    TurnType journal[SOLVE_CACHE_JOURNAL_LEN];
+} SolveCache;
+
+
 MoveStack* SolveCube(Arena* arena, Cube* cube);
-void F2LTestLookup(Arena* arena, Cube* cube);
+// One step of SolveCube on its own without printing anything, appending to
+// moves. Reset arena before each cube, the cross step fills it.
+void SolveStageRun(SolveStage stage, Arena* arena, MoveStack* moves, Cube* cube);
+void SolveUseAlgSet(AlgSet* set);
+
+void SolveCacheInit(SolveCache* cache);
+void SolveCacheTurn(SolveCache* cache, TurnType turn);
+void SolveCacheForget(SolveCache* cache);
+MoveStack* SolveCubeCached(Arena* arena, SolveCache* cache, Cube* cube);
+bool F2LVerifyCase(MoveStack* moves, Cube* cube, u8 lookup_index, u8 slot, u8 auf);
+bool OLLVerifyCase(MoveStack* moves, Cube* cube, AlgSet* set, u16 index);
+bool PLLVerifyCase(MoveStack* moves, Cube* cube, AlgSet* set, u16 index);
+void CrossBenchmark(Arena* arena, Cube* cube, int iterations);
+u32 ConvertToCrossCube(Cube* cube);
+u32 TurnCrossCube(u32 state, TurnType turn_type);
+
+bool IsCrossSolved(Cube* cube);
+bool IsF2LSolved(Cube* cube);
+bool IsOLLSolved(Cube* cube);
+bool IsPLLSolved(Cube* cube);
+bool F2LPairSolved(Cube* cube, u8 pair_index);
+u8 F2LCornerSlot(Cube* cube, u8 pair_index);
+u8 F2LEdgeSlot(Cube* cube, u8 pair_index);
 
 
 #endif  /* SOLVE_H */
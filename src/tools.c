@@ -0,0 +1,551 @@
+// Headless entry point for benchmarks and offline jobs that don't need a
+// window. Built with `./build.sh tools` and run as:
+//
+//   tools [--trace file.json] <command> [args...]
+//
+// With --trace every solver stage, table build and worker job is recorded and
+// written as a Chrome trace when the command finishes.
+
+
+#include "core.h"
+#include "algmine.h"
+#include "algset.h"
+#include "cpu.h"
+#include "cube.h"
+#include "dataset.h"
+#include "difftest.h"
+#include "extbfs.h"
+#include "hint.h"
+#include "moves.h"
+#include "pipeline.h"
+#include "pocket.h"
+#include "scramble.h"
+#include "service.h"
+#include "solve.h"
+#include "trace.h"
+#include "twophase.h"
+#include "verify.h"
+#include "raylib.h"
+
+#include <string.h>
+
+
+static const int DEFAULT_BENCH_ITERATIONS = 100;
+static const int DEFAULT_POCKET_BATCH = 1000000;
+static const int DEFAULT_SOLVE_COUNT = 10;
+static const int DEFAULT_RESOLVE_COUNT = 100;
+static const int DEFAULT_RESOLVE_TURNS = 2;
+static const int DEFAULT_DIFF_SEQUENCES = 1000000;
+static const int DEFAULT_DIFF_LENGTH = 30;
+static const int DEFAULT_HINT_COUNT = 1000;
+static const int DEFAULT_SCRAMBLE_COUNT = 1000;
+static const int DEFAULT_PIPELINE_COUNT = 200;
+static const int DEFAULT_PHASE1_COUNT = 1000000;
+static const int DEFAULT_DATASET_COUNT = 1000000;
+static const char* DEFAULT_DATASET_PATH = "states.dat";
+
+
+typedef int (*ToolFunction)(int argc, char** argv);
+
+typedef struct {
+    const char* name;
+    const char* usage;
+    ToolFunction func;
+} ToolCommand;
+
+
+static int ToolBenchCross(int argc, char** argv) {
+    int iterations = argc > 0 ? atoi(argv[0]) : DEFAULT_BENCH_ITERATIONS;
+    if (iterations <= 0) return 1;
+
+    Arena arena;
+    ArenaInit(&arena, Kilobytes(1));
+
+    Arena arena_solve;
+    ArenaInit(&arena_solve, Megabytes(8));
+
+    Cube cube;
+    CubeInit(&cube);
+
+    CrossBenchmark(&arena_solve, &cube, iterations);
+
+    ArenaFree(&arena_solve);
+    ArenaFree(&arena);
+    return 0;
+}
+
+static int ToolBenchPocket(int argc, char** argv) {
+    int count = argc > 0 ? atoi(argv[0]) : DEFAULT_POCKET_BATCH;
+    u32 thread_count = argc > 1 ? (u32) atoi(argv[1]) : ThreadCount();
+    if (count <= 0) return 1;
+
+    // Table and move tables are ~1MB, each batch state needs its coordinate,
+    // a solution for each order, the sort's keys and scratch, plus room for
+    // its packed and formatted solution
+    u64 per_state = 2 * sizeof(u32) + 3 * sizeof(u64) + 3 + POCKET_MAX_MOVES * (4 + MOVE_NAME_STRIDE);
+    Arena arena;
+    ArenaInit(&arena, Megabytes(2) + (u64) count * per_state);
+
+    PocketBenchmark(&arena, count, thread_count);
+
+    ArenaFree(&arena);
+    return 0;
+}
+
+static int ToolSolve(int argc, char** argv) {
+    int count = argc > 0 ? atoi(argv[0]) : DEFAULT_SOLVE_COUNT;
+    const char* algs_path = argc > 1 ? argv[1] : ALGSET_DEFAULT_PATH;
+    if (count <= 0) return 1;
+
+    Arena arena;
+    ArenaInit(&arena, Kilobytes(256));
+
+    Arena arena_solve;
+    ArenaInit(&arena_solve, Megabytes(5));
+
+    // Without a set OLL and PLL are skipped, the rest still works
+    AlgSet algs;
+    AlgSetLoad(&arena, &algs, algs_path);
+    SolveUseAlgSet(&algs);
+
+    Cube cube;
+    CubeInit(&cube);
+
+    for (int i = 0; i < count; i++) {
+        CubeHandScramble(&cube);
+        SolveCube(&arena_solve, &cube);
+    }
+
+    SolveUseAlgSet(NULL);
+    ArenaFree(&arena_solve);
+    ArenaFree(&arena);
+    return 0;
+}
+
+static int ToolResolve(int argc, char** argv) {
+    int count = argc > 0 ? atoi(argv[0]) : DEFAULT_RESOLVE_COUNT;
+    int turns = argc > 1 ? atoi(argv[1]) : DEFAULT_RESOLVE_TURNS;
+    if (count <= 0 || turns < 0 || turns > SOLVE_CACHE_JOURNAL_LEN) return 1;
+
+    Arena arena;
+    ArenaInit(&arena, Kilobytes(256));
+
+    Arena arena_solve;
+    ArenaInit(&arena_solve, Megabytes(5));
+
+    AlgSet algs;
+    AlgSetLoad(&arena, &algs, ALGSET_DEFAULT_PATH);
+    SolveUseAlgSet(&algs);
+
+    Cube cube;
+    CubeInit(&cube);
+    Cube fresh;
+    CubeInit(&fresh);
+
+    SolveCache* cache = ArenaPushStruct(&arena, SolveCache);
+    SolveCacheInit(cache);
+
+    // Scramble and solve, make a few turns like someone playing with the
+    // solved cube would, then solve again both ways
+    double cached_time = 0.0;
+    double fresh_time = 0.0;
+    u64 cached_moves = 0;
+    u64 fresh_moves = 0;
+    int incremental = 0;
+    for (int i = 0; i < count; i++) {
+        CubeHandScramble(&cube);
+        SolveCacheForget(cache);
+        SolveCubeCached(&arena_solve, cache, &cube);
+
+        for (int t = 0; t < turns; t++) {
+            TurnType turn = GetRandomValue(0, TURN_TYPE_COUNT - 1);
+            CubeTurn(&cube, turn);
+            SolveCacheTurn(cache, turn);
+        }
+        fresh = cube;
+
+        double start = TimeSeconds();
+        MoveStack* moves = SolveCubeCached(&arena_solve, cache, &cube);
+        cached_time += TimeSeconds() - start;
+        cached_moves += MoveStack_length(moves);
+        incremental += cache->last_incremental;
+        assert(IsPLLSolved(&cube));
+
+        start = TimeSeconds();
+        moves = SolveCube(&arena_solve, &fresh);
+        fresh_time += TimeSeconds() - start;
+        fresh_moves += MoveStack_length(moves);
+    }
+
+    printf("----- RESOLVE BENCHMARK -----\n");
+    printf("Solves: %d, %d turns off the last solution\n", count, turns);
+    printf("Incremental: %d, fell back to a full solve: %d\n", incremental, count - incremental);
+    printf("Cached:  %f ms/solve, %.1f moves/solve\n", cached_time * 1000.0 / count, (double) cached_moves / count);
+    printf("Fresh:   %f ms/solve, %.1f moves/solve\n", fresh_time * 1000.0 / count, (double) fresh_moves / count);
+
+    SolveUseAlgSet(NULL);
+    ArenaFree(&arena_solve);
+    ArenaFree(&arena);
+    return 0;
+}
+
+static int ToolAlgSet(int argc, char** argv) {
+    const char* path = argc > 0 ? argv[0] : ALGSET_DEFAULT_PATH;
+
+    Arena arena;
+    ArenaInit(&arena, Kilobytes(256));
+
+    AlgSet algs;
+    bool loaded = AlgSetLoad(&arena, &algs, path);
+    if (algs.algs != NULL) AlgSetReport(&algs);
+
+    ArenaFree(&arena);
+    return loaded ? 0 : 1;
+}
+
+static int ToolMineAlgs(int argc, char** argv) {
+    const char* faces = argc > 0 ? argv[0] : ALG_MINE_DEFAULT_FACES;
+    const char* metric_name = argc > 1 ? argv[1] : ALG_METRIC_NAMES[ALG_METRIC_HTM];
+    int max_length = argc > 2 ? atoi(argv[2]) : ALG_MINE_DEFAULT_LENGTH;
+    u32 thread_count = argc > 3 ? (u32) atoi(argv[3]) : ThreadCount();
+    const char* path = argc > 4 ? argv[4] : NULL;
+
+    int metric = -1;
+    for (int m = 0; m < ALG_METRIC_COUNT; m++) {
+        if (strcmp(metric_name, ALG_METRIC_NAMES[m]) == 0) metric = m;
+    }
+    if (metric < 0 || max_length <= 0 || max_length > ALG_MAX_LEN || thread_count == 0) return 1;
+
+    Arena arena;
+    ArenaInit(&arena, ALG_MINE_ARENA_SIZE);
+
+    bool valid = AlgMineRun(&arena, faces, metric, max_length, thread_count, path);
+
+    ArenaFree(&arena);
+    return valid ? 0 : 1;
+}
+
+static int ToolDiffTest(int argc, char** argv) {
+    int sequences = argc > 0 ? atoi(argv[0]) : DEFAULT_DIFF_SEQUENCES;
+    int length = argc > 1 ? atoi(argv[1]) : DEFAULT_DIFF_LENGTH;
+    u32 thread_count = argc > 2 ? (u32) atoi(argv[2]) : ThreadCount();
+    if (sequences <= 0 || length <= 0 || length > DIFF_MAX_LENGTH) return 1;
+
+    // Pocket table is ~1MB, the rest is tiny
+    Arena arena;
+    ArenaInit(&arena, Megabytes(2));
+
+    bool passed = DiffTestRun(&arena, sequences, length, thread_count);
+
+    ArenaFree(&arena);
+    return passed ? 0 : 1;
+}
+
+static int ToolBenchHint(int argc, char** argv) {
+    int count = argc > 0 ? atoi(argv[0]) : DEFAULT_HINT_COUNT;
+    if (count <= 0) return 1;
+
+    HintBenchmark(count);
+    return 0;
+}
+
+static int ToolBenchPipeline(int argc, char** argv) {
+    int count = argc > 0 ? atoi(argv[0]) : DEFAULT_PIPELINE_COUNT;
+    u32 thread_count = argc > 1 ? (u32) atoi(argv[1]) : ThreadCount();
+    u64 seed = argc > 2 ? strtoull(argv[2], NULL, 10) : 0;
+    if (count <= 0 || thread_count == 0) return 1;
+
+    Arena arena;
+    ArenaInit(&arena, PipelineArenaSize(count) + Kilobytes(256));
+
+    AlgSet algs;
+    AlgSetLoad(&arena, &algs, ALGSET_DEFAULT_PATH);
+    SolveUseAlgSet(&algs);
+
+    PipelineBenchmark(&arena, count, thread_count, seed);
+
+    ArenaFree(&arena);
+    return 0;
+}
+
+static int ToolBenchPhase1(int argc, char** argv) {
+    int count = argc > 0 ? atoi(argv[0]) : DEFAULT_PHASE1_COUNT;
+    u64 seed = argc > 1 ? strtoull(argv[1], NULL, 10) : 0;
+    u32 in_flight = argc > 2 ? (u32) atoi(argv[2]) : TWOPHASE_DEFAULT_IN_FLIGHT;
+    if (count <= 0 || in_flight == 0 || in_flight > TWOPHASE_MAX_IN_FLIGHT) return 1;
+
+    Arena arena;
+    ArenaInit(&arena, TwoPhasePhase1BenchmarkArenaSize(count));
+
+    TwoPhasePhase1Benchmark(&arena, count, seed, in_flight);
+
+    ArenaFree(&arena);
+    return 0;
+}
+
+static int ToolBenchService(int argc, char** argv) {
+    int count = argc > 0 ? atoi(argv[0]) : SERVICE_DEFAULT_COUNT;
+    int batch = argc > 1 ? atoi(argv[1]) : SERVICE_DEFAULT_BATCH;
+    if (count <= 0 || batch <= 0 || batch > SERVICE_RING_LEN) return 1;
+
+    Arena arena;
+    ArenaInit(&arena, ServiceArenaSize(count));
+
+    ServiceBenchmark(&arena, count, batch);
+
+    ArenaFree(&arena);
+    return 0;
+}
+
+static int ToolBenchServiceMixed(int argc, char** argv) {
+    int interactive_count = argc > 0 ? atoi(argv[0]) : SERVICE_DEFAULT_INTERACTIVE_COUNT;
+    int deadline_ms = argc > 1 ? atoi(argv[1]) : SERVICE_DEFAULT_DEADLINE_MS;
+    if (interactive_count <= 0 || deadline_ms <= 0) return 1;
+
+    Arena arena;
+    ArenaInit(&arena, SERVICE_MIXED_ARENA_SIZE);
+
+    ServiceMixedBenchmark(&arena, interactive_count, deadline_ms);
+
+    ArenaFree(&arena);
+    return 0;
+}
+
+static int ToolScramble(int argc, char** argv) {
+    int count = argc > 0 ? atoi(argv[0]) : DEFAULT_SCRAMBLE_COUNT;
+    u64 seed = argc > 1 ? strtoull(argv[1], NULL, 10) : 0;
+    u32 thread_count = argc > 2 ? (u32) atoi(argv[2]) : ThreadCount();
+    const char* path = argc > 3 ? argv[3] : NULL;
+    if (count <= 0 || thread_count == 0) return 1;
+
+    Arena arena;
+    ArenaInit(&arena, ScrambleArenaSize(count));
+
+    ScrambleRun(&arena, count, seed, thread_count, path);
+
+    ArenaFree(&arena);
+    return 0;
+}
+
+static int ToolDatasetGen(int argc, char** argv) {
+    int count = argc > 0 ? atoi(argv[0]) : DEFAULT_DATASET_COUNT;
+    int distinct = argc > 1 ? atoi(argv[1]) : count / 4;
+    u64 seed = argc > 2 ? strtoull(argv[2], NULL, 10) : 0;
+    const char* path = argc > 3 ? argv[3] : DEFAULT_DATASET_PATH;
+    if (count <= 0 || distinct <= 0) return 1;
+
+    Arena arena;
+    ArenaInit(&arena, Megabytes(4));
+
+    double start = TimeSeconds();
+    bool written = DatasetGenerate(&arena, path, count, distinct, seed);
+    printf("Generated %d states (%d distinct) in %f seconds\n", count, distinct, TimeSeconds() - start);
+
+    ArenaFree(&arena);
+    return written ? 0 : 1;
+}
+
+static int ToolDatasetSort(int argc, char** argv) {
+    if (argc < 2) return 1;
+    const char* in_path = argv[0];
+    const char* out_path = argv[1];
+    int memory_mb = argc > 2 ? atoi(argv[2]) : DATASET_DEFAULT_MEMORY_MB;
+    u32 thread_count = argc > 3 ? (u32) atoi(argv[3]) : ThreadCount();
+    if (memory_mb <= 0 || thread_count == 0) return 1;
+
+    // Room past the budget for the smallest buffers when it's tiny
+    u64 memory = Megabytes((u64) memory_mb);
+    Arena arena;
+    ArenaInit(&arena, memory + Megabytes(16));
+
+    printf("----- DATASET SORT -----\n");
+    DatasetStats stats;
+    double start = TimeSeconds();
+    bool sorted = DatasetSortDedupe(&arena, in_path, out_path, memory, thread_count, &stats);
+    double elapsed = TimeSeconds() - start;
+
+    u64 bytes = stats.bytes_read + stats.bytes_written;
+    printf("Threads: %u, memory: %d MB\n", thread_count, memory_mb);
+    printf(
+        "States: %llu, invalid: %llu, unique up to symmetry: %llu\n", (unsigned long long) stats.states,
+        (unsigned long long) stats.invalid, (unsigned long long) stats.unique
+    );
+    printf(
+        "Runs: %u, read %llu MB, written %llu MB\n", stats.runs,
+        (unsigned long long) ToMegabytes(stats.bytes_read), (unsigned long long) ToMegabytes(stats.bytes_written)
+    );
+    printf(
+        "Rank %f, sort %f, merge %f, total %f seconds (%.0f MB/s through disk)\n\n",
+        stats.rank_seconds, stats.sort_seconds, stats.merge_seconds, elapsed, bytes / elapsed / Megabytes(1)
+    );
+
+    ArenaFree(&arena);
+    return sorted ? 0 : 1;
+}
+
+static int ToolExtBfs(int argc, char** argv) {
+    if (argc < 2) return 1;
+    int edge_count = atoi(argv[0]);
+    const char* dir = argv[1];
+    int memory_mb = argc > 2 ? atoi(argv[2]) : EXTBFS_DEFAULT_MEMORY_MB;
+    u32 thread_count = argc > 3 ? (u32) atoi(argv[3]) : ThreadCount();
+    bool pdb = argc > 4 && strcmp(argv[4], "pdb") == 0;
+    if (edge_count < EXTBFS_MIN_EDGES || edge_count > EXTBFS_MAX_EDGES) return 1;
+    if (memory_mb <= 0 || thread_count == 0) return 1;
+
+    // Merge buffers and the like on top of the budget
+    u64 memory = Megabytes((u64) memory_mb);
+    Arena arena;
+    ArenaInit(&arena, memory + Megabytes(16));
+
+    bool done = ExtBfsRun(&arena, edge_count, dir, memory, thread_count, pdb);
+
+    ArenaFree(&arena);
+    return done ? 0 : 1;
+}
+
+static int ToolPhase1Sharded(int argc, char** argv) {
+    if (argc < 1) return 1;
+    const char* dir = argv[0];
+    int shard_count = argc > 1 ? atoi(argv[1]) : TWOPHASE_DEFAULT_SHARDS;
+    int worker_count = argc > 2 ? atoi(argv[2]) : (int) ThreadCount();
+    const char* cache_path = argc > 3 ? argv[3] : TWOPHASE_CACHE_PATH;
+    if (shard_count <= 0 || shard_count > TWOPHASE_MAX_SHARDS || worker_count <= 0) return 1;
+
+    Arena arena;
+    ArenaInit(&arena, TWOPHASE_SHARDED_ARENA_SIZE);
+
+    bool done = TwoPhasePhase1Sharded(&arena, dir, cache_path, shard_count, worker_count);
+
+    ArenaFree(&arena);
+    return done ? 0 : 1;
+}
+
+static int ToolPhase1Shard(int argc, char** argv) {
+    if (argc < 2) return 1;
+    const char* dir = argv[0];
+    int shard = atoi(argv[1]);
+    u32 thread_count = argc > 2 ? (u32) atoi(argv[2]) : ThreadCount();
+    if (shard < 0 || thread_count == 0) return 1;
+
+    Arena arena;
+    ArenaInit(&arena, TWOPHASE_ARENA_SIZE);
+
+    bool done = TwoPhasePhase1Shard(&arena, dir, shard, thread_count);
+
+    ArenaFree(&arena);
+    return done ? 0 : 1;
+}
+
+static int ToolSolveOptimal(int argc, char** argv) {
+    if (argc < 1) return 1;
+    int scramble_length = atoi(argv[0]);
+    u64 seed = argc > 1 ? strtoull(argv[1], NULL, 10) : 0;
+    u32 thread_count = argc > 2 ? (u32) atoi(argv[2]) : ThreadCount();
+    const char* checkpoint_path = argc > 3 ? argv[3] : NULL;
+    double interval = argc > 4 ? atof(argv[4]) : TWOPHASE_DEFAULT_CHECKPOINT_INTERVAL;
+    if (scramble_length < 0 || thread_count == 0 || interval <= 0) return 1;
+
+    Arena arena;
+    ArenaInit(&arena, TWOPHASE_ARENA_SIZE);
+
+    TwoPhaseOptimalRun(&arena, scramble_length, seed, thread_count, checkpoint_path, interval);
+
+    ArenaFree(&arena);
+    return 0;
+}
+
+static int ToolBenchCpu(int argc, char** argv) {
+    (void) argc;
+    (void) argv;
+
+    // Two 64MB buffers, 1M cubes and their results
+    Arena arena;
+    ArenaInit(&arena, Megabytes(160));
+
+    CpuBenchmark(&arena);
+
+    ArenaFree(&arena);
+    return 0;
+}
+
+static int ToolVerify(int argc, char** argv) {
+    u32 thread_count = argc > 0 ? (u32) atoi(argv[0]) : ThreadCount();
+    const char* algs_path = argc > 1 ? argv[1] : ALGSET_DEFAULT_PATH;
+    if (thread_count == 0) return 1;
+
+    Arena arena;
+    ArenaInit(&arena, Kilobytes(256));
+
+    AlgSet algs;
+    bool passed = AlgSetLoad(&arena, &algs, algs_path);
+    passed = VerifyRun(&algs, thread_count) && passed;
+
+    ArenaFree(&arena);
+    return passed ? 0 : 1;
+}
+
+static const ToolCommand TOOL_COMMANDS[] = {
+    { "bench-cross", "[iterations]", ToolBenchCross },
+    { "bench-pocket", "[count] [threads]", ToolBenchPocket },
+    { "solve", "[count] [algset]", ToolSolve },
+    { "resolve", "[count] [turns]", ToolResolve },
+    { "algset", "[path]", ToolAlgSet },
+    { "mine-algs", "[faces] [htm|qtm] [max length] [threads] [file]", ToolMineAlgs },
+    { "difftest", "[sequences] [length] [threads]", ToolDiffTest },
+    { "bench-cpu", "", ToolBenchCpu },
+    { "bench-hint", "[count]", ToolBenchHint },
+    { "bench-pipeline", "[count] [threads] [seed]", ToolBenchPipeline },
+    { "bench-phase1", "[count] [seed] [in flight]", ToolBenchPhase1 },
+    { "bench-service", "[count] [batch]", ToolBenchService },
+    { "bench-service-mixed", "[interactive count] [deadline ms]", ToolBenchServiceMixed },
+    { "verify", "[threads] [algset]", ToolVerify },
+    { "scramble", "[count] [seed] [threads] [file]", ToolScramble },
+    { "dataset-gen", "[count] [distinct] [seed] [file]", ToolDatasetGen },
+    { "dataset-sort", "<in> <out> [memory MB] [threads]", ToolDatasetSort },
+    { "extbfs", "<edges> <dir> [memory MB] [threads] [pdb]", ToolExtBfs },
+    { "phase1-sharded", "<dir> [shards] [workers] [cache path]", ToolPhase1Sharded },
+    { "phase1-shard", "<dir> <shard> [threads]", ToolPhase1Shard },
+    { "solve-optimal", "<scramble length> [seed] [threads] [checkpoint] [interval s]", ToolSolveOptimal },
+};
+static const int TOOL_COMMAND_COUNT = sizeof(TOOL_COMMANDS) / sizeof(TOOL_COMMANDS[0]);
+
+
+static void ToolUsage(const char* program) {
+    printf("Usage: %s [--trace file.json] <command> [args...]\n", program);
+    for (int i = 0; i < TOOL_COMMAND_COUNT; i++) {
+        printf("  %s %s\n", TOOL_COMMANDS[i].name, TOOL_COMMANDS[i].usage);
+    }
+}
+
+int main(int argc, char** argv) {
+    SetRandomSeed(0);
+    CpuInit();
+    CubeZobristInit();
+
+    const char* program = argv[0];
+    const char* trace_path = NULL;
+
+    if (argc >= 3 && strcmp(argv[1], "--trace") == 0) {
+        trace_path = argv[2];
+        argc -= 2;
+        argv += 2;
+        TraceInit();
+    }
+
+    if (argc < 2) {
+        ToolUsage(program);
+        return 1;
+    }
+
+    for (int i = 0; i < TOOL_COMMAND_COUNT; i++) {
+        if (strcmp(argv[1], TOOL_COMMANDS[i].name) == 0) {
+            int result = TOOL_COMMANDS[i].func(argc - 2, argv + 2);
+            if (trace_path != NULL) TraceWrite(trace_path);
+            return result;
+        }
+    }
+
+    ToolUsage(program);
+    return 1;
+}
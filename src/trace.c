@@ -0,0 +1,269 @@
+// Timeline tracing. Each thread records begin/end events into its own ring so
+// recording never takes a lock or touches another thread's cache lines, it is
+// two stores and a release of the ring head. A ring belongs to one ParallelRun
+// thread index in one thread lane, so share 0 of a ParallelRun uses the same
+// ring as the thread that called it (which is busy running that share), while
+// a background thread like the hint worker and anything it runs in parallel
+// get rings of their own. Lanes past TRACE_LANE_COUNT aren't recorded. Rings
+// are allocated by their thread on its first event, so only threads that
+// actually trace cost any memory.
+//
+// TraceWrite dumps every ring as Chrome trace JSON, which can be opened in
+// chrome://tracing or ui.perfetto.dev. Counters (page faults so far, not on
+// Windows) are written alongside so slow spots can be matched up with cold
+// memory.
+//
+// Separately TraceCacheStart/Stop read the hardware cache counters around a
+// piece of work, for comparing how two ways of doing the same job use the
+// cache.
+
+
+#include "trace.h"
+
+#ifndef PLATFORM_WINDOWS
+#include <sys/resource.h>
+#endif
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#endif
+
+
+typedef enum {
+    TRACE_BEGIN,
+    TRACE_END,
+    TRACE_COUNTER,
+} TraceType;
+
+typedef struct {
+    const char* name;
+    u64 time;   // nanoseconds since TraceInit
+    u64 value;
+    enum8(TraceType) type;
+} TraceEvent;
+
+typedef struct {
+    TraceEvent* events;
+    u64 head;   // total events ever written, only the last TRACE_RING_LEN kept
+} TraceRing;
+
+// The main thread's lane and one for a background thread
+#define TRACE_LANE_COUNT 2
+#define TRACE_RING_COUNT (TRACE_LANE_COUNT * MAX_THREADS)
+
+
+static TraceRing trace_rings[TRACE_RING_COUNT];
+static u32 trace_ring_count = 0;
+static u64 trace_start = 0;
+
+
+static u64 TraceNow(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (u64) now.tv_sec * 1000000000ull + now.tv_nsec;
+}
+
+// No getrusage on Windows, the counter just isn't written there
+static bool TracePageFaults(u64* faults) {
+#ifdef PLATFORM_WINDOWS
+    return false;
+#else
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0) return false;
+    *faults = usage.ru_minflt + usage.ru_majflt;
+    return true;
+#endif
+}
+
+void TraceInit(void) {
+    if (trace_ring_count > 0) return;
+
+    // There is a ring for every possible thread index in every lane as a
+    // ParallelRun can ask for more threads than there are cores, but each is
+    // only allocated by its thread the first time it records something
+    trace_start = TraceNow();
+    trace_ring_count = TRACE_RING_COUNT;
+}
+
+bool TraceEnabled(void) {
+    return trace_ring_count > 0;
+}
+
+static void TraceRecord(const char* name, enum8(TraceType) type, u64 value) {
+    u32 lane = ThreadLane();
+    if (lane >= TRACE_LANE_COUNT) return;
+
+    u32 index = lane * MAX_THREADS + ThreadIndex();
+    if (index >= trace_ring_count) return;
+
+    // Only this thread writes its ring so relaxed loads are enough
+    TraceRing* ring = &trace_rings[index];
+    TraceEvent* events = __atomic_load_n(&ring->events, __ATOMIC_RELAXED);
+    if (events == NULL) {
+        events = malloc(TRACE_RING_LEN * sizeof(TraceEvent));
+        if (events == NULL) return;
+        __atomic_store_n(&ring->events, events, __ATOMIC_RELEASE);
+    }
+    u64 head = __atomic_load_n(&ring->head, __ATOMIC_RELAXED);
+
+    TraceEvent* event = &events[head % TRACE_RING_LEN];
+    event->name = name;
+    event->time = TraceNow() - trace_start;
+    event->value = value;
+    event->type = type;
+
+    __atomic_store_n(&ring->head, head + 1, __ATOMIC_RELEASE);
+}
+
+void TraceBegin(const char* name) {
+    if (trace_ring_count == 0) return;
+    TraceRecord(name, TRACE_BEGIN, 0);
+}
+
+void TraceEnd(const char* name) {
+    if (trace_ring_count == 0) return;
+    TraceRecord(name, TRACE_END, 0);
+}
+
+void TraceCounter(const char* name, u64 value) {
+    if (trace_ring_count == 0) return;
+    TraceRecord(name, TRACE_COUNTER, value);
+}
+
+// Page faults so far as a counter, call after touching a lot of new memory
+void TraceFaults(void) {
+    u64 faults;
+    if (trace_ring_count == 0 || !TracePageFaults(&faults)) return;
+    TraceRecord("page faults", TRACE_COUNTER, faults);
+}
+
+// Meant to be called when no other thread is tracing
+bool TraceWrite(const char* path) {
+    if (trace_ring_count == 0) return false;
+
+    FILE* file = fopen(path, "w");
+    if (file == NULL) {
+        printf("Couldn't open %s for the trace\n", path);
+        return false;
+    }
+
+    // Page faults at the time of writing so the last counter value is current
+    TraceFaults();
+
+    fprintf(file, "{\"traceEvents\":[\n");
+    bool first = true;
+    u64 event_count = 0;
+
+    for (u32 i = 0; i < trace_ring_count; i++) {
+        TraceRing* ring = &trace_rings[i];
+        u64 head = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+        if (head == 0) continue;
+        TraceEvent* events = __atomic_load_n(&ring->events, __ATOMIC_ACQUIRE);
+
+        fprintf(
+            file, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,"
+            "\"args\":{\"name\":\"%s %u\"}}",
+            first ? "" : ",\n", i, i == 0 ? "main/worker" : i < MAX_THREADS ? "worker" : "background worker",
+            i % MAX_THREADS
+        );
+        first = false;
+
+        u64 start = head > TRACE_RING_LEN ? head - TRACE_RING_LEN : 0;
+        for (u64 j = start; j < head; j++) {
+            TraceEvent* event = &events[j % TRACE_RING_LEN];
+            double micros = event->time / 1000.0;
+
+            if (event->type == TRACE_COUNTER) {
+                fprintf(
+                    file, ",\n{\"name\":\"%s\",\"ph\":\"C\",\"pid\":1,\"tid\":%u,"
+                    "\"ts\":%.3f,\"args\":{\"value\":%llu}}",
+                    event->name, i, micros, (unsigned long long) event->value
+                );
+            } else {
+                fprintf(
+                    file, ",\n{\"name\":\"%s\",\"ph\":\"%c\",\"pid\":1,\"tid\":%u,\"ts\":%.3f}",
+                    event->name, event->type == TRACE_BEGIN ? 'B' : 'E', i, micros
+                );
+            }
+            event_count++;
+        }
+    }
+
+    fprintf(file, "\n]}\n");
+    fclose(file);
+
+    printf("Wrote %llu trace events to %s\n", (unsigned long long) event_count, path);
+    return true;
+}
+
+#ifdef __linux__
+static int TraceCacheOpen(u32 type, u64 config) {
+    struct perf_event_attr attr = { 0 };
+    attr.type = type;
+    attr.size = sizeof(attr);
+    attr.config = config;
+    attr.disabled = 1;
+    attr.inherit = 1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    return (int) syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+}
+
+static u64 TraceCacheRead(int fd) {
+    u64 value = 0;
+    if (fd < 0) return 0;
+    ioctl(fd, PERF_EVENT_IOC_DISABLE, 0);
+    if (read(fd, &value, sizeof(value)) != sizeof(value)) value = 0;
+    close(fd);
+    return value;
+}
+#endif
+
+bool TraceCacheStart(TraceCacheCounters* counters) {
+    counters->references = -1;
+    counters->misses = -1;
+    counters->tlb_misses = -1;
+
+#ifdef __linux__
+    // Generic events the kernel maps to the last level cache on x86
+    counters->references = TraceCacheOpen(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_REFERENCES);
+    counters->misses = TraceCacheOpen(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES);
+    if (counters->references < 0 || counters->misses < 0) {
+        if (counters->references >= 0) close(counters->references);
+        if (counters->misses >= 0) close(counters->misses);
+        counters->references = -1;
+        counters->misses = -1;
+        return false;
+    }
+
+    // Not every CPU (or VM) has this one, it's left at 0 if not
+    counters->tlb_misses = TraceCacheOpen(
+        PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_DTLB
+            | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16)
+    );
+
+    ioctl(counters->references, PERF_EVENT_IOC_ENABLE, 0);
+    ioctl(counters->misses, PERF_EVENT_IOC_ENABLE, 0);
+    if (counters->tlb_misses >= 0) ioctl(counters->tlb_misses, PERF_EVENT_IOC_ENABLE, 0);
+    return true;
+#else
+    return false;
+#endif
+}
+
+// Inherited counts from threads are only added in once they have exited,
+// which ParallelRun has made sure of by the time it returns
+void TraceCacheStop(TraceCacheCounters* counters, TraceCacheCounts* counts) {
+    *counts = (TraceCacheCounts) { 0 };
+
+#ifdef __linux__
+    counts->references = TraceCacheRead(counters->references);
+    counts->misses = TraceCacheRead(counters->misses);
+    counts->tlb_misses = TraceCacheRead(counters->tlb_misses);
+    counters->references = -1;
+    counters->misses = -1;
+    counters->tlb_misses = -1;
+#endif
+}
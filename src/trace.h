@@ -0,0 +1,44 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+
+#include "core.h"
+
+
+// Events kept per thread. Once full the oldest events are overwritten so the
+// trace always has the most recent work.
+#define TRACE_RING_LEN 16384
+
+
+// Names must be string literals (or otherwise live forever) as only the
+// pointer is stored. Every TraceBegin needs a TraceEnd with the same name on
+// the same thread. All of these do nothing until TraceInit is called.
+void TraceInit(void);
+bool TraceEnabled(void);
+void TraceBegin(const char* name);
+void TraceEnd(const char* name);
+void TraceCounter(const char* name, u64 value);
+void TraceFaults(void);
+bool TraceWrite(const char* path);
+
+// Last level cache references and misses, and data TLB misses, from the
+// CPU's own counters for this thread and every thread started after
+// TraceCacheStart (so start it before a ParallelRun, stop it after). Linux
+// only and the kernel has to let us (perf_event_paranoid), TraceCacheStart
+// returns false when it won't.
+typedef struct {
+    int references;
+    int misses;
+    int tlb_misses;
+} TraceCacheCounters;
+
+typedef struct {
+    u64 references;
+    u64 misses;
+    u64 tlb_misses;
+} TraceCacheCounts;
+
+bool TraceCacheStart(TraceCacheCounters* counters);
+void TraceCacheStop(TraceCacheCounters* counters, TraceCacheCounts* counts);
+
+#endif  /* TRACE_H */
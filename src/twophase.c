@@ -0,0 +1,2575 @@
+// Kociemba's two-phase algorithm for short 3x3 solutions.
+//
+// Phase 1 gets the cube into the group generated by U, D, R2, L2, F2 and B2:
+// every corner twist and edge flip fixed and the four middle layer edges
+// somewhere in the middle layer. Phase 2 then solves it using only those
+// turns. Both phases are IDA* searches over coordinates (small integers that
+// each describe part of the cube) with move tables to turn a coordinate
+// without touching the cube.
+//
+// Phase 1 has an exact distance table for all of twist, flip and slice. That
+// is 2 billion states, too many even at 2 bits, but the 16 symmetries that
+// keep the U-D axis where it is (TWOPHASE_SYM_COUNT) leave the distance alone
+// so only one flip and slice per symmetry class is stored, 140 million
+// entries in 35MB. It's built with the same 2 bit layered BFS as the pocket
+// table and cached on disk since it takes a while. Phase 2 uses two smaller
+// tables of exact distances for pairs of coordinates, the larger of which is
+// a lower bound.
+//
+// Phase 1 solutions are tried shortest first and each one gets a phase 2
+// search limited to whatever is left of max_length, so the first solution
+// found is at most max_length but not necessarily optimal. With max_length 20
+// a random cube usually takes a few milliseconds.
+//
+// Everything is built on the piece level TwoPhaseCubie. The effect of each
+// turn and each symmetry on the pieces is found from a real Cube's stickers,
+// so the conventions here can never drift from cube.c.
+
+
+#include "twophase.h"
+#include "cpu.h"
+#include "trace.h"
+
+#include <signal.h>
+
+#ifdef __linux__
+#include <sys/wait.h>
+#endif
+
+#if defined(__x86_64__) || defined(__i386__)
+#define TWOPHASE_X86
+#include <immintrin.h>
+#endif
+
+
+// First and last slot of the middle layer edges in CUBE_EDGE_COLOUR_TABLE
+#define TWOPHASE_SLICE_FIRST 4
+#define TWOPHASE_SLICE_LAST 7
+
+#define TWOPHASE_PRUNE_UNVISITED UINT8_MAX
+
+// Search nodes between asking a search's stop function, a power of two
+#define TWOPHASE_STOP_NODES 1024
+
+// Phase 1 distances are 2 bit entries, 16 to a word, 3 meaning not found yet
+#define TWOPHASE_WORD_ENTRIES 16
+#define TWOPHASE_UNVISITED 3
+
+// Words each BFS worker takes at a time
+#define TWOPHASE_BFS_CHUNK 4096
+
+// Bump when anything changes how the cached table is laid out or numbered
+#define TWOPHASE_CACHE_MAGIC 0x32505754u
+#define TWOPHASE_CACHE_VERSION 1
+
+#define TWOPHASE_SHARD_MAGIC 0x53505754u
+#define TWOPHASE_SHARD_STATE UINT32_MAX
+
+// Second version, roots went from a first turn to a first two turns
+#define TWOPHASE_CHECKPOINT_MAGIC 0x32435054u
+
+// An optimal search's roots, every pair of first turns whether or not the
+// second is allowed after the first
+#define TWOPHASE_OPTIMAL_ROOT_COUNT (TURN_TYPE_COUNT * TURN_TYPE_COUNT)
+
+// Three ways round (see TWOPHASE_ROTATE_FACES), each as is and inverted
+#define TWOPHASE_SEARCH_COUNT 6
+
+// Random walks checked against a real Cube after the tables are built
+#define TWOPHASE_CHECK_WALKS 64
+#define TWOPHASE_CHECK_WALK_LEN 40
+
+
+const enum8(TurnType) TWOPHASE_PHASE2_TURNS[TWOPHASE_PHASE2_TURN_COUNT] = {
+    TURN_UP, TURN_UP_PRIME, TURN_UP_DOUBLE,
+    TURN_DOWN, TURN_DOWN_PRIME, TURN_DOWN_DOUBLE,
+    TURN_FRONT_DOUBLE, TURN_RIGHT_DOUBLE, TURN_BACK_DOUBLE, TURN_LEFT_DOUBLE,
+};
+
+// Slots of the top and bottom layer edges, phase 2 keeps them among these
+static const u8 TWOPHASE_UD_EDGE_SLOTS[8] = { 0, 1, 2, 3, 8, 9, 10, 11 };
+static const u8 TWOPHASE_UD_EDGE_INDEX[TWOPHASE_EDGE_COUNT] = {
+    0, 1, 2, 3, UINT8_MAX, UINT8_MAX, UINT8_MAX, UINT8_MAX, 4, 5, 6, 7
+};
+
+
+// A third of a turn of the whole cube about the corner between U, R and F:
+// what was on F is now on U, R on F and U on R
+static const enum8(CubeColour) TWOPHASE_ROTATE_FACES[CUBE_COLOUR_COUNT] = {
+    CUBE_WHITE, CUBE_GREEN, CUBE_RED, CUBE_YELLOW, CUBE_BLUE, CUBE_ORANGE,
+};
+static const enum8(CubeColour) TWOPHASE_UNROTATE_FACES[CUBE_COLOUR_COUNT] = {
+    CUBE_RED, CUBE_WHITE, CUBE_GREEN, CUBE_ORANGE, CUBE_YELLOW, CUBE_BLUE,
+};
+
+// The symmetries are every combination of these: a quarter turn of the whole
+// cube about U-D (F goes to L), a half turn about F-B and a mirror swapping R
+// and L. Symmetry s is mirror^(s / 8 % 2) after half^(s / 4 % 2) after
+// quarter^(s % 4), after TWOPHASE_ROTATE_FACES s / 16 times for the ones that
+// move U-D as well. Only the first TWOPHASE_SYM_COUNT are used by the tables.
+static const enum8(CubeColour) TWOPHASE_SYM_QUARTER[CUBE_COLOUR_COUNT] = {
+    CUBE_ORANGE, CUBE_GREEN, CUBE_WHITE, CUBE_RED, CUBE_BLUE, CUBE_YELLOW,
+};
+static const enum8(CubeColour) TWOPHASE_SYM_HALF[CUBE_COLOUR_COUNT] = {
+    CUBE_GREEN, CUBE_ORANGE, CUBE_YELLOW, CUBE_BLUE, CUBE_RED, CUBE_WHITE,
+};
+static const enum8(CubeColour) TWOPHASE_SYM_MIRROR[CUBE_COLOUR_COUNT] = {
+    CUBE_GREEN, CUBE_ORANGE, CUBE_WHITE, CUBE_BLUE, CUBE_RED, CUBE_YELLOW,
+};
+
+
+// What a symmetry does to the pieces: the piece in slot i goes to slot
+// corner_slots[i] and its sticker k to sticker corner_stickers[i] + k there
+// (minus k when mirrored, which reverses the clockwise order). Edges the same
+// but always plus.
+typedef struct {
+    u8 corner_slots[TWOPHASE_CORNER_COUNT];
+    u8 corner_stickers[TWOPHASE_CORNER_COUNT];
+    u8 edge_slots[TWOPHASE_EDGE_COUNT];
+    u8 edge_stickers[TWOPHASE_EDGE_COUNT];
+    bool mirror;
+} TwoPhaseSym;
+
+
+// Found once by TwoPhaseTablesInit
+static bool twophase_turns_ready = false;
+static TwoPhaseCubie TWOPHASE_TURN_CUBIES[TURN_TYPE_COUNT];
+static u16 TWOPHASE_SLICE_RANK[1 << TWOPHASE_EDGE_COUNT];
+static u16 TWOPHASE_SLICE_MASKS[TWOPHASE_SLICE_COUNT];
+static u16 TWOPHASE_SLICE_SOLVED;
+static u8 TWOPHASE_ROTATE_STICKERS[CUBE_COLOUR_COUNT * 8];
+static enum8(CubeColour) TWOPHASE_SYM_FACES[TWOPHASE_FULL_SYM_COUNT][CUBE_COLOUR_COUNT];
+static u8 TWOPHASE_SYM_STICKERS[TWOPHASE_FULL_SYM_COUNT][CUBE_COLOUR_COUNT * 8];
+static u8 TWOPHASE_SYM_INVERSE[TWOPHASE_FULL_SYM_COUNT];
+static TwoPhaseSym TWOPHASE_SYMS[TWOPHASE_FULL_SYM_COUNT];
+
+
+typedef struct {
+    TwoPhaseTables* tables;
+    TwoPhaseCubie start;
+    u16 twist;
+    u16 flip;
+    u16 slice;
+    u8 distance;
+    u8 max_length;
+    enum8(TurnType) moves[TWOPHASE_MAX_LENGTH];
+    u8 length;
+
+    // TwoPhaseSolveUntil's, asked every TWOPHASE_STOP_NODES nodes
+    TwoPhaseStopFunction stop;
+    void* stop_data;
+    u32 nodes;
+    bool stopped;
+} TwoPhaseSearch;
+
+typedef struct {
+    TwoPhaseTables* tables;
+    u8 depth;
+    bool backward;
+    u32 next_chunk;
+    u64 found;
+
+    // Words looked through and entries that can be set, the whole table
+    // unless it's one shard's part (see TwoPhasePhase1Sharded)
+    u32 scan_first;
+    u32 scan_end;
+    u64 keep_first;
+    u64 keep_end;
+} TwoPhaseLayerJob;
+
+typedef struct {
+    u32 magic;
+    u32 version;
+    u64 entry_count;
+    u64 checksum;
+} TwoPhaseCacheHeader;
+
+// A sharded build's state or shard file: the cache header for just the
+// words in the file, then where they go
+typedef struct {
+    TwoPhaseCacheHeader cache;
+    u32 depth;          // Entries this far from solved or closer are all set
+    u32 shard;          // TWOPHASE_SHARD_STATE for the state file
+    u32 shard_count;
+    u32 first_word;
+    u64 layer;          // Entries found at depth, just this shard's in a shard file
+    u64 visited;        // State file only
+} TwoPhaseShardHeader;
+
+
+// COORDINATES ////////////////////////////////////////////////////////////////
+// Lehmer code, 0 for the identity
+static u32 TwoPhasePermRank(const u8* perm, u8 n) {
+    u32 rank = 0;
+    for (int i = 0; i < n; i++) {
+        u32 smaller = 0;
+        for (int j = i + 1; j < n; j++) {
+            if (perm[j] < perm[i]) smaller++;
+        }
+        rank = rank * (n - i) + smaller;
+    }
+    return rank;
+}
+
+static void TwoPhasePermUnrank(u32 rank, u8* perm, u8 n) {
+    u8 digits[TWOPHASE_EDGE_COUNT];
+    for (int i = n - 1; i >= 0; i--) {
+        digits[i] = rank % (n - i);
+        rank /= n - i;
+    }
+
+    u8 available[TWOPHASE_EDGE_COUNT];
+    for (int i = 0; i < n; i++) available[i] = i;
+    for (int i = 0; i < n; i++) {
+        perm[i] = available[digits[i]];
+        for (int j = digits[i]; j < n - i - 1; j++) available[j] = available[j + 1];
+    }
+}
+
+static u16 TwoPhaseTwist(TwoPhaseCubie* cubie) {
+    u16 twist = 0;
+    for (int i = 0; i < TWOPHASE_CORNER_COUNT - 1; i++) twist = twist * 3 + cubie->co[i];
+    return twist;
+}
+
+static void TwoPhaseSetTwist(TwoPhaseCubie* cubie, u16 twist) {
+    u8 total = 0;
+    for (int i = TWOPHASE_CORNER_COUNT - 2; i >= 0; i--) {
+        cubie->co[i] = twist % 3;
+        total += cubie->co[i];
+        twist /= 3;
+    }
+    cubie->co[TWOPHASE_CORNER_COUNT - 1] = (3 - total % 3) % 3;
+}
+
+static u16 TwoPhaseFlip(TwoPhaseCubie* cubie) {
+    u16 flip = 0;
+    for (int i = 0; i < TWOPHASE_EDGE_COUNT - 1; i++) flip = flip * 2 + cubie->eo[i];
+    return flip;
+}
+
+static void TwoPhaseSetFlip(TwoPhaseCubie* cubie, u16 flip) {
+    u8 total = 0;
+    for (int i = TWOPHASE_EDGE_COUNT - 2; i >= 0; i--) {
+        cubie->eo[i] = flip % 2;
+        total += cubie->eo[i];
+        flip /= 2;
+    }
+    cubie->eo[TWOPHASE_EDGE_COUNT - 1] = total % 2;
+}
+
+static bool TwoPhaseIsSliceEdge(u8 piece) {
+    return piece >= TWOPHASE_SLICE_FIRST && piece <= TWOPHASE_SLICE_LAST;
+}
+
+static u16 TwoPhaseSlice(TwoPhaseCubie* cubie) {
+    u16 mask = 0;
+    for (int i = 0; i < TWOPHASE_EDGE_COUNT; i++) {
+        if (TwoPhaseIsSliceEdge(cubie->ep[i])) FlagSet(mask, Bit(i));
+    }
+    return TWOPHASE_SLICE_RANK[mask];
+}
+
+// Middle layer edges into the slots of the mask in order, the rest in order
+static void TwoPhaseSetSlice(TwoPhaseCubie* cubie, u16 slice) {
+    u16 mask = TWOPHASE_SLICE_MASKS[slice];
+    u8 slice_piece = TWOPHASE_SLICE_FIRST;
+    u8 other = 0;
+    for (int i = 0; i < TWOPHASE_EDGE_COUNT; i++) {
+        if (BitActive(mask, i)) {
+            cubie->ep[i] = slice_piece++;
+        } else {
+            cubie->ep[i] = TWOPHASE_UD_EDGE_SLOTS[other++];
+        }
+    }
+}
+
+static u16 TwoPhaseCperm(TwoPhaseCubie* cubie) {
+    return TwoPhasePermRank(cubie->cp, TWOPHASE_CORNER_COUNT);
+}
+
+static void TwoPhaseSetCperm(TwoPhaseCubie* cubie, u16 cperm) {
+    TwoPhasePermUnrank(cperm, cubie->cp, TWOPHASE_CORNER_COUNT);
+}
+
+// Only meaningful once phase 1 is done and these edges are where they belong
+static u16 TwoPhaseEperm(TwoPhaseCubie* cubie) {
+    u8 perm[8];
+    for (int i = 0; i < 8; i++) {
+        perm[i] = TWOPHASE_UD_EDGE_INDEX[cubie->ep[TWOPHASE_UD_EDGE_SLOTS[i]]];
+    }
+    return TwoPhasePermRank(perm, 8);
+}
+
+static void TwoPhaseSetEperm(TwoPhaseCubie* cubie, u16 eperm) {
+    u8 perm[8];
+    TwoPhasePermUnrank(eperm, perm, 8);
+    for (int i = 0; i < 8; i++) {
+        cubie->ep[TWOPHASE_UD_EDGE_SLOTS[i]] = TWOPHASE_UD_EDGE_SLOTS[perm[i]];
+    }
+}
+
+static u16 TwoPhaseSlicePerm(TwoPhaseCubie* cubie) {
+    u8 perm[4];
+    for (int i = 0; i < 4; i++) {
+        perm[i] = cubie->ep[TWOPHASE_SLICE_FIRST + i] - TWOPHASE_SLICE_FIRST;
+    }
+    return TwoPhasePermRank(perm, 4);
+}
+
+static void TwoPhaseSetSlicePerm(TwoPhaseCubie* cubie, u16 slice_perm) {
+    u8 perm[4];
+    TwoPhasePermUnrank(slice_perm, perm, 4);
+    for (int i = 0; i < 4; i++) {
+        cubie->ep[TWOPHASE_SLICE_FIRST + i] = TWOPHASE_SLICE_FIRST + perm[i];
+    }
+}
+
+// CUBIES /////////////////////////////////////////////////////////////////////
+void TwoPhaseCubieSolved(TwoPhaseCubie* cubie) {
+    for (int i = 0; i < TWOPHASE_CORNER_COUNT; i++) {
+        cubie->cp[i] = i;
+        cubie->co[i] = 0;
+    }
+    for (int i = 0; i < TWOPHASE_EDGE_COUNT; i++) {
+        cubie->ep[i] = i;
+        cubie->eo[i] = 0;
+    }
+}
+
+// a then b. Slot i ends up with whatever piece b takes from slot b.cp[i],
+// twisted by however much b twists it on the way.
+static void TwoPhaseCubieMultiply(TwoPhaseCubie* a, TwoPhaseCubie* b, TwoPhaseCubie* out) {
+    for (int i = 0; i < TWOPHASE_CORNER_COUNT; i++) {
+        out->cp[i] = a->cp[b->cp[i]];
+        out->co[i] = (a->co[b->cp[i]] + b->co[i]) % 3;
+    }
+    for (int i = 0; i < TWOPHASE_EDGE_COUNT; i++) {
+        out->ep[i] = a->ep[b->ep[i]];
+        out->eo[i] = (a->eo[b->ep[i]] + b->eo[i]) % 2;
+    }
+}
+
+void TwoPhaseCubieTurn(TwoPhaseCubie* cubie, TurnType turn) {
+    assert(twophase_turns_ready && "TwoPhaseCubiesInit not called!");
+    TwoPhaseCubie before = *cubie;
+    TwoPhaseCubieMultiply(&before, &TWOPHASE_TURN_CUBIES[turn], cubie);
+}
+
+static u8 TwoPhaseParity(const u8* perm, u8 n) {
+    u8 parity = 0;
+    for (int i = 0; i < n; i++) {
+        for (int j = i + 1; j < n; j++) {
+            if (perm[j] < perm[i]) parity ^= 1;
+        }
+    }
+    return parity;
+}
+
+bool TwoPhaseCubieSolvable(TwoPhaseCubie* cubie) {
+    u16 corners_seen = 0;
+    u16 edges_seen = 0;
+    u8 twist = 0;
+    u8 flip = 0;
+    for (int i = 0; i < TWOPHASE_CORNER_COUNT; i++) {
+        if (cubie->cp[i] >= TWOPHASE_CORNER_COUNT || cubie->co[i] > 2) return false;
+        FlagSet(corners_seen, Bit(cubie->cp[i]));
+        twist += cubie->co[i];
+    }
+    for (int i = 0; i < TWOPHASE_EDGE_COUNT; i++) {
+        if (cubie->ep[i] >= TWOPHASE_EDGE_COUNT || cubie->eo[i] > 1) return false;
+        FlagSet(edges_seen, Bit(cubie->ep[i]));
+        flip += cubie->eo[i];
+    }
+
+    if (corners_seen != Bit(TWOPHASE_CORNER_COUNT) - 1) return false;
+    if (edges_seen != Bit(TWOPHASE_EDGE_COUNT) - 1) return false;
+    if (twist % 3 != 0 || flip % 2 != 0) return false;
+    return TwoPhaseParity(cubie->cp, TWOPHASE_CORNER_COUNT) == TwoPhaseParity(cubie->ep, TWOPHASE_EDGE_COUNT);
+}
+
+// Any corner permutation, edge permutation (0 to TWOPHASE_EDGE_PERM_COUNT),
+// twist and flip. Half of those can't be reached by turning, so when the
+// permutation parities disagree the last two edges are swapped to fix it.
+void TwoPhaseCubieFromCoords(TwoPhaseCubie* cubie, u16 cperm, u32 edge_perm, u16 twist, u16 flip) {
+    assert(edge_perm < TWOPHASE_EDGE_PERM_COUNT);
+    TwoPhasePermUnrank(cperm, cubie->cp, TWOPHASE_CORNER_COUNT);
+    TwoPhasePermUnrank(edge_perm, cubie->ep, TWOPHASE_EDGE_COUNT);
+    TwoPhaseSetTwist(cubie, twist);
+    TwoPhaseSetFlip(cubie, flip);
+
+    if (TwoPhaseParity(cubie->cp, TWOPHASE_CORNER_COUNT) != TwoPhaseParity(cubie->ep, TWOPHASE_EDGE_COUNT)) {
+        u8 swap = cubie->ep[TWOPHASE_EDGE_COUNT - 2];
+        cubie->ep[TWOPHASE_EDGE_COUNT - 2] = cubie->ep[TWOPHASE_EDGE_COUNT - 1];
+        cubie->ep[TWOPHASE_EDGE_COUNT - 1] = swap;
+    }
+    assert(TwoPhaseCubieSolvable(cubie));
+}
+
+bool TwoPhaseCubieFromCube(Cube* cube, TwoPhaseCubie* cubie) {
+    for (int slot = 0; slot < TWOPHASE_CORNER_COUNT; slot++) {
+        CubeColour colours[3];
+        u8 twist = 3;
+        for (int k = 0; k < 3; k++) {
+            CubeColour face = CUBE_CORNER_COLOUR_TABLE[slot * 3 + k];
+            colours[k] = FaceGetTile(cube->faces[face], CUBE_CORNER_POSITION_TABLE[slot * 3 + k]);
+            if (colours[k] == CUBE_WHITE || colours[k] == CUBE_YELLOW) twist = k;
+        }
+        if (twist == 3) return false;
+
+        // Reading clockwise from the white or yellow sticker matches the
+        // order that piece is listed in
+        u8 piece = TWOPHASE_CORNER_COUNT;
+        for (int p = 0; p < TWOPHASE_CORNER_COUNT; p++) {
+            bool match = true;
+            for (int k = 0; k < 3; k++) {
+                if (colours[(twist + k) % 3] != CUBE_CORNER_COLOUR_TABLE[p * 3 + k]) match = false;
+            }
+            if (match) piece = p;
+        }
+        if (piece == TWOPHASE_CORNER_COUNT) return false;
+
+        cubie->cp[slot] = piece;
+        cubie->co[slot] = twist;
+    }
+
+    for (int slot = 0; slot < TWOPHASE_EDGE_COUNT; slot++) {
+        CubeColour first = FaceGetTile(
+            cube->faces[CUBE_EDGE_COLOUR_TABLE[slot * 2]], CUBE_EDGE_POSITION_TABLE[slot * 2]
+        );
+        CubeColour second = FaceGetTile(
+            cube->faces[CUBE_EDGE_COLOUR_TABLE[slot * 2 + 1]], CUBE_EDGE_POSITION_TABLE[slot * 2 + 1]
+        );
+
+        u8 piece = TWOPHASE_EDGE_COUNT;
+        for (int p = 0; p < TWOPHASE_EDGE_COUNT; p++) {
+            CubeColour target1 = CUBE_EDGE_COLOUR_TABLE[p * 2];
+            CubeColour target2 = CUBE_EDGE_COLOUR_TABLE[p * 2 + 1];
+            if (first == target1 && second == target2) {
+                piece = p;
+                cubie->eo[slot] = 0;
+            } else if (first == target2 && second == target1) {
+                piece = p;
+                cubie->eo[slot] = 1;
+            }
+        }
+        if (piece == TWOPHASE_EDGE_COUNT) return false;
+
+        cubie->ep[slot] = piece;
+    }
+
+    return TwoPhaseCubieSolvable(cubie);
+}
+
+void TwoPhaseCubieToCube(TwoPhaseCubie* cubie, Cube* cube) {
+    for (int slot = 0; slot < TWOPHASE_CORNER_COUNT; slot++) {
+        u8 piece = cubie->cp[slot];
+        for (int k = 0; k < 3; k++) {
+            u8 sticker = slot * 3 + (cubie->co[slot] + k) % 3;
+            FaceSetTile(
+                &cube->faces[CUBE_CORNER_COLOUR_TABLE[sticker]],
+                CUBE_CORNER_COLOUR_TABLE[piece * 3 + k], CUBE_CORNER_POSITION_TABLE[sticker]
+            );
+        }
+    }
+    for (int slot = 0; slot < TWOPHASE_EDGE_COUNT; slot++) {
+        u8 piece = cubie->ep[slot];
+        for (int k = 0; k < 2; k++) {
+            u8 sticker = slot * 2 + (cubie->eo[slot] + k) % 2;
+            FaceSetTile(
+                &cube->faces[CUBE_EDGE_COLOUR_TABLE[sticker]],
+                CUBE_EDGE_COLOUR_TABLE[piece * 2 + k], CUBE_EDGE_POSITION_TABLE[sticker]
+            );
+        }
+    }
+    cube->hash = CubeHashCompute(cube);
+}
+
+static void TwoPhaseCubieInverse(TwoPhaseCubie* cubie, TwoPhaseCubie* out) {
+    for (int i = 0; i < TWOPHASE_CORNER_COUNT; i++) {
+        out->cp[cubie->cp[i]] = i;
+        out->co[cubie->cp[i]] = (3 - cubie->co[i]) % 3;
+    }
+    for (int i = 0; i < TWOPHASE_EDGE_COUNT; i++) {
+        out->ep[cubie->ep[i]] = i;
+        out->eo[cubie->ep[i]] = cubie->eo[i];
+    }
+}
+
+// The same cube with every sticker moved by stickers (face * 8 + position to
+// face * 8 + position) and recoloured by faces, which is how a whole cube
+// rotation or reflection looks with the centres kept where they always are
+static void TwoPhaseCubieRemap(
+    TwoPhaseCubie* cubie, const u8* stickers, const enum8(CubeColour)* faces, TwoPhaseCubie* out
+) {
+    Cube from;
+    Cube to;
+
+    TwoPhaseCubieToCube(cubie, &from);
+    for (int s = 0; s < CUBE_COLOUR_COUNT * 8; s++) {
+        u8 sticker = stickers[s];
+        CubeColour colour = FaceGetTile(from.faces[s / 8], s % 8);
+        FaceSetTile(&to.faces[sticker / 8], faces[colour], sticker % 8);
+    }
+
+    bool read = TwoPhaseCubieFromCube(&to, out);
+    assert(read);
+    (void) read;
+}
+
+// Solving this and mapping the turns back through TWOPHASE_UNROTATE_FACES
+// solves the original
+static void TwoPhaseCubieRotate(TwoPhaseCubie* cubie) {
+    TwoPhaseCubie before = *cubie;
+    TwoPhaseCubieRemap(&before, TWOPHASE_ROTATE_STICKERS, TWOPHASE_ROTATE_FACES, cubie);
+}
+
+// SYMMETRIES /////////////////////////////////////////////////////////////////
+// Where a sticker of a corner (size 3) or edge (size 2) goes when the whole
+// cube is moved by faces: to the piece on the mapped faces, on the mapped
+// face. Returns the index into the colour table.
+static u8 TwoPhaseMappedSticker(
+    const enum8(CubeColour)* faces, const enum8(CubeColour)* table, u8 size, u8 count, u8 sticker
+) {
+    u8 slot = sticker / size;
+    for (int other = 0; other < count; other++) {
+        u8 matched = 0;
+        for (int k = 0; k < size; k++) {
+            for (int j = 0; j < size; j++) {
+                if (table[other * size + k] == faces[table[slot * size + j]]) matched++;
+            }
+        }
+        if (matched != size) continue;
+
+        for (int k = 0; k < size; k++) {
+            if (table[other * size + k] == faces[table[sticker]]) return other * size + k;
+        }
+    }
+    assert(false && "Mapped sticker not found");
+    return 0;
+}
+
+// Sticker map for TwoPhaseCubieRemap
+static void TwoPhaseMappedStickers(const enum8(CubeColour)* faces, u8* stickers) {
+    for (int s = 0; s < TWOPHASE_CORNER_COUNT * 3; s++) {
+        u8 to = TwoPhaseMappedSticker(faces, CUBE_CORNER_COLOUR_TABLE, 3, TWOPHASE_CORNER_COUNT, s);
+        stickers[CUBE_CORNER_COLOUR_TABLE[s] * 8 + CUBE_CORNER_POSITION_TABLE[s]] =
+            CUBE_CORNER_COLOUR_TABLE[to] * 8 + CUBE_CORNER_POSITION_TABLE[to];
+    }
+    for (int s = 0; s < TWOPHASE_EDGE_COUNT * 2; s++) {
+        u8 to = TwoPhaseMappedSticker(faces, CUBE_EDGE_COLOUR_TABLE, 2, TWOPHASE_EDGE_COUNT, s);
+        stickers[CUBE_EDGE_COLOUR_TABLE[s] * 8 + CUBE_EDGE_POSITION_TABLE[s]] =
+            CUBE_EDGE_COLOUR_TABLE[to] * 8 + CUBE_EDGE_POSITION_TABLE[to];
+    }
+}
+
+static void TwoPhaseSymsInit(void) {
+    for (int s = 0; s < TWOPHASE_FULL_SYM_COUNT; s++) {
+        for (int f = 0; f < CUBE_COLOUR_COUNT; f++) {
+            CubeColour face = f;
+            for (int r = 0; r < s / TWOPHASE_SYM_COUNT; r++) face = TWOPHASE_ROTATE_FACES[face];
+            for (int q = 0; q < s % 4; q++) face = TWOPHASE_SYM_QUARTER[face];
+            if (s / 4 % 2) face = TWOPHASE_SYM_HALF[face];
+            if (s / 8 % 2) face = TWOPHASE_SYM_MIRROR[face];
+            TWOPHASE_SYM_FACES[s][f] = face;
+        }
+    }
+
+    for (int s = 0; s < TWOPHASE_FULL_SYM_COUNT; s++) {
+        TWOPHASE_SYM_INVERSE[s] = TWOPHASE_FULL_SYM_COUNT;
+        for (int t = 0; t < TWOPHASE_FULL_SYM_COUNT; t++) {
+            bool identity = true;
+            for (int f = 0; f < CUBE_COLOUR_COUNT; f++) {
+                if (TWOPHASE_SYM_FACES[t][TWOPHASE_SYM_FACES[s][f]] != f) identity = false;
+            }
+            if (identity) TWOPHASE_SYM_INVERSE[s] = t;
+        }
+        assert(TWOPHASE_SYM_INVERSE[s] < TWOPHASE_FULL_SYM_COUNT);
+    }
+
+    for (int s = 0; s < TWOPHASE_FULL_SYM_COUNT; s++) {
+        const enum8(CubeColour)* faces = TWOPHASE_SYM_FACES[s];
+        TwoPhaseSym* sym = &TWOPHASE_SYMS[s];
+        TwoPhaseMappedStickers(faces, TWOPHASE_SYM_STICKERS[s]);
+
+        for (int i = 0; i < TWOPHASE_CORNER_COUNT; i++) {
+            u8 first = TwoPhaseMappedSticker(faces, CUBE_CORNER_COLOUR_TABLE, 3, TWOPHASE_CORNER_COUNT, i * 3);
+            u8 second = TwoPhaseMappedSticker(faces, CUBE_CORNER_COLOUR_TABLE, 3, TWOPHASE_CORNER_COUNT, i * 3 + 1);
+            sym->corner_slots[i] = first / 3;
+            sym->corner_stickers[i] = first % 3;
+            sym->mirror = second % 3 != (first + 1) % 3;
+        }
+        for (int i = 0; i < TWOPHASE_EDGE_COUNT; i++) {
+            u8 first = TwoPhaseMappedSticker(faces, CUBE_EDGE_COLOUR_TABLE, 2, TWOPHASE_EDGE_COUNT, i * 2);
+            sym->edge_slots[i] = first / 2;
+            sym->edge_stickers[i] = first % 2;
+        }
+    }
+}
+
+// Same as TwoPhaseCubieRemap with symmetry sym but straight on the pieces.
+// Slot i's piece p goes to slot sym(i) as piece sym(p). Its twist changes by
+// however much further round the slot's stickers are taken than the piece's
+// own, and a mirror reverses which way round twists count.
+void TwoPhaseCubieConjugate(TwoPhaseCubie* cubie, u8 sym, TwoPhaseCubie* out) {
+    TwoPhaseSym* s = &TWOPHASE_SYMS[sym];
+    for (int i = 0; i < TWOPHASE_CORNER_COUNT; i++) {
+        u8 piece = cubie->cp[i];
+        u8 slot = s->corner_slots[i];
+        out->cp[slot] = s->corner_slots[piece];
+        if (s->mirror) {
+            out->co[slot] = (6 + s->corner_stickers[i] - s->corner_stickers[piece] - cubie->co[i]) % 3;
+        } else {
+            out->co[slot] = (3 + s->corner_stickers[i] - s->corner_stickers[piece] + cubie->co[i]) % 3;
+        }
+    }
+    for (int i = 0; i < TWOPHASE_EDGE_COUNT; i++) {
+        u8 piece = cubie->ep[i];
+        u8 slot = s->edge_slots[i];
+        out->ep[slot] = s->edge_slots[piece];
+        out->eo[slot] = cubie->eo[i] ^ s->edge_stickers[i] ^ s->edge_stickers[piece];
+    }
+}
+
+u32 TwoPhaseCornerCoord(TwoPhaseCubie* cubie) {
+    return TwoPhaseCperm(cubie) * TWOPHASE_TWIST_COUNT + TwoPhaseTwist(cubie);
+}
+
+u64 TwoPhaseEdgeCoord(TwoPhaseCubie* cubie) {
+    return (u64) TwoPhasePermRank(cubie->ep, TWOPHASE_EDGE_COUNT) * TWOPHASE_FLIP_COUNT + TwoPhaseFlip(cubie);
+}
+
+static u32 TwoPhaseFlipSlice(TwoPhaseCubie* cubie) {
+    return TwoPhaseSlice(cubie) * TWOPHASE_FLIP_COUNT + TwoPhaseFlip(cubie);
+}
+
+// TABLES /////////////////////////////////////////////////////////////////////
+// Random turns on a Cube and on a cubie should always agree, and every
+// symmetry should agree with moving the stickers
+static void TwoPhaseCubiesCheck(Cube* cube) {
+    u64 random = 0x9E3779B97F4A7C15ull;
+    for (int w = 0; w < TWOPHASE_CHECK_WALKS; w++) {
+        CubeSetSolved(cube);
+        TwoPhaseCubie cubie;
+        TwoPhaseCubieSolved(&cubie);
+
+        for (int i = 0; i < TWOPHASE_CHECK_WALK_LEN; i++) {
+            random = HashU64(random);
+            TurnType turn = random % TURN_TYPE_COUNT;
+            CubeTurn(cube, turn);
+            TwoPhaseCubieTurn(&cubie, turn);
+        }
+
+        TwoPhaseCubie read;
+        bool valid = TwoPhaseCubieFromCube(cube, &read);
+        assert(valid && MemCmp(&read, &cubie, sizeof(TwoPhaseCubie)) == 0);
+        (void) valid;
+
+        for (int s = 0; s < TWOPHASE_FULL_SYM_COUNT; s++) {
+            TwoPhaseCubie conj;
+            TwoPhaseCubie remapped;
+            TwoPhaseCubie back;
+            TwoPhaseCubieConjugate(&cubie, s, &conj);
+            TwoPhaseCubieRemap(&cubie, TWOPHASE_SYM_STICKERS[s], TWOPHASE_SYM_FACES[s], &remapped);
+            TwoPhaseCubieConjugate(&conj, TWOPHASE_SYM_INVERSE[s], &back);
+            assert(MemCmp(&conj, &remapped, sizeof(TwoPhaseCubie)) == 0);
+            assert(MemCmp(&back, &cubie, sizeof(TwoPhaseCubie)) == 0);
+        }
+    }
+}
+
+void TwoPhaseCubiesInit(void) {
+    if (twophase_turns_ready) return;
+
+    Cube cube;
+    CubeInit(&cube);
+
+    for (int t = 0; t < TURN_TYPE_COUNT; t++) {
+        CubeSetSolved(&cube);
+        CubeTurn(&cube, t);
+        bool read = TwoPhaseCubieFromCube(&cube, &TWOPHASE_TURN_CUBIES[t]);
+        assert(read);
+        (void) read;
+    }
+
+    // Every 12 bit mask with 4 bits set, in increasing order
+    u16 count = 0;
+    for (u16 mask = 0; mask < (1 << TWOPHASE_EDGE_COUNT); mask++) {
+        TWOPHASE_SLICE_RANK[mask] = UINT16_MAX;
+        if (__builtin_popcount(mask) != 4) continue;
+        TWOPHASE_SLICE_RANK[mask] = count;
+        TWOPHASE_SLICE_MASKS[count++] = mask;
+    }
+    assert(count == TWOPHASE_SLICE_COUNT);
+
+    TWOPHASE_SLICE_SOLVED = TWOPHASE_SLICE_RANK[0xF << TWOPHASE_SLICE_FIRST];
+
+    TwoPhaseMappedStickers(TWOPHASE_ROTATE_FACES, TWOPHASE_ROTATE_STICKERS);
+    TwoPhaseSymsInit();
+
+    twophase_turns_ready = true;
+    TwoPhaseCubiesCheck(&cube);
+}
+
+typedef u16 (*TwoPhaseGet)(TwoPhaseCubie* cubie);
+typedef void (*TwoPhaseSet)(TwoPhaseCubie* cubie, u16 coord);
+
+static u16* TwoPhaseMoveTable(
+    Arena* arena, u32 count, TwoPhaseGet get, TwoPhaseSet set,
+    const enum8(TurnType)* turns, u8 turn_count
+) {
+    u16* moves = ArenaPushArray(arena, count * turn_count, u16);
+
+    for (u32 coord = 0; coord < count; coord++) {
+        TwoPhaseCubie cubie;
+        TwoPhaseCubieSolved(&cubie);
+        set(&cubie, coord);
+        assert(get(&cubie) == coord);
+
+        for (int t = 0; t < turn_count; t++) {
+            TwoPhaseCubie turned;
+            TwoPhaseCubieMultiply(&cubie, &TWOPHASE_TURN_CUBIES[turns[t]], &turned);
+            moves[coord * turn_count + t] = get(&turned);
+        }
+    }
+
+    return moves;
+}
+
+// BFS over pairs of coordinates a * count_b + b, one layer per pass
+static u8* TwoPhasePruneTable(
+    Arena* arena, u32 count_a, const u16* moves_a, u32 count_b, const u16* moves_b,
+    u8 turn_count, u32 solved
+) {
+    u32 count = count_a * count_b;
+    u8* prune = ArenaPushArray(arena, count, u8);
+    MemSet(prune, TWOPHASE_PRUNE_UNVISITED, count);
+    prune[solved] = 0;
+
+    u32 layer = 1;
+    for (u8 depth = 0; layer > 0; depth++) {
+        layer = 0;
+        for (u32 index = 0; index < count; index++) {
+            if (prune[index] != depth) continue;
+
+            u32 a = index / count_b;
+            u32 b = index % count_b;
+            for (int t = 0; t < turn_count; t++) {
+                u32 next = moves_a[a * turn_count + t] * count_b + moves_b[b * turn_count + t];
+                if (prune[next] != TWOPHASE_PRUNE_UNVISITED) continue;
+                prune[next] = depth + 1;
+                layer++;
+            }
+        }
+    }
+
+    return prune;
+}
+
+// Twist only ever depends on twist under these symmetries, since they keep
+// the white and yellow stickers on U and D. Flip and slice depend on each
+// other (a quarter turn flips the middle layer edges but not the rest) so
+// they're classified together: the lowest flipslice of each class is its
+// representative and every flipslice notes its class and the symmetry that
+// takes it there.
+static void TwoPhaseSymTables(Arena* arena, TwoPhaseTables* tables) {
+    tables->twist_conj = ArenaPushArray(arena, TWOPHASE_TWIST_COUNT * TWOPHASE_SYM_COUNT, u16);
+    for (u32 twist = 0; twist < TWOPHASE_TWIST_COUNT; twist++) {
+        TwoPhaseCubie cubie;
+        TwoPhaseCubieSolved(&cubie);
+        TwoPhaseSetTwist(&cubie, twist);
+        for (int s = 0; s < TWOPHASE_SYM_COUNT; s++) {
+            TwoPhaseCubie conj;
+            TwoPhaseCubieConjugate(&cubie, s, &conj);
+            tables->twist_conj[twist * TWOPHASE_SYM_COUNT + s] = TwoPhaseTwist(&conj);
+        }
+    }
+
+    tables->flipslice_classes = ArenaPushArray(arena, TWOPHASE_FLIPSLICE_COUNT, u16);
+    tables->flipslice_syms = ArenaPushArray(arena, TWOPHASE_FLIPSLICE_COUNT, u8);
+    tables->class_reps = ArenaPushArray(arena, TWOPHASE_FLIPSLICE_CLASS_COUNT, u32);
+    tables->class_syms = ArenaPushArray(arena, TWOPHASE_FLIPSLICE_CLASS_COUNT, u16);
+    MemSet(tables->flipslice_classes, 0xFF, TWOPHASE_FLIPSLICE_COUNT * sizeof(u16));
+
+    u32 count = 0;
+    for (u32 flipslice = 0; flipslice < TWOPHASE_FLIPSLICE_COUNT; flipslice++) {
+        if (tables->flipslice_classes[flipslice] != UINT16_MAX) continue;
+        assert(count < TWOPHASE_FLIPSLICE_CLASS_COUNT);
+
+        TwoPhaseCubie cubie;
+        TwoPhaseCubieSolved(&cubie);
+        TwoPhaseSetSlice(&cubie, flipslice / TWOPHASE_FLIP_COUNT);
+        TwoPhaseSetFlip(&cubie, flipslice % TWOPHASE_FLIP_COUNT);
+
+        tables->class_reps[count] = flipslice;
+        tables->class_syms[count] = 0;
+        for (int s = 0; s < TWOPHASE_SYM_COUNT; s++) {
+            TwoPhaseCubie conj;
+            TwoPhaseCubieConjugate(&cubie, s, &conj);
+            u32 other = TwoPhaseFlipSlice(&conj);
+            tables->flipslice_classes[other] = count;
+            tables->flipslice_syms[other] = TWOPHASE_SYM_INVERSE[s];
+            if (other == flipslice) FlagSet(tables->class_syms[count], Bit(s));
+        }
+        count++;
+    }
+    assert(count == TWOPHASE_FLIPSLICE_CLASS_COUNT);
+}
+
+// PHASE 1 TABLE //////////////////////////////////////////////////////////////
+static u64 TwoPhasePhase1Index(TwoPhaseTables* tables, u16 twist, u16 flip, u16 slice) {
+    u32 flipslice = slice * TWOPHASE_FLIP_COUNT + flip;
+    u64 class = tables->flipslice_classes[flipslice];
+    u8 sym = tables->flipslice_syms[flipslice];
+    return class * TWOPHASE_TWIST_COUNT + tables->twist_conj[twist * TWOPHASE_SYM_COUNT + sym];
+}
+
+static u8 TwoPhaseGetDistance(const u32* distances, u64 index) {
+    u32 word = __atomic_load_n(&distances[index / TWOPHASE_WORD_ENTRIES], __ATOMIC_RELAXED);
+    return (word >> ((index % TWOPHASE_WORD_ENTRIES) * 2)) & 3;
+}
+
+// Same trick as PocketSetDistance, entries only go from unvisited to a value
+static bool TwoPhaseSetDistance(u32* distances, u64 index, u8 value) {
+    u32 shift = (index % TWOPHASE_WORD_ENTRIES) * 2;
+    u32 mask = ~((u32) (TWOPHASE_UNVISITED ^ value) << shift);
+    u32 old = __atomic_fetch_and(&distances[index / TWOPHASE_WORD_ENTRIES], mask, __ATOMIC_RELAXED);
+    return ((old >> shift) & 3) == TWOPHASE_UNVISITED;
+}
+
+// A representative with symmetries of its own is stored more than once, at
+// every twist those symmetries take its twist to. They're all the same
+// distance so they're all set together, the ones in [keep_first, keep_end).
+static u32 TwoPhaseSetEquivalent(TwoPhaseTables* tables, u64 index, u8 value, u64 keep_first, u64 keep_end) {
+    u32 class = index / TWOPHASE_TWIST_COUNT;
+    u32 twist = index % TWOPHASE_TWIST_COUNT;
+    u16 syms = tables->class_syms[class];
+    u32 found = 0;
+    for (int s = 0; s < TWOPHASE_SYM_COUNT; s++) {
+        if (!BitActive(syms, s)) continue;
+        u64 other = (u64) class * TWOPHASE_TWIST_COUNT + tables->twist_conj[twist * TWOPHASE_SYM_COUNT + s];
+        if (other < keep_first || other >= keep_end) continue;
+        if (TwoPhaseSetDistance(tables->phase1_distances, other, value)) found++;
+    }
+    return found;
+}
+
+static u64 TwoPhaseEntryTurn(TwoPhaseTables* tables, u64 index, u8 turn) {
+    u32 flipslice = tables->class_reps[index / TWOPHASE_TWIST_COUNT];
+    u16 twist = index % TWOPHASE_TWIST_COUNT;
+    u16 flip = flipslice % TWOPHASE_FLIP_COUNT;
+    u16 slice = flipslice / TWOPHASE_FLIP_COUNT;
+    return TwoPhasePhase1Index(
+        tables,
+        tables->twist_moves[twist * TURN_TYPE_COUNT + turn],
+        tables->flip_moves[flip * TURN_TYPE_COUNT + turn],
+        tables->slice_moves[slice * TURN_TYPE_COUNT + turn]
+    );
+}
+
+// True if any of the sixteen 2 bit entries in word equal value
+static bool TwoPhaseWordHas(u32 word, u8 value) {
+    u32 x = word ^ (value * 0x55555555u);
+    return ((x | (x >> 1)) & 0x55555555u) != 0x55555555u;
+}
+
+// Same shape as PocketLayerWorker
+static void TwoPhaseLayerWorker(void* data, u32 thread_index, u32 thread_count) {
+    TwoPhaseLayerJob* job = (TwoPhaseLayerJob*) data;
+    TwoPhaseTables* tables = job->tables;
+    u32* distances = tables->phase1_distances;
+
+    u8 current = job->depth % 3;
+    u8 next = (job->depth + 1) % 3;
+    u8 scan = job->backward ? TWOPHASE_UNVISITED : current;
+    u64 found = 0;
+
+    TraceBegin(job->backward ? "two phase layer backward" : "two phase layer forward");
+
+    for (;;) {
+        u32 chunk = __atomic_fetch_add(&job->next_chunk, 1, __ATOMIC_RELAXED);
+        u64 start = job->scan_first + (u64) chunk * TWOPHASE_BFS_CHUNK;
+        if (start >= job->scan_end) break;
+        u32 end = MinU64(start + TWOPHASE_BFS_CHUNK, job->scan_end);
+
+        for (u32 w = start; w < end; w++) {
+            w += TableScan2Bit(&distances[w], end - w, scan);
+            if (w >= end) break;
+
+            u32 word = __atomic_load_n(&distances[w], __ATOMIC_RELAXED);
+            if (!TwoPhaseWordHas(word, scan)) continue;
+
+            for (u32 i = 0; i < TWOPHASE_WORD_ENTRIES; i++) {
+                if (((word >> (i * 2)) & 3) != scan) continue;
+                u64 index = (u64) w * TWOPHASE_WORD_ENTRIES + i;
+                // The padding at the end of the last word
+                if (index >= TWOPHASE_PHASE1_ENTRY_COUNT) break;
+
+                if (job->backward) {
+                    for (u8 m = 0; m < TURN_TYPE_COUNT; m++) {
+                        u64 neighbour = TwoPhaseEntryTurn(tables, index, m);
+                        if (TwoPhaseGetDistance(distances, neighbour) == current) {
+                            if (TwoPhaseSetDistance(distances, index, next)) found++;
+                            break;
+                        }
+                    }
+                } else {
+                    for (u8 m = 0; m < TURN_TYPE_COUNT; m++) {
+                        u64 neighbour = TwoPhaseEntryTurn(tables, index, m);
+                        if (TwoPhaseGetDistance(distances, neighbour) != TWOPHASE_UNVISITED) continue;
+                        found += TwoPhaseSetEquivalent(tables, neighbour, next, job->keep_first, job->keep_end);
+                    }
+                }
+            }
+        }
+    }
+
+    __atomic_fetch_add(&job->found, found, __ATOMIC_RELAXED);
+
+    TraceEnd(job->backward ? "two phase layer backward" : "two phase layer forward");
+}
+
+static void TwoPhasePhase1Build(TwoPhaseTables* tables, u32 thread_count) {
+    MemSet(tables->phase1_distances, 0xFF, TWOPHASE_PHASE1_WORD_COUNT * sizeof(u32));
+
+    u64 solved = TwoPhasePhase1Index(tables, 0, 0, TWOPHASE_SLICE_SOLVED);
+    u64 layer = TwoPhaseSetEquivalent(tables, solved, 0, 0, TWOPHASE_PHASE1_ENTRY_COUNT);
+    u64 visited = layer;
+
+    for (u8 depth = 0; layer > 0; depth++) {
+        printf("Depth %2d: %llu\n", depth, (unsigned long long) layer);
+
+        TwoPhaseLayerJob job = {
+            .tables = tables,
+            .depth = depth,
+            .backward = layer > TWOPHASE_PHASE1_ENTRY_COUNT - visited,
+            .next_chunk = 0,
+            .found = 0,
+            .scan_first = 0,
+            .scan_end = TWOPHASE_PHASE1_WORD_COUNT,
+            .keep_first = 0,
+            .keep_end = TWOPHASE_PHASE1_ENTRY_COUNT
+        };
+        ParallelRun(thread_count, TwoPhaseLayerWorker, &job);
+        TraceFaults();
+
+        layer = job.found;
+        visited += layer;
+    }
+    assert(visited == TWOPHASE_PHASE1_ENTRY_COUNT);
+}
+
+static u64 TwoPhaseChecksum(const u32* words, u64 count) {
+    u64 checksum = TWOPHASE_CACHE_MAGIC;
+    for (u64 w = 0; w < count; w++) checksum = HashU64(checksum ^ words[w]);
+    return checksum;
+}
+
+// Only the distances are cached, everything else is quick to build and comes
+// out numbered the same every time
+static bool TwoPhaseCacheLoad(TwoPhaseTables* tables, const char* path) {
+    if (path == NULL) return false;
+    FILE* file = fopen(path, "rb");
+    if (file == NULL) return false;
+
+    TwoPhaseCacheHeader header;
+    bool valid = fread(&header, sizeof(header), 1, file) == 1 &&
+        header.magic == TWOPHASE_CACHE_MAGIC &&
+        header.version == TWOPHASE_CACHE_VERSION &&
+        header.entry_count == TWOPHASE_PHASE1_ENTRY_COUNT &&
+        fread(tables->phase1_distances, sizeof(u32), TWOPHASE_PHASE1_WORD_COUNT, file) == TWOPHASE_PHASE1_WORD_COUNT &&
+        TwoPhaseChecksum(tables->phase1_distances, TWOPHASE_PHASE1_WORD_COUNT) == header.checksum;
+    fclose(file);
+
+    if (!valid) printf("%s: out of date or damaged, rebuilding\n", path);
+    return valid;
+}
+
+// False if there's no path or it couldn't be written
+static bool TwoPhaseCacheSave(TwoPhaseTables* tables, const char* path) {
+    if (path == NULL) return false;
+    FILE* file = fopen(path, "wb");
+    if (file == NULL) {
+        printf("Couldn't open %s for the two phase cache\n", path);
+        return false;
+    }
+
+    TwoPhaseCacheHeader header = {
+        .magic = TWOPHASE_CACHE_MAGIC,
+        .version = TWOPHASE_CACHE_VERSION,
+        .entry_count = TWOPHASE_PHASE1_ENTRY_COUNT,
+        .checksum = TwoPhaseChecksum(tables->phase1_distances, TWOPHASE_PHASE1_WORD_COUNT)
+    };
+    bool written = fwrite(&header, sizeof(header), 1, file) == 1 &&
+        fwrite(tables->phase1_distances, sizeof(u32), TWOPHASE_PHASE1_WORD_COUNT, file) == TWOPHASE_PHASE1_WORD_COUNT;
+    written = fclose(file) == 0 && written;
+
+    if (!written) printf("Couldn't write %s\n", path);
+    return written;
+}
+
+// Walks down the table one turn at a time, each step to a neighbour one
+// closer. Mod 3 is enough to tell closer from further. The turns taken are a
+// shortest phase 1, written to moves unless it's NULL.
+static u8 TwoPhasePhase1Distance(
+    TwoPhaseTables* tables, u16 twist, u16 flip, u16 slice, enum8(TurnType)* moves
+) {
+    const u32* distances = tables->phase1_distances;
+    u8 distance = 0;
+    u8 mod = TwoPhaseGetDistance(distances, TwoPhasePhase1Index(tables, twist, flip, slice));
+
+    while (twist != 0 || flip != 0 || slice != TWOPHASE_SLICE_SOLVED) {
+        u8 closer = (mod + 2) % 3;
+        bool stepped = false;
+        for (int turn = 0; turn < TURN_TYPE_COUNT && !stepped; turn++) {
+            u16 next_twist = tables->twist_moves[twist * TURN_TYPE_COUNT + turn];
+            u16 next_flip = tables->flip_moves[flip * TURN_TYPE_COUNT + turn];
+            u16 next_slice = tables->slice_moves[slice * TURN_TYPE_COUNT + turn];
+            u64 index = TwoPhasePhase1Index(tables, next_twist, next_flip, next_slice);
+            if (TwoPhaseGetDistance(distances, index) != closer) continue;
+
+            twist = next_twist;
+            flip = next_flip;
+            slice = next_slice;
+            mod = closer;
+            stepped = true;
+            if (moves != NULL) moves[distance] = turn;
+        }
+        assert(stepped);
+        distance++;
+    }
+
+    return distance;
+}
+
+// INIT ///////////////////////////////////////////////////////////////////////
+// Every symmetry of a cubie should land on the same phase 1 distance, with
+// twist and flipslice going where the tables say
+static void TwoPhaseTablesCheck(TwoPhaseTables* tables) {
+    u64 random = 0x9E3779B97F4A7C15ull;
+    for (int w = 0; w < TWOPHASE_CHECK_WALKS; w++) {
+        TwoPhaseCubie cubie;
+        TwoPhaseCubieSolved(&cubie);
+        for (int i = 0; i < TWOPHASE_CHECK_WALK_LEN; i++) {
+            random = HashU64(random);
+            TwoPhaseCubieTurn(&cubie, random % TURN_TYPE_COUNT);
+        }
+
+        u8 distance = TwoPhaseLowerBound(tables, &cubie);
+        u32 flipslice = TwoPhaseFlipSlice(&cubie);
+        for (int s = 0; s < TWOPHASE_SYM_COUNT; s++) {
+            TwoPhaseCubie conj;
+            TwoPhaseCubieConjugate(&cubie, s, &conj);
+            assert(TwoPhaseTwist(&conj) == tables->twist_conj[TwoPhaseTwist(&cubie) * TWOPHASE_SYM_COUNT + s]);
+            assert(tables->flipslice_classes[TwoPhaseFlipSlice(&conj)] == tables->flipslice_classes[flipslice]);
+            assert(TwoPhaseLowerBound(tables, &conj) == distance);
+            (void) distance;
+            (void) flipslice;
+        }
+    }
+}
+
+// Everything but filling in the phase 1 distances, which are pushed
+static void TwoPhaseTablesBuild(Arena* arena, TwoPhaseTables* tables) {
+    TwoPhaseCubiesInit();
+
+    const enum8(TurnType) all_turns[TURN_TYPE_COUNT] = {
+        0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15, 16, 17
+    };
+    tables->twist_moves = TwoPhaseMoveTable(
+        arena, TWOPHASE_TWIST_COUNT, TwoPhaseTwist, TwoPhaseSetTwist, all_turns, TURN_TYPE_COUNT
+    );
+    tables->flip_moves = TwoPhaseMoveTable(
+        arena, TWOPHASE_FLIP_COUNT, TwoPhaseFlip, TwoPhaseSetFlip, all_turns, TURN_TYPE_COUNT
+    );
+    tables->slice_moves = TwoPhaseMoveTable(
+        arena, TWOPHASE_SLICE_COUNT, TwoPhaseSlice, TwoPhaseSetSlice, all_turns, TURN_TYPE_COUNT
+    );
+    tables->cperm_moves = TwoPhaseMoveTable(
+        arena, TWOPHASE_CPERM_COUNT, TwoPhaseCperm, TwoPhaseSetCperm,
+        TWOPHASE_PHASE2_TURNS, TWOPHASE_PHASE2_TURN_COUNT
+    );
+    tables->eperm_moves = TwoPhaseMoveTable(
+        arena, TWOPHASE_EPERM_COUNT, TwoPhaseEperm, TwoPhaseSetEperm,
+        TWOPHASE_PHASE2_TURNS, TWOPHASE_PHASE2_TURN_COUNT
+    );
+    tables->slice_perm_moves = TwoPhaseMoveTable(
+        arena, TWOPHASE_SLICE_PERM_COUNT, TwoPhaseSlicePerm, TwoPhaseSetSlicePerm,
+        TWOPHASE_PHASE2_TURNS, TWOPHASE_PHASE2_TURN_COUNT
+    );
+
+    tables->cperm_slice_prune = TwoPhasePruneTable(
+        arena, TWOPHASE_CPERM_COUNT, tables->cperm_moves, TWOPHASE_SLICE_PERM_COUNT, tables->slice_perm_moves,
+        TWOPHASE_PHASE2_TURN_COUNT, 0
+    );
+    tables->eperm_slice_prune = TwoPhasePruneTable(
+        arena, TWOPHASE_EPERM_COUNT, tables->eperm_moves, TWOPHASE_SLICE_PERM_COUNT, tables->slice_perm_moves,
+        TWOPHASE_PHASE2_TURN_COUNT, 0
+    );
+
+    TwoPhaseSymTables(arena, tables);
+
+    tables->phase1_distances = (u32*) _ArenaPush(
+        arena, TWOPHASE_PHASE1_WORD_COUNT * sizeof(u32), alignof(u32), false
+    );
+}
+
+void TwoPhaseTablesInit(Arena* arena, TwoPhaseTables* tables, const char* cache_path, u32 thread_count) {
+    printf("----- TWO PHASE TABLES -----\n");
+    double start = TimeSeconds();
+    TraceBegin("two phase tables");
+
+    TwoPhaseTablesBuild(arena, tables);
+    if (TwoPhaseCacheLoad(tables, cache_path)) {
+        printf("Phase 1: loaded %s\n", cache_path);
+    } else {
+        TwoPhasePhase1Build(tables, thread_count);
+        TwoPhaseCacheSave(tables, cache_path);
+    }
+
+    TwoPhaseTablesCheck(tables);
+
+    TraceEnd("two phase tables");
+    printf("Time: %f seconds\n\n", TimeSeconds() - start);
+}
+
+// SHARDS /////////////////////////////////////////////////////////////////////
+// The phase 1 BFS with each layer split between worker processes. A layer's
+// shards are runs of words of the table, and the worker for one works out
+// its run of the next layer from the whole table as of this one, only ever
+// writing inside its run. Backward that's just its own unvisited entries.
+// Forward every shard has to go through the whole layer and keep the
+// neighbours that land in its run, so it only goes forward while the layer
+// times the shards is less than what's left unvisited.
+//
+// A shard needs nothing but the state file and writes nothing but its own
+// file, so shards can be done in any order by anything that can see dir, and
+// a worker that dies only loses its own. state.bin is the whole table after
+// the last complete layer and shard_NNNN.bin are runs of it after the next.
+// Once every shard of a layer is there and checks out they're merged into a
+// new state.bin and deleted, so a build that stops picks up at the last
+// layer and keeps any shards of the next one already done. When the table is
+// whole and safely in the cache state.bin goes too.
+static void TwoPhaseShardPath(const char* dir, u32 shard, char* path) {
+    if (shard == TWOPHASE_SHARD_STATE) {
+        snprintf(path, TWOPHASE_SHARD_PATH_SIZE, "%s/state.bin", dir);
+    } else {
+        snprintf(path, TWOPHASE_SHARD_PATH_SIZE, "%s/shard_%04u.bin", dir, shard);
+    }
+}
+
+static void TwoPhaseShardWords(u32 shard, u32 shard_count, u32* first, u32* end) {
+    u32 per_shard = (TWOPHASE_PHASE1_WORD_COUNT + shard_count - 1) / shard_count;
+    *first = MinU64((u64) shard * per_shard, TWOPHASE_PHASE1_WORD_COUNT);
+    *end = MinU64((u64) *first + per_shard, TWOPHASE_PHASE1_WORD_COUNT);
+}
+
+// Written to a temporary file first so a file that's there is always whole
+static bool TwoPhaseShardWrite(const char* dir, TwoPhaseShardHeader* header, const u32* words, u32 word_count) {
+    char path[TWOPHASE_SHARD_PATH_SIZE];
+    char tmp_path[TWOPHASE_SHARD_PATH_SIZE + 4];
+    TwoPhaseShardPath(dir, header->shard, path);
+    snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", path);
+
+    header->cache.magic = TWOPHASE_SHARD_MAGIC;
+    header->cache.version = TWOPHASE_CACHE_VERSION;
+    header->cache.checksum = TwoPhaseChecksum(words, word_count);
+
+    FILE* file = fopen(tmp_path, "wb");
+    if (file == NULL) {
+        printf("Couldn't open %s\n", tmp_path);
+        return false;
+    }
+    bool ok = fwrite(header, sizeof(*header), 1, file) == 1 &&
+        fwrite(words, sizeof(u32), word_count, file) == word_count;
+    ok = fclose(file) == 0 && ok;
+    if (ok) {
+        remove(path);
+        ok = rename(tmp_path, path) == 0;
+    }
+
+    if (!ok) printf("Couldn't write %s\n", path);
+    return ok;
+}
+
+// False without a word if there's no file
+static bool TwoPhaseShardRead(
+    const char* dir, u32 shard, TwoPhaseShardHeader* header, u32* words, u32 word_capacity
+) {
+    char path[TWOPHASE_SHARD_PATH_SIZE];
+    TwoPhaseShardPath(dir, shard, path);
+    FILE* file = fopen(path, "rb");
+    if (file == NULL) return false;
+
+    bool valid = fread(header, sizeof(*header), 1, file) == 1 &&
+        header->cache.magic == TWOPHASE_SHARD_MAGIC &&
+        header->cache.version == TWOPHASE_CACHE_VERSION &&
+        header->shard == shard;
+    u64 word_count = valid ? (header->cache.entry_count + TWOPHASE_WORD_ENTRIES - 1) / TWOPHASE_WORD_ENTRIES : 0;
+    valid = valid && word_count <= word_capacity &&
+        fread(words, sizeof(u32), word_count, file) == word_count &&
+        TwoPhaseChecksum(words, word_count) == header->cache.checksum;
+    fclose(file);
+
+    if (!valid) printf("%s: damaged\n", path);
+    return valid;
+}
+
+// Whether shard's file is a whole run of the layer after state's
+static bool TwoPhaseShardValid(
+    const char* dir, TwoPhaseShardHeader* state, u32 shard, TwoPhaseShardHeader* header, u32* words
+) {
+    u32 first;
+    u32 end;
+    TwoPhaseShardWords(shard, state->shard_count, &first, &end);
+    return TwoPhaseShardRead(dir, shard, header, words, end - first) &&
+        header->depth == state->depth + 1 &&
+        header->shard_count == state->shard_count &&
+        header->first_word == first &&
+        header->cache.entry_count == MinU64((u64) end * TWOPHASE_WORD_ENTRIES, TWOPHASE_PHASE1_ENTRY_COUNT) -
+            (u64) first * TWOPHASE_WORD_ENTRIES;
+}
+
+static bool TwoPhaseShardStateLoad(TwoPhaseTables* tables, const char* dir, TwoPhaseShardHeader* state) {
+    return TwoPhaseShardRead(dir, TWOPHASE_SHARD_STATE, state, tables->phase1_distances, TWOPHASE_PHASE1_WORD_COUNT)
+        && state->cache.entry_count == TWOPHASE_PHASE1_ENTRY_COUNT
+        && state->shard_count > 0 && state->shard_count <= TWOPHASE_MAX_SHARDS;
+}
+
+// Works out shard's run of the layer after state and writes it to its file.
+// The table has to be as of state, apart from other shards' runs, and is
+// left with shard's run as of the next layer.
+static bool TwoPhaseShardRun(
+    TwoPhaseTables* tables, const char* dir, TwoPhaseShardHeader* state, u32 shard, u32 thread_count
+) {
+    u32 first;
+    u32 end;
+    TwoPhaseShardWords(shard, state->shard_count, &first, &end);
+    u64 keep_first = (u64) first * TWOPHASE_WORD_ENTRIES;
+    u64 keep_end = MinU64((u64) end * TWOPHASE_WORD_ENTRIES, TWOPHASE_PHASE1_ENTRY_COUNT);
+
+    bool backward = state->layer * state->shard_count > TWOPHASE_PHASE1_ENTRY_COUNT - state->visited;
+    TwoPhaseLayerJob job = {
+        .tables = tables,
+        .depth = state->depth,
+        .backward = backward,
+        .next_chunk = 0,
+        .found = 0,
+        .scan_first = backward ? first : 0,
+        .scan_end = backward ? end : TWOPHASE_PHASE1_WORD_COUNT,
+        .keep_first = keep_first,
+        .keep_end = keep_end
+    };
+    ParallelRun(thread_count, TwoPhaseLayerWorker, &job);
+
+    TwoPhaseShardHeader header = {
+        .cache = { .entry_count = keep_end - keep_first },
+        .depth = state->depth + 1,
+        .shard = shard,
+        .shard_count = state->shard_count,
+        .first_word = first,
+        .layer = job.found
+    };
+    return TwoPhaseShardWrite(dir, &header, &tables->phase1_distances[first], end - first);
+}
+
+// Shards split between worker_count forked workers, or done here one after
+// another where there's no fork. Either way a shard that fails just isn't
+// there when the layer is merged.
+static void TwoPhaseShardWorkers(
+    TwoPhaseTables* tables, const char* dir, TwoPhaseShardHeader* state, u32* shards, u32 count, u32 worker_count
+) {
+#ifdef __linux__
+    worker_count = MinU32(worker_count, count);
+    pid_t workers[TWOPHASE_MAX_SHARDS];
+    for (u32 w = 0; w < worker_count; w++) {
+        workers[w] = fork();
+        if (workers[w] == 0) {
+            bool ok = true;
+            for (u32 i = w; i < count; i += worker_count) {
+                ok = TwoPhaseShardRun(tables, dir, state, shards[i], 1) && ok;
+            }
+            _exit(ok ? 0 : 1);
+        }
+        if (workers[w] < 0) printf("Couldn't start worker %u\n", w);
+    }
+    for (u32 w = 0; w < worker_count; w++) {
+        if (workers[w] > 0) waitpid(workers[w], NULL, 0);
+    }
+#else
+    for (u32 i = 0; i < count; i++) TwoPhaseShardRun(tables, dir, state, shards[i], ThreadCount());
+#endif
+}
+
+bool TwoPhasePhase1Sharded(
+    Arena* arena, const char* dir, const char* cache_path, u32 shard_count, u32 worker_count
+) {
+    assert(shard_count > 0 && shard_count <= TWOPHASE_MAX_SHARDS && worker_count > 0);
+
+    printf("----- SHARDED PHASE 1 -----\n");
+    double start = TimeSeconds();
+    TraceBegin("two phase sharded");
+
+    TwoPhaseTables tables;
+    TwoPhaseTablesBuild(arena, &tables);
+    u32* distances = tables.phase1_distances;
+
+    bool ok = true;
+    TwoPhaseShardHeader state;
+    if (TwoPhaseShardStateLoad(&tables, dir, &state)) {
+        printf(
+            "Resuming after depth %u with %llu visited, in %u shards\n", state.depth,
+            (unsigned long long) state.visited, state.shard_count
+        );
+    } else {
+        MemSet(distances, 0xFF, TWOPHASE_PHASE1_WORD_COUNT * sizeof(u32));
+        u64 solved = TwoPhasePhase1Index(&tables, 0, 0, TWOPHASE_SLICE_SOLVED);
+        u64 layer = TwoPhaseSetEquivalent(&tables, solved, 0, 0, TWOPHASE_PHASE1_ENTRY_COUNT);
+        state = (TwoPhaseShardHeader) {
+            .cache = { .entry_count = TWOPHASE_PHASE1_ENTRY_COUNT },
+            .depth = 0,
+            .shard = TWOPHASE_SHARD_STATE,
+            .shard_count = shard_count,
+            .first_word = 0,
+            .layer = layer,
+            .visited = layer
+        };
+        ok = TwoPhaseShardWrite(dir, &state, distances, TWOPHASE_PHASE1_WORD_COUNT);
+    }
+
+    u32 first;
+    u32 end;
+    TwoPhaseShardWords(0, state.shard_count, &first, &end);
+    u32* scratch = ArenaPushArray(arena, end - first, u32);
+
+    while (ok && state.layer > 0) {
+        printf("Depth %2u: %llu\n", state.depth, (unsigned long long) state.layer);
+
+        u32 shards[TWOPHASE_MAX_SHARDS];
+        u32 pending = 0;
+        for (u32 s = 0; s < state.shard_count; s++) {
+            TwoPhaseShardHeader header;
+            if (!TwoPhaseShardValid(dir, &state, s, &header, scratch)) shards[pending++] = s;
+        }
+        if (pending < state.shard_count) printf("          %u shards already done\n", state.shard_count - pending);
+        TwoPhaseShardWorkers(&tables, dir, &state, shards, pending, worker_count);
+
+        // Checked again since they've been through the filesystem
+        u64 layer = 0;
+        for (u32 s = 0; s < state.shard_count && ok; s++) {
+            TwoPhaseShardHeader header;
+            ok = TwoPhaseShardValid(dir, &state, s, &header, scratch);
+            if (!ok) {
+                printf("Shard %u of depth %u didn't finish, running again redoes it\n", s, state.depth + 1);
+                break;
+            }
+            u32 word_count = (header.cache.entry_count + TWOPHASE_WORD_ENTRIES - 1) / TWOPHASE_WORD_ENTRIES;
+            MemCopy(&distances[header.first_word], scratch, word_count * sizeof(u32));
+            layer += header.layer;
+        }
+        if (!ok) break;
+
+        state.depth++;
+        state.layer = layer;
+        state.visited += layer;
+        ok = TwoPhaseShardWrite(dir, &state, distances, TWOPHASE_PHASE1_WORD_COUNT);
+        for (u32 s = 0; s < state.shard_count && ok; s++) {
+            char path[TWOPHASE_SHARD_PATH_SIZE];
+            TwoPhaseShardPath(dir, s, path);
+            remove(path);
+        }
+    }
+
+    if (ok) {
+        assert(state.visited == TWOPHASE_PHASE1_ENTRY_COUNT);
+        TwoPhaseTablesCheck(&tables);
+        ok = TwoPhaseCacheSave(&tables, cache_path);
+    }
+    if (ok) {
+        printf("Wrote %s, checksum %016llx\n", cache_path, (unsigned long long) state.cache.checksum);
+
+        // A table's worth of disk that nothing needs any more
+        char path[TWOPHASE_SHARD_PATH_SIZE];
+        TwoPhaseShardPath(dir, TWOPHASE_SHARD_STATE, path);
+        remove(path);
+    }
+
+    TraceEnd("two phase sharded");
+    printf("Time: %f seconds\n\n", TimeSeconds() - start);
+    return ok;
+}
+
+bool TwoPhasePhase1Shard(Arena* arena, const char* dir, u32 shard, u32 thread_count) {
+    printf("----- PHASE 1 SHARD -----\n");
+    double start = TimeSeconds();
+
+    TwoPhaseTables tables;
+    TwoPhaseTablesBuild(arena, &tables);
+
+    TwoPhaseShardHeader state;
+    if (!TwoPhaseShardStateLoad(&tables, dir, &state)) {
+        printf("No state in %s, start the build with phase1-sharded\n", dir);
+        return false;
+    }
+    if (state.layer == 0) {
+        printf("The build in %s is finished, phase1-sharded writes the table\n", dir);
+        return false;
+    }
+    if (shard >= state.shard_count) {
+        printf("Depth %u only has %u shards\n", state.depth + 1, state.shard_count);
+        return false;
+    }
+
+    bool ok = TwoPhaseShardRun(&tables, dir, &state, shard, thread_count);
+    printf(
+        "Depth %u shard %u of %u: %s\nTime: %f seconds\n\n", state.depth + 1, shard, state.shard_count,
+        ok ? "done" : "failed", TimeSeconds() - start
+    );
+    return ok;
+}
+
+// SEARCH /////////////////////////////////////////////////////////////////////
+// Same face twice is never needed, and opposite faces commute so only one
+// order of them is searched
+static bool TwoPhaseTurnAllowed(u8 turn, u8 last) {
+    if (last == TURN_TYPE_COUNT) return true;
+    u8 face = turn % CUBE_COLOUR_COUNT;
+    u8 last_face = last % CUBE_COLOUR_COUNT;
+    if (face == last_face) return false;
+    if ((face + CUBE_COLOUR_COUNT / 2) % CUBE_COLOUR_COUNT == last_face && face < last_face) return false;
+    return true;
+}
+
+static bool TwoPhaseIsPhase2Turn(u8 turn) {
+    u8 face = turn % CUBE_COLOUR_COUNT;
+    return turn >= TURN_FRONT_DOUBLE || face == TURN_UP || face == TURN_DOWN;
+}
+
+// Asked at every node of both phases, phase 2 can take as long as phase 1
+static bool TwoPhaseStopped(TwoPhaseSearch* search) {
+    if (search->stop != NULL && (++search->nodes % TWOPHASE_STOP_NODES) == 0 && search->stop(search->stop_data)) {
+        search->stopped = true;
+    }
+    return search->stopped;
+}
+
+static bool TwoPhasePhase2(
+    TwoPhaseSearch* search, u16 cperm, u16 eperm, u16 slice_perm, u8 depth, u8 togo
+) {
+    // Claiming a solution is the quickest way back out of the recursion,
+    // TwoPhaseSolveUntil knows better
+    if (TwoPhaseStopped(search)) return true;
+
+    if (togo == 0) {
+        if (cperm != 0 || eperm != 0 || slice_perm != 0) return false;
+        search->length = depth;
+        return true;
+    }
+
+    TwoPhaseTables* tables = search->tables;
+    u8 last = depth > 0 ? search->moves[depth - 1] : TURN_TYPE_COUNT;
+
+    for (int i = 0; i < TWOPHASE_PHASE2_TURN_COUNT; i++) {
+        u8 turn = TWOPHASE_PHASE2_TURNS[i];
+        if (!TwoPhaseTurnAllowed(turn, last)) continue;
+
+        u16 next_cperm = tables->cperm_moves[cperm * TWOPHASE_PHASE2_TURN_COUNT + i];
+        u16 next_eperm = tables->eperm_moves[eperm * TWOPHASE_PHASE2_TURN_COUNT + i];
+        u16 next_slice_perm = tables->slice_perm_moves[slice_perm * TWOPHASE_PHASE2_TURN_COUNT + i];
+
+        u8 bound = MaxU8(
+            tables->cperm_slice_prune[next_cperm * TWOPHASE_SLICE_PERM_COUNT + next_slice_perm],
+            tables->eperm_slice_prune[next_eperm * TWOPHASE_SLICE_PERM_COUNT + next_slice_perm]
+        );
+        if (bound >= togo) continue;
+
+        search->moves[depth] = turn;
+        if (TwoPhasePhase2(search, next_cperm, next_eperm, next_slice_perm, depth + 1, togo - 1)) return true;
+    }
+    return false;
+}
+
+static bool TwoPhaseStartPhase2(TwoPhaseSearch* search, u8 phase1_length) {
+    // A phase 1 solution ending in a phase 2 turn is the shorter one plus a
+    // turn, and that was already tried
+    if (phase1_length > 0 && TwoPhaseIsPhase2Turn(search->moves[phase1_length - 1])) return false;
+
+    TwoPhaseCubie cubie = search->start;
+    for (int i = 0; i < phase1_length; i++) TwoPhaseCubieTurn(&cubie, search->moves[i]);
+
+    u16 cperm = TwoPhaseCperm(&cubie);
+    u16 eperm = TwoPhaseEperm(&cubie);
+    u16 slice_perm = TwoPhaseSlicePerm(&cubie);
+
+    TwoPhaseTables* tables = search->tables;
+    u8 bound = MaxU8(
+        tables->cperm_slice_prune[cperm * TWOPHASE_SLICE_PERM_COUNT + slice_perm],
+        tables->eperm_slice_prune[eperm * TWOPHASE_SLICE_PERM_COUNT + slice_perm]
+    );
+
+    for (u8 togo = bound; phase1_length + togo <= search->max_length; togo++) {
+        if (TwoPhasePhase2(search, cperm, eperm, slice_perm, phase1_length, togo)) return true;
+    }
+    return false;
+}
+
+static bool TwoPhasePhase1(
+    TwoPhaseSearch* search, u16 twist, u16 flip, u16 slice, u8 distance, u8 depth, u8 togo
+);
+
+// Turns the coordinates and returns the exact phase 1 distance after.
+// distance is the exact phase 1 distance before, which with the mod 3 entry
+// of a neighbour is enough to know the neighbour's exactly.
+static inline u8 TwoPhasePhase1Step(
+    TwoPhaseTables* tables, u16* twist, u16* flip, u16* slice, u8 distance, u8 turn
+) {
+    *twist = tables->twist_moves[*twist * TURN_TYPE_COUNT + turn];
+    *flip = tables->flip_moves[*flip * TURN_TYPE_COUNT + turn];
+    *slice = tables->slice_moves[*slice * TURN_TYPE_COUNT + turn];
+    u64 index = TwoPhasePhase1Index(tables, *twist, *flip, *slice);
+    u8 mod = TwoPhaseGetDistance(tables->phase1_distances, index);
+
+    if (mod == distance % 3) return distance;
+    if (mod == (distance + 2) % 3) return distance - 1;
+    return distance + 1;
+}
+
+static bool TwoPhasePhase1Turn(
+    TwoPhaseSearch* search, u16 twist, u16 flip, u16 slice, u8 distance, u8 depth, u8 togo, u8 turn
+) {
+    u8 next_distance = TwoPhasePhase1Step(search->tables, &twist, &flip, &slice, distance, turn);
+    if (next_distance >= togo) return false;
+
+    search->moves[depth] = turn;
+    return TwoPhasePhase1(search, twist, flip, slice, next_distance, depth + 1, togo - 1);
+}
+
+static bool TwoPhasePhase1(
+    TwoPhaseSearch* search, u16 twist, u16 flip, u16 slice, u8 distance, u8 depth, u8 togo
+) {
+    if (TwoPhaseStopped(search)) return true;
+
+    if (togo == 0) return TwoPhaseStartPhase2(search, depth);
+
+    u8 last = depth > 0 ? search->moves[depth - 1] : TURN_TYPE_COUNT;
+    for (int turn = 0; turn < TURN_TYPE_COUNT; turn++) {
+        if (!TwoPhaseTurnAllowed(turn, last)) continue;
+        if (TwoPhasePhase1Turn(search, twist, flip, slice, distance, depth, togo, turn)) return true;
+    }
+    return false;
+}
+
+// Phase 1 on its own is a lower bound for the whole cube
+u8 TwoPhaseLowerBound(TwoPhaseTables* tables, TwoPhaseCubie* cubie) {
+    return TwoPhasePhase1Distance(tables, TwoPhaseTwist(cubie), TwoPhaseFlip(cubie), TwoPhaseSlice(cubie), NULL);
+}
+
+// Writes at most max_length turns to moves and returns how many, or
+// TWOPHASE_NO_SOLUTION if there is nothing that short.
+//
+// A cube that needs a long phase 1 one way round is often easy another way,
+// so the cube is searched from all three axes and inverted as well (a
+// solution to the inverse, backwards, solves the cube). All six go one phase
+// 1 depth at a time and whichever finds something first wins.
+u8 TwoPhaseSolve(TwoPhaseTables* tables, TwoPhaseCubie* cubie, u8 max_length, enum8(TurnType)* moves) {
+    return TwoPhaseSolveUntil(tables, cubie, max_length, moves, NULL, NULL);
+}
+
+// The cube held the vth way round, see TwoPhaseSolve
+static void TwoPhaseSearchInit(
+    TwoPhaseSearch* search, TwoPhaseTables* tables, TwoPhaseCubie* cubie, int v, u8 max_length,
+    TwoPhaseStopFunction stop, void* stop_data
+) {
+    search->tables = tables;
+    search->max_length = max_length;
+    search->stop = stop;
+    search->stop_data = stop_data;
+    search->nodes = 0;
+    search->stopped = false;
+
+    if (v < TWOPHASE_SEARCH_COUNT / 2) {
+        search->start = *cubie;
+    } else {
+        TwoPhaseCubieInverse(cubie, &search->start);
+    }
+    for (int r = 0; r < v % 3; r++) TwoPhaseCubieRotate(&search->start);
+
+    search->twist = TwoPhaseTwist(&search->start);
+    search->flip = TwoPhaseFlip(&search->start);
+    search->slice = TwoPhaseSlice(&search->start);
+    search->distance = TwoPhasePhase1Distance(tables, search->twist, search->flip, search->slice, NULL);
+}
+
+// The vth search's solution back to how the cube was actually held, and
+// undone if it was inverted
+static void TwoPhaseSearchMoves(TwoPhaseSearch* search, int v, enum8(TurnType)* moves) {
+    bool inverted = v >= TWOPHASE_SEARCH_COUNT / 2;
+    for (int i = 0; i < search->length; i++) {
+        u8 turn = search->moves[i];
+        u8 face = turn % CUBE_COLOUR_COUNT;
+        for (int r = 0; r < v % 3; r++) face = TWOPHASE_UNROTATE_FACES[face];
+        turn = turn - turn % CUBE_COLOUR_COUNT + face;
+
+        if (inverted) {
+            if (turn < TURN_FRONT_PRIME) {
+                turn += TURN_FRONT_PRIME;
+            } else if (turn < TURN_FRONT_DOUBLE) {
+                turn -= TURN_FRONT_PRIME;
+            }
+            moves[search->length - 1 - i] = turn;
+        } else {
+            moves[i] = turn;
+        }
+    }
+}
+
+u8 TwoPhaseSolveUntil(
+    TwoPhaseTables* tables, TwoPhaseCubie* cubie, u8 max_length, enum8(TurnType)* moves,
+    TwoPhaseStopFunction stop, void* stop_data
+) {
+    assert(max_length <= TWOPHASE_MAX_LENGTH);
+
+    TwoPhaseSearch searches[TWOPHASE_SEARCH_COUNT];
+    u8 first_depth = UINT8_MAX;
+    for (int v = 0; v < TWOPHASE_SEARCH_COUNT; v++) {
+        TwoPhaseSearchInit(&searches[v], tables, cubie, v, max_length, stop, stop_data);
+        first_depth = MinU8(first_depth, searches[v].distance);
+    }
+
+    for (u8 togo = first_depth; togo <= max_length; togo++) {
+        for (int v = 0; v < TWOPHASE_SEARCH_COUNT; v++) {
+            TwoPhaseSearch* search = &searches[v];
+            if (search->distance > togo) continue;
+            if (!TwoPhasePhase1(
+                search, search->twist, search->flip, search->slice, search->distance, 0, togo
+            )) {
+                continue;
+            }
+            if (search->stopped) return TWOPHASE_STOPPED;
+
+            TwoPhaseSearchMoves(search, v, moves);
+            return search->length;
+        }
+    }
+    return TWOPHASE_NO_SOLUTION;
+}
+
+// OPTIMAL ////////////////////////////////////////////////////////////////////
+// Two-phase keeps going once it has a solution, with max_length one less
+// each time, until it has looked at every phase 1 length up to the best
+// length found. Then nothing shorter can exist, as an optimal solution is
+// just a phase 1 solution of its full length with an empty phase 2.
+//
+// Each phase 1 length is split into a root per first two turns, handed out
+// to the threads one at a time. A solve can take hours, so given a checkpoint
+// path the phase 1 length, which roots of it are finished and the best
+// solution so far are written out as a root finishes once interval seconds
+// have gone by since the last time, after each length and when stopped by
+// SIGINT or SIGTERM. With 243 real roots a length has a few hundred points to
+// save at, where a root per first turn left long lengths with only 18. Running it again on the same cube carries on
+// from there, redoing only the roots that were part way. Only the cube as
+// held is searched, the rotated and inverted ones would find the same things
+// again.
+static volatile sig_atomic_t twophase_interrupted;
+
+static void TwoPhaseInterrupt(int signal_number) {
+    (void) signal_number;
+    twophase_interrupted = 1;
+}
+
+static bool TwoPhaseInterruptStop(void* data) {
+    (void) data;
+    return twophase_interrupted != 0;
+}
+
+// Written straight from memory, the cube is there to catch a checkpoint from
+// some other solve
+typedef struct {
+    u32 magic;
+    u32 version;
+    u64 edges;
+    u32 corners;
+    u8 togo;            // Phase 1 length being searched
+    u8 best_length;     // TWOPHASE_NO_SOLUTION until there is one
+    enum8(TurnType) best_moves[TWOPHASE_MAX_LENGTH];
+    u8 done[TWOPHASE_OPTIMAL_ROOT_COUNT];
+    double seconds;     // Spent on this cube by earlier runs
+    u64 nodes;
+} TwoPhaseCheckpoint;
+
+typedef struct {
+    TwoPhaseSearch search;
+    TwoPhaseCheckpoint state;
+    u32 next_root;
+    u32 lock;
+    const char* path;
+    double interval;
+    double next_save;
+    double start;
+} TwoPhaseOptimalJob;
+
+static void TwoPhaseOptimalLock(TwoPhaseOptimalJob* job) {
+    // Only ever held for a few instructions or one small write
+    while (__atomic_exchange_n(&job->lock, 1, __ATOMIC_ACQUIRE)) {}
+}
+
+static void TwoPhaseOptimalUnlock(TwoPhaseOptimalJob* job) {
+    __atomic_store_n(&job->lock, 0, __ATOMIC_RELEASE);
+}
+
+// Called with the lock held, or with no workers running. Written to a
+// temporary file first so the last good checkpoint is never lost.
+static bool TwoPhaseCheckpointSave(TwoPhaseOptimalJob* job) {
+    char tmp_path[TWOPHASE_SHARD_PATH_SIZE + 4];
+    snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", job->path);
+
+    TwoPhaseCheckpoint state = job->state;
+    state.seconds += TimeSeconds() - job->start;
+
+    FILE* file = fopen(tmp_path, "wb");
+    if (file == NULL) {
+        printf("Couldn't open %s\n", tmp_path);
+        return false;
+    }
+    bool ok = fwrite(&state, sizeof(state), 1, file) == 1;
+    ok = fclose(file) == 0 && ok;
+    if (ok) {
+        remove(job->path);
+        ok = rename(tmp_path, job->path) == 0;
+    }
+
+    if (!ok) printf("Couldn't write %s\n", job->path);
+    job->next_save = TimeSeconds() + job->interval;
+    return ok;
+}
+
+// False without a word if there's no file
+static bool TwoPhaseCheckpointLoad(TwoPhaseOptimalJob* job) {
+    FILE* file = fopen(job->path, "rb");
+    if (file == NULL) return false;
+
+    TwoPhaseCheckpoint state;
+    bool valid = fread(&state, sizeof(state), 1, file) == 1 &&
+        state.magic == job->state.magic &&
+        state.version == job->state.version &&
+        state.corners == job->state.corners &&
+        state.edges == job->state.edges &&
+        state.togo <= TWOPHASE_MAX_LENGTH &&
+        (state.best_length == TWOPHASE_NO_SOLUTION || state.best_length <= TWOPHASE_MAX_LENGTH);
+    fclose(file);
+
+    if (!valid) {
+        printf("%s isn't a checkpoint of this cube, starting over\n", job->path);
+        return false;
+    }
+    job->state = state;
+    return true;
+}
+
+// The longest a solution can be and still be worth finding
+static u8 TwoPhaseOptimalLimit(TwoPhaseOptimalJob* job) {
+    u8 best = __atomic_load_n(&job->state.best_length, __ATOMIC_RELAXED);
+    return best == TWOPHASE_NO_SOLUTION ? TWOPHASE_MAX_LENGTH : best - 1;
+}
+
+// Phase 1 solutions of length togo starting with first then second. Length 1
+// only has a first turn and goes with second 0, length 0 has neither and goes
+// with root 0.
+static bool TwoPhaseOptimalPhase1(TwoPhaseSearch* search, u8 togo, u8 first, u8 second) {
+    if (togo == 0) return TwoPhaseStartPhase2(search, 0);
+
+    u16 twist = search->twist;
+    u16 flip = search->flip;
+    u16 slice = search->slice;
+    if (togo == 1) return TwoPhasePhase1Turn(search, twist, flip, slice, search->distance, 0, togo, first);
+
+    u8 distance = TwoPhasePhase1Step(search->tables, &twist, &flip, &slice, search->distance, first);
+    if (distance >= togo) return false;
+
+    search->moves[0] = first;
+    return TwoPhasePhase1Turn(search, twist, flip, slice, distance, 1, togo - 1, second);
+}
+
+// Everything at phase 1 length togo starting with root's two turns, again
+// with a lower max_length after each solution until there's none left. False
+// if stopped part way.
+static bool TwoPhaseOptimalRoot(TwoPhaseOptimalJob* job, u8 togo, u32 root) {
+    TwoPhaseSearch search = job->search;
+    u8 first = root / TURN_TYPE_COUNT;
+    u8 second = root % TURN_TYPE_COUNT;
+    if (togo == 0 && (root != 0 || search.distance != 0)) return true;
+    if (togo == 1 && second != 0) return true;
+    if (togo >= 2 && !TwoPhaseTurnAllowed(second, first)) return true;
+    if (search.distance > togo) return true;
+
+    while (true) {
+        search.max_length = TwoPhaseOptimalLimit(job);
+        if (togo > search.max_length) return true;
+
+        bool found = TwoPhaseOptimalPhase1(&search, togo, first, second);
+        if (search.stopped) break;
+        if (!found) break;
+
+        TwoPhaseOptimalLock(job);
+        if (search.length <= TwoPhaseOptimalLimit(job)) {
+            __atomic_store_n(&job->state.best_length, search.length, __ATOMIC_RELAXED);
+            TwoPhaseSearchMoves(&search, 0, job->state.best_moves);
+            printf("Found %u turns\n", search.length);
+        }
+        TwoPhaseOptimalUnlock(job);
+    }
+
+    __atomic_fetch_add(&job->state.nodes, search.nodes, __ATOMIC_RELAXED);
+    return !search.stopped;
+}
+
+static void TwoPhaseOptimalWorker(void* data, u32 thread_index, u32 thread_count) {
+    (void) thread_index;
+    (void) thread_count;
+    TwoPhaseOptimalJob* job = data;
+    u8 togo = job->state.togo;
+
+    while (!twophase_interrupted) {
+        u32 root = __atomic_fetch_add(&job->next_root, 1, __ATOMIC_RELAXED);
+        if (root >= TWOPHASE_OPTIMAL_ROOT_COUNT) break;
+        if (job->state.done[root]) continue;
+        if (!TwoPhaseOptimalRoot(job, togo, root)) break;
+
+        TwoPhaseOptimalLock(job);
+        job->state.done[root] = true;
+        if (job->path != NULL && TimeSeconds() >= job->next_save) TwoPhaseCheckpointSave(job);
+        TwoPhaseOptimalUnlock(job);
+    }
+}
+
+u8 TwoPhaseSolveOptimal(
+    TwoPhaseTables* tables, TwoPhaseCubie* cubie, enum8(TurnType)* moves, u32 thread_count,
+    const char* checkpoint_path, double interval
+) {
+    TwoPhaseOptimalJob job = {
+        .state = {
+            .magic = TWOPHASE_CHECKPOINT_MAGIC,
+            .version = TWOPHASE_CACHE_VERSION,
+            .edges = TwoPhaseEdgeCoord(cubie),
+            .corners = TwoPhaseCornerCoord(cubie),
+            .best_length = TWOPHASE_NO_SOLUTION,
+        },
+        .path = checkpoint_path,
+        .interval = interval,
+        .start = TimeSeconds(),
+    };
+    job.next_save = job.start + interval;
+
+    // Without a checkpoint there's nothing to stop for, so the search runs
+    // exactly as it would with no stop function at all
+    void (*old_int)(int) = SIG_DFL;
+    void (*old_term)(int) = SIG_DFL;
+    twophase_interrupted = 0;
+    TwoPhaseSearchInit(&job.search, tables, cubie, 0, TWOPHASE_MAX_LENGTH, NULL, NULL);
+    if (checkpoint_path != NULL) {
+        job.search.stop = TwoPhaseInterruptStop;
+        old_int = signal(SIGINT, TwoPhaseInterrupt);
+        old_term = signal(SIGTERM, TwoPhaseInterrupt);
+
+        if (TwoPhaseCheckpointLoad(&job)) {
+            u32 done = 0;
+            for (int r = 0; r < TWOPHASE_OPTIMAL_ROOT_COUNT; r++) done += job.state.done[r];
+            printf(
+                "Carrying on from %s: phase 1 length %u with %u of %u first two turns done, best %u\n",
+                checkpoint_path, job.state.togo, done, TWOPHASE_OPTIMAL_ROOT_COUNT, job.state.best_length
+            );
+        }
+    }
+    if (job.state.togo < job.search.distance) job.state.togo = job.search.distance;
+
+    while (job.state.togo <= TwoPhaseOptimalLimit(&job)) {
+        job.next_root = 0;
+        ParallelRun(thread_count, TwoPhaseOptimalWorker, &job);
+        if (twophase_interrupted) break;
+
+        job.state.togo++;
+        MemSet(job.state.done, 0, sizeof(job.state.done));
+        if (checkpoint_path != NULL) TwoPhaseCheckpointSave(&job);
+    }
+
+    if (checkpoint_path != NULL) {
+        signal(SIGINT, old_int);
+        signal(SIGTERM, old_term);
+    }
+    if (twophase_interrupted) {
+        TwoPhaseCheckpointSave(&job);
+        printf("Stopped, %s has where it got to\n", checkpoint_path);
+        return TWOPHASE_STOPPED;
+    }
+    if (checkpoint_path != NULL) remove(checkpoint_path);
+
+    if (job.state.best_length != TWOPHASE_NO_SOLUTION) {
+        MemCopy(moves, job.state.best_moves, job.state.best_length);
+    }
+    return job.state.best_length;
+}
+
+void TwoPhaseOptimalRun(
+    Arena* arena, u32 scramble_length, u64 seed, u32 thread_count, const char* checkpoint_path, double interval
+) {
+    TwoPhaseTables tables;
+    TwoPhaseTablesInit(arena, &tables, TWOPHASE_CACHE_PATH, ThreadCount());
+
+    printf("----- OPTIMAL SOLVE -----\n");
+
+    // HashU64 keeps 0 at 0, so the seed is mixed with something first
+    u64 random = HashU64(seed ^ 0x9E3779B97F4A7C15ull);
+    TwoPhaseCubie cubie;
+    TwoPhaseCubieSolved(&cubie);
+    u8 last = TURN_TYPE_COUNT;
+    printf("Scramble:");
+    for (u32 i = 0; i < scramble_length; i++) {
+        u8 turn;
+        do {
+            random = HashU64(random);
+            turn = random % TURN_TYPE_COUNT;
+        } while (!TwoPhaseTurnAllowed(turn, last));
+        TwoPhaseCubieTurn(&cubie, turn);
+        printf(" %s", TURN_TYPE_NAMES[turn]);
+        last = turn;
+    }
+    printf("\n");
+
+    enum8(TurnType) moves[TWOPHASE_MAX_LENGTH];
+    double start = TimeSeconds();
+    u8 length = TwoPhaseSolveOptimal(&tables, &cubie, moves, thread_count, checkpoint_path, interval);
+    double elapsed = TimeSeconds() - start;
+    if (length == TWOPHASE_STOPPED) return;
+    assert(length != TWOPHASE_NO_SOLUTION && "Every state is 20 or less!");
+
+    printf("Optimal (%u turns):", length);
+    for (int i = 0; i < length; i++) {
+        printf(" %s", TURN_TYPE_NAMES[moves[i]]);
+        TwoPhaseCubieTurn(&cubie, moves[i]);
+    }
+    printf("\n");
+
+    TwoPhaseCubie solved;
+    TwoPhaseCubieSolved(&solved);
+    bool ok = MemCmp(&cubie, &solved, sizeof(cubie)) == 0;
+    printf("Took %.2fs, %s\n", elapsed, ok ? "solves it" : "DOESN'T SOLVE IT");
+}
+
+// BATCH //////////////////////////////////////////////////////////////////////
+// Phase 1 for lots of cubes at once. With an exact table IDA* never has to
+// back up: every step is the first turn to a neighbour one closer, the same
+// lookups whatever the cube. So eight cubes can go down the table together
+// in AVX2 lanes, one gather for each table in the chain, each lane trying
+// the turns in the same order as the scalar walk so the answers match move
+// for move. A lane that reaches solved gets the next cube.
+//
+// One group of lanes on its own is slower than scalar. Each probe is a chain
+// of six dependent loads ending in a miss on 35MB, and the next probe can't
+// start until this one says whether to turn, whereas the scalar loop's tries
+// within a step don't depend on each other and run ahead out of order. So
+// several groups are probed back to back before any of them steps.
+
+#define TWOPHASE_BATCH_LANES 8
+
+// Groups of lanes probed back to back
+#define TWOPHASE_BATCH_GROUPS 4
+
+#define TWOPHASE_BENCH_ROUNDS 3
+#define TWOPHASE_BATCH_IDLE UINT32_MAX
+
+// Sort keys are a cube's starting phase 1 index, under 2^28, in two passes
+#define TWOPHASE_SORT_DIGIT_BITS 14
+#define TWOPHASE_SORT_PASSES 2
+#define TWOPHASE_SORT_DIGITS (1 << TWOPHASE_SORT_DIGIT_BITS)
+
+static void TwoPhasePhase1BatchScalar(
+    TwoPhaseTables* tables, TwoPhaseCubie* cubies, u32 count, u8* lengths, enum8(TurnType)* moves
+) {
+    for (u32 i = 0; i < count; i++) {
+        TwoPhaseCubie* cubie = &cubies[i];
+        lengths[i] = TwoPhasePhase1Distance(
+            tables, TwoPhaseTwist(cubie), TwoPhaseFlip(cubie), TwoPhaseSlice(cubie),
+            &moves[(u64) i * TWOPHASE_PHASE1_MAX_LENGTH]
+        );
+    }
+}
+
+#ifdef TWOPHASE_X86
+#define TWOPHASE_AVX2 __attribute__((target("avx2")))
+
+// Gathers only come in 32 bits, so u16 and u8 entries are read as a u32 and
+// masked, which reads up to 3 bytes past the last entry. Every table gathered
+// that way has something pushed after it in the arena, so that's harmless.
+TWOPHASE_AVX2 static inline __m256i TwoPhaseGather16(const u16* table, __m256i index) {
+    __m256i words = _mm256_i32gather_epi32((const int*) table, index, 2);
+    return _mm256_and_si256(words, _mm256_set1_epi32(0xFFFF));
+}
+
+TWOPHASE_AVX2 static inline __m256i TwoPhaseGather8(const u8* table, __m256i index) {
+    __m256i words = _mm256_i32gather_epi32((const int*) table, index, 1);
+    return _mm256_and_si256(words, _mm256_set1_epi32(0xFF));
+}
+
+// Eight cubes, each with the turn it's trying next and the distance mod 3
+// that turn has to reach. Lanes don't wait for each other: one that finds
+// its closer neighbour starts over from turn 0 on the next pass while the
+// rest carry on from wherever they were.
+typedef struct {
+    __m256i twist;
+    __m256i flip;
+    __m256i slice;
+    __m256i closer;
+    __m256i turn;
+    __m256i live;
+
+    // What the current turn leads to, from TwoPhaseLanesProbe
+    __m256i next_twist;
+    __m256i next_flip;
+    __m256i next_slice;
+    __m256i distance;
+
+    u32 solved_lanes;
+    u32 cube_of[TWOPHASE_BATCH_LANES];
+    u8 lengths[TWOPHASE_BATCH_LANES];
+} TwoPhaseLanes;
+
+typedef struct {
+    TwoPhaseTables* tables;
+    TwoPhaseCubie* cubies;
+    u32 count;
+    u32 next;
+    u8* lengths;
+    enum8(TurnType)* moves;
+} TwoPhaseBatch;
+
+// Hands out the lengths of the lanes that just got to solved and gives them
+// the next cubes, or leaves them solved and idle when there are none
+TWOPHASE_AVX2 static void TwoPhaseLanesRefill(TwoPhaseBatch* batch, TwoPhaseLanes* lanes) {
+    alignas(32) u32 twists[TWOPHASE_BATCH_LANES];
+    alignas(32) u32 flips[TWOPHASE_BATCH_LANES];
+    alignas(32) u32 slices[TWOPHASE_BATCH_LANES];
+    alignas(32) u32 closers[TWOPHASE_BATCH_LANES];
+    alignas(32) u32 turns[TWOPHASE_BATCH_LANES];
+    alignas(32) u32 live[TWOPHASE_BATCH_LANES];
+    _mm256_store_si256((__m256i*) twists, lanes->twist);
+    _mm256_store_si256((__m256i*) flips, lanes->flip);
+    _mm256_store_si256((__m256i*) slices, lanes->slice);
+    _mm256_store_si256((__m256i*) closers, lanes->closer);
+    _mm256_store_si256((__m256i*) turns, lanes->turn);
+    _mm256_store_si256((__m256i*) live, lanes->live);
+
+    for (u32 solved = lanes->solved_lanes; solved != 0; solved &= solved - 1) {
+        int lane = __builtin_ctz(solved);
+        if (lanes->cube_of[lane] != TWOPHASE_BATCH_IDLE) {
+            batch->lengths[lanes->cube_of[lane]] = lanes->lengths[lane];
+        }
+
+        // Cubes that start out solved are done without taking the lane
+        for (;;) {
+            if (batch->next == batch->count) {
+                twists[lane] = 0;
+                flips[lane] = 0;
+                slices[lane] = TWOPHASE_SLICE_SOLVED;
+                live[lane] = 0;
+                lanes->cube_of[lane] = TWOPHASE_BATCH_IDLE;
+                break;
+            }
+
+            TwoPhaseCubie* cubie = &batch->cubies[batch->next];
+            twists[lane] = TwoPhaseTwist(cubie);
+            flips[lane] = TwoPhaseFlip(cubie);
+            slices[lane] = TwoPhaseSlice(cubie);
+            if (twists[lane] == 0 && flips[lane] == 0 && slices[lane] == TWOPHASE_SLICE_SOLVED) {
+                batch->lengths[batch->next++] = 0;
+                continue;
+            }
+
+            u64 index = TwoPhasePhase1Index(batch->tables, twists[lane], flips[lane], slices[lane]);
+            closers[lane] = (TwoPhaseGetDistance(batch->tables->phase1_distances, index) + 2) % 3;
+            turns[lane] = 0;
+            live[lane] = UINT32_MAX;
+            lanes->cube_of[lane] = batch->next++;
+            lanes->lengths[lane] = 0;
+            break;
+        }
+    }
+    lanes->solved_lanes = 0;
+
+    lanes->twist = _mm256_load_si256((const __m256i*) twists);
+    lanes->flip = _mm256_load_si256((const __m256i*) flips);
+    lanes->slice = _mm256_load_si256((const __m256i*) slices);
+    lanes->closer = _mm256_load_si256((const __m256i*) closers);
+    lanes->turn = _mm256_load_si256((const __m256i*) turns);
+    lanes->live = _mm256_load_si256((const __m256i*) live);
+}
+
+// TwoPhasePhase1Index and TwoPhaseGetDistance after each lane's turn, eight
+// at a time. Idle lanes look up the solved state, which does no harm.
+TWOPHASE_AVX2 static void TwoPhaseLanesProbe(TwoPhaseTables* tables, TwoPhaseLanes* lanes) {
+    const __m256i turn_count = _mm256_set1_epi32(TURN_TYPE_COUNT);
+    lanes->next_twist = TwoPhaseGather16(
+        tables->twist_moves, _mm256_add_epi32(_mm256_mullo_epi32(lanes->twist, turn_count), lanes->turn)
+    );
+    lanes->next_flip = TwoPhaseGather16(
+        tables->flip_moves, _mm256_add_epi32(_mm256_mullo_epi32(lanes->flip, turn_count), lanes->turn)
+    );
+    lanes->next_slice = TwoPhaseGather16(
+        tables->slice_moves, _mm256_add_epi32(_mm256_mullo_epi32(lanes->slice, turn_count), lanes->turn)
+    );
+
+    // TWOPHASE_FLIP_COUNT is 2^11
+    __m256i flipslice = _mm256_or_si256(_mm256_slli_epi32(lanes->next_slice, 11), lanes->next_flip);
+    __m256i class = TwoPhaseGather16(tables->flipslice_classes, flipslice);
+    __m256i sym = TwoPhaseGather8(tables->flipslice_syms, flipslice);
+    __m256i conj_index = _mm256_add_epi32(
+        _mm256_mullo_epi32(lanes->next_twist, _mm256_set1_epi32(TWOPHASE_SYM_COUNT)), sym
+    );
+    __m256i conj = TwoPhaseGather16(tables->twist_conj, conj_index);
+    __m256i index = _mm256_add_epi32(_mm256_mullo_epi32(class, _mm256_set1_epi32(TWOPHASE_TWIST_COUNT)), conj);
+
+    __m256i word = _mm256_i32gather_epi32((const int*) tables->phase1_distances, _mm256_srli_epi32(index, 4), 4);
+    __m256i shift = _mm256_slli_epi32(_mm256_and_si256(index, _mm256_set1_epi32(TWOPHASE_WORD_ENTRIES - 1)), 1);
+    lanes->distance = _mm256_and_si256(_mm256_srlv_epi32(word, shift), _mm256_set1_epi32(3));
+}
+
+// Lanes whose turn got one closer take it, the rest move on to their next turn
+TWOPHASE_AVX2 static void TwoPhaseLanesStep(TwoPhaseBatch* batch, TwoPhaseLanes* lanes) {
+    const __m256i one = _mm256_set1_epi32(1);
+    const __m256i two = _mm256_set1_epi32(2);
+    const __m256i three = _mm256_set1_epi32(3);
+
+    __m256i hit = _mm256_and_si256(lanes->live, _mm256_cmpeq_epi32(lanes->distance, lanes->closer));
+    u32 hit_lanes = _mm256_movemask_ps(_mm256_castsi256_ps(hit));
+    if (hit_lanes == 0) {
+        lanes->turn = _mm256_add_epi32(lanes->turn, one);
+        assert(_mm256_testz_si256(
+            _mm256_cmpgt_epi32(lanes->turn, _mm256_set1_epi32(TURN_TYPE_COUNT - 1)), lanes->live
+        ));
+        return;
+    }
+
+    alignas(32) u32 turns[TWOPHASE_BATCH_LANES];
+    _mm256_store_si256((__m256i*) turns, lanes->turn);
+    for (u32 hits = hit_lanes; hits != 0; hits &= hits - 1) {
+        int lane = __builtin_ctz(hits);
+        assert(lanes->lengths[lane] < TWOPHASE_PHASE1_MAX_LENGTH);
+        u64 offset = (u64) lanes->cube_of[lane] * TWOPHASE_PHASE1_MAX_LENGTH + lanes->lengths[lane];
+        batch->moves[offset] = turns[lane];
+        lanes->lengths[lane]++;
+    }
+
+    // (closer + 2) % 3
+    __m256i after = _mm256_add_epi32(lanes->closer, two);
+    after = _mm256_sub_epi32(after, _mm256_and_si256(_mm256_cmpgt_epi32(after, two), three));
+
+    lanes->twist = _mm256_blendv_epi8(lanes->twist, lanes->next_twist, hit);
+    lanes->flip = _mm256_blendv_epi8(lanes->flip, lanes->next_flip, hit);
+    lanes->slice = _mm256_blendv_epi8(lanes->slice, lanes->next_slice, hit);
+    lanes->closer = _mm256_blendv_epi8(lanes->closer, after, hit);
+    lanes->turn = _mm256_andnot_si256(hit, _mm256_add_epi32(lanes->turn, one));
+
+    __m256i solved = _mm256_and_si256(
+        _mm256_cmpeq_epi32(_mm256_or_si256(lanes->twist, lanes->flip), _mm256_setzero_si256()),
+        _mm256_cmpeq_epi32(lanes->slice, _mm256_set1_epi32(TWOPHASE_SLICE_SOLVED))
+    );
+    lanes->solved_lanes = _mm256_movemask_ps(_mm256_castsi256_ps(_mm256_and_si256(solved, hit)));
+}
+
+TWOPHASE_AVX2 static void TwoPhasePhase1BatchAVX2(
+    TwoPhaseTables* tables, TwoPhaseCubie* cubies, u32 count, u8* lengths, enum8(TurnType)* moves
+) {
+    TwoPhaseBatch batch = {
+        .tables = tables, .cubies = cubies, .count = count, .next = 0, .lengths = lengths, .moves = moves
+    };
+
+    // Every lane starts out solved and idle, so the first refill fills them
+    TwoPhaseLanes groups[TWOPHASE_BATCH_GROUPS];
+    for (int g = 0; g < TWOPHASE_BATCH_GROUPS; g++) {
+        TwoPhaseLanes* lanes = &groups[g];
+        lanes->twist = _mm256_setzero_si256();
+        lanes->flip = _mm256_setzero_si256();
+        lanes->slice = _mm256_set1_epi32(TWOPHASE_SLICE_SOLVED);
+        lanes->closer = _mm256_setzero_si256();
+        lanes->turn = _mm256_setzero_si256();
+        lanes->live = _mm256_setzero_si256();
+        lanes->solved_lanes = Bit(TWOPHASE_BATCH_LANES) - 1;
+        for (int lane = 0; lane < TWOPHASE_BATCH_LANES; lane++) {
+            lanes->cube_of[lane] = TWOPHASE_BATCH_IDLE;
+            lanes->lengths[lane] = 0;
+        }
+    }
+
+    for (;;) {
+        bool any_live = false;
+        for (int g = 0; g < TWOPHASE_BATCH_GROUPS; g++) {
+            if (groups[g].solved_lanes != 0) TwoPhaseLanesRefill(&batch, &groups[g]);
+            any_live |= !_mm256_testz_si256(groups[g].live, groups[g].live);
+        }
+        if (!any_live) break;
+
+        // All the probes first, they don't depend on each other so their
+        // misses can all be waited on at once
+        for (int g = 0; g < TWOPHASE_BATCH_GROUPS; g++) TwoPhaseLanesProbe(tables, &groups[g]);
+        for (int g = 0; g < TWOPHASE_BATCH_GROUPS; g++) TwoPhaseLanesStep(&batch, &groups[g]);
+    }
+}
+#endif
+
+// INTERLEAVED ////////////////////////////////////////////////////////////////
+// The same walk for one cube at a time, but written as a little state
+// machine that stops wherever it would wait on memory. Before reading a
+// flipslice's class or a distance word it prefetches it and hands back
+// control, and the scheduler goes round the other walks in flight before
+// coming back. With enough of them going, by the time a walk resumes its
+// line has arrived, so the core spends its time on misses that are all in
+// flight together instead of waiting on each one in turn. No vectors needed,
+// so it works anywhere.
+//
+// Move tables and twist_conj are small enough to stay in cache and are read
+// straight away.
+
+typedef enum {
+    TWOPHASE_WALK_CLASS,
+    TWOPHASE_WALK_DISTANCE,
+    TWOPHASE_WALK_DONE
+} TwoPhaseWalkState;
+
+// Turn a walk is on before it knows its own distance
+#define TWOPHASE_WALK_START UINT8_MAX
+
+typedef struct {
+    enum8(TwoPhaseWalkState) state;
+    u32 cube;
+    u16 twist;
+    u16 flip;
+    u16 slice;
+    u8 closer;
+    u8 turn;
+    u8 length;
+
+    // The state being looked up, where turn leads
+    u16 next_twist;
+    u16 next_flip;
+    u16 next_slice;
+    u32 flipslice;
+    u64 index;
+} TwoPhaseWalk;
+
+static void TwoPhaseWalkProbe(TwoPhaseTables* tables, TwoPhaseWalk* walk, u16 twist, u16 flip, u16 slice) {
+    walk->next_twist = twist;
+    walk->next_flip = flip;
+    walk->next_slice = slice;
+    walk->flipslice = slice * TWOPHASE_FLIP_COUNT + flip;
+    __builtin_prefetch(&tables->flipslice_classes[walk->flipslice]);
+    __builtin_prefetch(&tables->flipslice_syms[walk->flipslice]);
+    walk->state = TWOPHASE_WALK_CLASS;
+}
+
+static void TwoPhaseWalkNextTurn(TwoPhaseTables* tables, TwoPhaseWalk* walk) {
+    assert(walk->turn < TURN_TYPE_COUNT);
+    TwoPhaseWalkProbe(
+        tables, walk,
+        tables->twist_moves[walk->twist * TURN_TYPE_COUNT + walk->turn],
+        tables->flip_moves[walk->flip * TURN_TYPE_COUNT + walk->turn],
+        tables->slice_moves[walk->slice * TURN_TYPE_COUNT + walk->turn]
+    );
+}
+
+// False when the cube is solved already and there's nothing to walk
+static bool TwoPhaseWalkStart(TwoPhaseTables* tables, TwoPhaseWalk* walk, TwoPhaseCubie* cubie, u32 cube) {
+    walk->cube = cube;
+    walk->twist = TwoPhaseTwist(cubie);
+    walk->flip = TwoPhaseFlip(cubie);
+    walk->slice = TwoPhaseSlice(cubie);
+    walk->length = 0;
+    walk->turn = TWOPHASE_WALK_START;
+    if (walk->twist == 0 && walk->flip == 0 && walk->slice == TWOPHASE_SLICE_SOLVED) return false;
+
+    TwoPhaseWalkProbe(tables, walk, walk->twist, walk->flip, walk->slice);
+    return true;
+}
+
+// Runs the walk up to its next prefetch
+static void TwoPhaseWalkResume(TwoPhaseTables* tables, TwoPhaseWalk* walk, enum8(TurnType)* moves) {
+    switch (walk->state) {
+        case TWOPHASE_WALK_CLASS: {
+            u64 class = tables->flipslice_classes[walk->flipslice];
+            u8 sym = tables->flipslice_syms[walk->flipslice];
+            u16 twist = tables->twist_conj[walk->next_twist * TWOPHASE_SYM_COUNT + sym];
+            walk->index = class * TWOPHASE_TWIST_COUNT + twist;
+            __builtin_prefetch(&tables->phase1_distances[walk->index / TWOPHASE_WORD_ENTRIES]);
+            walk->state = TWOPHASE_WALK_DISTANCE;
+        } break;
+
+        case TWOPHASE_WALK_DISTANCE: {
+            u8 distance = TwoPhaseGetDistance(tables->phase1_distances, walk->index);
+            if (walk->turn == TWOPHASE_WALK_START) {
+                walk->closer = (distance + 2) % 3;
+                walk->turn = 0;
+            } else if (distance == walk->closer) {
+                assert(walk->length < TWOPHASE_PHASE1_MAX_LENGTH);
+                moves[(u64) walk->cube * TWOPHASE_PHASE1_MAX_LENGTH + walk->length++] = walk->turn;
+                walk->twist = walk->next_twist;
+                walk->flip = walk->next_flip;
+                walk->slice = walk->next_slice;
+                walk->closer = (walk->closer + 2) % 3;
+                walk->turn = 0;
+                if (walk->twist == 0 && walk->flip == 0 && walk->slice == TWOPHASE_SLICE_SOLVED) {
+                    walk->state = TWOPHASE_WALK_DONE;
+                    break;
+                }
+            } else {
+                walk->turn++;
+            }
+            TwoPhaseWalkNextTurn(tables, walk);
+        } break;
+
+        default:
+            assert(false && "Resumed a finished walk!");
+    }
+}
+
+void TwoPhasePhase1Interleaved(
+    TwoPhaseTables* tables, TwoPhaseCubie* cubies, u32 count, u8* lengths, enum8(TurnType)* moves, u32 in_flight
+) {
+    assert(in_flight > 0 && in_flight <= TWOPHASE_MAX_IN_FLIGHT);
+    TraceBegin("two phase phase 1 interleaved");
+
+    TwoPhaseWalk walks[TWOPHASE_MAX_IN_FLIGHT];
+    u32 next = 0;
+    u32 running = 0;
+    for (u32 w = 0; w < in_flight; w++) {
+        walks[w].state = TWOPHASE_WALK_DONE;
+        while (next < count) {
+            u32 cube = next++;
+            if (TwoPhaseWalkStart(tables, &walks[w], &cubies[cube], cube)) {
+                running++;
+                break;
+            }
+            lengths[cube] = 0;
+        }
+    }
+
+    // Round and round, each walk gets one step between prefetches per lap
+    while (running > 0) {
+        for (u32 w = 0; w < in_flight; w++) {
+            TwoPhaseWalk* walk = &walks[w];
+            if (walk->state == TWOPHASE_WALK_DONE) continue;
+
+            TwoPhaseWalkResume(tables, walk, moves);
+            if (walk->state != TWOPHASE_WALK_DONE) continue;
+
+            lengths[walk->cube] = walk->length;
+            running--;
+            while (next < count) {
+                u32 cube = next++;
+                if (TwoPhaseWalkStart(tables, walk, &cubies[cube], cube)) {
+                    running++;
+                    break;
+                }
+                lengths[cube] = 0;
+            }
+        }
+    }
+
+    TraceEnd("two phase phase 1 interleaved");
+}
+
+void TwoPhasePhase1Batch(
+    TwoPhaseTables* tables, TwoPhaseCubie* cubies, u32 count, u8* lengths, enum8(TurnType)* moves
+) {
+    TraceBegin("two phase phase 1 batch");
+#ifdef TWOPHASE_X86
+    if (CpuLevelGet() >= CPU_LEVEL_AVX2) {
+        TwoPhasePhase1BatchAVX2(tables, cubies, count, lengths, moves);
+        TraceEnd("two phase phase 1 batch");
+        return;
+    }
+#endif
+    TwoPhasePhase1BatchScalar(tables, cubies, count, lengths, moves);
+    TraceEnd("two phase phase 1 batch");
+}
+
+// Each cube's starting phase 1 index << 32 | its place in cubies, sorted.
+// The index is class major, so cubes end up grouped by flipslice class and
+// within a class in the order their distances are stored.
+static u64* TwoPhaseSortKeys(Arena* arena, TwoPhaseTables* tables, TwoPhaseCubie* cubies, u32 count) {
+    assert(TWOPHASE_PHASE1_ENTRY_COUNT <= 1ull << (TWOPHASE_SORT_DIGIT_BITS * TWOPHASE_SORT_PASSES));
+
+    u64* keys = (u64*) _ArenaPush(arena, (u64) count * sizeof(u64), alignof(u64), false);
+    u64 arena_start = arena->used;
+    u64* scratch = (u64*) _ArenaPush(arena, (u64) count * sizeof(u64), alignof(u64), false);
+    u32* starts = (u32*) _ArenaPush(arena, TWOPHASE_SORT_DIGITS * sizeof(u32), alignof(u32), false);
+
+    for (u32 i = 0; i < count; i++) {
+        TwoPhaseCubie* cubie = &cubies[i];
+        u64 index = TwoPhasePhase1Index(tables, TwoPhaseTwist(cubie), TwoPhaseFlip(cubie), TwoPhaseSlice(cubie));
+        keys[i] = index << 32 | i;
+    }
+
+    // An even number of passes so it ends back in keys
+    u64* from = keys;
+    u64* to = scratch;
+    for (int pass = 0; pass < TWOPHASE_SORT_PASSES; pass++) {
+        u32 shift = 32 + pass * TWOPHASE_SORT_DIGIT_BITS;
+        MemZero(starts, TWOPHASE_SORT_DIGITS * sizeof(u32));
+        for (u32 i = 0; i < count; i++) {
+            starts[(from[i] >> shift) & (TWOPHASE_SORT_DIGITS - 1)]++;
+        }
+
+        u32 total = 0;
+        for (u32 d = 0; d < TWOPHASE_SORT_DIGITS; d++) {
+            u32 bucket = starts[d];
+            starts[d] = total;
+            total += bucket;
+        }
+
+        for (u32 i = 0; i < count; i++) {
+            to[starts[(from[i] >> shift) & (TWOPHASE_SORT_DIGITS - 1)]++] = from[i];
+        }
+        u64* swap = from;
+        from = to;
+        to = swap;
+    }
+    assert(from == keys);
+
+    arena->used = arena_start;
+    return keys;
+}
+
+void TwoPhasePhase1Sorted(
+    Arena* arena, TwoPhaseTables* tables, TwoPhaseCubie* cubies, u32 count, u8* lengths, enum8(TurnType)* moves,
+    u32 in_flight
+) {
+    u64 arena_start = arena->used;
+
+    TraceBegin("two phase phase 1 sort");
+    u64* keys = TwoPhaseSortKeys(arena, tables, cubies, count);
+    TwoPhaseCubie* sorted = ArenaPushArray(arena, count, TwoPhaseCubie);
+    for (u32 k = 0; k < count; k++) sorted[k] = cubies[(u32) keys[k]];
+    TraceEnd("two phase phase 1 sort");
+
+    // Walked into their sorted places and put back after, same as the 2x2
+    u8* sorted_lengths = (u8*) _ArenaPush(arena, count, 1, false);
+    enum8(TurnType)* sorted_moves = (u8*) _ArenaPush(arena, (u64) count * TWOPHASE_PHASE1_MAX_LENGTH, 1, false);
+    if (in_flight == 0) {
+        TwoPhasePhase1Batch(tables, sorted, count, sorted_lengths, sorted_moves);
+    } else {
+        TwoPhasePhase1Interleaved(tables, sorted, count, sorted_lengths, sorted_moves, in_flight);
+    }
+
+    TraceBegin("two phase phase 1 restore");
+    for (u32 k = 0; k < count; k++) {
+        u32 i = (u32) keys[k];
+        lengths[i] = sorted_lengths[k];
+        MemCopy(
+            &moves[(u64) i * TWOPHASE_PHASE1_MAX_LENGTH], &sorted_moves[(u64) k * TWOPHASE_PHASE1_MAX_LENGTH],
+            sorted_lengths[k]
+        );
+    }
+    TraceEnd("two phase phase 1 restore");
+
+    arena->used = arena_start;
+}
+
+typedef enum {
+    TWOPHASE_BENCH_SCALAR,
+    TWOPHASE_BENCH_BATCH,
+    TWOPHASE_BENCH_INTERLEAVED,
+    TWOPHASE_BENCH_SORTED_BATCH,
+    TWOPHASE_BENCH_SORTED_INTERLEAVED,
+
+    TWOPHASE_BENCH_COUNT
+} TwoPhaseBenchMethod;
+
+void TwoPhasePhase1Benchmark(Arena* arena, u32 count, u64 seed, u32 in_flight) {
+    TwoPhaseTables tables;
+    TwoPhaseTablesInit(arena, &tables, TWOPHASE_CACHE_PATH, ThreadCount());
+
+    printf("----- PHASE 1 BATCH BENCHMARK -----\n");
+
+    TwoPhaseCubie* cubies = ArenaPushArray(arena, count, TwoPhaseCubie);
+    // HashU64 keeps 0 at 0, so the seed is mixed with something first
+    u64 random = HashU64(seed ^ 0x9E3779B97F4A7C15ull);
+    for (u32 i = 0; i < count; i++) {
+        u64 a = random = HashU64(random);
+        u64 b = random = HashU64(random);
+        TwoPhaseCubieFromCoords(
+            &cubies[i], a % TWOPHASE_CPERM_COUNT, (a >> 16) % TWOPHASE_EDGE_PERM_COUNT,
+            b % TWOPHASE_TWIST_COUNT, (b >> 16) % TWOPHASE_FLIP_COUNT
+        );
+    }
+
+    u64 move_count = (u64) count * TWOPHASE_PHASE1_MAX_LENGTH;
+    u8* lengths[TWOPHASE_BENCH_COUNT];
+    enum8(TurnType)* moves[TWOPHASE_BENCH_COUNT];
+    double seconds[TWOPHASE_BENCH_COUNT];
+    for (int m = 0; m < TWOPHASE_BENCH_COUNT; m++) {
+        lengths[m] = ArenaPushArray(arena, count, u8);
+        moves[m] = ArenaPushArray(arena, move_count, u8);
+    }
+
+    // Taking turns and keeping the best of each, a single run of any of
+    // them can be a good 20% off on a busy machine
+    for (int round = 0; round < TWOPHASE_BENCH_ROUNDS; round++) {
+        for (int m = 0; m < TWOPHASE_BENCH_COUNT; m++) {
+            double start = TimeSeconds();
+            switch (m) {
+                case TWOPHASE_BENCH_SCALAR:
+                    TwoPhasePhase1BatchScalar(&tables, cubies, count, lengths[m], moves[m]);
+                    break;
+                case TWOPHASE_BENCH_BATCH:
+                    TwoPhasePhase1Batch(&tables, cubies, count, lengths[m], moves[m]);
+                    break;
+                case TWOPHASE_BENCH_INTERLEAVED:
+                    TwoPhasePhase1Interleaved(&tables, cubies, count, lengths[m], moves[m], in_flight);
+                    break;
+                case TWOPHASE_BENCH_SORTED_BATCH:
+                    TwoPhasePhase1Sorted(arena, &tables, cubies, count, lengths[m], moves[m], 0);
+                    break;
+                case TWOPHASE_BENCH_SORTED_INTERLEAVED:
+                    TwoPhasePhase1Sorted(arena, &tables, cubies, count, lengths[m], moves[m], in_flight);
+                    break;
+            }
+            double elapsed = TimeSeconds() - start;
+            if (round == 0 || elapsed < seconds[m]) seconds[m] = elapsed;
+        }
+    }
+
+    u32 mismatched[TWOPHASE_BENCH_COUNT] = { 0 };
+    u64 total_length = 0;
+    for (u32 i = 0; i < count; i++) {
+        u64 offset = (u64) i * TWOPHASE_PHASE1_MAX_LENGTH;
+        u8 length = lengths[TWOPHASE_BENCH_SCALAR][i];
+        for (int m = 0; m < TWOPHASE_BENCH_COUNT; m++) {
+            if (lengths[m][i] != length
+                || MemCmp(&moves[m][offset], &moves[TWOPHASE_BENCH_SCALAR][offset], length) != 0) {
+                mismatched[m]++;
+            }
+        }
+        total_length += length;
+    }
+
+    printf(
+        "Cubes: %u, seed %llu, %.2f turns on average\n", count, (unsigned long long) seed,
+        (double) total_length / count
+    );
+    char batch_name[32];
+    char interleaved_name[32];
+    char sorted_batch_name[48];
+    char sorted_interleaved_name[48];
+    snprintf(batch_name, sizeof(batch_name), "Batch %s", CPU_LEVEL_NAMES[CpuLevelGet()]);
+    snprintf(interleaved_name, sizeof(interleaved_name), "Interleaved %u", in_flight);
+    snprintf(sorted_batch_name, sizeof(sorted_batch_name), "Sorted %s", batch_name);
+    snprintf(sorted_interleaved_name, sizeof(sorted_interleaved_name), "Sorted %s", interleaved_name);
+    const char* names[TWOPHASE_BENCH_COUNT] = {
+        "Scalar", batch_name, interleaved_name, sorted_batch_name, sorted_interleaved_name
+    };
+    for (int m = 0; m < TWOPHASE_BENCH_COUNT; m++) {
+        printf(
+            "%-23s %f seconds, %.0f cubes/second (%.2fx), %u differ\n", names[m], seconds[m],
+            count / seconds[m], seconds[TWOPHASE_BENCH_SCALAR] / seconds[m], mismatched[m]
+        );
+    }
+    printf("\n");
+}
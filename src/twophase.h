@@ -0,0 +1,218 @@
+#ifndef TWOPHASE_H
+#define TWOPHASE_H
+
+
+#include "core.h"
+#include "cube.h"
+
+
+#define TWOPHASE_CORNER_COUNT 8
+#define TWOPHASE_EDGE_COUNT 12
+
+// Phase 1 coordinates: corner twists (3^7), edge flips (2^11) and which four
+// places hold the middle layer edges (12 choose 4)
+#define TWOPHASE_TWIST_COUNT 2187
+#define TWOPHASE_FLIP_COUNT 2048
+#define TWOPHASE_SLICE_COUNT 495
+#define TWOPHASE_FLIPSLICE_COUNT (TWOPHASE_FLIP_COUNT * TWOPHASE_SLICE_COUNT)
+
+// Phase 2 coordinates: corner permutation (8!), the eight top and bottom
+// layer edges (8!) and the middle layer edges (4!)
+#define TWOPHASE_CPERM_COUNT 40320
+#define TWOPHASE_EPERM_COUNT 40320
+#define TWOPHASE_SLICE_PERM_COUNT 24
+
+// All twelve edges anywhere (12!), only used to pick random states
+#define TWOPHASE_EDGE_PERM_COUNT 479001600u
+
+// U and D any way, everything else only as a double
+#define TWOPHASE_PHASE2_TURN_COUNT 10
+
+// Symmetries that keep U and D on the U-D axis: 4 quarter turns about it,
+// upside down or not, mirrored or not. Flip and slice together fall into
+// this many classes under them.
+#define TWOPHASE_SYM_COUNT 16
+
+// Those and the two thirds of a turn about the U-R-F corner, so every way
+// the cube can be held or mirrored. The first TWOPHASE_SYM_COUNT are the above.
+#define TWOPHASE_FULL_SYM_COUNT 48
+#define TWOPHASE_FLIPSLICE_CLASS_COUNT 64430
+
+// Exact phase 1 distance for every flipslice class and twist, 2 bits each
+#define TWOPHASE_PHASE1_ENTRY_COUNT ((u64) TWOPHASE_FLIPSLICE_CLASS_COUNT * TWOPHASE_TWIST_COUNT)
+#define TWOPHASE_PHASE1_WORD_COUNT ((TWOPHASE_PHASE1_ENTRY_COUNT + 15) / 16)
+
+// Everything TwoPhaseTablesInit pushes
+#define TWOPHASE_ARENA_SIZE Megabytes(48)
+
+// Where the tools keep the symmetry and phase 1 tables between runs
+#define TWOPHASE_CACHE_PATH "twophase.cache"
+
+// Sharded phase 1 builds, see TwoPhasePhase1Sharded
+#define TWOPHASE_DEFAULT_SHARDS 16
+#define TWOPHASE_MAX_SHARDS 1024
+#define TWOPHASE_SHARD_PATH_SIZE 1024
+
+// Everything a sharded build pushes, the tables and a shard to merge
+#define TWOPHASE_SHARDED_ARENA_SIZE (TWOPHASE_ARENA_SIZE + TWOPHASE_PHASE1_WORD_COUNT * sizeof(u32))
+
+// Longest solution the search can be asked for. Every state can be solved in
+// 20, so anything more is only there to make the first solution come faster.
+#define TWOPHASE_MAX_LENGTH 30
+
+#define TWOPHASE_NO_SOLUTION UINT8_MAX
+
+// TwoPhaseSolveUntil gave up when its stop function said to
+#define TWOPHASE_STOPPED (UINT8_MAX - 1)
+
+// Deepest the phase 1 table goes, so the longest phase 1 there is
+#define TWOPHASE_PHASE1_MAX_LENGTH 12
+
+// Most walks TwoPhasePhase1Interleaved can keep going at once
+#define TWOPHASE_MAX_IN_FLIGHT 64
+#define TWOPHASE_DEFAULT_IN_FLIGHT 24
+
+
+// The cube as pieces instead of stickers. Slots and pieces are numbered the
+// same as CUBE_CORNER_COLOUR_TABLE and CUBE_EDGE_COLOUR_TABLE. Twist is which
+// sticker of the slot (in table order) has the piece's white or yellow
+// sticker, flip is 1 when the piece's first sticker isn't on the slot's first.
+typedef struct {
+    u8 cp[TWOPHASE_CORNER_COUNT];
+    u8 co[TWOPHASE_CORNER_COUNT];
+    u8 ep[TWOPHASE_EDGE_COUNT];
+    u8 eo[TWOPHASE_EDGE_COUNT];
+} TwoPhaseCubie;
+
+// Move tables are [coordinate][turn], 18 turns for phase 1 coordinates and
+// TWOPHASE_PHASE2_TURN_COUNT for phase 2. Phase 2 pruning tables are the
+// exact distance to solved for a pair of coordinates, one byte each.
+//
+// Phase 1 is looked up by flipslice class: flipslice_classes and
+// flipslice_syms say which class a flip and slice is in and which symmetry
+// takes it to the class representative, twist_conj takes the twist along with
+// it. phase1_distances holds distance mod 3, which is enough when the search
+// always knows the distance of the state it came from.
+typedef struct {
+    u16* twist_moves;
+    u16* flip_moves;
+    u16* slice_moves;
+    u16* cperm_moves;
+    u16* eperm_moves;
+    u16* slice_perm_moves;
+
+    u16* twist_conj;
+    u16* flipslice_classes;
+    u8* flipslice_syms;
+    u32* class_reps;
+    u16* class_syms;
+    u32* phase1_distances;
+
+    u8* cperm_slice_prune;
+    u8* eperm_slice_prune;
+} TwoPhaseTables;
+
+
+extern const enum8(TurnType) TWOPHASE_PHASE2_TURNS[TWOPHASE_PHASE2_TURN_COUNT];
+
+
+// Turn and symmetry effects on cubies, enough for everything but solving.
+// TwoPhaseTablesInit calls it too.
+void TwoPhaseCubiesInit(void);
+
+// Loads the big tables from cache_path if it holds them, otherwise builds
+// them on thread_count threads and writes them there. NULL skips the cache.
+void TwoPhaseTablesInit(Arena* arena, TwoPhaseTables* tables, const char* cache_path, u32 thread_count);
+
+// Builds the phase 1 table in dir a layer at a time, each layer split into
+// shard_count runs of the table done by worker_count forked processes, and
+// writes the result to cache_path the way TwoPhaseTablesInit would. Every
+// shard is its own checksummed file so a worker that dies only loses its
+// shard, and running it again carries on from the last whole layer, keeping
+// any shards of the next already done. dir has to exist.
+bool TwoPhasePhase1Sharded(
+    Arena* arena, const char* dir, const char* cache_path, u32 shard_count, u32 worker_count
+);
+
+// One shard of the next layer of dir's build, for a worker that isn't one of
+// TwoPhasePhase1Sharded's, on another machine that sees dir say
+bool TwoPhasePhase1Shard(Arena* arena, const char* dir, u32 shard, u32 thread_count);
+
+void TwoPhaseCubieSolved(TwoPhaseCubie* cubie);
+bool TwoPhaseCubieFromCube(Cube* cube, TwoPhaseCubie* cubie);
+void TwoPhaseCubieToCube(TwoPhaseCubie* cubie, Cube* cube);
+void TwoPhaseCubieTurn(TwoPhaseCubie* cubie, TurnType turn);
+bool TwoPhaseCubieSolvable(TwoPhaseCubie* cubie);
+void TwoPhaseCubieConjugate(TwoPhaseCubie* cubie, u8 sym, TwoPhaseCubie* out);
+void TwoPhaseCubieFromCoords(TwoPhaseCubie* cubie, u16 cperm, u32 edge_perm, u16 twist, u16 flip);
+
+// Corner permutation and twist, under 2^27, and edge permutation and flip,
+// under 2^40. Together they're a unique number for every state.
+u32 TwoPhaseCornerCoord(TwoPhaseCubie* cubie);
+u64 TwoPhaseEdgeCoord(TwoPhaseCubie* cubie);
+
+u8 TwoPhaseLowerBound(TwoPhaseTables* tables, TwoPhaseCubie* cubie);
+u8 TwoPhaseSolve(TwoPhaseTables* tables, TwoPhaseCubie* cubie, u8 max_length, enum8(TurnType)* moves);
+
+// TwoPhaseSolve for callers with something better to do now and then. stop
+// is asked every so often during the search, and once it says true the
+// search gives up and returns TWOPHASE_STOPPED.
+typedef bool (*TwoPhaseStopFunction)(void* data);
+u8 TwoPhaseSolveUntil(
+    TwoPhaseTables* tables, TwoPhaseCubie* cubie, u8 max_length, enum8(TurnType)* moves,
+    TwoPhaseStopFunction stop, void* stop_data
+);
+
+// A shortest solution, however long that takes, which for some cubes is
+// hours. With a checkpoint path the search can be stopped with SIGINT or
+// SIGTERM and carries on from the file next time. The file is also brought up
+// to date whenever one of the search's roots (its first two turns) finishes
+// at least interval seconds after the last save. Returns TWOPHASE_STOPPED if
+// stopped.
+u8 TwoPhaseSolveOptimal(
+    TwoPhaseTables* tables, TwoPhaseCubie* cubie, enum8(TurnType)* moves, u32 thread_count,
+    const char* checkpoint_path, double interval
+);
+
+// Scrambles with scramble_length random turns from seed, solves that
+// optimally and checks the answer
+void TwoPhaseOptimalRun(
+    Arena* arena, u32 scramble_length, u64 seed, u32 thread_count, const char* checkpoint_path, double interval
+);
+
+#define TWOPHASE_DEFAULT_CHECKPOINT_INTERVAL 60
+
+// A shortest phase 1 for each of cubies[0, count): its length in lengths[i]
+// and its turns from moves[i * TWOPHASE_PHASE1_MAX_LENGTH]. Eight cubes at a
+// time in AVX2 lanes when the CPU level allows.
+void TwoPhasePhase1Batch(
+    TwoPhaseTables* tables, TwoPhaseCubie* cubies, u32 count, u8* lengths, enum8(TurnType)* moves
+);
+
+// The same as TwoPhasePhase1Batch, one cube at a time but with in_flight of
+// them going at once on this thread, each handing over to the next whenever
+// it would wait on memory
+void TwoPhasePhase1Interleaved(
+    TwoPhaseTables* tables, TwoPhaseCubie* cubies, u32 count, u8* lengths, enum8(TurnType)* moves, u32 in_flight
+);
+
+// Either of the above, TwoPhasePhase1Batch when in_flight is 0, with the
+// cubes radix sorted first by the phase 1 index they start at, which groups
+// them by flipslice class, and the answers put back in the given order after.
+// Scratch comes from arena and is given back before returning.
+void TwoPhasePhase1Sorted(
+    Arena* arena, TwoPhaseTables* tables, TwoPhaseCubie* cubies, u32 count, u8* lengths, enum8(TurnType)* moves,
+    u32 in_flight
+);
+
+// Phase 1 for count random cubes one at a time, as a batch and interleaved
+// in_flight at a time, each of those with and without sorting, timed and
+// checked against each other
+void TwoPhasePhase1Benchmark(Arena* arena, u32 count, u64 seed, u32 in_flight);
+
+// Results for five methods and TwoPhasePhase1Sorted's scratch
+#define TwoPhasePhase1BenchmarkArenaSize(count) (TWOPHASE_ARENA_SIZE + Megabytes(1) + \
+    (u64) (count) * (2 * sizeof(TwoPhaseCubie) + 2 * sizeof(u64) + 6 * (1 + TWOPHASE_PHASE1_MAX_LENGTH)))
+
+
+#endif  /* TWOPHASE_H */
@@ -0,0 +1,178 @@
+// Exhaustive checks of the solver's lookup tables. Each table in
+// VERIFY_TABLES says how many cases it has and how to check one of them, the
+// cases are then spread over threads in chunks. A case is a full setup and
+// solve on its own cube so there is nothing shared between threads except the
+// counters.
+//
+// The F2L table is checked for every case, from every slot and with the top
+// layer at every angle (AUF). OLL and PLL come from an algorithm set so those
+// are checked by painting every legal top layer state and solving it with the
+// set, which covers every AUF too.
+
+
+#include "verify.h"
+#include "cube.h"
+#include "solve.h"
+
+
+// Cases handed to a thread at a time
+#define VERIFY_CHUNK 16
+
+// Longest algorithm the loader takes plus up to three top layer turns either
+// side of it. A case that still doesn't fit fails rather than asserting.
+#define VERIFY_MOVE_LEN (ALG_MAX_LEN + 6)
+
+// Random walks for the hash, each of HASH_WALK_LEN turns
+#define HASH_WALK_COUNT 1024
+#define HASH_WALK_LEN 1000
+
+
+typedef struct {
+    Cube cube;
+
+    TurnType items[VERIFY_MOVE_LEN];
+    MoveStack moves;
+
+    u8 turns[HASH_WALK_LEN];
+    AlgSet* algs;
+} VerifyState;
+
+typedef struct {
+    const char* name;
+    u32 case_count;
+    bool (*check)(VerifyState* state, u32 index);
+    void (*describe)(u32 index);
+    bool needs_algs;
+} VerifyTable;
+
+// F2L: index = (lookup * 4 + slot) * 4 + auf
+static bool VerifyF2LCheck(VerifyState* state, u32 index) {
+    return F2LVerifyCase(&state->moves, &state->cube, index / 16, (index / 4) % 4, index % 4);
+}
+
+static void VerifyF2LDescribe(u32 index) {
+    printf("lookup %u, slot %u, auf %u", index / 16, (index / 4) % 4, index % 4);
+}
+
+// xorshift64*
+static u64 VerifyRandom(u64* state) {
+    u64 x = *state;
+    x ^= x >> 12;
+    x ^= x << 25;
+    x ^= x >> 27;
+    *state = x;
+    return x * 0x2545F4914F6CDD1Dull;
+}
+
+// Hash: every walk seeds from its index so a failure can be replayed
+static bool VerifyHashCheck(VerifyState* state, u32 index) {
+    u64 random = (index + 1) * 0x9E3779B97F4A7C15ull;
+    for (int i = 0; i < HASH_WALK_LEN; i++) {
+        state->turns[i] = VerifyRandom(&random) % TURN_TYPE_COUNT;
+    }
+    return CubeHashVerify(&state->cube, state->turns, HASH_WALK_LEN);
+}
+
+static void VerifyHashDescribe(u32 index) {
+    printf("walk %u", index);
+}
+
+static bool VerifyOLLCheck(VerifyState* state, u32 index) {
+    return OLLVerifyCase(&state->moves, &state->cube, state->algs, index);
+}
+
+static bool VerifyPLLCheck(VerifyState* state, u32 index) {
+    return PLLVerifyCase(&state->moves, &state->cube, state->algs, index);
+}
+
+static void VerifyLastLayerDescribe(u32 index) {
+    printf("state %u", index);
+}
+
+static const VerifyTable VERIFY_TABLES[] = {
+    { "f2l top layer", F2L_TOP_LAYER_LEN * 4 * 4, VerifyF2LCheck, VerifyF2LDescribe, false },
+    { "oll algset", OLL_CASE_LEN, VerifyOLLCheck, VerifyLastLayerDescribe, true },
+    { "pll algset", PLL_CASE_LEN, VerifyPLLCheck, VerifyLastLayerDescribe, true },
+    { "zobrist hash", HASH_WALK_COUNT, VerifyHashCheck, VerifyHashDescribe, false },
+};
+static const int VERIFY_TABLE_COUNT = sizeof(VERIFY_TABLES) / sizeof(VERIFY_TABLES[0]);
+
+
+typedef struct {
+    AlgSet* algs;
+    u32 table;
+    u32 next_chunk;
+    u32 failures;
+    u32 first_failure;
+} VerifyJob;
+
+static void VerifyWorker(void* data, u32 thread_index, u32 thread_count) {
+    (void) thread_index;
+    (void) thread_count;
+    VerifyJob* job = (VerifyJob*) data;
+    const VerifyTable* table = &VERIFY_TABLES[job->table];
+
+    VerifyState state;
+    CubeInit(&state.cube);
+    state.algs = job->algs;
+    MoveStack_init(&state.moves, state.items, VERIFY_MOVE_LEN);
+
+    for (;;) {
+        u32 start = __atomic_fetch_add(&job->next_chunk, 1, __ATOMIC_RELAXED) * VERIFY_CHUNK;
+        if (start >= table->case_count) break;
+        u32 end = MinU32(start + VERIFY_CHUNK, table->case_count);
+
+        for (u32 i = start; i < end; i++) {
+            if (table->check(&state, i)) continue;
+
+            // Keep the lowest failing case so the report doesn't depend on
+            // thread timing
+            __atomic_fetch_add(&job->failures, 1, __ATOMIC_RELAXED);
+            u32 first = __atomic_load_n(&job->first_failure, __ATOMIC_RELAXED);
+            while (i < first && !__atomic_compare_exchange_n(
+                &job->first_failure, &first, i, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED
+            )) {}
+        }
+    }
+}
+
+bool VerifyRun(AlgSet* algs, u32 thread_count) {
+    printf("----- VERIFY -----\n");
+    printf("Threads: %u\n", thread_count);
+
+    // Without a set every last layer case would fail, which says nothing
+    // about the set, so those tables are skipped and the run still fails
+    bool algs_loaded = algs != NULL && algs->algs != NULL;
+
+    bool passed = true;
+    for (int t = 0; t < VERIFY_TABLE_COUNT; t++) {
+        const VerifyTable* table = &VERIFY_TABLES[t];
+        if (table->needs_algs && !algs_loaded) {
+            printf("%-16s algset not loaded, skipped\n", table->name);
+            passed = false;
+            continue;
+        }
+
+        VerifyJob job = {0};
+        job.algs = algs;
+        job.table = t;
+        job.first_failure = UINT32_MAX;
+
+        double start = TimeSeconds();
+        ParallelRun(thread_count, VerifyWorker, &job);
+        double elapsed = TimeSeconds() - start;
+
+        if (job.failures == 0) {
+            printf("%-16s %6u cases ok (%f seconds)\n", table->name, table->case_count, elapsed);
+            continue;
+        }
+
+        passed = false;
+        printf("%-16s %6u / %u cases FAILED, first: ", table->name, job.failures, table->case_count);
+        table->describe(job.first_failure);
+        printf("\n");
+    }
+
+    printf(passed ? "All tables verified\n\n" : "Verification failed\n\n");
+    return passed;
+}
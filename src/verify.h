@@ -0,0 +1,15 @@
+#ifndef VERIFY_H
+#define VERIFY_H
+
+
+#include "core.h"
+#include "algset.h"
+
+
+// Checks every entry of every algorithm table from every starting angle, with
+// the last layer coming from algs. Nothing here can change at runtime so it
+// lives in tools, not the game.
+bool VerifyRun(AlgSet* algs, u32 thread_count);
+
+
+#endif  /* VERIFY_H */